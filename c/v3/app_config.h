@@ -5,9 +5,15 @@
 #ifndef APP_CONFIG_H
 #define APP_CONFIG_H
 
+#include <netinet/in.h>
 #include <stddef.h>
 #include <stdint.h>
 
+struct packet_capture;
+struct probe_cookie_key;
+struct result_log;
+struct target_list;
+
 /**
  * @struct app_config
  * @brief Unified, read-only configuration state parsed from CLI arguments.
@@ -15,15 +21,55 @@
 struct app_config
 {
     // Execution State
-    uint32_t quantity;   /**< Number of packets to send */
-    uint8_t sleep_time;  /**< Delay in seconds between packets */
-    const char *payload; /**< Pointer to user-defined payload string */
-    size_t payload_len;  /**< Explicit byte boundary of the payload */
+    uint32_t quantity;         /**< Number of packets to send */
+    uint8_t sleep_time;        /**< Delay in seconds between packets (or between batches) */
+    uint32_t batch_size;       /**< Packets handed to the kernel per `sendmmsg` call (1 = one `sendto` per packet) */
+    uint64_t rate_pps;         /**< Target packets per second (0 = not set; overrides @ref sleep_time) */
+    uint64_t rate_bps;         /**< Target IPv4 bits per second (0 = not set; overrides @ref sleep_time) */
+    uint32_t burst;            /**< Token bucket depth in packets that may go out back-to-back after idle */
+    uint32_t reply_timeout_ms; /**< How long each request waits for its reply before it counts as lost */
+    uint32_t threads;          /**< Worker threads, each with its own socket and identifier (1 = single-threaded) */
+    uint8_t quiet;             /**< 1 to print only the summary, not a line per reply or timeout */
+    uint32_t report_interval;  /**< Seconds between live statistics lines (0 = final report only) */
+    const uint8_t *payload;    /**< Payload bytes (text, pattern, random or a mapped file; not terminated) */
+    size_t payload_len;        /**< Explicit byte boundary of the payload */
+    uint8_t payload_stamp;     /**< 1 to rewrite the payload's leading bytes with a per-packet `payload_stamp` */
+    uint32_t pmtu_max_size;    /**< Largest datagram a path MTU discovery tries, instead of a normal run (0 = no discovery) */
+    uint32_t traceroute_hops;  /**< Highest TTL a traceroute probes, instead of a normal run (0 = no traceroute) */
+    const char *replay_path;   /**< pcap or pcapng file whose IPv4/ICMP datagrams are re-sent, instead of a normal run (NULL = no replay) */
+    double replay_speed;       /**< Replay time scale: 1 = original timing, 2 = twice as fast, 0 = back to back */
+
+    // Transmit Backend
+    const char *tx_ring_ifname;   /**< Interface for the PACKET_TX_RING backend (NULL = raw socket `sendmmsg`) */
+    const char *xdp_ifname;       /**< Interface for the AF_XDP backend (NULL = not used) */
+    uint32_t xdp_queue;           /**< Interface queue the AF_XDP socket binds */
+    uint8_t next_hop_mac[6];      /**< Next-hop hardware address written into every frame (zeroes on loopback) */
+    uint8_t use_uring;            /**< 1 to drive the raw socket through io_uring instead of `sendmmsg`/`recvfrom` */
+    uint8_t uring_sq_poll;        /**< 1 to let a kernel thread poll the io_uring submission queue */
+    uint8_t kernel_timestamps;    /**< 1 to take round trips from SO_TIMESTAMPING stamps instead of clock_gettime() */
+    const char *timestamp_ifname; /**< Interface whose NIC stamps in hardware (NULL = kernel software stamps only) */
+
+    // Stateless Probing
+    const struct probe_cookie_key *cookie_key; /**< SipHash key replies are validated with instead of an in-flight table (NULL = stateful) */
+
+    // Result Output
+    const char *result_log_path;    /**< Binary per-probe result log to create (NULL = not written) */
+    struct result_log *result_log;  /**< The open log every worker streams into, or NULL */
+    const char *capture_path;       /**< pcapng capture of every sent and received packet to create (NULL = not written) */
+    struct packet_capture *capture; /**< The open capture every worker streams into, or NULL */
 
     // IPv4 Configuration
-    const char *ip_v4_src_addr; /**< Source IPv4 address string (e.g., "127.0.0.1") */
-    const char *ip_v4_dst_addr; /**< Destination IPv4 address string */
-    uint8_t ip_v4_ttl;          /**< IPv4 Time To Live (TTL) */
+    const char *ip_v4_src_addr;        /**< Source IPv4 address string (e.g., "127.0.0.1"), for display */
+    struct in_addr ip_v4_src;          /**< Source address, validated and converted once while parsing */
+    const char *ip_v4_dst_addr;        /**< Destination IPv4 address string (last `-d` given, for display) */
+    const struct target_list *targets; /**< Every destination, parsed to binary and permuted once */
+    uint8_t ip_v4_ttl;                 /**< IPv4 Time To Live (TTL), also the IPv6 hop limit */
+    uint8_t dont_fragment;             /**< 1 to set the IPv4 Don't Fragment flag (IPv6 routers never fragment) */
+    uint32_t fragment_mtu;             /**< Largest datagram sent whole; bigger ones are split into fragments this size (0 = never) */
+
+    // IPv6 Configuration (used when the targets are IPv6)
+    const char *ip_v6_src_addr; /**< Source IPv6 address string (e.g., "::1"), for display */
+    struct in6_addr ip_v6_src;  /**< Source address, validated and converted once while parsing */
 
     // ICMPv4 Configuration
     uint8_t icmp_v4_type;        /**< ICMP message type (e.g., Echo Request) */
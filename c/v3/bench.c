@@ -0,0 +1,687 @@
+/**
+ * @file bench.c
+ * @brief Benchmark harness: packet builder and checksum micro-benchmarks plus an end-to-end loopback run.
+ *
+ * Every result is one JSON object per line on stdout, so two runs can be diffed or fed to a
+ * regression check. Every checksum kernel is first cross-checked against @ref compute_checksum;
+ * any mismatch is reported and makes the harness exit with failure before anything is timed.
+ * Micro-benchmarks sweep the payload sizes in @ref bench_payload_sizes; the end-to-end run needs
+ * root (raw sockets) and is reported as an error line otherwise.
+ *
+ * Build next to the main executable (each has its own `main`):
+ * @code
+ * gcc -std=gnu17 -O2 -pthread $(ls *.c | grep -v -e '^bench.c$' -e '^result_export.c$') -o ip_stack_v3
+ * gcc -std=gnu17 -O2 -pthread $(ls *.c | grep -v -e '^main.c$' -e '^result_export.c$') -o ip_stack_v3_bench
+ * @endcode
+ *
+ * @author Jim Diroff II
+ */
+#include "app_config.h"
+#include "checksum.h"
+#include "icmp_v4.h"
+#include "ip_common.h"
+#include "ip_v4.h"
+#include "ip_v6.h"
+#include "packet_builder.h"
+#include "packet_parser.h"
+#include "probe_cookie.h"
+#include "reassembly_cache.h"
+#include "target_list.h"
+#include "timestamp.h"
+#include "worker_pool.h"
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BASE10 10
+
+/**
+ * @brief Largest ICMPv4 Echo payload: the IPv4 maximum minus the IPv4 and ICMP headers.
+ */
+#define BENCH_MAX_PAYLOAD (IP_V4_MAX_PACKET_SIZE - sizeof(struct ip_v4_header) - sizeof(struct icmp_v4_header) - sizeof(struct icmp_v4_echo_header))
+
+/**
+ * @brief Room for the largest IPv6 datagram the sweep builds (its header is 20 bytes longer than IPv4's).
+ */
+#define BENCH_BUFFER_SIZE (IP_V4_MAX_PACKET_SIZE + 64)
+
+/**
+ * @brief Link MTU the fragmentation benchmark splits datagrams for.
+ */
+#define BENCH_FRAGMENT_MTU 1500
+
+/**
+ * @brief Fragments the benchmark train holds: enough for the largest datagram at @ref BENCH_FRAGMENT_MTU.
+ */
+#define BENCH_FRAGMENT_CAPACITY 64
+
+/**
+ * @brief Payload sizes every micro-benchmark is run at.
+ */
+static const size_t bench_payload_sizes[] = {0, 64, 576, 1500, 9000, BENCH_MAX_PAYLOAD};
+
+/**
+ * @brief Bytes the widest checksum kernel (32-byte AVX2 iterations) covers between two lane flushes.
+ */
+#define BENCH_VERIFY_FLUSH_BYTES ((size_t)CHECKSUM_VECTOR_FLUSH_INTERVAL * 32)
+
+/**
+ * @brief Every length below this is cross-checked, at every start offset up to @ref BENCH_VERIFY_OFFSETS.
+ */
+#define BENCH_VERIFY_SMALL 300
+
+/**
+ * @brief Start offsets (buffer misalignments) every small length is checked at.
+ */
+#define BENCH_VERIFY_OFFSETS 8
+
+/**
+ * @brief Large lengths straddling the lane flushes of every kernel; odd ones leave a trailing byte.
+ */
+static const size_t bench_verify_large[] = {
+    BENCH_VERIFY_FLUSH_BYTES / 2 - 1, BENCH_VERIFY_FLUSH_BYTES / 2 + 1, BENCH_VERIFY_FLUSH_BYTES - 1, BENCH_VERIFY_FLUSH_BYTES,
+    BENCH_VERIFY_FLUSH_BYTES + 1,     BENCH_VERIFY_FLUSH_BYTES + 31,    3 * BENCH_VERIFY_FLUSH_BYTES + 13,
+};
+
+/**
+ * @brief Results the compiler must not prove unused.
+ */
+static volatile uint64_t bench_sink;
+
+/**
+ * @struct bench_context
+ * @brief Inputs shared by every micro-benchmark at one payload size.
+ */
+struct bench_context
+{
+    uint8_t *buffer;                              /**< Scratch datagram buffer of @ref BENCH_BUFFER_SIZE bytes */
+    const char *payload;                          /**< Payload bytes */
+    size_t payload_len;                           /**< Payload size under test */
+    struct in_addr src;                           /**< IPv4 source */
+    struct in_addr dst;                           /**< IPv4 destination */
+    struct in6_addr src6;                         /**< IPv6 source */
+    struct in6_addr dst6;                         /**< IPv6 destination */
+    struct icmp_v4_echo_template tmpl4;           /**< Prebuilt IPv4 template for the patch benchmarks */
+    struct icmp_v6_echo_template tmpl6;           /**< Prebuilt IPv6 template for the patch benchmarks */
+    checksum_fn checksum;                         /**< Kernel under test for the checksum benchmarks */
+    struct probe_cookie_key cookie_key;           /**< Key for the stateless cookie benchmark (all zeroes) */
+    struct ip_fragment_train train;               /**< Fragment train for the fragmentation benchmark */
+    uint8_t *fragments;                           /**< The IPv4 template's fragments laid end to end, for the reassembly benchmark */
+    size_t fragment_len[BENCH_FRAGMENT_CAPACITY]; /**< Bytes of each fragment in @ref fragments */
+    uint32_t fragment_count;                      /**< Fragments in @ref fragments */
+    struct reassembly_cache reassembly;           /**< Cache for the reassembly benchmark */
+    uint16_t counter;                             /**< Varies the sequence/identification so no call is a no-op */
+};
+
+/**
+ * @brief One operation under test; runs once per call.
+ */
+typedef void (*bench_op)(struct bench_context *ctx);
+
+static void op_ip_v4_header(struct bench_context *ctx)
+{
+    bench_sink += build_ip_v4_header(ctx->buffer, BENCH_BUFFER_SIZE, "127.0.0.1", "127.0.0.1", IP_V4_STD_TTL, ctx->counter++, 0, IP_PROTO_ICMP_V4,
+                                     sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header) + ctx->payload_len);
+}
+
+static void op_ip_v4_header_addr(struct bench_context *ctx)
+{
+    bench_sink += build_ip_v4_header_addr(ctx->buffer, BENCH_BUFFER_SIZE, ctx->src, ctx->dst, IP_V4_STD_TTL, ctx->counter++, 0, IP_PROTO_ICMP_V4,
+                                          sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header) + ctx->payload_len);
+}
+
+static void op_ip_v6_header_addr(struct bench_context *ctx)
+{
+    bench_sink += build_ip_v6_header_addr(ctx->buffer, BENCH_BUFFER_SIZE, &ctx->src6, &ctx->dst6, IP_V4_STD_TTL, IP_V6_ICMP_V6,
+                                          sizeof(struct icmp_v6_header) + sizeof(struct icmp_v6_echo_header) + ctx->payload_len);
+}
+
+static void op_icmp_v4_echo_request(struct bench_context *ctx)
+{
+    bench_sink += build_icmp_v4_echo_request(ctx->buffer + sizeof(struct ip_v4_header), BENCH_BUFFER_SIZE - sizeof(struct ip_v4_header),
+                                             ICMP_V4_ECHO_REQUEST, ICMP_V4_ECHO_CODE, 0x1234, ctx->counter++, ctx->payload, ctx->payload_len);
+}
+
+static void op_icmp_v6_echo_request(struct bench_context *ctx)
+{
+    bench_sink += build_icmp_v6_echo_request(ctx->buffer + sizeof(struct ip_v6_header), BENCH_BUFFER_SIZE - sizeof(struct ip_v6_header),
+                                             ICMP_V6_ECHO_REQUEST, 0, 0x1234, ctx->counter++, ctx->payload, ctx->payload_len);
+}
+
+static void op_icmp_v4_echo_template(struct bench_context *ctx)
+{
+    struct icmp_v4_echo_template tmpl;
+    bench_sink += build_icmp_v4_echo_template(&tmpl, ctx->buffer, BENCH_BUFFER_SIZE, ctx->src, ctx->dst, IP_V4_STD_TTL, ICMP_V4_ECHO_REQUEST,
+                                              ICMP_V4_ECHO_CODE, 0x1234, ctx->counter++, 0, ctx->payload, ctx->payload_len);
+}
+
+static void op_icmp_v6_echo_template(struct bench_context *ctx)
+{
+    struct icmp_v6_echo_template tmpl;
+    bench_sink += build_icmp_v6_echo_template(&tmpl, ctx->buffer, BENCH_BUFFER_SIZE, &ctx->src6, &ctx->dst6, IP_V4_STD_TTL, 0, 0x1234,
+                                              ctx->counter++, ctx->payload, ctx->payload_len);
+}
+
+static void op_patch_v4(struct bench_context *ctx)
+{
+    patch_icmp_v4_echo_template(&ctx->tmpl4, ctx->counter, ctx->counter);
+    ctx->counter++;
+    bench_sink += ctx->tmpl4.icmp->checksum;
+}
+
+static void op_patch_v4_dst(struct bench_context *ctx)
+{
+    patch_icmp_v4_echo_template_dst(&ctx->tmpl4, htonl(INADDR_LOOPBACK + (ctx->counter++ & 0xFF)));
+    bench_sink += ctx->tmpl4.ip->checksum;
+}
+
+static void op_patch_v6(struct bench_context *ctx)
+{
+    patch_icmp_v6_echo_template(&ctx->tmpl6, ctx->counter++);
+    bench_sink += ctx->tmpl6.icmp->checksum;
+}
+
+static void op_patch_v6_dst(struct bench_context *ctx)
+{
+    ctx->dst6.s6_addr[15] = (uint8_t)ctx->counter++;
+    patch_icmp_v6_echo_template_dst(&ctx->tmpl6, &ctx->dst6);
+    bench_sink += ctx->tmpl6.icmp->checksum;
+}
+
+static void op_probe_cookie_make(struct bench_context *ctx)
+{
+    struct probe_cookie cookie;
+    bench_sink += probe_cookie_make(&ctx->cookie_key, &ctx->dst, sizeof(ctx->dst), 0x1234, ctx->counter, ctx->counter, &cookie);
+    ctx->counter++;
+}
+
+static void op_fragment_v4(struct bench_context *ctx)
+{
+    bench_sink += fragment_ip_v4_datagram(&ctx->train, ctx->tmpl4.buffer, ctx->tmpl4.length, BENCH_FRAGMENT_MTU);
+}
+
+static void op_reassemble_v4(struct bench_context *ctx)
+{
+    // Every call completes the datagram, so its slot is free again for the next one
+    const uint8_t *fragment = ctx->fragments;
+    const uint8_t *out;
+    size_t out_len = 0;
+    for (uint32_t i = 0; i < ctx->fragment_count; i++)
+    {
+        reassembly_cache_add_v4(&ctx->reassembly, fragment, ctx->fragment_len[i], 0, &out, &out_len);
+        fragment += ctx->fragment_len[i];
+    }
+    bench_sink += out_len;
+}
+
+static void op_parse_v4(struct bench_context *ctx)
+{
+    struct icmp_v4_view view;
+    bench_sink += (uint64_t)packet_parse_icmp_v4(ctx->tmpl4.buffer, ctx->tmpl4.length, PACKET_PARSE_VERIFY_IP | PACKET_PARSE_VERIFY_ICMP, &view) + view.data_len;
+}
+
+static void op_parse_v6(struct bench_context *ctx)
+{
+    struct icmp_v6_view view;
+    bench_sink += (uint64_t)packet_parse_icmp_v6((const uint8_t *)ctx->tmpl6.icmp, ctx->tmpl6.length - sizeof(struct ip_v6_header), &ctx->src6, &ctx->dst6,
+                                                 PACKET_PARSE_VERIFY_ICMP, &view) + view.data_len;
+}
+
+static void op_checksum(struct bench_context *ctx)
+{
+    // Checksums the ICMP segment, as the builders do
+    bench_sink += ctx->checksum(ctx->buffer + sizeof(struct ip_v4_header), sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header) + ctx->payload_len);
+}
+
+/**
+ * @struct bench_case
+ * @brief A named micro-benchmark; throughput is only reported for calls whose cost grows with the payload.
+ */
+struct bench_case
+{
+    const char *name; /**< Reported benchmark name */
+    bench_op op;      /**< Operation under test */
+    uint8_t scales;   /**< 1 if the call touches the payload, so a throughput is reported */
+};
+
+static const struct bench_case bench_builders[] = {
+    {"build_ip_v4_header", op_ip_v4_header, 0},
+    {"build_ip_v4_header_addr", op_ip_v4_header_addr, 0},
+    {"build_ip_v6_header_addr", op_ip_v6_header_addr, 0},
+    {"build_icmp_v4_echo_request", op_icmp_v4_echo_request, 1},
+    {"build_icmp_v6_echo_request", op_icmp_v6_echo_request, 1},
+    {"build_icmp_v4_echo_template", op_icmp_v4_echo_template, 1},
+    {"build_icmp_v6_echo_template", op_icmp_v6_echo_template, 1},
+    {"patch_icmp_v4_echo_template", op_patch_v4, 0},
+    {"patch_icmp_v4_echo_template_dst", op_patch_v4_dst, 0},
+    {"patch_icmp_v6_echo_template", op_patch_v6, 0},
+    {"patch_icmp_v6_echo_template_dst", op_patch_v6_dst, 0},
+    {"probe_cookie_make", op_probe_cookie_make, 0},
+    {"fragment_ip_v4_datagram", op_fragment_v4, 1},
+    {"reassembly_cache_add_v4", op_reassemble_v4, 1},
+    {"packet_parse_icmp_v4", op_parse_v4, 1},
+    {"packet_parse_icmp_v6", op_parse_v6, 1},
+};
+
+/**
+ * @brief Runs @p op in growing rounds until at least @p min_ns have elapsed.
+ * @param op         Operation under test.
+ * @param ctx        Its inputs.
+ * @param min_ns     Minimum measured time.
+ * @param iterations Output for the number of calls measured.
+ * @return Mean nanoseconds per call (including one indirect call of harness overhead).
+ */
+static double measure(bench_op op, struct bench_context *ctx, uint64_t min_ns, uint64_t *iterations)
+{
+    // 1. Warm caches and branch predictors outside the measurement
+    for (int i = 0; i < 64; i++)
+    {
+        op(ctx);
+    }
+
+    // 2. Double the round size until the clock read is negligible next to the work
+    uint64_t total = 0;
+    uint64_t elapsed = 0;
+    uint64_t round = 1;
+    while (elapsed < min_ns)
+    {
+        uint64_t start = timestamp_now_ns();
+        for (uint64_t i = 0; i < round; i++)
+        {
+            op(ctx);
+        }
+        elapsed += timestamp_now_ns() - start;
+        total += round;
+        round = (round < (1ULL << 24)) ? round * 2 : round;
+    }
+
+    *iterations = total;
+    return (double)elapsed / (double)total;
+}
+
+static void emit_micro(const char *suite, const char *name, const char *variant, size_t payload_len, uint64_t iterations, double ns_per_op, size_t bytes)
+{
+    printf("{\"suite\":\"%s\",\"name\":\"%s\",\"variant\":\"%s\",\"payload\":%zu,\"iterations\":%llu,\"ns_per_op\":%.3f,\"mops\":%.3f",
+           suite, name, variant, payload_len, (unsigned long long)iterations, ns_per_op, 1e3 / ns_per_op);
+    if (bytes > 0)
+    {
+        printf(",\"gbps\":%.3f", (double)bytes * 8.0 / ns_per_op);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+/**
+ * @brief Fills @p buffer with xorshift64 output (a fixed seed keeps failures reproducible), or with 0xFF bytes,
+ *        the input that drives every accumulator lane to its limit.
+ */
+static void fill_verify_buffer(uint8_t *buffer, size_t length, uint8_t all_ones)
+{
+    if (all_ones)
+    {
+        memset(buffer, 0xFF, length);
+        return;
+    }
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        buffer[i] = (uint8_t)(state >> 56);
+    }
+}
+
+/**
+ * @brief Compares one kernel against the reference on one range, reporting a mismatch on stderr.
+ * @return 1 on a mismatch, 0 otherwise.
+ */
+static uint32_t verify_case(const char *name, checksum_fn kernel, const uint8_t *buffer, size_t offset, size_t length, const char *pattern)
+{
+    uint16_t expected = compute_checksum(buffer + offset, length);
+    uint16_t actual = kernel(buffer + offset, length);
+    if (actual == expected)
+    {
+        return 0;
+    }
+
+    fprintf(stderr, "Error: Checksum kernel '%s' returned 0x%04x instead of 0x%04x (%s bytes, offset %zu, length %zu)\n", name, actual, expected, pattern, offset, length);
+    return 1;
+}
+
+/**
+ * @brief Cross-checks every available checksum kernel and the dispatched entry point against @ref compute_checksum
+ *        on random and all-ones buffers: every length below @ref BENCH_VERIFY_SMALL at every start offset below
+ *        @ref BENCH_VERIFY_OFFSETS, then @ref bench_verify_large at odd and even offsets.
+ * @return 0 if every kernel agreed, -1 otherwise.
+ */
+static int run_verify(void)
+{
+    size_t capacity = 3 * BENCH_VERIFY_FLUSH_BYTES + 64 + BENCH_VERIFY_OFFSETS;
+    uint8_t *buffer = malloc(capacity);
+    if (!buffer)
+    {
+        fprintf(stderr, "Error: Failed to allocate the verification buffer\n");
+        return -1;
+    }
+
+    int status = 0;
+    for (int k = CHECKSUM_KERNEL_REFERENCE + 1; k <= CHECKSUM_KERNEL_COUNT; k++)
+    {
+        // One pass per kernel except the reference itself, then the dispatched entry point as the last "kernel"
+        checksum_fn kernel = (k < CHECKSUM_KERNEL_COUNT) ? checksum_kernel_get((enum checksum_kernel)k) : compute_checksum_fast;
+        const char *name = (k < CHECKSUM_KERNEL_COUNT) ? checksum_kernel_name((enum checksum_kernel)k) : "dispatch";
+        if (!kernel)
+        {
+            continue;
+        }
+
+        uint32_t cases = 0;
+        uint32_t mismatches = 0;
+        for (uint8_t all_ones = 0; all_ones <= 1; all_ones++)
+        {
+            const char *pattern = all_ones ? "0xFF" : "random";
+            fill_verify_buffer(buffer, capacity, all_ones);
+
+            for (size_t length = 0; length < BENCH_VERIFY_SMALL; length++)
+            {
+                for (size_t offset = 0; offset < BENCH_VERIFY_OFFSETS; offset++)
+                {
+                    mismatches += verify_case(name, kernel, buffer, offset, length, pattern);
+                    cases++;
+                }
+            }
+
+            for (size_t i = 0; i < sizeof(bench_verify_large) / sizeof(bench_verify_large[0]); i++)
+            {
+                for (size_t offset = 0; offset < 2; offset++)
+                {
+                    mismatches += verify_case(name, kernel, buffer, offset, bench_verify_large[i], pattern);
+                    cases++;
+                }
+            }
+        }
+
+        printf("{\"suite\":\"verify\",\"name\":\"compute_checksum\",\"variant\":\"%s\",\"cases\":%u,\"mismatches\":%u}\n", name, cases, mismatches);
+        fflush(stdout);
+        if (mismatches > 0)
+        {
+            status = -1;
+        }
+    }
+
+    free(buffer);
+    return status;
+}
+
+/**
+ * @brief Sweeps every builder and every available checksum kernel across @ref bench_payload_sizes.
+ */
+static int run_micro(const char *payload, uint64_t min_ns)
+{
+    struct bench_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.buffer = calloc(1, BENCH_BUFFER_SIZE);
+    if (!ctx.buffer)
+    {
+        fprintf(stderr, "Error: Failed to allocate the benchmark buffer\n");
+        return -1;
+    }
+    ctx.payload = payload;
+    ctx.src.s_addr = htonl(INADDR_LOOPBACK);
+    ctx.dst.s_addr = htonl(INADDR_LOOPBACK);
+    ctx.src6 = in6addr_loopback;
+    ctx.dst6 = in6addr_loopback;
+
+    uint8_t *template_memory = calloc(2, BENCH_BUFFER_SIZE);
+    ctx.train.headers = calloc(BENCH_FRAGMENT_CAPACITY, IP_FRAGMENT_HEADER_SPACE);
+    ctx.train.iovecs = calloc(2 * BENCH_FRAGMENT_CAPACITY, sizeof(struct iovec));
+    ctx.train.capacity = BENCH_FRAGMENT_CAPACITY;
+    ctx.fragments = malloc(BENCH_FRAGMENT_CAPACITY * BENCH_FRAGMENT_MTU);
+    if (!template_memory || !ctx.train.headers || !ctx.train.iovecs || !ctx.fragments)
+    {
+        fprintf(stderr, "Error: Failed to allocate the benchmark buffer\n");
+        free(template_memory);
+        free(ctx.train.headers);
+        free(ctx.train.iovecs);
+        free(ctx.fragments);
+        free(ctx.buffer);
+        return -1;
+    }
+    if (reassembly_cache_init(&ctx.reassembly, REASSEMBLY_CACHE_SLOTS, TIMESTAMP_NS_PER_SEC) != 0)
+    {
+        free(template_memory);
+        free(ctx.train.headers);
+        free(ctx.train.iovecs);
+        free(ctx.fragments);
+        free(ctx.buffer);
+        return -1;
+    }
+
+    for (size_t s = 0; s < sizeof(bench_payload_sizes) / sizeof(bench_payload_sizes[0]); s++)
+    {
+        ctx.payload_len = bench_payload_sizes[s];
+        size_t segment = sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header) + ctx.payload_len;
+
+        // 1. Templates for the patch benchmarks, and a real segment for the checksum kernels
+        build_icmp_v4_echo_template(&ctx.tmpl4, template_memory, BENCH_BUFFER_SIZE, ctx.src, ctx.dst, IP_V4_STD_TTL, ICMP_V4_ECHO_REQUEST,
+                                    ICMP_V4_ECHO_CODE, 0x1234, 0, 0, ctx.payload, ctx.payload_len);
+        build_icmp_v6_echo_template(&ctx.tmpl6, template_memory + BENCH_BUFFER_SIZE, BENCH_BUFFER_SIZE, &ctx.src6, &ctx.dst6, IP_V4_STD_TTL, 0,
+                                    0x1234, 0, ctx.payload, ctx.payload_len);
+        build_icmp_v4_echo_template(&(struct icmp_v4_echo_template){0}, ctx.buffer, BENCH_BUFFER_SIZE, ctx.src, ctx.dst, IP_V4_STD_TTL,
+                                    ICMP_V4_ECHO_REQUEST, ICMP_V4_ECHO_CODE, 0x1234, 0, 0, ctx.payload, ctx.payload_len);
+
+        // The IPv4 template's fragments, flattened as they would arrive, for the reassembly benchmark
+        ctx.fragment_count = fragment_ip_v4_datagram(&ctx.train, ctx.tmpl4.buffer, ctx.tmpl4.length, BENCH_FRAGMENT_MTU);
+        uint8_t *fragment = ctx.fragments;
+        for (uint32_t f = 0; f < ctx.fragment_count; f++)
+        {
+            const struct iovec *iov = &ctx.train.iovecs[2 * f];
+            memcpy(fragment, iov[0].iov_base, iov[0].iov_len);
+            memcpy(fragment + iov[0].iov_len, iov[1].iov_base, iov[1].iov_len);
+            ctx.fragment_len[f] = iov[0].iov_len + iov[1].iov_len;
+            fragment += ctx.fragment_len[f];
+        }
+
+        // 2. Builders and patches
+        for (size_t b = 0; b < sizeof(bench_builders) / sizeof(bench_builders[0]); b++)
+        {
+            uint64_t iterations;
+            double ns = measure(bench_builders[b].op, &ctx, min_ns, &iterations);
+            emit_micro("builder", bench_builders[b].name, "default", ctx.payload_len, iterations, ns, bench_builders[b].scales ? segment : 0);
+        }
+
+        // 3. Every checksum kernel this CPU supports, then the dispatched entry point
+        for (int k = 0; k < CHECKSUM_KERNEL_COUNT; k++)
+        {
+            ctx.checksum = checksum_kernel_get((enum checksum_kernel)k);
+            if (!ctx.checksum)
+            {
+                continue;
+            }
+            uint64_t iterations;
+            double ns = measure(op_checksum, &ctx, min_ns, &iterations);
+            emit_micro("checksum", "compute_checksum", checksum_kernel_name((enum checksum_kernel)k), ctx.payload_len, iterations, ns, segment);
+        }
+
+        ctx.checksum = compute_checksum_fast;
+        uint64_t iterations;
+        double ns = measure(op_checksum, &ctx, min_ns, &iterations);
+        emit_micro("checksum", "compute_checksum_fast", "dispatch", ctx.payload_len, iterations, ns, segment);
+    }
+
+    reassembly_cache_close(&ctx.reassembly);
+    free(template_memory);
+    free(ctx.train.headers);
+    free(ctx.train.iovecs);
+    free(ctx.fragments);
+    free(ctx.buffer);
+    return 0;
+}
+
+/**
+ * @brief Sends @p count Echo Requests to 127.0.0.1 as fast as possible and reports pps, loss and RTT.
+ */
+static int run_e2e(const char *variant, uint32_t batch, uint8_t use_uring, uint32_t count, const char *payload, size_t payload_len)
+{
+    struct target_list targets;
+    target_list_init(&targets);
+    if (target_list_add_spec(&targets, "127.0.0.1") != 0)
+    {
+        return -1;
+    }
+
+    struct app_config config;
+    memset(&config, 0, sizeof(config));
+    config.quantity = count;
+    config.sleep_time = 0;
+    config.batch_size = batch;
+    config.burst = batch;
+    config.reply_timeout_ms = 1000;
+    config.threads = 1;
+    config.quiet = 1;
+    config.use_uring = use_uring;
+    config.payload = (const uint8_t *)payload;
+    config.payload_len = payload_len;
+    config.ip_v4_src_addr = "127.0.0.1";
+    config.ip_v4_src.s_addr = htonl(INADDR_LOOPBACK);
+    config.ip_v4_dst_addr = "127.0.0.1";
+    config.targets = &targets;
+    config.ip_v4_ttl = IP_V4_STD_TTL;
+    config.icmp_v4_type = ICMP_V4_ECHO_REQUEST;
+    config.icmp_v4_code = ICMP_V4_ECHO_CODE;
+    config.icmp_v4_identifier = (uint16_t)getpid(); /**< Keeps concurrent runs from matching each other's replies */
+
+    struct worker_pool pool;
+    uint64_t start = timestamp_now_ns();
+    int rc = worker_pool_run(&pool, &config);
+    uint64_t elapsed = timestamp_now_ns() - start;
+
+    if (rc != 0)
+    {
+        printf("{\"suite\":\"e2e\",\"name\":\"loopback\",\"variant\":\"%s\",\"batch\":%u,\"error\":\"run failed (raw sockets need root)\"}\n", variant, batch);
+    }
+    else
+    {
+        // The run includes draining the last replies, so pps is the sustained round-trip rate
+        const struct icmp_target_stats *stats = &pool.stats[0];
+        double seconds = (double)elapsed / TIMESTAMP_NS_PER_SEC;
+        double avg_us = stats->received ? (double)stats->rtt_sum_ns / stats->received / 1e3 : 0.0;
+        printf("{\"suite\":\"e2e\",\"name\":\"loopback\",\"variant\":\"%s\",\"batch\":%u,\"payload\":%zu,\"sent\":%llu,\"received\":%llu,\"lost\":%llu,"
+               "\"seconds\":%.6f,\"pps\":%.0f,\"rtt_min_us\":%.3f,\"rtt_avg_us\":%.3f,\"rtt_max_us\":%.3f}\n",
+               variant, batch, payload_len, (unsigned long long)pool.total.sent, (unsigned long long)pool.total.received,
+               (unsigned long long)pool.total.lost, seconds, (double)pool.total.sent / seconds,
+               stats->received ? (double)stats->rtt_min_ns / 1e3 : 0.0, avg_us, (double)stats->rtt_max_ns / 1e3);
+    }
+    fflush(stdout);
+
+    worker_pool_free(&pool);
+    target_list_free(&targets);
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t min_ns = 100 * TIMESTAMP_NS_PER_MSEC;
+    uint32_t count = 100000;
+    size_t e2e_payload = 56;
+    uint8_t run_micro_suite = 1;
+    uint8_t run_e2e_suite = 1;
+    uint8_t verify_only = 0;
+
+    /**
+     * Arguments:
+     *
+     * t:minimum time per micro-benchmark (ms), c:end-to-end packet count, s:end-to-end payload size,
+     * M:micro-benchmarks only, E:end-to-end only, V:checksum cross-check only
+     */
+    int opt;
+    while ((opt = getopt(argc, argv, "t:c:s:MEV")) != -1)
+    {
+        char *endptr;
+        long val;
+        switch (opt)
+        {
+        case 't':
+            val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val < 1 || val > 60000)
+            {
+                fprintf(stderr, "Error: Invalid time '%s'. Must be 1-60000 ms\n", optarg);
+                return -1;
+            }
+            min_ns = (uint64_t)val * TIMESTAMP_NS_PER_MSEC;
+            break;
+        case 'c':
+            val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val < 1 || val > UINT32_MAX)
+            {
+                fprintf(stderr, "Error: Invalid count '%s'\n", optarg);
+                return -1;
+            }
+            count = (uint32_t)val;
+            break;
+        case 's':
+            val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val < 0 || (size_t)val > BENCH_MAX_PAYLOAD)
+            {
+                fprintf(stderr, "Error: Invalid payload size '%s'. Must be 0-%zu\n", optarg, (size_t)BENCH_MAX_PAYLOAD);
+                return -1;
+            }
+            e2e_payload = (size_t)val;
+            break;
+        case 'M':
+            run_e2e_suite = 0;
+            break;
+        case 'E':
+            run_micro_suite = 0;
+            break;
+        case 'V':
+            verify_only = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-t ms_per_benchmark] [-c e2e_count] [-s e2e_payload] [-M | -E | -V]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    // A kernel that disagrees with the reference invalidates every timing, so nothing else runs
+    int verified = run_verify();
+    if (verified != 0 || verify_only)
+    {
+        return verified;
+    }
+
+    // One payload buffer covers every size; only a prefix is used per run
+    char *payload = malloc(BENCH_MAX_PAYLOAD);
+    if (!payload)
+    {
+        fprintf(stderr, "Error: Failed to allocate the payload\n");
+        return -1;
+    }
+    for (size_t i = 0; i < BENCH_MAX_PAYLOAD; i++)
+    {
+        payload[i] = (char)('a' + (i % 26));
+    }
+
+    int status = 0;
+    if (run_micro_suite && run_micro(payload, min_ns) != 0)
+    {
+        status = -1;
+    }
+
+    if (run_e2e_suite)
+    {
+        status |= run_e2e("sendto", 1, 0, count, payload, e2e_payload);
+        status |= run_e2e("sendmmsg", 64, 0, count, payload, e2e_payload);
+        status |= run_e2e("io_uring", 64, 1, count, payload, e2e_payload);
+    }
+
+    free(payload);
+    return status;
+}
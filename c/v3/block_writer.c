@@ -0,0 +1,273 @@
+/**
+ * @file block_writer.c
+ * @brief Lock-free hand-off of filled blocks from worker threads to one background file writer.
+ *
+ * @author Jim Diroff II
+ */
+#define _GNU_SOURCE /**< Exposes O_DIRECT */
+
+#include "block_writer.h"
+#include "timestamp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief How long the writer sleeps when no stream has a block ready.
+ */
+#define BLOCK_WRITER_IDLE_NS (1 * TIMESTAMP_NS_PER_MSEC)
+
+/**
+ * @brief Writes the gathered pieces at @p offset, retrying short and interrupted writes.
+ *
+ * If the file system accepted O_DIRECT at open time but rejects the write itself, the descriptor
+ * drops back to buffered I/O and the write is retried.
+ *
+ * @param iov    The pieces, in file order; consumed (modified) as they are written.
+ * @param iovcnt Entries in @p iov.
+ * @return 0 on success, -1 with `errno` set on failure.
+ */
+static int write_vector(struct block_writer *writer, struct iovec *iov, int iovcnt, uint64_t offset)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t n = pwritev(writer->fd, iov, iovcnt, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && errno == EINVAL && writer->direct)
+        {
+            int flags = fcntl(writer->fd, F_GETFL);
+            if (flags < 0 || fcntl(writer->fd, F_SETFL, flags & ~O_DIRECT) != 0)
+            {
+                return -1;
+            }
+            writer->direct = 0;
+            continue;
+        }
+        if (n <= 0)
+        {
+            errno = (n == 0) ? EIO : errno;
+            return -1;
+        }
+
+        // Skip what went out, including a partially written piece
+        offset += (uint64_t)n;
+        size_t done = (size_t)n;
+        while (iovcnt > 0 && done >= iov->iov_len)
+        {
+            done -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Writer thread: appends every published block, in runs of contiguous ring slots, until stopped and drained.
+ * @param arg The writer.
+ * @return NULL; failures are left in the writer's `error`.
+ */
+static void *writer_main(void *arg)
+{
+    struct block_writer *writer = (struct block_writer *)arg;
+
+    for (;;)
+    {
+        // Read the flag first: anything published before it was raised is still drained below
+        uint8_t stopping = __atomic_load_n(&writer->stopping, __ATOMIC_ACQUIRE);
+        uint32_t written = 0;
+
+        for (uint32_t i = 0; i < writer->stream_count; i++)
+        {
+            struct block_writer_stream *stream = &writer->streams[i];
+            uint32_t tail = __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE);
+            uint32_t head = stream->head;
+
+            while (head != tail)
+            {
+                uint32_t first = head % BLOCK_WRITER_STREAM_BLOCKS;
+                uint32_t run = tail - head;
+                run = (run < BLOCK_WRITER_STREAM_BLOCKS - first) ? run : BLOCK_WRITER_STREAM_BLOCKS - first;
+
+                struct iovec iov[BLOCK_WRITER_STREAM_BLOCKS];
+                uint64_t bytes = 0;
+                for (uint32_t k = 0; k < run; k++)
+                {
+                    iov[k].iov_base = stream->blocks + (size_t)(first + k) * stream->block_size;
+                    iov[k].iov_len = stream->lengths[first + k];
+                    bytes += iov[k].iov_len;
+                }
+
+                // After a failure, blocks are still consumed so producers never stall on a dead file
+                if (writer->error == 0)
+                {
+                    if (write_vector(writer, iov, (int)run, writer->offset) != 0)
+                    {
+                        writer->error = errno;
+                    }
+                    writer->offset += bytes;
+                }
+
+                head += run;
+                written += run;
+                __atomic_store_n(&stream->head, head, __ATOMIC_RELEASE);
+            }
+        }
+
+        if (written == 0)
+        {
+            if (stopping)
+            {
+                break;
+            }
+            struct timespec pause = { .tv_sec = 0, .tv_nsec = (long)BLOCK_WRITER_IDLE_NS };
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+int block_writer_open(struct block_writer *writer, const char *path, const char *name, size_t block_size, uint32_t stream_count, uint32_t flags, const void *header, size_t header_len)
+{
+    memset(writer, 0, sizeof(struct block_writer));
+    writer->name = name;
+    writer->flags = flags;
+    writer->block_size = block_size;
+
+    // 1. Bypass the page cache where asked and possible; some file systems (e.g. tmpfs on older kernels) refuse O_DIRECT
+    writer->fd = -1;
+    if (flags & BLOCK_WRITER_DIRECT)
+    {
+        writer->direct = 1;
+        writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+    }
+    if (writer->fd < 0 && (!(flags & BLOCK_WRITER_DIRECT) || errno == EINVAL))
+    {
+        writer->direct = 0;
+        writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if (writer->fd < 0)
+    {
+        fprintf(stderr, "Error: Failed to create the %s '%s': %s\n", name, path, strerror(errno));
+        return -1;
+    }
+
+    // 2. The header, then one (lazily filled) stream per producer
+    writer->streams = calloc(stream_count, sizeof(struct block_writer_stream));
+    if (!writer->streams)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u %s streams\n", stream_count, name);
+        block_writer_close(writer);
+        return -1;
+    }
+    writer->stream_count = stream_count;
+
+    struct iovec iov = { .iov_base = (void *)header, .iov_len = header_len };
+    if (write_vector(writer, &iov, 1, 0) != 0)
+    {
+        fprintf(stderr, "Error: Failed to write the %s header: %s\n", name, strerror(errno));
+        block_writer_close(writer);
+        return -1;
+    }
+    writer->offset = header_len;
+
+    // 3. The writer owns every system call from here on
+    if (pthread_create(&writer->writer, NULL, writer_main, writer) != 0)
+    {
+        fprintf(stderr, "Error: Failed to start the %s writer\n", name);
+        block_writer_close(writer);
+        return -1;
+    }
+    writer->writer_started = 1;
+
+    return 0;
+}
+
+struct block_writer_stream *block_writer_stream_open(struct block_writer *writer, uint32_t index)
+{
+    struct block_writer_stream *stream = &writer->streams[index];
+
+    // Allocated by the producer itself, so the blocks land near its core
+    stream->blocks = aligned_alloc(BLOCK_WRITER_ALIGNMENT, (size_t)BLOCK_WRITER_STREAM_BLOCKS * writer->block_size);
+    if (!stream->blocks)
+    {
+        fprintf(stderr, "Error: Failed to allocate %s stream %u\n", writer->name, index);
+        return NULL;
+    }
+    stream->block_size = writer->block_size;
+
+    return stream;
+}
+
+uint8_t *block_writer_stream_block(const struct block_writer_stream *stream)
+{
+    return stream->blocks + (size_t)(stream->tail % BLOCK_WRITER_STREAM_BLOCKS) * stream->block_size;
+}
+
+void block_writer_stream_publish(struct block_writer_stream *stream, uint32_t length)
+{
+    uint32_t tail = stream->tail + 1;
+    stream->lengths[stream->tail % BLOCK_WRITER_STREAM_BLOCKS] = length;
+    __atomic_store_n(&stream->tail, tail, __ATOMIC_RELEASE);
+
+    while (tail - __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE) >= BLOCK_WRITER_STREAM_BLOCKS)
+    {
+        sched_yield();
+    }
+}
+
+int block_writer_close(struct block_writer *writer)
+{
+    if (writer->fd < 0)
+    {
+        return 0;
+    }
+
+    // 1. Let the writer drain every published block, then make it durable if asked
+    if (writer->writer_started)
+    {
+        __atomic_store_n(&writer->stopping, 1, __ATOMIC_RELEASE);
+        pthread_join(writer->writer, NULL);
+        writer->writer_started = 0;
+    }
+    if (writer->error == 0 && (writer->flags & BLOCK_WRITER_SYNC) && fdatasync(writer->fd) != 0)
+    {
+        writer->error = errno;
+    }
+
+    int rc = 0;
+    if (writer->error != 0)
+    {
+        fprintf(stderr, "Error: Failed to write the %s: %s\n", writer->name, strerror(writer->error));
+        rc = -1;
+    }
+
+    // 2. Release the streams and the file
+    for (uint32_t i = 0; i < writer->stream_count; i++)
+    {
+        free(writer->streams[i].blocks);
+    }
+    free(writer->streams);
+    close(writer->fd);
+
+    writer->streams = NULL;
+    writer->stream_count = 0;
+    writer->fd = -1;
+    return rc;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file block_writer.h
+ * @brief Lock-free hand-off of filled blocks from worker threads to one background file writer.
+ *
+ * @note Each producer owns one stream: a ring of @ref BLOCK_WRITER_STREAM_BLOCKS page-aligned blocks
+ *       it fills in place and publishes with a single store-release. The writer thread appends every
+ *       published block to the file in publication order per stream, gathering runs of contiguous
+ *       ring slots into one `pwritev`, so producers never make a system call. A producer only waits
+ *       when the disk falls a full ring behind.
+ *
+ *       The users choose the policy: the block size, whether blocks are always written whole (and
+ *       so may go through O_DIRECT) or trimmed to the bytes they hold, and whether the file is made
+ *       durable on close. The block contents are theirs; the result log fills blocks with fixed-size
+ *       records, the packet capture with pcapng blocks of any length.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef BLOCK_WRITER_H
+#define BLOCK_WRITER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Alignment of every block buffer, and of every write offset and length under O_DIRECT.
+ */
+#define BLOCK_WRITER_ALIGNMENT 4096
+
+/**
+ * @brief Blocks per stream ring (power of two).
+ */
+#define BLOCK_WRITER_STREAM_BLOCKS 16
+
+/**
+ * @enum block_writer_flags
+ * @brief Per-user file policy, passed to @ref block_writer_open.
+ */
+enum block_writer_flags
+{
+    BLOCK_WRITER_DIRECT = 1 << 0, /**< Bypass the page cache with O_DIRECT where the file system allows it (every length must stay aligned) */
+    BLOCK_WRITER_SYNC = 1 << 1    /**< `fdatasync` the file on close */
+};
+
+/**
+ * @struct block_writer_stream
+ * @brief Single-producer, single-consumer block ring between one producer and the writer.
+ */
+struct block_writer_stream
+{
+    uint8_t *blocks;                              /**< @ref BLOCK_WRITER_STREAM_BLOCKS blocks, aligned to @ref BLOCK_WRITER_ALIGNMENT, or NULL if unused */
+    size_t block_size;                            /**< Bytes per block, copied from the writer */
+    uint32_t lengths[BLOCK_WRITER_STREAM_BLOCKS]; /**< Bytes to write from each slot, set before it is published */
+    uint32_t tail;                                /**< Blocks published by the producer (store-release) */
+    uint32_t head;                                /**< Blocks written out by the writer (store-release) */
+};
+
+/**
+ * @struct block_writer
+ * @brief The file, its streams and the writer thread.
+ */
+struct block_writer
+{
+    int fd;                              /**< Output file, or -1 when closed */
+    const char *name;                    /**< What the file is, for messages (e.g. "result log") */
+    uint32_t flags;                      /**< @ref block_writer_flags */
+    uint8_t direct;                      /**< 1 while @ref fd is in O_DIRECT mode */
+    size_t block_size;                   /**< Bytes per block */
+    uint64_t offset;                     /**< File offset of the next block (writer only once started) */
+    struct block_writer_stream *streams; /**< One stream per producer */
+    uint32_t stream_count;               /**< Entries in @ref streams */
+    pthread_t writer;                    /**< Background writer thread */
+    uint8_t writer_started;              /**< 1 once @ref writer has to be joined */
+    uint8_t stopping;                    /**< Set (release) by @ref block_writer_close; the writer drains and exits */
+    int error;                           /**< First write failure (`errno` value), or 0 */
+};
+
+/**
+ * @brief Creates @p path, writes @p header at offset 0 and starts the writer thread.
+ * @param writer       Pointer to the caller-allocated writer.
+ * @param path         File to create (truncated if it exists).
+ * @param name         What the file is, for messages; must outlive the writer.
+ * @param block_size   Bytes per block (a multiple of @ref BLOCK_WRITER_ALIGNMENT with @ref BLOCK_WRITER_DIRECT).
+ * @param stream_count Number of producers.
+ * @param flags        @ref block_writer_flags.
+ * @param header       Bytes preceding the first block (aligned, in address and length, with @ref BLOCK_WRITER_DIRECT).
+ * @param header_len   Bytes in @p header.
+ * @return 0 on success, -1 on failure (the writer is left closed and the reason printed).
+ */
+int block_writer_open(struct block_writer *writer, const char *path, const char *name, size_t block_size, uint32_t stream_count, uint32_t flags, const void *header, size_t header_len);
+
+/**
+ * @brief Allocates stream @p index. Call from the producing thread before its first block.
+ * @param writer Pointer to an open writer.
+ * @param index  Stream index, below `stream_count`.
+ * @return The stream, or NULL on allocation failure.
+ */
+struct block_writer_stream *block_writer_stream_open(struct block_writer *writer, uint32_t index);
+
+/**
+ * @brief The block the producer is filling.
+ * @param stream Pointer to the producer's stream.
+ * @return Start of @p stream's current block (`block_size` bytes).
+ */
+uint8_t *block_writer_stream_block(const struct block_writer_stream *stream);
+
+/**
+ * @brief Publishes the current block, then waits for the writer if it has fallen a full ring behind.
+ * @param stream Pointer to the producer's stream.
+ * @param length Bytes of the block to write (`block_size` for a full block).
+ */
+void block_writer_stream_publish(struct block_writer_stream *stream, uint32_t length);
+
+/**
+ * @brief Writes out every published block, stops the writer, applies the close policy and closes the file.
+ *        Safe to call on a closed writer.
+ *
+ * Every producer must have published its last block and stopped.
+ *
+ * @param writer Pointer to the writer.
+ * @return 0 if every block reached the file, -1 otherwise (the reason is printed).
+ */
+int block_writer_close(struct block_writer *writer);
+
+#endif /* BLOCK_WRITER_H */
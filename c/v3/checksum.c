@@ -7,10 +7,20 @@
 
 #include "checksum.h"
 
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 uint16_t compute_checksum(const void *data, size_t length)
 {
     const uint16_t *word_ptr = (const uint16_t *)data;
-    uint32_t sum = 0;
+    uint64_t sum = 0; /**< 64 bits keep the sum exact beyond 128 KiB, where the vector kernels are checked against it */
 
     while (length > 1)
     {
@@ -31,4 +41,256 @@ uint16_t compute_checksum(const void *data, size_t length)
     }
 
     return (uint16_t)~sum;
-}
\ No newline at end of file
+}
+
+uint16_t update_checksum_16(uint16_t checksum, uint16_t old_word, uint16_t new_word)
+{
+    uint32_t sum = (uint16_t)~checksum;
+    sum += (uint16_t)~old_word;
+    sum += new_word;
+
+    while (sum >> 16)
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return (uint16_t)~sum;
+}
+
+uint16_t combine_checksum(uint16_t first, uint16_t second)
+{
+    uint32_t sum = (uint16_t)~first;
+    sum += (uint16_t)~second;
+
+    while (sum >> 16)
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return (uint16_t)~sum;
+}
+
+/**
+ * @brief Folds a wide accumulator down to the final 16-bit ones' complement checksum.
+ * @param sum Sum of native-order words of any width (2^16 is congruent to 1 modulo 0xFFFF).
+ * @return The complemented 16-bit checksum.
+ */
+static uint16_t fold_checksum_64(uint64_t sum)
+{
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+/**
+ * @brief Portable wide-word accumulation of everything past @p offset.
+ *
+ * 32-bit words are added into a 64-bit accumulator, so carries are deferred to a single fold at the end.
+ * The final 1-3 bytes are zero-padded in memory order, exactly like the reference odd-byte handling.
+ *
+ * @param bytes Start of the buffer.
+ * @param length Remaining bytes to sum. Callers only stop vector loops at even offsets.
+ * @return The unfolded 64-bit sum.
+ */
+static uint64_t sum_wide(const uint8_t *bytes, size_t length)
+{
+    uint64_t sum = 0;
+    uint32_t word;
+
+    while (length >= 16)
+    {
+        uint32_t w[4];
+        memcpy(w, bytes, sizeof(w));
+        sum += (uint64_t)w[0] + w[1] + w[2] + w[3];
+        bytes += 16;
+        length -= 16;
+    }
+
+    while (length >= 4)
+    {
+        memcpy(&word, bytes, sizeof(word));
+        sum += word;
+        bytes += 4;
+        length -= 4;
+    }
+
+    if (length > 0)
+    {
+        word = 0;
+        memcpy(&word, bytes, length);
+        sum += word;
+    }
+
+    return sum;
+}
+
+static uint16_t compute_checksum_wide(const void *data, size_t length)
+{
+    return fold_checksum_64(sum_wide((const uint8_t *)data, length));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2"))) static uint16_t compute_checksum_sse2(const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+
+    while (length >= 16)
+    {
+        __m128i acc = _mm_setzero_si128();
+        size_t iterations = 0;
+
+        // Widen each 16-bit word to 32 bits and add lane-wise; no carries can be lost before the flush
+        while (length >= 16 && iterations < CHECKSUM_VECTOR_FLUSH_INTERVAL)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)bytes);
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+            bytes += 16;
+            length -= 16;
+            iterations++;
+        }
+
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    return fold_checksum_64(sum + sum_wide(bytes, length));
+}
+
+__attribute__((target("avx2"))) static uint16_t compute_checksum_avx2(const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+
+    while (length >= 32)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        size_t iterations = 0;
+
+        while (length >= 32 && iterations < CHECKSUM_VECTOR_FLUSH_INTERVAL)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)bytes);
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+            bytes += 32;
+            length -= 32;
+            iterations++;
+        }
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, acc);
+        for (size_t i = 0; i < 8; i++)
+        {
+            sum += lanes[i];
+        }
+    }
+
+    return fold_checksum_64(sum + sum_wide(bytes, length));
+}
+
+#endif /* x86 */
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static uint16_t compute_checksum_neon(const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64x2_t total = vdupq_n_u64(0);
+
+    while (length >= 16)
+    {
+        uint32x4_t acc = vdupq_n_u32(0);
+        size_t iterations = 0;
+
+        // Pairwise add adjacent 16-bit words into 32-bit lanes
+        while (length >= 16 && iterations < CHECKSUM_VECTOR_FLUSH_INTERVAL)
+        {
+            acc = vpadalq_u16(acc, vld1q_u16((const uint16_t *)(const void *)bytes));
+            bytes += 16;
+            length -= 16;
+            iterations++;
+        }
+
+        total = vpadalq_u32(total, acc);
+    }
+
+    uint64_t sum = vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1);
+    return fold_checksum_64(sum + sum_wide(bytes, length));
+}
+
+#endif /* ARM NEON */
+
+checksum_fn checksum_kernel_get(enum checksum_kernel kernel)
+{
+    switch (kernel)
+    {
+    case CHECKSUM_KERNEL_REFERENCE:
+        return compute_checksum;
+    case CHECKSUM_KERNEL_WIDE:
+        return compute_checksum_wide;
+#if defined(__x86_64__) || defined(__i386__)
+    case CHECKSUM_KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2") ? compute_checksum_sse2 : NULL;
+    case CHECKSUM_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2") ? compute_checksum_avx2 : NULL;
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    case CHECKSUM_KERNEL_NEON:
+        return compute_checksum_neon;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+const char *checksum_kernel_name(enum checksum_kernel kernel)
+{
+    switch (kernel)
+    {
+    case CHECKSUM_KERNEL_REFERENCE:
+        return "reference";
+    case CHECKSUM_KERNEL_WIDE:
+        return "wide";
+    case CHECKSUM_KERNEL_SSE2:
+        return "sse2";
+    case CHECKSUM_KERNEL_AVX2:
+        return "avx2";
+    case CHECKSUM_KERNEL_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief The kernel used by @ref compute_checksum_fast, NULL until first resolved.
+ * @note Accessed atomically; concurrent first calls resolve to the same value.
+ */
+static checksum_fn resolved_kernel = NULL;
+
+uint16_t compute_checksum_fast(const void *data, size_t length)
+{
+    checksum_fn kernel = __atomic_load_n(&resolved_kernel, __ATOMIC_RELAXED);
+
+    if (kernel == NULL)
+    {
+        // Prefer the widest vectors the CPU supports, falling back to the portable wide loop
+        static const enum checksum_kernel preference[] = {CHECKSUM_KERNEL_AVX2, CHECKSUM_KERNEL_NEON, CHECKSUM_KERNEL_SSE2, CHECKSUM_KERNEL_WIDE};
+        for (size_t i = 0; kernel == NULL && i < sizeof(preference) / sizeof(preference[0]); i++)
+        {
+            kernel = checksum_kernel_get(preference[i]);
+        }
+        __atomic_store_n(&resolved_kernel, kernel, __ATOMIC_RELAXED);
+    }
+
+    return kernel(data, length);
+}
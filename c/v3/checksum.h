@@ -18,4 +18,81 @@
  */
 uint16_t compute_checksum(const void *data, size_t length);
 
+/**
+ * @enum checksum_kernel
+ * @brief Implementations of the ones' complement checksum, all bit-identical to @ref compute_checksum.
+ */
+enum checksum_kernel
+{
+    CHECKSUM_KERNEL_REFERENCE = 0, /**< The portable 16-bit word loop (@ref compute_checksum) */
+    CHECKSUM_KERNEL_WIDE,          /**< Portable 64-bit accumulation with deferred carry folding */
+    CHECKSUM_KERNEL_SSE2,          /**< x86 128-bit vectors */
+    CHECKSUM_KERNEL_AVX2,          /**< x86 256-bit vectors, selected only when the CPU reports AVX2 */
+    CHECKSUM_KERNEL_NEON,          /**< ARM 128-bit vectors */
+    CHECKSUM_KERNEL_COUNT
+};
+
+/**
+ * @brief Vector iterations before the SIMD kernels flush their 32-bit lanes into the 64-bit total.
+ * @note Each lane absorbs two 16-bit words per iteration: 2 * 32768 * 0xFFFF < 2^32.
+ */
+#define CHECKSUM_VECTOR_FLUSH_INTERVAL 32768
+
+/**
+ * @brief Signature shared by every checksum kernel.
+ */
+typedef uint16_t (*checksum_fn)(const void *data, size_t length);
+
+/**
+ * @brief Computes the checksum with the fastest kernel available on this CPU.
+ *
+ * The kernel is resolved on first use (runtime CPU feature detection) and cached.
+ *
+ * @param data Pointer to the data buffer.
+ * @param length Number of bytes in @p data checksum.
+ * @return 16-bit ones' complement checksum, identical to @ref compute_checksum.
+ */
+uint16_t compute_checksum_fast(const void *data, size_t length);
+
+/**
+ * @brief Looks up a specific kernel, e.g. to cross-check or benchmark the variants.
+ * @param kernel The requested implementation.
+ * @return The kernel, or NULL if it was not compiled in or the CPU does not support it.
+ */
+checksum_fn checksum_kernel_get(enum checksum_kernel kernel);
+
+/**
+ * @brief Human-readable kernel name (e.g., "avx2").
+ * @param kernel The implementation.
+ * @return A static string, or "unknown" for an out-of-range value.
+ */
+const char *checksum_kernel_name(enum checksum_kernel kernel);
+
+/**
+ * @brief Incrementally updates a checksum after a single 16-bit word change.
+ *
+ * Implements HC' = ~(~HC + ~m + m'), which is correct for every input including
+ * the ones' complement negative zero case.
+ *
+ * @param checksum The existing checksum, exactly as stored in the header.
+ * @param old_word The 16-bit word as it was when @p checksum was computed.
+ * @param new_word The replacement 16-bit word.
+ * @return The updated 16-bit ones' complement checksum.
+ *
+ * @note All three values must share the same byte order (typically Network Byte Order as stored).
+ * @see RFC 1624
+ */
+uint16_t update_checksum_16(uint16_t checksum, uint16_t old_word, uint16_t new_word);
+
+/**
+ * @brief Combines the checksums of two blocks into the checksum of their concatenation.
+ *
+ * Used for pseudo-headers: the header and the segment are summed separately, never copied together.
+ *
+ * @param first  Checksum of the leading block, whose length must be even.
+ * @param second Checksum of the trailing block.
+ * @return The 16-bit ones' complement checksum of both blocks.
+ */
+uint16_t combine_checksum(uint16_t first, uint16_t second);
+
 #endif /* CHECKSUM_H */
\ No newline at end of file
@@ -0,0 +1,178 @@
+/**
+ * @file hdr_histogram.c
+ * @brief Log-linear (HDR-style) latency histogram with a single lock-free writer.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "hdr_histogram.h"
+
+#include <string.h>
+
+/**
+ * @brief Values below this bound are their own bucket.
+ */
+#define HDR_LINEAR_LIMIT (1ULL << (HDR_HISTOGRAM_SUB_BITS + 1))
+
+/**
+ * @brief Largest value with a bucket of its own range; anything above is clamped to the last bucket.
+ */
+#define HDR_MAX_VALUE ((1ULL << (HDR_HISTOGRAM_SUB_BITS + 1 + HDR_HISTOGRAM_MAX_EXPONENT)) - 1)
+
+/**
+ * @brief Square root by Newton's method, so the histogram does not pull in libm.
+ */
+static double square_root(double value)
+{
+    if (value <= 0.0)
+    {
+        return 0.0;
+    }
+
+    double root = (value > 1.0) ? value : 1.0;
+    for (int i = 0; i < 128; i++)
+    {
+        double next = 0.5 * (root + value / root);
+        if (next >= root)
+        {
+            break; /**< Converged: Newton's iterates decrease monotonically from above */
+        }
+        root = next;
+    }
+
+    return root;
+}
+
+/**
+ * @brief Maps a value onto its bucket: exponent `e` covers `[128 << e, 256 << e)` in steps of `1 << e`.
+ */
+static uint32_t bucket_of(uint64_t value)
+{
+    if (value < HDR_LINEAR_LIMIT)
+    {
+        return (uint32_t)value;
+    }
+    if (value > HDR_MAX_VALUE)
+    {
+        value = HDR_MAX_VALUE;
+    }
+
+    uint32_t exponent = (uint32_t)(63 - __builtin_clzll(value)) - HDR_HISTOGRAM_SUB_BITS;
+    return (exponent << HDR_HISTOGRAM_SUB_BITS) + (uint32_t)(value >> exponent);
+}
+
+/**
+ * @brief Lowest value of @p bucket and the number of values it spans.
+ */
+static uint64_t bucket_low(uint32_t bucket, uint64_t *width)
+{
+    if (bucket < HDR_LINEAR_LIMIT)
+    {
+        *width = 1;
+        return bucket;
+    }
+
+    uint32_t exponent = (bucket >> HDR_HISTOGRAM_SUB_BITS) - 1;
+    uint64_t mantissa = bucket - (exponent << HDR_HISTOGRAM_SUB_BITS);
+    *width = 1ULL << exponent;
+    return mantissa << exponent;
+}
+
+void hdr_histogram_init(struct hdr_histogram *histogram)
+{
+    memset(histogram, 0, sizeof(struct hdr_histogram));
+    histogram->min = UINT64_MAX;
+}
+
+void hdr_histogram_record(struct hdr_histogram *histogram, uint64_t value)
+{
+    // Single writer: plain increments published with relaxed stores, no locked instruction on the hot path
+    uint64_t *slot = &histogram->counts[bucket_of(value)];
+    __atomic_store_n(slot, *slot + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->sum, histogram->sum + value, __ATOMIC_RELAXED);
+    if (value < histogram->min)
+    {
+        __atomic_store_n(&histogram->min, value, __ATOMIC_RELAXED);
+    }
+    if (value > histogram->max)
+    {
+        __atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+    }
+}
+
+void hdr_histogram_merge(struct hdr_histogram *dst, const struct hdr_histogram *src)
+{
+    // The bucket total is recomputed, so percentiles stay consistent even if a record lands mid-merge
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < HDR_HISTOGRAM_BUCKETS; i++)
+    {
+        uint64_t n = __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+        dst->counts[i] += n;
+        count += n;
+    }
+    dst->count += count;
+    dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+
+    uint64_t min = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+    dst->min = (min < dst->min) ? min : dst->min;
+    dst->max = (max > dst->max) ? max : dst->max;
+}
+
+uint64_t hdr_histogram_percentile(const struct hdr_histogram *histogram, double percentile)
+{
+    if (histogram->count == 0)
+    {
+        return 0;
+    }
+
+    // 1. Rank of the requested value, at least the first one
+    double clamped = (percentile < 0.0) ? 0.0 : (percentile > 100.0) ? 100.0 : percentile;
+    double exact = clamped / 100.0 * (double)histogram->count;
+    uint64_t rank = (uint64_t)exact;
+    rank += ((double)rank < exact || rank == 0) ? 1 : 0;
+
+    // 2. Walk the buckets until the rank is covered
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HDR_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += histogram->counts[i];
+        if (seen >= rank)
+        {
+            uint64_t width;
+            uint64_t high = bucket_low(i, &width) + width - 1;
+            return (high < histogram->max) ? high : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+double hdr_histogram_mean(const struct hdr_histogram *histogram)
+{
+    return (histogram->count > 0) ? (double)histogram->sum / (double)histogram->count : 0.0;
+}
+
+double hdr_histogram_stddev(const struct hdr_histogram *histogram)
+{
+    if (histogram->count == 0)
+    {
+        return 0.0;
+    }
+
+    double mean = hdr_histogram_mean(histogram);
+    double squares = 0.0;
+    for (uint32_t i = 0; i < HDR_HISTOGRAM_BUCKETS; i++)
+    {
+        if (histogram->counts[i] == 0)
+        {
+            continue;
+        }
+        uint64_t width;
+        double mid = (double)bucket_low(i, &width) + (double)(width - 1) / 2.0;
+        squares += (double)histogram->counts[i] * (mid - mean) * (mid - mean);
+    }
+
+    return square_root(squares / (double)histogram->count);
+}
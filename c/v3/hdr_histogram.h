@@ -0,0 +1,89 @@
+/**
+ * @file hdr_histogram.h
+ * @brief Log-linear (HDR-style) latency histogram with a single lock-free writer.
+ *
+ * @note Values below 256 get their own bucket; above that, every power of two is split into 128
+ *       linear sub-buckets, so any recorded value is known to within 0.8%. Up to 2^48 ns (about
+ *       3 days) fits; larger values land in the last bucket.
+ *
+ *       Exactly one thread records into a histogram, with relaxed atomic stores and no read-modify-write.
+ *       Any other thread may merge it at the same time and sees a slightly stale but consistent-enough view.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <stdint.h>
+
+/**
+ * @brief log2 of the linear sub-buckets per power of two.
+ */
+#define HDR_HISTOGRAM_SUB_BITS 7
+
+/**
+ * @brief Highest power-of-two exponent above the linear range.
+ */
+#define HDR_HISTOGRAM_MAX_EXPONENT 40
+
+/**
+ * @brief Number of buckets: the 256-value linear range plus 128 per exponent.
+ */
+#define HDR_HISTOGRAM_BUCKETS ((HDR_HISTOGRAM_MAX_EXPONENT + 2) << HDR_HISTOGRAM_SUB_BITS)
+
+/**
+ * @struct hdr_histogram
+ * @brief Bucket counts plus exact count, sum, minimum and maximum.
+ */
+struct hdr_histogram
+{
+    uint64_t counts[HDR_HISTOGRAM_BUCKETS]; /**< Values recorded per bucket */
+    uint64_t count;                         /**< Values recorded in total */
+    uint64_t sum;                           /**< Sum of every recorded value, for an exact mean */
+    uint64_t min;                           /**< Smallest recorded value (UINT64_MAX while empty) */
+    uint64_t max;                           /**< Largest recorded value */
+};
+
+/**
+ * @brief Empties @p histogram.
+ * @param histogram Pointer to the histogram.
+ */
+void hdr_histogram_init(struct hdr_histogram *histogram);
+
+/**
+ * @brief Records one value. Must only ever be called from the histogram's owning thread.
+ * @param histogram Pointer to the histogram.
+ * @param value     The value (e.g., a round trip in nanoseconds).
+ */
+void hdr_histogram_record(struct hdr_histogram *histogram, uint64_t value);
+
+/**
+ * @brief Adds @p src into @p dst; @p src may be recorded into concurrently by its owner.
+ * @param dst Pointer to the accumulating histogram (owned by the caller).
+ * @param src Pointer to the histogram to read.
+ */
+void hdr_histogram_merge(struct hdr_histogram *dst, const struct hdr_histogram *src);
+
+/**
+ * @brief Value at or below which @p percentile percent of the recorded values fall.
+ * @param histogram   Pointer to the histogram.
+ * @param percentile  Between 0 and 100 (e.g., 99.9).
+ * @return The highest value equivalent to the matching bucket, capped at the recorded maximum; 0 while empty.
+ */
+uint64_t hdr_histogram_percentile(const struct hdr_histogram *histogram, double percentile);
+
+/**
+ * @brief Exact mean of the recorded values.
+ * @param histogram Pointer to the histogram.
+ * @return The mean, or 0 while empty.
+ */
+double hdr_histogram_mean(const struct hdr_histogram *histogram);
+
+/**
+ * @brief Standard deviation of the recorded values, from the bucket midpoints.
+ * @param histogram Pointer to the histogram.
+ * @return The population standard deviation, or 0 while empty.
+ */
+double hdr_histogram_stddev(const struct hdr_histogram *histogram);
+
+#endif /* HDR_HISTOGRAM_H */
@@ -0,0 +1,277 @@
+/**
+ * @file icmp_engine.c
+ * @brief Event-driven run loop: paced transmission and reply reception interleaved on one epoll set.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "icmp_engine.h"
+#include "target_list.h"
+#include "timestamp.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/**
+ * @brief epoll user data tags for the event sources (the raw socket, an AF_XDP port and io_uring share one tag).
+ */
+enum engine_event_source
+{
+    ENGINE_EVENT_SOCKET = 1,
+    ENGINE_EVENT_TIMER = 2
+};
+
+/**
+ * @brief Reports every queued reply and returns once the socket is drained.
+ * @param rx    Pointer to the receiver.
+ * @param quiet 1 to match and count replies without printing them.
+ * @return 0 on success, -1 on socket failure.
+ */
+static int drain_replies(struct icmp_receiver *rx, uint8_t quiet)
+{
+    struct icmp_reply reply;
+    char src[TARGET_LIST_ADDRSTRLEN];
+    int rc;
+
+    while ((rc = icmp_receiver_poll(rx, &reply)) == 1)
+    {
+        if (quiet)
+        {
+            continue;
+        }
+        target_list_format(rx->targets, reply.target, src, sizeof(src)); /**< The source was checked against this target */
+        printf("Reply from %s: bytes=%zu seq=%u ttl=%u time=%.3f ms\n", src, reply.length, reply.sequence, reply.ttl, (double)reply.rtt_ns / TIMESTAMP_NS_PER_MSEC);
+    }
+
+    return rc;
+}
+
+/**
+ * @brief Arms the timerfd for an absolute CLOCK_MONOTONIC deadline.
+ * @param timer_fd    The timerfd.
+ * @param deadline_ns Absolute deadline; a value of 0 would disarm the timer and is never passed.
+ * @return 0 on success, -1 on failure.
+ */
+static int arm_timer(int timer_fd, uint64_t deadline_ns)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = (time_t)(deadline_ns / TIMESTAMP_NS_PER_SEC);
+    spec.it_value.tv_nsec = (long)(deadline_ns % TIMESTAMP_NS_PER_SEC);
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0)
+    {
+        perror("Error: Failed to arm the pacing timer");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Publishes the running totals for concurrent readers (see @ref icmp_engine_result).
+ * @param result     Output shared with the readers.
+ * @param rx         Pointer to the receiver holding the reply counters.
+ * @param sent       Requests sent so far.
+ * @param packet_len Bytes per datagram.
+ */
+static void publish_result(struct icmp_engine_result *result, const struct icmp_receiver *rx, uint64_t sent, size_t packet_len)
+{
+    __atomic_store_n(&result->sent, sent, __ATOMIC_RELAXED);
+    __atomic_store_n(&result->received, rx->received, __ATOMIC_RELAXED);
+    __atomic_store_n(&result->duplicates, rx->duplicates, __ATOMIC_RELAXED);
+    __atomic_store_n(&result->lost, rx->lost, __ATOMIC_RELAXED);
+    __atomic_store_n(&result->bytes_sent, sent * packet_len, __ATOMIC_RELAXED);
+    for (int i = 0; i < TIMESTAMP_SOURCE_COUNT; i++)
+    {
+        __atomic_store_n(&result->sources[i], rx->sources[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&result->reassembled, rx->reassembly.completed, __ATOMIC_RELAXED);
+    __atomic_store_n(&result->fragments_dropped, rx->reassembly.dropped, __ATOMIC_RELAXED);
+}
+
+int icmp_engine_run(struct icmp_session *session, struct icmp_receiver *rx, struct pacer *pacer, uint64_t packet_cost, struct icmp_engine_result *result)
+{
+    const struct app_config *config = session->config;
+    const struct target_list *targets = config->targets;
+    uint64_t sent = 0;
+    publish_result(result, rx, sent, session->packet_len);
+
+    // Probes go round-robin over the (already permuted) targets: probe `p` hits target `p % count`
+    uint64_t total = (uint64_t)config->quantity * targets->count;
+
+    // 1. One epoll set watches the socket for replies and a timerfd for pacing/expiry deadlines
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || timer_fd < 0)
+    {
+        perror("Error: Failed to create the event loop");
+        if (epoll_fd >= 0)
+        {
+            close(epoll_fd);
+        }
+        if (timer_fd >= 0)
+        {
+            close(timer_fd);
+        }
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = ENGINE_EVENT_SOCKET;
+    int rc = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, session->sockfd, &ev);
+    if (rc == 0 && session->use_xdp)
+    {
+        rc = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, session->xdp.fd, &ev); /**< Steered replies land on the AF_XDP RX ring */
+    }
+    if (rc == 0 && session->use_uring)
+    {
+        rc = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, session->uring.fd, &ev); /**< Readable whenever completions are posted */
+    }
+    ev.data.u32 = ENGINE_EVENT_TIMER;
+    if (rc == 0)
+    {
+        rc = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+    }
+    if (rc != 0)
+    {
+        perror("Error: Failed to register event sources");
+        close(timer_fd);
+        close(epoll_fd);
+        return -1;
+    }
+
+    uint64_t armed_deadline_ns = 0;
+    int status = 0;
+
+    while (status == 0)
+    {
+        uint64_t now_ns = timestamp_now_ns();
+        uint64_t wait_until_ns = 0; /**< 0 = poll without blocking */
+
+        // 2. Sweep the timing wheel for requests whose reply timeout has passed
+        uint16_t lost_seq;
+        uint32_t lost_target;
+        while (icmp_receiver_expire(rx, now_ns, &lost_seq, &lost_target))
+        {
+            if (config->quiet)
+            {
+                continue;
+            }
+            char dst[TARGET_LIST_ADDRSTRLEN];
+            target_list_format(targets, lost_target, dst, sizeof(dst));
+            printf("Request timeout for %s seq=%u\n", dst, lost_seq);
+        }
+
+        // 3. Transmit whenever the pacer allows it
+        if (sent < total)
+        {
+            // A batch never wraps past the end of the target list, so its destinations stay contiguous
+            uint32_t first_target = (uint32_t)(sent % targets->count);
+            uint64_t remaining = total - sent;
+            uint32_t burst = (remaining < config->batch_size) ? (uint32_t)remaining : config->batch_size;
+            if (burst > targets->count - first_target)
+            {
+                burst = targets->count - first_target;
+            }
+
+            if (pacer_try(pacer, burst * packet_cost, now_ns, &wait_until_ns))
+            {
+                /** Sequence is allowed to overflow back to `0` */
+                uint16_t current_seq = (uint16_t)(config->icmp_v4_sequence + sent);
+
+                // Track before sending so a reply racing the syscall return still matches
+                icmp_receiver_track(rx, current_seq, first_target, burst, now_ns);
+
+                int send_rc = (burst == 1) ? icmp_session_send(session, first_target, current_seq) : icmp_session_send_batch(session, first_target, current_seq, burst);
+                if (send_rc != 0)
+                {
+                    fprintf(stderr, "Error: The packet transmission failed at packet %llu\n", (unsigned long long)sent);
+                    status = -1;
+                    break;
+                }
+
+                sent += burst;
+                wait_until_ns = 0;
+            }
+        }
+        else if (icmp_receiver_idle(rx, now_ns))
+        {
+            // 4. Everything is sent and every request was either answered or timed out
+            break;
+        }
+        else
+        {
+            wait_until_ns = UINT64_MAX; /**< Only replies or expiries are left to wait for */
+        }
+
+        // 5. When blocking, never sleep past the next possible expiry
+        uint64_t expiry_ns = icmp_receiver_next_deadline(rx);
+        if (wait_until_ns != 0 && expiry_ns != 0 && expiry_ns < wait_until_ns)
+        {
+            wait_until_ns = expiry_ns;
+        }
+
+        // 6. Block until a reply arrives or the next deadline fires (re-arming only on change)
+        int timeout_ms = 0;
+        if (wait_until_ns > now_ns)
+        {
+            if (wait_until_ns != armed_deadline_ns)
+            {
+                if (arm_timer(timer_fd, wait_until_ns) != 0)
+                {
+                    status = -1;
+                    break;
+                }
+                armed_deadline_ns = wait_until_ns;
+            }
+            timeout_ms = -1;
+        }
+
+        publish_result(result, rx, sent, session->packet_len);
+
+        struct epoll_event events[4];
+        int ready = epoll_wait(epoll_fd, events, 4, timeout_ms);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("Error: epoll_wait failed");
+            status = -1;
+            break;
+        }
+
+        for (int i = 0; i < ready; i++)
+        {
+            if (events[i].data.u32 == ENGINE_EVENT_SOCKET)
+            {
+                if (drain_replies(rx, config->quiet) != 0)
+                {
+                    status = -1;
+                }
+            }
+            else
+            {
+                uint64_t expirations;
+                if (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+                {
+                    armed_deadline_ns = 0;
+                }
+            }
+        }
+    }
+
+    publish_result(result, rx, sent, session->packet_len);
+
+    close(timer_fd);
+    close(epoll_fd);
+    return status;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file icmp_engine.h
+ * @brief Event-driven run loop: paced transmission and reply reception interleaved on one epoll set.
+ *
+ * @note Sending never waits for a reply. Replies are drained whenever the socket becomes readable,
+ *       including while the pacer holds back the next transmission.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef ICMP_ENGINE_H
+#define ICMP_ENGINE_H
+
+#include "icmp_executor.h"
+#include "icmp_receiver.h"
+#include "kernel_timestamp.h"
+#include "pacer.h"
+
+#include <stdint.h>
+
+/**
+ * @struct icmp_engine_result
+ * @brief Totals of a run.
+ *
+ * @note Published with relaxed atomic stores on every loop iteration, so another thread may sample
+ *       a run in progress with relaxed loads. Only the final values are mutually consistent.
+ */
+struct icmp_engine_result
+{
+    uint64_t sent;                            /**< Echo Requests handed to the kernel */
+    uint64_t received;                        /**< Echo Replies matched to a request */
+    uint64_t duplicates;                      /**< Replies for requests that were already answered or had timed out */
+    uint64_t lost;                            /**< Requests whose reply timeout passed (or that a sequence wrap displaced) */
+    uint64_t bytes_sent;                      /**< Datagram bytes handed to the kernel, IP headers included */
+    uint64_t sources[TIMESTAMP_SOURCE_COUNT]; /**< Matched replies per @ref timestamp_source of their round trip */
+    uint64_t reassembled;                     /**< Datagrams rebuilt from AF_XDP fragments (an incomplete one surfaces as a lost reply) */
+    uint64_t fragments_dropped;               /**< AF_XDP fragments rejected as malformed, overlapping or too finely split */
+};
+
+/**
+ * @brief Sends `config->quantity` requests to every target under @p pacer while matching replies,
+ *        until every request is resolved.
+ * @param session     Pointer to an open session (its config supplies targets, quantity and batch size).
+ * @param rx          Pointer to a receiver initialized on the session's socket.
+ * @param pacer       Pointer to an initialized pacer.
+ * @param packet_cost Tokens a single packet consumes from @p pacer.
+ * @param result      Output for the run totals.
+ * @return 0 on success, -1 on socket, timer or transmission failure.
+ */
+int icmp_engine_run(struct icmp_session *session, struct icmp_receiver *rx, struct pacer *pacer, uint64_t packet_cost, struct icmp_engine_result *result);
+
+#endif /* ICMP_ENGINE_H */
@@ -1,100 +1,710 @@
+#define _GNU_SOURCE /**< Exposes sendmmsg() and struct mmsghdr */
+
 #include "icmp_executor.h"
 #include "app_config.h"
+#include "kernel_timestamp.h"
 #include "packet_builder.h"
+#include "payload.h"
+#include "probe_cookie.h"
+#include "socket_filter.h"
+#include "target_list.h"
+#include "timestamp.h"
 
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
-#include <netinet/in.h> // For AF_INET, IPPROTO_ICMP, sockaddr_in
-#include <arpa/inet.h>  // For inet_pton
+#include <netinet/in.h>    // For AF_INET, IPPROTO_ICMP, sockaddr_in
+#include <netinet/icmp6.h> // For ICMP6_FILTER
 
-int send_icmp_echo(const struct app_config *config, uint16_t current_sequence)
+int icmp_socket_open(sa_family_t family, uint16_t identifier, uint8_t accept_errors)
 {
-    // 1. Request a Raw IPv4 Socket
-    int sockfd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    // 1. Request a Raw Socket
+    int sockfd = (family == AF_INET6) ? socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6) : socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
     if (sockfd < 0)
     {
         perror("Error: Failed to open raw socket (Are you running as root?)");
         return -1;
     }
 
-    // 2. Tell the kernel we are providing our own IPv4 header
+    // 2. Tell the kernel we are providing our own IP header
     int hincl = 1;
-    if (setsockopt(sockfd, IPPROTO_IP, IP_HDRINCL, &hincl, sizeof(hincl)) < 0)
+    int rc = (family == AF_INET6) ? setsockopt(sockfd, IPPROTO_IPV6, IPV6_HDRINCL, &hincl, sizeof(hincl)) : setsockopt(sockfd, IPPROTO_IP, IP_HDRINCL, &hincl, sizeof(hincl));
+    if (rc < 0)
     {
-        perror("Error: Failed to set IP_HDRINCL socket option");
+        perror("Error: Failed to set the IP header include socket option");
         close(sockfd);
         return -1;
     }
 
-    // 3. Prepare the Destination Routing Structure
-    struct sockaddr_in dest_addr;
-    memset(&dest_addr, 0, sizeof(dest_addr));
-    dest_addr.sin_family = AF_INET;
+    if (family == AF_INET6)
+    {
+        struct icmp6_filter filter;
+        ICMP6_FILTER_SETBLOCKALL(&filter);
+        ICMP6_FILTER_SETPASS(ICMP_V6_ECHO_REPLY, &filter);
+        if (accept_errors)
+        {
+            ICMP6_FILTER_SETPASS(ICMP_V6_DEST_UNREACHABLE, &filter);
+            ICMP6_FILTER_SETPASS(ICMP_V6_PACKET_TOO_BIG, &filter);
+            ICMP6_FILTER_SETPASS(ICMP_V6_TIME_EXCEEDED, &filter);
+        }
+
+        int on = 1;
+        if (setsockopt(sockfd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter)) < 0 ||
+            setsockopt(sockfd, IPPROTO_IPV6, IPV6_RECVHOPLIMIT, &on, sizeof(on)) < 0)
+        {
+            perror("Error: Failed to configure the ICMPv6 socket");
+            close(sockfd);
+            return -1;
+        }
+    }
 
-    if (inet_pton(AF_INET, config->ip_v4_dst_addr, &dest_addr.sin_addr) != 1)
+    // 3. Drop everyone else's ICMP in the kernel; the matcher still validates whatever gets through
+    if (socket_filter_attach(sockfd, family, identifier, 1, accept_errors) != 0)
     {
-        fprintf(stderr, "Error: Invalid destination IP address format: %s\n", config->ip_v4_dst_addr);
-        close(sockfd);
+        fprintf(stderr, "Warning: Receiving unfiltered ICMP traffic\n");
+    }
+
+    return sockfd;
+}
+
+/**
+ * @brief Allocates a fragment train per batch slot and one message per fragment, addressed like its slot.
+ * @return 0 on success, -1 if the fragment MTU is below the family's minimum or on allocation failure.
+ */
+static int open_fragments(struct icmp_session *session)
+{
+    const struct app_config *config = session->config;
+    uint32_t count = (session->family == AF_INET6) ? ip_v6_fragment_count(session->packet_len, config->fragment_mtu)
+                                                   : ip_v4_fragment_count(session->packet_len, config->fragment_mtu);
+    if (count == 0)
+    {
+        fprintf(stderr, "Error: Fragment MTU %u is below the minimum of %i\n", config->fragment_mtu, (session->family == AF_INET6) ? IP_V6_MIN_LINK_MTU : IP_V4_MIN_MTU);
+        return -1;
+    }
+
+    size_t fragments = (size_t)count * session->batch_size;
+    session->trains = calloc(session->batch_size, sizeof(struct ip_fragment_train));
+    session->fragment_headers = calloc(fragments, IP_FRAGMENT_HEADER_SPACE);
+    session->fragment_iovecs = calloc(2 * fragments, sizeof(struct iovec));
+    session->fragment_msgs = calloc(fragments, sizeof(struct mmsghdr));
+    if (!session->trains || !session->fragment_headers || !session->fragment_iovecs || !session->fragment_msgs)
+    {
+        fprintf(stderr, "Error: Failed to allocate %zu fragments\n", fragments);
         return -1;
     }
 
-    // 4. Allocate the packet buffer (Zeroed out)
-    uint8_t packet[IP_V4_MAX_PACKET_SIZE];
-    memset(packet, 0, sizeof(packet));
+    for (uint32_t i = 0; i < session->batch_size; i++)
+    {
+        struct ip_fragment_train *train = &session->trains[i];
+        train->headers = session->fragment_headers + (size_t)i * count * IP_FRAGMENT_HEADER_SPACE;
+        train->iovecs = session->fragment_iovecs + (size_t)2 * i * count;
+        train->capacity = count;
 
-    // 5. Build the ICMPv4 Segment (placed immediately after where the IP header will go)
-    size_t ip_hdr_size = sizeof(struct ip_v4_header);
-    uint8_t *icmp_start = packet + ip_hdr_size;
-    size_t max_icmp_capacity = sizeof(packet) - ip_hdr_size;
+        // Every fragment of a slot travels to the slot's destination, which patching keeps current
+        for (uint32_t f = 0; f < count; f++)
+        {
+            struct msghdr *hdr = &session->fragment_msgs[(size_t)i * count + f].msg_hdr;
+            hdr->msg_name = session->msgs[i].msg_hdr.msg_name;
+            hdr->msg_namelen = session->msgs[i].msg_hdr.msg_namelen;
+            hdr->msg_iov = &train->iovecs[2 * f];
+            hdr->msg_iovlen = 2;
+        }
+    }
 
-    size_t icmp_len = build_icmp_v4_echo_request(
-        icmp_start, max_icmp_capacity,
-        config->icmp_v4_type, config->icmp_v4_code,
-        config->icmp_v4_identifier, current_sequence,
-        config->payload, config->payload_len);
+    session->fragment_count = count;
+    return 0;
+}
 
-    if (icmp_len == 0)
+int icmp_session_open(struct icmp_session *session, const struct app_config *config)
+{
+    memset(session, 0, sizeof(struct icmp_session));
+    session->sockfd = -1;
+    session->config = config;
+
+    if (config->batch_size == 0 || config->batch_size > ICMP_SESSION_MAX_BATCH)
     {
-        fprintf(stderr, "Error: Failed to construct ICMP segment.\n");
-        close(sockfd);
+        fprintf(stderr, "Error: Invalid batch size %u. Must be 1-%i\n", config->batch_size, ICMP_SESSION_MAX_BATCH);
         return -1;
     }
 
-    // 6. Build the IPv4 Header (placed at the very beginning of the buffer)
-    // We use the current_sequence as the IP Identification field as well for tracking
-    size_t ip_len = build_ip_v4_header(
-        packet, sizeof(packet),
-        config->ip_v4_src_addr, config->ip_v4_dst_addr,
-        config->ip_v4_ttl, current_sequence,
-        IP_PROTO_ICMP_V4, icmp_len);
+    // Every template starts out addressed to the first target; sends retarget slots in O(1)
+    const struct target_list *targets = config->targets;
+    if (!targets || targets->count == 0)
+    {
+        fprintf(stderr, "Error: No targets to probe\n");
+        return -1;
+    }
+    session->family = targets->family;
 
-    if (ip_len == 0)
+    size_t packet_len;
+    if (session->family == AF_INET6)
+    {
+        packet_len = sizeof(struct ip_v6_header) + sizeof(struct icmp_v6_header) + sizeof(struct icmp_v6_echo_header) + config->payload_len;
+        if (packet_len - sizeof(struct ip_v6_header) > UINT16_MAX)
+        {
+            fprintf(stderr, "Error: Payload of %zu bytes exceeds the IPv6 maximum payload length\n", config->payload_len);
+            return -1;
+        }
+    }
+    else
+    {
+        packet_len = sizeof(struct ip_v4_header) + sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header) + config->payload_len;
+        if (packet_len > IP_V4_MAX_PACKET_SIZE)
+        {
+            fprintf(stderr, "Error: Payload of %zu bytes exceeds the IPv4 maximum datagram size\n", config->payload_len);
+            return -1;
+        }
+    }
+    session->packet_len = packet_len;
+
+    // 1. Open the raw socket for the targets' family
+    session->sockfd = icmp_socket_open(session->family, config->icmp_v4_identifier, 0);
+    if (session->sockfd < 0)
     {
-        fprintf(stderr, "Error: Failed to construct IPv4 header.\n");
-        close(sockfd);
         return -1;
     }
 
-    // Total size of the packet to send
-    size_t total_packet_len = ip_len + icmp_len;
+    // 2. Kernel timestamps must be on before the first send, as transmit stamps are keyed by send order
+    if (config->kernel_timestamps)
+    {
+        if (kernel_timestamp_enable(session->sockfd, config->timestamp_ifname) == 0)
+        {
+            session->kernel_timestamps = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Warning: Kernel timestamps unavailable; round trips use userspace timestamps\n");
+        }
+    }
+
+    // 3. Optionally move transmission onto a memory-mapped ring; any failure keeps the raw socket path
+    session->batch_size = config->batch_size;
+    session->slot_count = config->batch_size;
+    session->ring.fd = -1;
+    session->xdp.fd = -1;
+    uint32_t frames = (2 * session->batch_size > PACKET_RING_MIN_FRAMES) ? 2 * session->batch_size : PACKET_RING_MIN_FRAMES;
+    uint16_t ethertype = (session->family == AF_INET6) ? ETHERTYPE_IPV6 : ETHERTYPE_IP;
+    if (config->xdp_ifname)
+    {
+        if (xdp_socket_open(&session->xdp, config->xdp_ifname, config->xdp_queue, config->next_hop_mac, ethertype, config->icmp_v4_identifier, frames, packet_len) == 0)
+        {
+            session->use_xdp = 1;
+            session->slot_count = session->xdp.tx_frames;
+        }
+        else
+        {
+            fprintf(stderr, "Warning: AF_XDP unavailable on '%s' queue %u; falling back to the raw socket\n", config->xdp_ifname, config->xdp_queue);
+        }
+    }
+    else if (config->tx_ring_ifname)
+    {
+        if (packet_ring_open(&session->ring, config->tx_ring_ifname, config->next_hop_mac, ethertype, packet_len, frames) == 0)
+        {
+            session->use_ring = 1;
+            session->slot_count = session->ring.frame_count;
+        }
+        else
+        {
+            fprintf(stderr, "Warning: TX ring unavailable on '%s'; falling back to the raw socket\n", config->tx_ring_ifname);
+        }
+    }
+    else if (config->use_uring)
+    {
+        if (uring_queue_open(&session->uring, session->sockfd, session->family, frames, packet_len, config->uring_sq_poll) == 0)
+        {
+            session->use_uring = 1;
+            session->slot_count = session->uring.send_slots;
+        }
+        else
+        {
+            fprintf(stderr, "Warning: io_uring unavailable; falling back to sendmmsg\n");
+        }
+    }
+
+    // 4. Allocate right-sized slots for a full batch (the ring already provides the datagram memory, otherwise the pool does)
+    if (session->family == AF_INET6)
+    {
+        session->slots6 = calloc(session->slot_count, sizeof(struct icmp_v6_echo_template));
+        session->slot_addrs6 = calloc(session->slot_count, sizeof(struct sockaddr_in6));
+    }
+    else
+    {
+        session->slots = calloc(session->slot_count, sizeof(struct icmp_v4_echo_template));
+        session->slot_addrs = calloc(session->slot_count, sizeof(struct sockaddr_in));
+    }
+    uint8_t in_place = session->use_ring || session->use_xdp;
+    if (!in_place && packet_pool_init(&session->pool, session->slot_count, packet_len) != 0)
+    {
+        icmp_session_close(session);
+        return -1;
+    }
+    session->iovecs = calloc(session->batch_size, sizeof(struct iovec));
+    session->msgs = calloc(session->batch_size, sizeof(struct mmsghdr));
+
+    if ((!session->slots && !session->slots6) || (!session->slot_addrs && !session->slot_addrs6) || !session->iovecs || !session->msgs)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u batch slots\n", session->batch_size);
+        icmp_session_close(session);
+        return -1;
+    }
+
+    // 5. Build every datagram once; each send afterwards is an O(1) header patch
+    for (uint32_t i = 0; i < session->slot_count; i++)
+    {
+        uint8_t *buffer;
+        if (session->use_xdp)
+        {
+            buffer = xdp_socket_frame_data(&session->xdp, i);
+        }
+        else if (session->use_ring)
+        {
+            buffer = packet_ring_frame_data(&session->ring, i);
+        }
+        else
+        {
+            buffer = packet_pool_buffer(&session->pool, i);
+        }
+        size_t built_len;
+
+        if (session->family == AF_INET6)
+        {
+            built_len = build_icmp_v6_echo_template(
+                &session->slots6[i], buffer, packet_len,
+                &config->ip_v6_src, &targets->addrs6[0], config->ip_v4_ttl,
+                config->icmp_v4_code, config->icmp_v4_identifier, config->icmp_v4_sequence,
+                config->payload, config->payload_len);
+        }
+        else
+        {
+            built_len = build_icmp_v4_echo_template(
+                &session->slots[i], buffer, packet_len,
+                config->ip_v4_src, targets->addrs[0], config->ip_v4_ttl,
+                config->icmp_v4_type, config->icmp_v4_code,
+                config->icmp_v4_identifier, config->icmp_v4_sequence,
+                config->dont_fragment ? IP_V4_FLAG_DF : 0,
+                config->payload, config->payload_len);
+        }
+
+        if (built_len == 0)
+        {
+            fprintf(stderr, "Error: Failed to construct the ICMP Echo template.\n");
+            icmp_session_close(session);
+            return -1;
+        }
+
+        if (in_place)
+        {
+            continue; /**< Ring and UMEM frames are handed over by index, never through a message header */
+        }
+
+        if (session->family == AF_INET6)
+        {
+            session->slot_addrs6[i].sin6_family = AF_INET6;
+            session->slot_addrs6[i].sin6_addr = targets->addrs6[0];
+        }
+        else
+        {
+            session->slot_addrs[i].sin_family = AF_INET;
+            session->slot_addrs[i].sin_addr = targets->addrs[0];
+        }
+
+        if (i >= session->batch_size)
+        {
+            continue; /**< io_uring slots beyond one batch are only ever sent through their template and address */
+        }
+
+        if (session->family == AF_INET6)
+        {
+            session->msgs[i].msg_hdr.msg_name = &session->slot_addrs6[i];
+            session->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+        }
+        else
+        {
+            session->msgs[i].msg_hdr.msg_name = &session->slot_addrs[i];
+            session->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+
+        session->iovecs[i].iov_base = buffer;
+        session->iovecs[i].iov_len = built_len;
+
+        session->msgs[i].msg_hdr.msg_iov = &session->iovecs[i];
+        session->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // 6. Datagrams over the fragment MTU get a train per slot; only its headers are rewritten per send
+    if (config->fragment_mtu > 0 && packet_len > config->fragment_mtu && !in_place && !session->use_uring && open_fragments(session) != 0)
+    {
+        icmp_session_close(session);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Points slot @p slot at target @p target with sequence @p seq, stamping its payload when enabled.
+ *
+ * In stateless mode @p seq is ignored: the sequence is the low half of the probe's cookie MAC, and the
+ * cookie takes the place of the stamp.
+ */
+static void patch_slot(struct icmp_session *session, uint32_t slot, uint32_t target, uint16_t seq)
+{
+    const struct app_config *config = session->config;
+    const struct target_list *targets = config->targets;
+
+    struct payload_stamp stamp;
+    struct probe_cookie cookie;
+    if (config->cookie_key)
+    {
+        const void *addr = (session->family == AF_INET6) ? (const void *)&targets->addrs6[target] : (const void *)&targets->addrs[target];
+        size_t addr_len = (session->family == AF_INET6) ? sizeof(struct in6_addr) : sizeof(struct in_addr);
+        seq = probe_cookie_make(config->cookie_key, addr, addr_len, config->icmp_v4_identifier, target, session->stamp_ns, &cookie);
+    }
+    else if (config->payload_stamp)
+    {
+        stamp.send_ns = session->stamp_ns;
+        stamp.magic = PAYLOAD_STAMP_MAGIC;
+        stamp.identifier = config->icmp_v4_identifier;
+        stamp.sequence = seq;
+    }
+
+    if (session->family == AF_INET6)
+    {
+        patch_icmp_v6_echo_template_dst(&session->slots6[slot], &targets->addrs6[target]);
+        patch_icmp_v6_echo_template(&session->slots6[slot], seq);
+        if (config->cookie_key)
+        {
+            patch_icmp_v6_echo_template_payload(&session->slots6[slot], 0, &cookie, sizeof(cookie));
+        }
+        else if (config->payload_stamp)
+        {
+            patch_icmp_v6_echo_template_payload(&session->slots6[slot], 0, &stamp, sizeof(stamp));
+        }
+        if (!session->use_ring && !session->use_xdp)
+        {
+            session->slot_addrs6[slot].sin6_addr = targets->addrs6[target];
+        }
+    }
+    else
+    {
+        // We use the sequence as the IP Identification field as well for tracking
+        patch_icmp_v4_echo_template_dst(&session->slots[slot], targets->addrs[target].s_addr);
+        patch_icmp_v4_echo_template(&session->slots[slot], seq, seq);
+        if (config->cookie_key)
+        {
+            patch_icmp_v4_echo_template_payload(&session->slots[slot], 0, &cookie, sizeof(cookie));
+        }
+        else if (config->payload_stamp)
+        {
+            patch_icmp_v4_echo_template_payload(&session->slots[slot], 0, &stamp, sizeof(stamp));
+        }
+        if (!session->use_ring && !session->use_xdp)
+        {
+            session->slot_addrs[slot].sin_addr = targets->addrs[target];
+        }
+    }
+}
+
+/**
+ * @brief Tees slot @p slot's patched datagram into the capture stream, if one is attached.
+ */
+static void capture_slot(struct icmp_session *session, uint32_t slot)
+{
+    if (session->capture)
+    {
+        struct iovec iov;
+        iov.iov_base = (session->family == AF_INET6) ? session->slots6[slot].buffer : session->slots[slot].buffer;
+        iov.iov_len = (session->family == AF_INET6) ? session->slots6[slot].length : session->slots[slot].length;
+        packet_capture_append(session->capture, session->stamp_ns, PACKET_CAPTURE_OUTBOUND, &iov, 1);
+    }
+}
+
+/**
+ * @brief Ring transmission: patch each frame in place as soon as the kernel has released it, then kick once.
+ */
+static int send_ring(struct icmp_session *session, uint32_t first_target, uint16_t first_sequence, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t frame;
+        if (packet_ring_acquire(&session->ring, &frame) != 0)
+        {
+            return -1;
+        }
+        patch_slot(session, frame, first_target + i, (uint16_t)(first_sequence + i));
+        capture_slot(session, frame);
+        packet_ring_commit(&session->ring, session->packet_len);
+    }
+
+    return packet_ring_flush(&session->ring);
+}
+
+/**
+ * @brief AF_XDP transmission: patch free UMEM frames in place, queue them on the TX ring, then kick once.
+ */
+static int send_xdp(struct icmp_session *session, uint32_t first_target, uint16_t first_sequence, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t frame;
+        if (xdp_socket_acquire_tx(&session->xdp, &frame) != 0)
+        {
+            return -1;
+        }
+        patch_slot(session, frame, first_target + i, (uint16_t)(first_sequence + i));
+        capture_slot(session, frame);
+        xdp_socket_commit_tx(&session->xdp, frame, session->packet_len);
+    }
+
+    return xdp_socket_flush(&session->xdp);
+}
+
+/**
+ * @brief io_uring transmission: patch each slot once its previous send completed, queue it, then submit once.
+ */
+static int send_uring(struct icmp_session *session, uint32_t first_target, uint16_t first_sequence, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t slot;
+        if (uring_queue_acquire(&session->uring, &slot) != 0)
+        {
+            return -1;
+        }
+        patch_slot(session, slot, first_target + i, (uint16_t)(first_sequence + i));
+        capture_slot(session, slot);
+
+        if (session->family == AF_INET6)
+        {
+            uring_queue_send(&session->uring, slot, session->slots6[slot].buffer, session->slots6[slot].length,
+                             (const struct sockaddr *)&session->slot_addrs6[slot], sizeof(struct sockaddr_in6));
+        }
+        else
+        {
+            uring_queue_send(&session->uring, slot, session->slots[slot].buffer, session->slots[slot].length,
+                             (const struct sockaddr *)&session->slot_addrs[slot], sizeof(struct sockaddr_in));
+        }
+    }
+
+    return uring_queue_submit(&session->uring);
+}
+
+int icmp_socket_send_messages(int sockfd, struct mmsghdr *msgs, uint32_t count)
+{
+    uint32_t sent = 0;
+    while (sent < count)
+    {
+        int rc = sendmmsg(sockfd, &msgs[sent], count - sent, 0);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("Error: Failed to send packet batch");
+            return -1;
+        }
+        sent += (uint32_t)rc;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Fragmented transmission: split each patched slot into its train, then push every fragment of the batch at once.
+ */
+static int send_fragments(struct icmp_session *session, uint32_t count)
+{
+    const struct app_config *config = session->config;
 
-    // 7. Inject the raw bytes onto the wire
-    ssize_t bytes_sent = sendto(sockfd, packet, total_packet_len, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    // 1. Only headers are rebuilt; each fragment's payload vector points into its slot's datagram
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t built;
+        if (session->family == AF_INET6)
+        {
+            const struct icmp_v6_echo_template *tmpl = &session->slots6[i];
+            uint32_t identification = ((uint32_t)config->icmp_v4_identifier << 16) | ntohs(tmpl->echo->sequence);
+            built = fragment_ip_v6_packet(&session->trains[i], tmpl->buffer, tmpl->length, config->fragment_mtu, identification);
+        }
+        else
+        {
+            // Raw sockets replace an Identification of 0 with a fresh one per fragment, which would defeat reassembly
+            struct icmp_v4_echo_template *tmpl = &session->slots[i];
+            if (tmpl->ip->identification == 0)
+            {
+                patch_icmp_v4_echo_template(tmpl, UINT16_MAX, ntohs(tmpl->echo->sequence));
+            }
+            built = fragment_ip_v4_datagram(&session->trains[i], tmpl->buffer, tmpl->length, config->fragment_mtu);
+        }
+
+        if (built != session->fragment_count)
+        {
+            fprintf(stderr, "Error: Failed to fragment the datagram for slot %u\n", i);
+            return -1;
+        }
+    }
+
+    // 2. What goes on the wire is the fragments, so those are what a capture sees
+    uint32_t messages = count * session->fragment_count;
+    for (uint32_t i = 0; session->capture && i < messages; i++)
+    {
+        const struct msghdr *hdr = &session->fragment_msgs[i].msg_hdr;
+        packet_capture_append(session->capture, session->stamp_ns, PACKET_CAPTURE_OUTBOUND, hdr->msg_iov, (int)hdr->msg_iovlen);
+    }
+
+    // 3. The trains of consecutive slots are contiguous, so the whole batch is one message array
+    return icmp_socket_send_messages(session->sockfd, session->fragment_msgs, messages);
+}
+
+int icmp_session_send(struct icmp_session *session, uint32_t target, uint16_t current_sequence)
+{
+    if (session->config->payload_stamp || session->config->cookie_key || session->capture)
+    {
+        session->stamp_ns = timestamp_now_ns();
+    }
+
+    if (session->use_uring)
+    {
+        return send_uring(session, target, current_sequence, 1);
+    }
+    if (session->use_xdp)
+    {
+        return send_xdp(session, target, current_sequence, 1);
+    }
+    if (session->use_ring)
+    {
+        return send_ring(session, target, current_sequence, 1);
+    }
+
+    // 1. Patch the only fields that change between packets
+    patch_slot(session, 0, target, current_sequence);
+    if (session->fragment_count)
+    {
+        return send_fragments(session, 1);
+    }
+    capture_slot(session, 0);
+
+    // 2. Inject the raw bytes onto the wire
+    const struct msghdr *hdr = &session->msgs[0].msg_hdr;
+    ssize_t bytes_sent = sendto(session->sockfd, session->iovecs[0].iov_base, session->iovecs[0].iov_len, 0, (const struct sockaddr *)hdr->msg_name, hdr->msg_namelen);
 
     if (bytes_sent < 0)
     {
         perror("Error: Failed to send packet");
-        close(sockfd);
         return -1;
     }
-    else if ((size_t)bytes_sent != total_packet_len)
+    else if ((size_t)bytes_sent != session->iovecs[0].iov_len)
     {
-        fprintf(stderr, "Warning: Only sent %zd out of %zu bytes\n", bytes_sent, total_packet_len);
+        fprintf(stderr, "Warning: Only sent %zd out of %zu bytes\n", bytes_sent, session->iovecs[0].iov_len);
     }
 
-    // 8. Clean up
-    close(sockfd);
     return 0;
-}
\ No newline at end of file
+}
+
+int icmp_session_send_batch(struct icmp_session *session, uint32_t first_target, uint16_t first_sequence, uint32_t count)
+{
+    if (count == 0 || count > session->batch_size)
+    {
+        fprintf(stderr, "Error: Batch of %u packets exceeds the session's %u slots\n", count, session->batch_size);
+        return -1;
+    }
+
+    // One clock read per batch: every packet of it leaves within the same system call
+    if (session->config->payload_stamp || session->config->cookie_key || session->capture)
+    {
+        session->stamp_ns = timestamp_now_ns();
+    }
+
+    if (session->use_uring)
+    {
+        return send_uring(session, first_target, first_sequence, count);
+    }
+    if (session->use_xdp)
+    {
+        return send_xdp(session, first_target, first_sequence, count);
+    }
+    if (session->use_ring)
+    {
+        return send_ring(session, first_target, first_sequence, count);
+    }
+
+    // 1. Patch each slot with its own destination and sequence (allowed to overflow back to `0`)
+    for (uint32_t i = 0; i < count; i++)
+    {
+        patch_slot(session, i, first_target + i, (uint16_t)(first_sequence + i));
+    }
+
+    // 2. Hand the whole batch to the kernel, as whole datagrams or as every fragment of them
+    if (session->fragment_count)
+    {
+        return send_fragments(session, count);
+    }
+    for (uint32_t i = 0; session->capture && i < count; i++)
+    {
+        capture_slot(session, i);
+    }
+
+    return icmp_socket_send_messages(session->sockfd, session->msgs, count);
+}
+
+void icmp_session_attach_capture(struct icmp_session *session, struct packet_capture_stream *stream)
+{
+    session->capture = stream;
+}
+
+void icmp_session_close(struct icmp_session *session)
+{
+    // Waits for in-flight sends, which still read the slots freed below
+    if (session->use_uring)
+    {
+        uring_queue_close(&session->uring);
+        session->use_uring = 0;
+    }
+
+    if (session->use_ring)
+    {
+        packet_ring_close(&session->ring);
+        session->use_ring = 0;
+    }
+
+    if (session->use_xdp)
+    {
+        xdp_socket_close(&session->xdp);
+        session->use_xdp = 0;
+    }
+
+    if (session->sockfd >= 0)
+    {
+        close(session->sockfd);
+        session->sockfd = -1;
+    }
+
+    free(session->slots);
+    free(session->slots6);
+    packet_pool_free(&session->pool);
+    free(session->slot_addrs);
+    free(session->slot_addrs6);
+    free(session->iovecs);
+    free(session->msgs);
+    free(session->trains);
+    free(session->fragment_headers);
+    free(session->fragment_iovecs);
+    free(session->fragment_msgs);
+    session->slots = NULL;
+    session->slots6 = NULL;
+    session->slot_addrs = NULL;
+    session->slot_addrs6 = NULL;
+    session->iovecs = NULL;
+    session->msgs = NULL;
+    session->trains = NULL;
+    session->fragment_headers = NULL;
+    session->fragment_iovecs = NULL;
+    session->fragment_msgs = NULL;
+    session->fragment_count = 0;
+    session->batch_size = 0;
+    session->slot_count = 0;
+}
@@ -7,14 +7,147 @@
 
 #include "app_config.h"
 #include "ip_common.h"
+#include "ip_v4.h"
+#include "ip_v6.h"
+#include "packet_builder.h"
+#include "packet_capture.h"
+#include "packet_pool.h"
+#include "packet_ring.h"
+#include "uring_queue.h"
+#include "xdp_socket.h"
+
+#include <netinet/in.h>
 #include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Upper bound on packets handed to the kernel in a single `sendmmsg` call.
+ * @note Matches the kernel's UIO_MAXIOV limit on message vectors.
+ */
+#define ICMP_SESSION_MAX_BATCH 1024
+
+/**
+ * @struct icmp_session
+ * @brief Long-lived transmission state: one raw socket shared by every destination, reused for N sends.
+ *
+ * @note Opened once with @ref icmp_session_open, torn down explicitly with @ref icmp_session_close.
+ *       Each batch slot owns a prebuilt template and address so a whole batch can be patched and sent
+ *       in one syscall, to one or many destinations. The target list's family selects the IPv4 or
+ *       the IPv6 slot arrays; the other pair stays NULL. Both families share the same batching path.
+ *       With a TX ring (`-I`) or an AF_XDP port (`-X`), the templates live directly in the ring's frames
+ *       or the UMEM instead of @ref pool, and the address, I/O vector and message arrays are unused.
+ *       With io_uring (`-U`), there is one template and address per send slot, as a slot is only reused
+ *       once the kernel has completed its previous send. Datagrams larger than `config->fragment_mtu`
+ *       are split into a train per slot right after patching, and every fragment of the batch goes out
+ *       in one `sendmmsg` call, each referencing its payload in the slot's datagram.
+ */
+struct icmp_session
+{
+    int sockfd;                            /**< Raw socket with IP_HDRINCL/IPV6_HDRINCL set, or -1 when closed */
+    sa_family_t family;                    /**< AF_INET or AF_INET6, from the target list */
+    const struct app_config *config;       /**< Validated application state the session was opened with */
+    uint32_t batch_size;                   /**< Number of entries in the address, @ref iovecs and @ref msgs arrays */
+    uint32_t slot_count;                   /**< Number of templates: the batch size, or one per TX ring/UMEM frame or io_uring send slot */
+    size_t packet_len;                     /**< Bytes in every slot's datagram, IP header included */
+    struct icmp_v4_echo_template *slots;   /**< IPv4 datagrams patched per packet (slot 0 for single sends) */
+    struct icmp_v6_echo_template *slots6;  /**< IPv6 datagrams patched per packet (slot 0 for single sends) */
+    struct packet_pool pool;               /**< Cache-line-aligned datagram buffer per slot (empty when frames hold the templates) */
+    struct sockaddr_in *slot_addrs;        /**< IPv4 kernel routing structure per slot, patched with the slot's destination */
+    struct sockaddr_in6 *slot_addrs6;      /**< IPv6 kernel routing structure per slot, patched with the slot's destination */
+    struct iovec *iovecs;                  /**< One I/O vector per slot, pointing at the slot's datagram */
+    struct mmsghdr *msgs;                  /**< One message header per slot, addressed to the slot's destination */
+    struct packet_ring ring;               /**< Memory-mapped transmit ring, used only when @ref use_ring is set */
+    uint8_t use_ring;                      /**< 1 if packets go out through @ref ring instead of the raw socket */
+    struct xdp_socket xdp;                 /**< AF_XDP port, used only when @ref use_xdp is set */
+    uint8_t use_xdp;                       /**< 1 if packets go out (and replies come in) through @ref xdp */
+    struct uring_queue uring;              /**< io_uring queues on @ref sockfd, used only when @ref use_uring is set */
+    uint8_t use_uring;                     /**< 1 if sends and receives on the raw socket go through @ref uring */
+    uint64_t stamp_ns;                     /**< Transmit timestamp of the current send, written into payload stamps or cookies */
+    uint8_t kernel_timestamps;             /**< 1 if SO_TIMESTAMPING is on for @ref sockfd */
+    uint32_t fragment_count;               /**< Fragments each datagram is split into before sending (0 = sent whole) */
+    struct ip_fragment_train *trains;      /**< One fragment train per batch slot, or NULL when datagrams are sent whole */
+    uint8_t *fragment_headers;             /**< Header blocks of every train */
+    struct iovec *fragment_iovecs;         /**< I/O vectors of every train */
+    struct mmsghdr *fragment_msgs;         /**< One message per fragment of a full batch, addressed to the fragment's slot */
+    struct packet_capture_stream *capture; /**< Borrowed capture stream every transmitted packet is teed into, or NULL */
+};
+
+/**
+ * @brief Opens a raw ICMP (or ICMPv6) socket for @p family with a caller-supplied IP header.
+ *
+ * IPv6 raw sockets never deliver the IPv6 header, so the reply hop limit is requested as ancillary
+ * data and the kernel is told to drop every ICMPv6 type but Echo Reply (and, with @p accept_errors,
+ * the error messages) before it is queued. Either family then gets a BPF filter (see socket_filter.h)
+ * that also drops replies and errors for any other identifier; without it the socket still works,
+ * just unfiltered.
+ *
+ * @param family        AF_INET or AF_INET6.
+ * @param identifier    Echo identifier the socket's requests carry (host byte order).
+ * @param accept_errors 1 to also receive Destination Unreachable, Time Exceeded and Packet Too Big errors.
+ * @return The socket, or -1 on failure.
+ */
+int icmp_socket_open(sa_family_t family, uint16_t identifier, uint8_t accept_errors);
+
+/**
+ * @brief Hands @p count prepared messages to the kernel with `sendmmsg`, resuming after a partial send until every one is out.
+ * @param sockfd Raw socket from @ref icmp_socket_open.
+ * @param msgs   Messages to send, each addressed and pointing at one whole datagram (or fragment).
+ * @param count  Entries in @p msgs.
+ * @return 0 on success, -1 on transmission failure.
+ */
+int icmp_socket_send_messages(int sockfd, struct mmsghdr *msgs, uint32_t count);
 
 /**
- * @brief Coordinates the packet builder and raw socket transmission.
- * @param config Pointer to the validated application state.
+ * @brief Opens the raw socket, configures IP_HDRINCL and builds the packet templates.
+ *
+ * When `config->xdp_ifname` is set, transmission goes through an AF_XDP port on that interface, and
+ * when `config->tx_ring_ifname` is set, through a PACKET_TX_RING. With `config->use_uring`, the raw
+ * socket itself is driven asynchronously through io_uring. If the backend cannot be created,
+ * a warning is printed and the raw socket sends instead. The raw socket always stays open, as replies
+ * (all of them, or those the AF_XDP program does not steer) are received on it. With
+ * `config->kernel_timestamps`, the socket is stamped by the kernel (and the NIC behind
+ * `config->timestamp_ifname`); if SO_TIMESTAMPING is unsupported, a warning is printed and round trips
+ * keep their userspace timestamps. With `config->cookie_key`, each packet's sequence and leading payload
+ * bytes carry its @ref probe_cookie instead of the sequence it was sent with (see probe_cookie.h).
+ * With `config->fragment_mtu` below the datagram size, every send goes out as fragments (raw socket only).
+ *
+ * @param session Pointer to the caller-allocated session.
+ * @param config  Pointer to the validated application state, with a non-empty target list. Must outlive the session.
+ * @return 0 on success, -1 on socket, allocation or construction failure (the session is left closed).
+ */
+int icmp_session_open(struct icmp_session *session, const struct app_config *config);
+
+/**
+ * @brief Patches the first template for a target and @p current_sequence and transmits it over the open session.
+ * @param session Pointer to an open session.
+ * @param target Index of the destination in the session's target list.
  * @param current_sequence The dynamically calculated sequence number.
- * @return 0 on success, -1 on socket or transmission failure.
+ * @return 0 on success, -1 on transmission failure.
+ */
+int icmp_session_send(struct icmp_session *session, uint32_t target, uint16_t current_sequence);
+
+/**
+ * @brief Patches @p count templates with consecutive sequence numbers and pushes them with `sendmmsg`.
+ * @param session Pointer to an open session.
+ * @param first_target Index of the first destination; packet `i` goes to target `first_target + i`.
+ * @param first_sequence Sequence number of the first packet. Later packets wrap past 65535 back to `0`.
+ * @param count Number of packets to send, between 1 and the session's batch size, within the target list.
+ * @return 0 on success, -1 on transmission failure or an invalid @p count.
+ */
+int icmp_session_send_batch(struct icmp_session *session, uint32_t first_target, uint16_t first_sequence, uint32_t count);
+
+/**
+ * @brief Tees every packet the session transmits from now on into @p stream, as patched for the wire.
+ * @param session Pointer to an open session.
+ * @param stream  The capture stream, owned by the caller; must outlive the session's sends.
+ */
+void icmp_session_attach_capture(struct icmp_session *session, struct packet_capture_stream *stream);
+
+/**
+ * @brief Releases the session's socket and slot memory. Safe to call on an already closed session.
+ * @param session Pointer to the session.
  */
-int send_icmp_echo(const struct app_config *config, uint16_t current_sequence);
+void icmp_session_close(struct icmp_session *session);
 
-#endif // ICMP_EXECUTOR_H
\ No newline at end of file
+#endif // ICMP_EXECUTOR_H
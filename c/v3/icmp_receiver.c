@@ -0,0 +1,778 @@
+/**
+ * @file icmp_receiver.c
+ * @brief Non-blocking Echo Reply reception and matching against in-flight requests.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "icmp_receiver.h"
+#include "packet_builder.h"
+#include "packet_parser.h"
+#include "payload.h"
+#include "probe_cookie.h"
+#include "timestamp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+int icmp_receiver_init(struct icmp_receiver *rx, int sockfd, uint16_t identifier, const struct target_list *targets, uint64_t timeout_ns)
+{
+    memset(rx, 0, sizeof(struct icmp_receiver));
+    rx->sockfd = sockfd;
+    rx->identifier = htons(identifier);
+    rx->targets = targets;
+
+    rx->buffer = malloc(IP_V4_MAX_PACKET_SIZE);
+    rx->stats = calloc(targets->count, sizeof(struct icmp_target_stats));
+    if (!rx->buffer || !rx->stats || inflight_table_init(&rx->table, timeout_ns) != 0)
+    {
+        fprintf(stderr, "Error: Failed to allocate the reply matcher\n");
+        icmp_receiver_close(rx);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < targets->count; i++)
+    {
+        rx->stats[i].rtt_min_ns = UINT64_MAX;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Appends one probe outcome to the attached result log.
+ * @param rx      Pointer to the receiver, with a log attached.
+ * @param target  Target index of the probe.
+ * @param seq     Sequence number of the probe (host byte order).
+ * @param send_ns Send timestamp.
+ * @param status  A @ref result_log_status value.
+ * @param reply   The matched reply for @ref RESULT_LOG_REPLY, NULL otherwise.
+ */
+static void log_outcome(struct icmp_receiver *rx, uint32_t target, uint16_t seq, uint64_t send_ns, uint8_t status, const struct icmp_reply *reply)
+{
+    struct result_record record;
+    memset(&record, 0, sizeof(record));
+    record.send_ns = send_ns;
+    record.target = target;
+    record.identifier = ntohs(rx->identifier);
+    record.sequence = seq;
+    record.status = status;
+    if (reply)
+    {
+        record.recv_ns = send_ns + reply->rtt_ns;
+        record.ttl = reply->ttl;
+        record.length = (uint16_t)reply->length;
+    }
+
+    result_log_append(rx->log, &record);
+}
+
+void icmp_receiver_track(struct icmp_receiver *rx, uint16_t first_sequence, uint32_t first_target, uint32_t count, uint64_t send_ns)
+{
+    // Stateless requests leave nothing behind but the counters and the end of the quiet period
+    if (rx->cookie_key)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            rx->stats[first_target + i].sent++;
+        }
+        rx->tracked += count;
+        rx->quiet_ns = send_ns + rx->table.timeout_ns;
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint16_t seq = (uint16_t)(first_sequence + i);
+        uint32_t target = first_target + i;
+
+        // A sequence still pending after a full wrap can no longer be told apart from its successor
+        if (rx->log && rx->table.entries[seq].state == INFLIGHT_PENDING)
+        {
+            const struct inflight_entry *displaced = &rx->table.entries[seq];
+            log_outcome(rx, displaced->target, seq, displaced->send_ns, RESULT_LOG_DISPLACED, NULL);
+        }
+        rx->lost += (uint64_t)inflight_table_insert(&rx->table, seq, target, send_ns);
+        rx->stats[target].sent++;
+
+        // The kernel keys transmit stamps by send order, counting from the first packet after enabling them
+        if (rx->tx_stamps)
+        {
+            memset(&rx->tx_stamps[seq], 0, sizeof(struct kernel_timestamp));
+            rx->tx_keys[(uint16_t)rx->next_key++] = seq;
+        }
+    }
+}
+
+/**
+ * @brief Completes the in-flight request for @p seq and folds its round trip into the target's counters.
+ * @param rx         Pointer to the receiver.
+ * @param target     Target index the in-flight slot holds (already checked against the reply's source).
+ * @param seq        Sequence number echoed back (host byte order).
+ * @param recv_ns    Receive timestamp.
+ * @param rx_stamp   Kernel receive stamps of the reply, or NULL if it was not stamped.
+ * @param echoed     Echo payload carried back by the reply.
+ * @param echoed_len Bytes at @p echoed.
+ * @param reply      Output for the matched reply; the caller fills the family-specific fields.
+ */
+static void record_reply(struct icmp_receiver *rx, uint32_t target, uint16_t seq, uint64_t recv_ns, const struct kernel_timestamp *rx_stamp,
+                         const uint8_t *echoed, size_t echoed_len, struct icmp_reply *reply)
+{
+    reply->target = target;
+    reply->sequence = seq;
+    reply->source = TIMESTAMP_SOURCE_USERSPACE;
+    if (rx->cookie_key)
+    {
+        // The cookie was already verified, so its send time is ours
+        struct probe_cookie cookie;
+        memcpy(&cookie, echoed, sizeof(cookie));
+        reply->rtt_ns = (recv_ns > cookie.send_ns) ? recv_ns - cookie.send_ns : 0;
+    }
+    else
+    {
+        inflight_table_complete(&rx->table, seq, recv_ns, &reply->rtt_ns);
+    }
+
+    // A stamp echoed back carries its own transmit time, taken closer to the wire than the tracked one
+    if (rx->stamped && echoed_len >= PAYLOAD_STAMP_SIZE)
+    {
+        struct payload_stamp stamp;
+        memcpy(&stamp, echoed, sizeof(stamp));
+        if (stamp.magic == PAYLOAD_STAMP_MAGIC && stamp.identifier == ntohs(rx->identifier) && stamp.sequence == seq && stamp.send_ns <= recv_ns)
+        {
+            reply->rtt_ns = recv_ns - stamp.send_ns;
+        }
+    }
+
+    // Stamps taken by the kernel or the NIC exclude the syscalls and scheduling on both ends
+    if (rx->tx_stamps && rx_stamp)
+    {
+        reply->source = kernel_timestamp_rtt(&rx->tx_stamps[seq], rx_stamp, &reply->rtt_ns);
+    }
+    rx->sources[reply->source]++;
+
+    struct icmp_target_stats *stats = &rx->stats[target];
+    stats->received++;
+    stats->rtt_sum_ns += reply->rtt_ns;
+    stats->rtt_min_ns = (reply->rtt_ns < stats->rtt_min_ns) ? reply->rtt_ns : stats->rtt_min_ns;
+    stats->rtt_max_ns = (reply->rtt_ns > stats->rtt_max_ns) ? reply->rtt_ns : stats->rtt_max_ns;
+    if (rx->rtt)
+    {
+        hdr_histogram_record(rx->rtt, reply->rtt_ns);
+    }
+    if (rx->log)
+    {
+        log_outcome(rx, target, seq, recv_ns - reply->rtt_ns, RESULT_LOG_REPLY, reply);
+    }
+
+    rx->received++;
+}
+
+/**
+ * @brief Validates the cookie a stateless reply echoes back, in place of the in-flight lookup.
+ * @param src        Source address of the reply (Network Byte Order).
+ * @param src_len    Bytes at @p src.
+ * @param seq        Sequence number echoed back (host byte order).
+ * @param echoed     Echo payload carried back by the reply.
+ * @param echoed_len Bytes at @p echoed.
+ * @return The target index the cookie names, or UINT32_MAX if the reply does not answer one of our requests to @p src.
+ */
+static uint32_t check_cookie(const struct icmp_receiver *rx, const void *src, size_t src_len, uint16_t seq, const uint8_t *echoed, size_t echoed_len)
+{
+    if (echoed_len < PROBE_COOKIE_SIZE)
+    {
+        return UINT32_MAX;
+    }
+
+    // The MAC covers the target index as well as the address, so a valid one names the host that answered
+    struct probe_cookie cookie;
+    memcpy(&cookie, echoed, sizeof(cookie));
+    if (cookie.target >= rx->targets->count || !probe_cookie_check(rx->cookie_key, src, src_len, ntohs(rx->identifier), seq, &cookie))
+    {
+        return UINT32_MAX;
+    }
+
+    return cookie.target;
+}
+
+/**
+ * @brief Matches one IPv4 datagram (header included) against the in-flight requests.
+ * @param flags Checksums to verify: the ICMP one always (raw sockets deliver it unchecked), the IPv4 one for AF_XDP frames.
+ * @return 1 if @p reply was filled, 0 if the datagram is not one of our replies.
+ */
+static int match_v4(struct icmp_receiver *rx, const uint8_t *datagram, size_t length, unsigned int flags, uint64_t recv_ns, const struct kernel_timestamp *stamp, struct icmp_reply *reply)
+{
+    // 1. Validated views of the IPv4 header (of any IHL), the ICMP header and the Echo fields
+    struct icmp_v4_view view;
+    if (packet_parse_icmp_v4(datagram, length, flags, &view) != PACKET_PARSE_OK)
+    {
+        return 0;
+    }
+
+    // 2. Skip our own reflected requests, foreign ICMP traffic and other sessions' replies
+    if (view.icmp->type != ICMP_V4_ECHO_REPLY || view.echo->identifier != rx->identifier)
+    {
+        return 0;
+    }
+
+    // 3. The sequence selects the in-flight slot (stateless: the cookie names the target); its target must be the host that answered
+    uint16_t seq = ntohs(view.echo->sequence);
+    uint32_t target;
+    if (rx->cookie_key)
+    {
+        target = check_cookie(rx, &view.ip.header->src, sizeof(view.ip.header->src), seq, view.data, view.data_len);
+        if (target == UINT32_MAX)
+        {
+            rx->duplicates++;
+            return 0;
+        }
+    }
+    else
+    {
+        const struct inflight_entry *entry = inflight_table_find(&rx->table, seq);
+        if (!entry || rx->targets->addrs[entry->target].s_addr != view.ip.header->src)
+        {
+            rx->duplicates += (entry == NULL);
+            return 0;
+        }
+        target = entry->target;
+    }
+
+    reply->src.s_addr = view.ip.header->src;
+    reply->ttl = view.ip.header->ttl;
+    reply->length = view.ip.header_len + view.ip.payload_len;
+    record_reply(rx, target, seq, recv_ns, stamp, view.data, view.data_len, reply);
+    return 1;
+}
+
+/**
+ * @brief Matches one ICMPv6 message (no IPv6 header) from @p src against the in-flight requests.
+ * @param dst Destination of the enclosing packet, to verify the checksum over; NULL when a raw socket already did.
+ * @return 1 if @p reply was filled, 0 if the message is not one of our replies.
+ */
+static int match_v6(struct icmp_receiver *rx, const uint8_t *message, size_t length, const struct in6_addr *src, const struct in6_addr *dst, uint8_t hop_limit, uint64_t recv_ns,
+                    const struct kernel_timestamp *stamp, struct icmp_reply *reply)
+{
+    // 1. The socket filter already restricted delivery to Echo Replies; still verify the layout
+    struct icmp_v6_view view;
+    if (packet_parse_icmp_v6(message, length, src, dst, dst ? PACKET_PARSE_VERIFY_ICMP : 0, &view) != PACKET_PARSE_OK ||
+        view.icmp->type != ICMP_V6_ECHO_REPLY || view.echo->identifier != rx->identifier)
+    {
+        return 0;
+    }
+
+    // 2. The sequence selects the in-flight slot (stateless: the cookie names the target); its target must be the host that answered
+    uint16_t seq = ntohs(view.echo->sequence);
+    uint32_t target;
+    if (rx->cookie_key)
+    {
+        target = check_cookie(rx, src, sizeof(struct in6_addr), seq, view.data, view.data_len);
+        if (target == UINT32_MAX)
+        {
+            rx->duplicates++;
+            return 0;
+        }
+    }
+    else
+    {
+        const struct inflight_entry *entry = inflight_table_find(&rx->table, seq);
+        if (!entry || memcmp(&rx->targets->addrs6[entry->target], src, sizeof(struct in6_addr)) != 0)
+        {
+            rx->duplicates += (entry == NULL);
+            return 0;
+        }
+        target = entry->target;
+    }
+
+    reply->src6 = *src;
+    reply->ttl = hop_limit;
+    reply->length = length;
+    record_reply(rx, target, seq, recv_ns, stamp, view.data, view.data_len, reply);
+    return 1;
+}
+
+int icmp_parse_error_v4(const uint8_t *datagram, size_t length, struct icmp_error *error)
+{
+    struct icmp_v4_view view;
+    if (packet_parse_icmp_v4(datagram, length, PACKET_PARSE_VERIFY_ICMP, &view) != PACKET_PARSE_OK || !view.error || !view.quoted_echo)
+    {
+        return 0;
+    }
+
+    memset(error, 0, sizeof(struct icmp_error));
+    error->type = view.icmp->type;
+    error->code = view.icmp->code;
+    if (view.icmp->type == ICMP_V4_DEST_UNREACHABLE && view.icmp->code == ICMP_V4_FRAG_NEEDED)
+    {
+        error->mtu = ntohs(view.error->next_hop_mtu);
+    }
+    error->reporter.s_addr = view.ip.header->src;
+    error->original.s_addr = view.quoted.header->dst;
+    error->identifier = ntohs(view.quoted_echo->identifier);
+    error->sequence = ntohs(view.quoted_echo->sequence);
+    return 1;
+}
+
+int icmp_parse_error_v6(const uint8_t *message, size_t length, const struct in6_addr *src, struct icmp_error *error)
+{
+    struct icmp_v6_view view;
+    if (packet_parse_icmp_v6(message, length, src, NULL, 0, &view) != PACKET_PARSE_OK || !view.error || !view.quoted_echo)
+    {
+        return 0;
+    }
+
+    memset(error, 0, sizeof(struct icmp_error));
+    error->type = view.icmp->type;
+    error->code = view.icmp->code;
+    if (view.icmp->type == ICMP_V6_PACKET_TOO_BIG)
+    {
+        error->mtu = ntohl(view.error->mtu);
+    }
+    error->reporter6 = *src;
+    memcpy(&error->original6, view.quoted->dst, sizeof(struct in6_addr));
+    error->identifier = ntohs(view.quoted_echo->identifier);
+    error->sequence = ntohs(view.quoted_echo->sequence);
+    return 1;
+}
+
+/**
+ * @brief Room for the IPV6_HOPLIMIT and SCM_TIMESTAMPING control messages of one datagram.
+ */
+#define ICMP_RECEIVER_CONTROL_SIZE (CMSG_SPACE(sizeof(int)) + KERNEL_TIMESTAMP_CONTROL_SPACE)
+
+/**
+ * @brief Tees one received packet into the capture stream, if one is attached.
+ * @param src Sender of a bare ICMPv6 message, whose stripped IPv6 header is rebuilt; NULL if @p packet is a whole datagram.
+ */
+static void capture_packet(struct icmp_receiver *rx, uint64_t recv_ns, const uint8_t *packet, size_t length, const struct in6_addr *src, uint8_t hop_limit)
+{
+    if (!rx->capture)
+    {
+        return;
+    }
+
+    uint8_t header[sizeof(struct ip_v6_header)];
+    struct iovec iov[2];
+    int iovcnt = 0;
+    if (src)
+    {
+        // Only the header is written; the capacity counts the payload that follows it in the next iovec
+        build_ip_v6_header_addr(header, sizeof(header) + length, src, &rx->capture_local6, hop_limit, IP_V6_ICMP_V6, length);
+        iov[iovcnt].iov_base = header;
+        iov[iovcnt++].iov_len = sizeof(header);
+    }
+    iov[iovcnt].iov_base = (void *)packet;
+    iov[iovcnt++].iov_len = length;
+    packet_capture_append(rx->capture, recv_ns, PACKET_CAPTURE_INBOUND, iov, iovcnt);
+}
+
+/**
+ * @brief IPv4 reception: the kernel delivers the whole datagram, IPv4 header included.
+ */
+static int poll_v4(struct icmp_receiver *rx, struct icmp_reply *reply)
+{
+    struct sockaddr_in sender_info;
+    union
+    {
+        struct cmsghdr align;
+        uint8_t bytes[ICMP_RECEIVER_CONTROL_SIZE];
+    } control;
+
+    while (1)
+    {
+        struct iovec iov = {.iov_base = rx->buffer, .iov_len = IP_V4_MAX_PACKET_SIZE};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &sender_info;
+        msg.msg_namelen = sizeof(sender_info);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.bytes;
+        msg.msg_controllen = sizeof(control.bytes);
+
+        ssize_t bytes_received = recvmsg(rx->sockfd, &msg, MSG_DONTWAIT);
+        if (bytes_received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+            perror("Error: Failed to receive packet");
+            return -1;
+        }
+
+        uint64_t recv_ns = timestamp_now_ns();
+        struct kernel_timestamp stamp;
+        kernel_timestamp_read(&msg, &stamp);
+        capture_packet(rx, recv_ns, rx->buffer, (size_t)bytes_received, NULL, 0);
+        if (match_v4(rx, rx->buffer, (size_t)bytes_received, PACKET_PARSE_VERIFY_ICMP, recv_ns, &stamp, reply))
+        {
+            return 1;
+        }
+    }
+}
+
+/**
+ * @brief Extracts the IPV6_HOPLIMIT ancillary value from a received message.
+ * @return The hop limit, or 0 if the kernel did not attach one.
+ */
+static uint8_t read_hop_limit(struct msghdr *msg)
+{
+    uint8_t hop_limit = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_HOPLIMIT)
+        {
+            int value;
+            memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+            hop_limit = (uint8_t)value;
+        }
+    }
+
+    return hop_limit;
+}
+
+/**
+ * @brief IPv6 reception: the kernel strips the IPv6 header, so the hop limit arrives as ancillary data.
+ */
+static int poll_v6(struct icmp_receiver *rx, struct icmp_reply *reply)
+{
+    struct sockaddr_in6 sender_info;
+    union
+    {
+        struct cmsghdr align;
+        uint8_t bytes[ICMP_RECEIVER_CONTROL_SIZE];
+    } control;
+
+    while (1)
+    {
+        struct iovec iov = {.iov_base = rx->buffer, .iov_len = IP_V4_MAX_PACKET_SIZE};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &sender_info;
+        msg.msg_namelen = sizeof(sender_info);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.bytes;
+        msg.msg_controllen = sizeof(control.bytes);
+
+        ssize_t bytes_received = recvmsg(rx->sockfd, &msg, MSG_DONTWAIT);
+        if (bytes_received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+            perror("Error: Failed to receive packet");
+            return -1;
+        }
+
+        uint64_t recv_ns = timestamp_now_ns();
+        struct kernel_timestamp stamp;
+        kernel_timestamp_read(&msg, &stamp);
+        uint8_t hop_limit = read_hop_limit(&msg);
+        capture_packet(rx, recv_ns, rx->buffer, (size_t)bytes_received, &sender_info.sin6_addr, hop_limit);
+        if (match_v6(rx, rx->buffer, (size_t)bytes_received, &sender_info.sin6_addr, NULL, hop_limit, recv_ns, &stamp, reply))
+        {
+            return 1;
+        }
+    }
+}
+
+/**
+ * @brief AF_XDP reception: whole Ethernet frames, taken straight from the UMEM without any copy.
+ */
+static int poll_xdp(struct icmp_receiver *rx, struct icmp_reply *reply)
+{
+    const uint8_t *frame;
+    size_t length;
+    uint64_t addr;
+
+    while (xdp_socket_receive(rx->xdp, &frame, &length, &addr))
+    {
+        uint64_t recv_ns = timestamp_now_ns();
+        int matched = 0;
+        if (length > ETHER_HDR_LEN)
+        {
+            capture_packet(rx, recv_ns, frame + ETHER_HDR_LEN, length - ETHER_HDR_LEN, NULL, 0);
+        }
+
+        if (length >= ETHER_HDR_LEN + sizeof(struct ip_v6_header) && rx->targets->family == AF_INET6)
+        {
+            const uint8_t *packet = frame + ETHER_HDR_LEN;
+            const struct ip_v6_header *ip = (const struct ip_v6_header *)packet;
+            struct in6_addr src;
+            struct in6_addr dst;
+            memcpy(&src, ip->src, sizeof(src));
+            memcpy(&dst, ip->dst, sizeof(dst));
+
+            // A fragment yields nothing until the one completing its packet arrives
+            const uint8_t *message = packet + sizeof(struct ip_v6_header);
+            size_t message_len = ntohs(ip->payload_length);
+            uint8_t next_header = ip->next_header;
+            int whole = 1;
+            if (next_header == IP_V6_FRAGMENT && rx->reassembly.slots)
+            {
+                whole = reassembly_cache_add_v6(&rx->reassembly, packet, length - ETHER_HDR_LEN, recv_ns, &message, &message_len, &next_header) == 1;
+            }
+            else if (message_len > length - ETHER_HDR_LEN - sizeof(struct ip_v6_header))
+            {
+                whole = 0;
+            }
+
+            // Nothing in the kernel has looked at these frames, so every checksum is verified here
+            matched = whole && next_header == IP_V6_ICMP_V6 && match_v6(rx, message, message_len, &src, &dst, ip->hop_limit, recv_ns, NULL, reply);
+        }
+        else if (length > ETHER_HDR_LEN && rx->targets->family == AF_INET)
+        {
+            const uint8_t *datagram = frame + ETHER_HDR_LEN;
+            size_t datagram_len = length - ETHER_HDR_LEN;
+            int whole = 1;
+            if (rx->reassembly.slots && datagram_len >= sizeof(struct ip_v4_header) &&
+                ip_v4_is_fragment(ntohs(((const struct ip_v4_header *)datagram)->flags_frag_offset)))
+            {
+                whole = reassembly_cache_add_v4(&rx->reassembly, datagram, datagram_len, recv_ns, &datagram, &datagram_len) == 1;
+            }
+
+            matched = whole && match_v4(rx, datagram, datagram_len, PACKET_PARSE_VERIFY_IP | PACKET_PARSE_VERIFY_ICMP, recv_ns, NULL, reply);
+        }
+
+        // Everything needed was copied into the reply, so the frame can go straight back to the kernel
+        xdp_socket_release_rx(rx->xdp, addr);
+        if (matched)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief io_uring reception: datagrams the multishot receive already placed in provided buffers.
+ */
+static int poll_uring(struct icmp_receiver *rx, struct icmp_reply *reply)
+{
+    struct uring_message message;
+    int rc;
+
+    while ((rc = uring_queue_receive(rx->uring, &message)) == 1)
+    {
+        uint64_t recv_ns = timestamp_now_ns();
+        int matched;
+
+        if (rx->targets->family == AF_INET6)
+        {
+            // Wrap the buffer's control area so the regular CMSG walk applies
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = (void *)message.control;
+            msg.msg_controllen = message.control_len;
+            uint8_t hop_limit = read_hop_limit(&msg);
+            if (message.sender)
+            {
+                capture_packet(rx, recv_ns, message.data, message.length, &message.sender->sin6_addr, hop_limit);
+            }
+            matched = message.sender && match_v6(rx, message.data, message.length, &message.sender->sin6_addr, NULL, hop_limit, recv_ns, NULL, reply);
+        }
+        else
+        {
+            capture_packet(rx, recv_ns, message.data, message.length, NULL, 0);
+            matched = match_v4(rx, message.data, message.length, PACKET_PARSE_VERIFY_ICMP, recv_ns, NULL, reply);
+        }
+
+        // Everything needed was copied into the reply, so the buffer can go straight back to the kernel
+        uring_queue_release(rx->uring, message.buffer);
+        if (matched)
+        {
+            return 1;
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * @brief Files every transmit stamp waiting on the error queue under the sequence it belongs to.
+ * @return 0 on success, -1 on socket failure.
+ */
+static int drain_tx_stamps(struct icmp_receiver *rx)
+{
+    uint32_t key;
+    struct kernel_timestamp stamp;
+    int rc;
+
+    while ((rc = kernel_timestamp_read_tx(rx->sockfd, &key, &stamp)) == 1)
+    {
+        // Software and hardware stamps of one packet arrive as separate messages
+        struct kernel_timestamp *tx = &rx->tx_stamps[rx->tx_keys[(uint16_t)key]];
+        tx->software_ns = stamp.software_ns ? stamp.software_ns : tx->software_ns;
+        tx->hardware_ns = stamp.hardware_ns ? stamp.hardware_ns : tx->hardware_ns;
+    }
+
+    return rc;
+}
+
+int icmp_receiver_poll(struct icmp_receiver *rx, struct icmp_reply *reply)
+{
+    // A request's transmit stamp is queued at the driver, before its reply can possibly arrive
+    if (rx->tx_stamps && drain_tx_stamps(rx) != 0)
+    {
+        return -1;
+    }
+
+    // Replies the steering program passed on (other queues, IP options) still arrive on the socket
+    if (rx->xdp && poll_xdp(rx, reply))
+    {
+        return 1;
+    }
+
+    // The socket is still read afterwards: a datagram may land there while the multishot receive is re-armed
+    if (rx->uring)
+    {
+        int rc = poll_uring(rx, reply);
+        if (rc != 0)
+        {
+            return rc;
+        }
+    }
+
+    return (rx->targets->family == AF_INET6) ? poll_v6(rx, reply) : poll_v4(rx, reply);
+}
+
+void icmp_receiver_attach_xdp(struct icmp_receiver *rx, struct xdp_socket *xsk)
+{
+    rx->xdp = xsk;
+}
+
+int icmp_receiver_use_reassembly(struct icmp_receiver *rx)
+{
+    // A datagram still incomplete after the reply timeout could only ever answer a lost request
+    return reassembly_cache_init(&rx->reassembly, REASSEMBLY_CACHE_SLOTS, rx->table.timeout_ns);
+}
+
+void icmp_receiver_attach_uring(struct icmp_receiver *rx, struct uring_queue *queue)
+{
+    rx->uring = queue;
+}
+
+void icmp_receiver_use_stamps(struct icmp_receiver *rx)
+{
+    rx->stamped = 1;
+}
+
+int icmp_receiver_use_kernel_timestamps(struct icmp_receiver *rx)
+{
+    rx->tx_stamps = calloc(INFLIGHT_TABLE_SLOTS, sizeof(struct kernel_timestamp));
+    rx->tx_keys = calloc(INFLIGHT_TABLE_SLOTS, sizeof(uint16_t));
+    rx->next_key = 0;
+    if (!rx->tx_stamps || !rx->tx_keys)
+    {
+        fprintf(stderr, "Error: Failed to allocate the transmit timestamp table\n");
+        free(rx->tx_stamps);
+        free(rx->tx_keys);
+        rx->tx_stamps = NULL;
+        rx->tx_keys = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void icmp_receiver_use_cookies(struct icmp_receiver *rx, const struct probe_cookie_key *key)
+{
+    // Only the timeout is kept, as the length of the quiet period after the last request
+    inflight_table_close(&rx->table);
+    rx->cookie_key = key;
+}
+
+void icmp_receiver_attach_log(struct icmp_receiver *rx, struct result_log_stream *stream)
+{
+    rx->log = stream;
+}
+
+void icmp_receiver_attach_capture(struct icmp_receiver *rx, struct packet_capture_stream *stream, const struct in6_addr *local6)
+{
+    rx->capture = stream;
+    rx->capture_local6 = *local6;
+}
+
+void icmp_receiver_attach_histogram(struct icmp_receiver *rx, struct hdr_histogram *histogram)
+{
+    rx->rtt = histogram;
+}
+
+int icmp_receiver_expire(struct icmp_receiver *rx, uint64_t now_ns, uint16_t *sequence, uint32_t *target)
+{
+    if (rx->reassembly.slots)
+    {
+        reassembly_cache_expire(&rx->reassembly, now_ns);
+    }
+
+    // Stateless requests are never timed out one by one; the unanswered ones are counted at the end
+    if (rx->cookie_key || !inflight_table_expire_next(&rx->table, now_ns, sequence))
+    {
+        return 0;
+    }
+
+    // The freed slot still holds the probe's target until the sequence is reused
+    *target = rx->table.entries[*sequence].target;
+    rx->lost++;
+    if (rx->log)
+    {
+        log_outcome(rx, *target, *sequence, rx->table.entries[*sequence].send_ns, RESULT_LOG_TIMEOUT, NULL);
+    }
+    return 1;
+}
+
+uint64_t icmp_receiver_next_deadline(const struct icmp_receiver *rx)
+{
+    if (rx->cookie_key)
+    {
+        return (rx->tracked > 0) ? rx->quiet_ns : 0;
+    }
+
+    return inflight_table_next_deadline(&rx->table);
+}
+
+int icmp_receiver_idle(struct icmp_receiver *rx, uint64_t now_ns)
+{
+    if (!rx->cookie_key)
+    {
+        return rx->table.pending == 0;
+    }
+    if (now_ns < rx->quiet_ns)
+    {
+        return 0;
+    }
+
+    // Replies cannot be told from duplicates without state, so more replies than requests means none were lost
+    rx->lost = (rx->tracked > rx->received) ? rx->tracked - rx->received : 0;
+    return 1;
+}
+
+void icmp_receiver_close(struct icmp_receiver *rx)
+{
+    inflight_table_close(&rx->table);
+    free(rx->stats);
+    free(rx->buffer);
+    free(rx->tx_stamps);
+    free(rx->tx_keys);
+    reassembly_cache_close(&rx->reassembly);
+    rx->stats = NULL;
+    rx->buffer = NULL;
+    rx->tx_stamps = NULL;
+    rx->tx_keys = NULL;
+}
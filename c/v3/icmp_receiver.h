@@ -0,0 +1,281 @@
+/**
+ * @file icmp_receiver.h
+ * @brief Non-blocking Echo Reply reception and matching against in-flight requests.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef ICMP_RECEIVER_H
+#define ICMP_RECEIVER_H
+
+#include "hdr_histogram.h"
+#include "icmp_v4.h"
+#include "icmp_v6.h"
+#include "inflight_table.h"
+#include "kernel_timestamp.h"
+#include "ip_v4.h"
+#include "ip_v6.h"
+#include "packet_capture.h"
+#include "probe_cookie.h"
+#include "reassembly_cache.h"
+#include "result_log.h"
+#include "target_list.h"
+#include "uring_queue.h"
+#include "xdp_socket.h"
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @struct icmp_reply
+ * @brief One Echo Reply matched to the request that caused it.
+ */
+struct icmp_reply
+{
+    struct in_addr src;   /**< Replying host (IPv4 targets) */
+    struct in6_addr src6; /**< Replying host (IPv6 targets) */
+    uint32_t target;      /**< Index of the replying host in the target list */
+    uint16_t sequence;    /**< Sequence number echoed back (host byte order) */
+    uint8_t ttl;          /**< TTL of the reply's IPv4 header, or its IPv6 hop limit */
+    size_t length;        /**< Bytes received: IPv4 header included, ICMPv6 message only (as the kernel delivers it) */
+    uint64_t rtt_ns;      /**< Receive timestamp minus send timestamp */
+    uint8_t source;       /**< The @ref timestamp_source both timestamps were taken from */
+};
+
+/**
+ * @struct icmp_target_stats
+ * @brief Per-destination outcome counters.
+ */
+struct icmp_target_stats
+{
+    uint32_t sent;       /**< Requests sent to this destination */
+    uint32_t received;   /**< Matched replies from this destination */
+    uint64_t rtt_min_ns; /**< Fastest round trip (UINT64_MAX until the first reply) */
+    uint64_t rtt_max_ns; /**< Slowest round trip */
+    uint64_t rtt_sum_ns; /**< Sum of round trips, for the average */
+};
+
+/**
+ * @struct icmp_error
+ * @brief An ICMP error message that quotes one of our Echo Requests.
+ */
+struct icmp_error
+{
+    uint8_t type;              /**< ICMPv4 or ICMPv6 error type (e.g., Destination Unreachable) */
+    uint8_t code;              /**< Error code (e.g., @ref ICMP_V4_FRAG_NEEDED) */
+    uint32_t mtu;              /**< Next-hop MTU reported by "fragmentation needed" or Packet Too Big, else 0 */
+    struct in_addr reporter;   /**< Router or host that sent the error (IPv4) */
+    struct in6_addr reporter6; /**< Router or host that sent the error (IPv6) */
+    struct in_addr original;   /**< Destination of the quoted request (IPv4) */
+    struct in6_addr original6; /**< Destination of the quoted request (IPv6) */
+    uint16_t identifier;       /**< Echo identifier of the quoted request (host byte order) */
+    uint16_t sequence;         /**< Echo sequence of the quoted request (host byte order) */
+};
+
+/**
+ * @brief Parses an IPv4 datagram (header included) carrying an ICMP Destination Unreachable or Time Exceeded.
+ *
+ * Only errors quoting an ICMP Echo Request are accepted: the quote must hold the original IPv4
+ * header and at least the first 8 bytes of its ICMP message (RFC 792).
+ *
+ * @param datagram Received datagram, as delivered by a raw IPv4 socket.
+ * @param length   Bytes at @p datagram.
+ * @param error    Output for the parsed error.
+ * @return 1 if @p error was filled, 0 if the datagram is not an error about one of our requests.
+ */
+int icmp_parse_error_v4(const uint8_t *datagram, size_t length, struct icmp_error *error);
+
+/**
+ * @brief Parses an ICMPv6 Destination Unreachable, Packet Too Big or Time Exceeded message (no IPv6 header).
+ * @param message Received ICMPv6 message, as delivered by a raw IPv6 socket.
+ * @param length  Bytes at @p message.
+ * @param src     Sender of the message.
+ * @param error   Output for the parsed error.
+ * @return 1 if @p error was filled, 0 if the message is not an error about one of our requests.
+ */
+int icmp_parse_error_v6(const uint8_t *message, size_t length, const struct in6_addr *src, struct icmp_error *error);
+
+/**
+ * @struct icmp_receiver
+ * @brief Reply matching state for one identifier across every destination in a target list.
+ *
+ * @note Replies are demultiplexed without a hash map: the sequence number selects the in-flight
+ *       slot, and the slot's target index must match the reply's source address. In stateless mode
+ *       (see @ref icmp_receiver_use_cookies) there is no table at all: the @ref probe_cookie echoed
+ *       back names the target and the send time, and its MAC proves both.
+ */
+struct icmp_receiver
+{
+    int sockfd;                                /**< Borrowed raw ICMP or ICMPv6 socket, owned by the session */
+    uint16_t identifier;                       /**< Expected Echo identifier (Network Byte Order, as on the wire) */
+    const struct target_list *targets;         /**< Probed destinations; replies from anywhere else are ignored */
+    struct icmp_target_stats *stats;           /**< One entry per target, in target list order */
+    struct inflight_table table;               /**< Outstanding requests, indexed by sequence number */
+    uint64_t received;                         /**< Replies matched to an in-flight request */
+    uint64_t duplicates;                       /**< Replies for sequences that were not in flight (answered, expired or unknown) */
+    uint64_t lost;                             /**< Requests that timed out, or were displaced by a sequence wrap */
+    uint8_t *buffer;                           /**< Receive buffer sized for the largest IPv4 datagram */
+    struct xdp_socket *xdp;                    /**< Borrowed AF_XDP port read before the socket, or NULL */
+    struct uring_queue *uring;                 /**< Borrowed io_uring queue whose multishot receive reads the socket, or NULL */
+    struct hdr_histogram *rtt;                 /**< Borrowed histogram every matched round trip is recorded into, or NULL */
+    struct result_log_stream *log;             /**< Borrowed result log stream every probe outcome is appended to, or NULL */
+    uint8_t stamped;                           /**< 1 if requests carry a `payload_stamp` to take the round trip from */
+    struct kernel_timestamp *tx_stamps;        /**< Kernel transmit stamps, indexed by sequence number, or NULL if unused */
+    uint16_t *tx_keys;                         /**< Sequence of each tracked packet, indexed by the low 16 bits of its timestamp key */
+    uint32_t next_key;                         /**< Timestamp key the next tracked packet will be given */
+    uint64_t sources[TIMESTAMP_SOURCE_COUNT];  /**< Matched replies per @ref timestamp_source */
+    const struct probe_cookie_key *cookie_key; /**< Borrowed key echoed cookies are checked against (stateless mode), or NULL */
+    uint64_t tracked;                          /**< Stateless requests sent, settled into @ref lost once the run goes quiet */
+    uint64_t quiet_ns;                         /**< Stateless: when the reply timeout of the last request sent passes */
+    struct reassembly_cache reassembly;        /**< Fragmented replies off the AF_XDP port (no slots unless @ref icmp_receiver_use_reassembly) */
+    struct packet_capture_stream *capture;     /**< Borrowed capture stream every received packet is teed into, or NULL */
+    struct in6_addr capture_local6;            /**< Local address written into the IPv6 headers rebuilt for @ref capture */
+};
+
+/**
+ * @brief Prepares the matcher for replies to @p identifier from any of @p targets.
+ * @param rx         Pointer to the caller-allocated receiver.
+ * @param sockfd     Raw IPPROTO_ICMP (or IPPROTO_ICMPV6, for IPv6 targets) socket to read from (not owned).
+ * @param identifier Echo identifier the requests carry (host byte order).
+ * @param targets    Destinations the requests are sent to. Must outlive the receiver.
+ * @param timeout_ns How long a request waits for its reply before it is counted as lost.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int icmp_receiver_init(struct icmp_receiver *rx, int sockfd, uint16_t identifier, const struct target_list *targets, uint64_t timeout_ns);
+
+/**
+ * @brief Records @p count consecutive sequences as in flight, sent at @p send_ns.
+ * @param rx             Pointer to the receiver.
+ * @param first_sequence First sequence of the transmission. Later ones wrap past 65535 back to `0`.
+ * @param first_target   Target index of the first packet; packet `i` probes target `first_target + i`.
+ * @param count          Number of packets in the transmission.
+ * @param send_ns        CLOCK_MONOTONIC timestamp taken just before the send.
+ */
+void icmp_receiver_track(struct icmp_receiver *rx, uint16_t first_sequence, uint32_t first_target, uint32_t count, uint64_t send_ns);
+
+/**
+ * @brief Reads queued datagrams without blocking until one matches an in-flight request.
+ *
+ * Our own outgoing requests (loopback reflection), other ICMP traffic, foreign identifiers and
+ * replies whose source is not the probed target are skipped.
+ *
+ * @param rx    Pointer to the receiver.
+ * @param reply Output for the matched reply.
+ * @return 1 if @p reply was filled, 0 once the socket has nothing more queued, -1 on socket failure.
+ */
+int icmp_receiver_poll(struct icmp_receiver *rx, struct icmp_reply *reply);
+
+/**
+ * @brief Additionally reads replies from an AF_XDP port, ahead of the raw socket.
+ * @param rx  Pointer to the receiver.
+ * @param xsk Open port steering our replies (not owned). Must outlive the receiver.
+ */
+void icmp_receiver_attach_xdp(struct icmp_receiver *rx, struct xdp_socket *xsk);
+
+/**
+ * @brief Reassembles fragmented replies read from the AF_XDP port (see reassembly_cache.h).
+ *
+ * The raw socket needs none of this: the kernel reassembles before delivering. Fragments are held
+ * for at most the reply timeout, in @ref REASSEMBLY_CACHE_SLOTS preallocated slots.
+ *
+ * @param rx Pointer to the receiver.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int icmp_receiver_use_reassembly(struct icmp_receiver *rx);
+
+/**
+ * @brief Additionally reads replies that an io_uring multishot receive took off the socket, ahead of the socket itself.
+ * @param rx    Pointer to the receiver.
+ * @param queue Open queue on the receiver's socket (not owned). Must outlive the receiver.
+ */
+void icmp_receiver_attach_uring(struct icmp_receiver *rx, struct uring_queue *queue);
+
+/**
+ * @brief Records the round trip of every matched reply into @p histogram, which this thread then owns as its writer.
+ * @param rx        Pointer to the receiver.
+ * @param histogram Initialized histogram (not owned). Must outlive the receiver.
+ */
+void icmp_receiver_attach_histogram(struct icmp_receiver *rx, struct hdr_histogram *histogram);
+
+/**
+ * @brief Takes round trips from the `payload_stamp` echoed back in each reply, when present and intact.
+ * @param rx Pointer to the receiver.
+ */
+void icmp_receiver_use_stamps(struct icmp_receiver *rx);
+
+/**
+ * @brief Takes round trips from the kernel's (or the NIC's) own transmit and receive stamps, when both are present.
+ *
+ * The session's socket must have SO_TIMESTAMPING enabled (see @ref kernel_timestamp_enable) before
+ * its first send: transmit stamps are matched to sequences in the order @ref icmp_receiver_track
+ * saw them. A reply without a matching pair of stamps falls back to the userspace timestamps.
+ *
+ * @param rx Pointer to the receiver.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int icmp_receiver_use_kernel_timestamps(struct icmp_receiver *rx);
+
+/**
+ * @brief Switches to stateless matching: the in-flight table is released and every reply is validated by its cookie.
+ *
+ * Requests must carry a @ref probe_cookie made with @p key (see probe_cookie.h). Without per-probe
+ * state, a repeated reply counts as received again, wrong cookies count as duplicates, and requests
+ * are not timed out one by one: whatever is unanswered once the reply timeout of the last request has
+ * passed is counted as lost (see @ref icmp_receiver_idle), and only replies reach the result log.
+ *
+ * @param rx  Pointer to the receiver, before its first @ref icmp_receiver_track.
+ * @param key The run's cookie key (not owned). Must outlive the receiver.
+ */
+void icmp_receiver_use_cookies(struct icmp_receiver *rx, const struct probe_cookie_key *key);
+
+/**
+ * @brief Appends the outcome of every probe (reply, timeout or displacement) to @p stream, which this thread produces into.
+ * @param rx     Pointer to the receiver.
+ * @param stream Open stream (not owned). Must outlive the receiver.
+ */
+void icmp_receiver_attach_log(struct icmp_receiver *rx, struct result_log_stream *stream);
+
+/**
+ * @brief Tees every packet read from now on into @p stream, before it is matched (see packet_capture.h).
+ * @param rx     Pointer to the receiver.
+ * @param stream Open stream (not owned), which this thread produces into. Must outlive the receiver.
+ * @param local6 Destination written into the IPv6 headers rebuilt for raw socket reads (ignored for IPv4).
+ */
+void icmp_receiver_attach_capture(struct icmp_receiver *rx, struct packet_capture_stream *stream, const struct in6_addr *local6);
+
+/**
+ * @brief Pops one request whose reply timeout has passed, counting it as lost.
+ * @param rx       Pointer to the receiver.
+ * @param now_ns   Current CLOCK_MONOTONIC time.
+ * @param sequence Output for the lost request's sequence number.
+ * @param target   Output for the lost request's target index.
+ * @return 1 if @p sequence and @p target were filled, 0 once nothing more has expired.
+ */
+int icmp_receiver_expire(struct icmp_receiver *rx, uint64_t now_ns, uint16_t *sequence, uint32_t *target);
+
+/**
+ * @brief Earliest time at which @ref icmp_receiver_expire or @ref icmp_receiver_idle could change its answer.
+ * @param rx Pointer to the receiver.
+ * @return Absolute CLOCK_MONOTONIC time, or 0 when nothing is outstanding.
+ */
+uint64_t icmp_receiver_next_deadline(const struct icmp_receiver *rx);
+
+/**
+ * @brief Whether every request tracked so far has been answered or counted as lost.
+ *
+ * Stateless receivers cannot tell, so they wait out the reply timeout of the last request and then
+ * settle every request still unanswered into @ref icmp_receiver::lost.
+ *
+ * @param rx     Pointer to the receiver.
+ * @param now_ns Current CLOCK_MONOTONIC time.
+ * @return 1 if nothing is outstanding, 0 otherwise.
+ */
+int icmp_receiver_idle(struct icmp_receiver *rx, uint64_t now_ns);
+
+/**
+ * @brief Releases the receiver's tables. The socket is left open.
+ * @param rx Pointer to the receiver.
+ */
+void icmp_receiver_close(struct icmp_receiver *rx);
+
+#endif /* ICMP_RECEIVER_H */
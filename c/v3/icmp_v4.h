@@ -7,7 +7,6 @@
  *
  * @see RFC 792
  *
- * @todo Add additional ICMP message types and fields (i.e. Destination Unreachable)
  * @todo Address updates in RFC 4884 - Extended ICMP to Support Multi-Part Messages
  *
  * @author Jim Diroff II
@@ -30,9 +29,16 @@
 enum icmp_v4_message_type
 {
     ICMP_V4_ECHO_REPLY = 0,
-    ICMP_V4_ECHO_REQUEST = 8
+    ICMP_V4_DEST_UNREACHABLE = 3,
+    ICMP_V4_ECHO_REQUEST = 8,
+    ICMP_V4_TIME_EXCEEDED = 11
 };
 
+/**
+ * @brief Destination Unreachable code: the datagram needed fragmentation but DF was set (RFC 1191).
+ */
+#define ICMP_V4_FRAG_NEEDED 4
+
 /**
  * @struct icmp_v4_header
  * @brief ICMPv4 header (type/code/checksum), packed wire layout. Required for all ICMPv4 packets.
@@ -54,4 +60,15 @@ struct icmp_v4_echo_header
     uint16_t sequence;   /**< Sequence number */
 } __attribute__((packed));
 
+/**
+ * @struct icmp_v4_error_header
+ * @brief Fields between the ICMPv4 header and the quoted datagram of an error message, packed wire layout.
+ * @note Only "fragmentation needed" uses @ref next_hop_mtu; every other error leaves all four bytes unused.
+ */
+struct icmp_v4_error_header
+{
+    uint16_t unused;       /**< Zero */
+    uint16_t next_hop_mtu; /**< MTU of the link that refused the datagram (RFC 1191), or 0 from old routers */
+} __attribute__((packed));
+
 #endif /* ICMP_V4_H */
\ No newline at end of file
@@ -21,6 +21,9 @@
 
 enum icmp_v6_message_type
 {
+    ICMP_V6_DEST_UNREACHABLE = 1,
+    ICMP_V6_PACKET_TOO_BIG = 2,
+    ICMP_V6_TIME_EXCEEDED = 3,
     ICMP_V6_ECHO_REQUEST = 128,
     ICMP_V6_ECHO_REPLY = 129
 };
@@ -46,4 +49,13 @@ struct icmp_v6_echo_header
     uint16_t sequence;   /**< A sequence number to aid in matching Echo Replies to this Echo Request. May be zero. */
 } __attribute__((packed));
 
+/**
+ * @struct icmp_v6_error_header
+ * @brief Field between the ICMPv6 header and the quoted packet of an error message, packed wire layout.
+ */
+struct icmp_v6_error_header
+{
+    uint32_t mtu; /**< Packet Too Big: MTU of the next-hop link. Unused (zero) for every other error */
+} __attribute__((packed));
+
 #endif /* ICMP_V6_H */
\ No newline at end of file
@@ -0,0 +1,193 @@
+/**
+ * @file inflight_table.c
+ * @brief Outstanding probe table: a ring indexed by the 16-bit sequence plus a timing wheel for expiry.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "inflight_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Mask selecting a bucket from an absolute tick.
+ */
+#define WHEEL_MASK (INFLIGHT_WHEEL_BUCKETS - 1)
+
+/**
+ * @brief Absolute tick in which a probe sent at @p send_ns times out.
+ */
+static uint64_t deadline_tick(const struct inflight_table *table, uint64_t send_ns)
+{
+    return (send_ns + table->timeout_ns) / table->tick_ns;
+}
+
+static void wheel_link(struct inflight_table *table, uint32_t index)
+{
+    struct inflight_entry *entry = &table->entries[index];
+    uint32_t *head = &table->wheel[deadline_tick(table, entry->send_ns) & WHEEL_MASK];
+
+    entry->prev = INFLIGHT_NIL;
+    entry->next = *head;
+    if (*head != INFLIGHT_NIL)
+    {
+        table->entries[*head].prev = index;
+    }
+    *head = index;
+}
+
+static void wheel_unlink(struct inflight_table *table, uint32_t index)
+{
+    struct inflight_entry *entry = &table->entries[index];
+
+    if (entry->prev != INFLIGHT_NIL)
+    {
+        table->entries[entry->prev].next = entry->next;
+    }
+    else
+    {
+        table->wheel[deadline_tick(table, entry->send_ns) & WHEEL_MASK] = entry->next;
+    }
+
+    if (entry->next != INFLIGHT_NIL)
+    {
+        table->entries[entry->next].prev = entry->prev;
+    }
+
+    entry->next = INFLIGHT_NIL;
+    entry->prev = INFLIGHT_NIL;
+    entry->state = INFLIGHT_FREE;
+    table->pending--;
+}
+
+int inflight_table_init(struct inflight_table *table, uint64_t timeout_ns)
+{
+    memset(table, 0, sizeof(struct inflight_table));
+
+    // The wheel covers twice the timeout, so no pending probe is ever more than one revolution ahead
+    table->timeout_ns = timeout_ns;
+    table->tick_ns = (timeout_ns / (INFLIGHT_WHEEL_BUCKETS / 2)) + 1;
+
+    table->entries = calloc(INFLIGHT_TABLE_SLOTS, sizeof(struct inflight_entry));
+    table->wheel = malloc(INFLIGHT_WHEEL_BUCKETS * sizeof(uint32_t));
+    if (!table->entries || !table->wheel)
+    {
+        fprintf(stderr, "Error: Failed to allocate the in-flight table\n");
+        inflight_table_close(table);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < INFLIGHT_WHEEL_BUCKETS; i++)
+    {
+        table->wheel[i] = INFLIGHT_NIL;
+    }
+
+    return 0;
+}
+
+int inflight_table_insert(struct inflight_table *table, uint16_t sequence, uint32_t target, uint64_t send_ns)
+{
+    int displaced = 0;
+
+    if (table->pending == 0)
+    {
+        // Nothing to sweep: skip the cursor straight to now instead of walking idle ticks later
+        table->cursor_tick = send_ns / table->tick_ns;
+    }
+
+    if (table->entries[sequence].state == INFLIGHT_PENDING)
+    {
+        wheel_unlink(table, sequence);
+        displaced = 1;
+    }
+
+    table->entries[sequence].send_ns = send_ns;
+    table->entries[sequence].target = target;
+    table->entries[sequence].state = INFLIGHT_PENDING;
+    wheel_link(table, sequence);
+    table->pending++;
+
+    return displaced;
+}
+
+const struct inflight_entry *inflight_table_find(const struct inflight_table *table, uint16_t sequence)
+{
+    const struct inflight_entry *entry = &table->entries[sequence];
+    return (entry->state == INFLIGHT_PENDING) ? entry : NULL;
+}
+
+int inflight_table_complete(struct inflight_table *table, uint16_t sequence, uint64_t recv_ns, uint64_t *rtt_ns)
+{
+    struct inflight_entry *entry = &table->entries[sequence];
+    if (entry->state != INFLIGHT_PENDING)
+    {
+        return 0;
+    }
+
+    *rtt_ns = recv_ns - entry->send_ns;
+    wheel_unlink(table, sequence);
+    return 1;
+}
+
+int inflight_table_expire_next(struct inflight_table *table, uint64_t now_ns, uint16_t *sequence)
+{
+    uint64_t now_tick = now_ns / table->tick_ns;
+
+    // Only fully elapsed ticks are swept, so every probe in a swept bucket's tick has timed out.
+    // A cursor lagging more than one revolution only needs to visit each bucket once.
+    if (now_tick > table->cursor_tick + INFLIGHT_WHEEL_BUCKETS)
+    {
+        table->cursor_tick = now_tick - INFLIGHT_WHEEL_BUCKETS;
+    }
+
+    while (table->pending > 0 && table->cursor_tick < now_tick)
+    {
+        uint32_t index = table->wheel[table->cursor_tick & WHEEL_MASK];
+
+        // Buckets are shared across revolutions; skip probes due on a later lap
+        while (index != INFLIGHT_NIL)
+        {
+            struct inflight_entry *entry = &table->entries[index];
+            if (deadline_tick(table, entry->send_ns) < now_tick)
+            {
+                wheel_unlink(table, index);
+                *sequence = (uint16_t)index;
+                return 1;
+            }
+            index = entry->next;
+        }
+
+        table->cursor_tick++;
+    }
+
+    return 0;
+}
+
+uint64_t inflight_table_next_deadline(const struct inflight_table *table)
+{
+    if (table->pending == 0)
+    {
+        return 0;
+    }
+
+    // The first non-empty bucket at or after the cursor holds the earliest deadline
+    for (uint64_t tick = table->cursor_tick; tick < table->cursor_tick + INFLIGHT_WHEEL_BUCKETS; tick++)
+    {
+        if (table->wheel[tick & WHEEL_MASK] != INFLIGHT_NIL)
+        {
+            return (tick + 1) * table->tick_ns;
+        }
+    }
+
+    return (table->cursor_tick + INFLIGHT_WHEEL_BUCKETS) * table->tick_ns;
+}
+
+void inflight_table_close(struct inflight_table *table)
+{
+    free(table->entries);
+    free(table->wheel);
+    table->entries = NULL;
+    table->wheel = NULL;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file inflight_table.h
+ * @brief Outstanding probe table: a ring indexed by the 16-bit sequence plus a timing wheel for expiry.
+ *
+ * @note Every slot and wheel bucket is preallocated; inserting, matching and expiring are O(1) per probe
+ *       and never allocate. Sequence wraparound re-arms the slot and reports the displaced probe as lost.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef INFLIGHT_TABLE_H
+#define INFLIGHT_TABLE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Number of ring slots: one per 16-bit sequence number.
+ */
+#define INFLIGHT_TABLE_SLOTS (UINT16_MAX + 1)
+
+/**
+ * @brief Number of timing wheel buckets (power of two). The wheel spans at least twice the timeout.
+ */
+#define INFLIGHT_WHEEL_BUCKETS 1024
+
+/**
+ * @brief Sentinel link value meaning "no entry".
+ */
+#define INFLIGHT_NIL UINT32_MAX
+
+/**
+ * @enum inflight_state
+ * @brief Lifecycle of a ring slot.
+ */
+enum inflight_state
+{
+    INFLIGHT_FREE = 0, /**< Never used, answered, or expired */
+    INFLIGHT_PENDING   /**< Sent and awaiting a reply; linked into a wheel bucket */
+};
+
+/**
+ * @struct inflight_entry
+ * @brief One ring slot, intrusively linked into the wheel bucket of its deadline.
+ */
+struct inflight_entry
+{
+    uint64_t send_ns; /**< CLOCK_MONOTONIC send timestamp */
+    uint32_t next;    /**< Next slot in the same wheel bucket, or @ref INFLIGHT_NIL */
+    uint32_t prev;    /**< Previous slot in the same wheel bucket, or @ref INFLIGHT_NIL */
+    uint32_t target;  /**< Index of the probed destination, so replies can be checked against it */
+    uint8_t state;    /**< An @ref inflight_state value */
+};
+
+/**
+ * @struct inflight_table
+ * @brief The ring, the wheel and the sweep cursor.
+ */
+struct inflight_table
+{
+    struct inflight_entry *entries; /**< @ref INFLIGHT_TABLE_SLOTS slots indexed by sequence number */
+    uint32_t *wheel;                /**< @ref INFLIGHT_WHEEL_BUCKETS list heads, or @ref INFLIGHT_NIL */
+    uint64_t timeout_ns;            /**< A probe is lost once this long has passed without a reply */
+    uint64_t tick_ns;               /**< Width of one wheel bucket */
+    uint64_t cursor_tick;           /**< First tick that has not been fully swept */
+    uint32_t pending;               /**< Slots currently in @ref INFLIGHT_PENDING */
+};
+
+/**
+ * @brief Allocates the ring and the wheel.
+ * @param table      Pointer to the caller-allocated table.
+ * @param timeout_ns Reply timeout. Expiry is reported at most one tick (timeout / 512) late.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int inflight_table_init(struct inflight_table *table, uint64_t timeout_ns);
+
+/**
+ * @brief Marks @p sequence as pending since @p send_ns.
+ * @param table    Pointer to the table.
+ * @param sequence Sequence number of the probe.
+ * @param target   Index of the probed destination.
+ * @param send_ns  CLOCK_MONOTONIC send timestamp.
+ * @return 1 if a still-pending probe with the same sequence (a full wrap earlier) was displaced, 0 otherwise.
+ */
+int inflight_table_insert(struct inflight_table *table, uint16_t sequence, uint32_t target, uint64_t send_ns);
+
+/**
+ * @brief Looks up a pending probe without resolving it.
+ * @param table    Pointer to the table.
+ * @param sequence Sequence number carried by a reply.
+ * @return The pending entry, or NULL if @p sequence is not in flight.
+ */
+const struct inflight_entry *inflight_table_find(const struct inflight_table *table, uint16_t sequence);
+
+/**
+ * @brief Resolves a reply for @p sequence.
+ * @param table    Pointer to the table.
+ * @param sequence Sequence number carried by the reply.
+ * @param recv_ns  CLOCK_MONOTONIC receive timestamp.
+ * @param rtt_ns   Output for the round-trip time when matched.
+ * @return 1 if the probe was pending (now freed), 0 if it was already answered, expired or never sent.
+ */
+int inflight_table_complete(struct inflight_table *table, uint16_t sequence, uint64_t recv_ns, uint64_t *rtt_ns);
+
+/**
+ * @brief Pops one probe whose timeout has passed by @p now_ns, advancing the wheel as needed.
+ * @param table    Pointer to the table.
+ * @param now_ns   Current CLOCK_MONOTONIC time.
+ * @param sequence Output for the expired probe's sequence number.
+ * @return 1 if @p sequence was filled, 0 once nothing more has expired.
+ */
+int inflight_table_expire_next(struct inflight_table *table, uint64_t now_ns, uint16_t *sequence);
+
+/**
+ * @brief Earliest time at which @ref inflight_table_expire_next could report another probe.
+ * @param table Pointer to the table.
+ * @return Absolute CLOCK_MONOTONIC time, or 0 when nothing is pending.
+ */
+uint64_t inflight_table_next_deadline(const struct inflight_table *table);
+
+/**
+ * @brief Releases the ring and the wheel.
+ * @param table Pointer to the table.
+ */
+void inflight_table_close(struct inflight_table *table);
+
+#endif /* INFLIGHT_TABLE_H */
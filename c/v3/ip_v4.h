@@ -29,11 +29,36 @@
  */
 #define IP_V4_MIN_IHL 5
 
+/**
+ * @brief Maximum Internet Header Length in 32-bit words (60 bytes, 40 of them options).
+ */
+#define IP_V4_MAX_IHL 15
+
 /**
  * @brief Standard TTL value
  */
 #define IP_V4_STD_TTL 64
 
+/**
+ * @brief Don't Fragment flag, in host byte order within `flags_frag_offset`.
+ */
+#define IP_V4_FLAG_DF 0x4000
+
+/**
+ * @brief More Fragments flag, in host byte order within `flags_frag_offset`.
+ */
+#define IP_V4_FLAG_MF 0x2000
+
+/**
+ * @brief Fragment offset bits (in 8-octet units), in host byte order within `flags_frag_offset`.
+ */
+#define IP_V4_FRAG_OFFSET_MASK 0x1FFF
+
+/**
+ * @brief Smallest MTU every IPv4 link must support (RFC 791).
+ */
+#define IP_V4_MIN_MTU 68
+
 /**
  * @struct ip_v4_header
  * @brief 20-byte IPv4 header, packed wire layout, without options.
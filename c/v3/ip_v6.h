@@ -35,9 +35,20 @@
  */
 enum ip_v6_header_id
 {
+    IP_V6_FRAGMENT = 44, /**< Fragment extension header (RFC 8200 Section 4.5) */
     IP_V6_ICMP_V6 = 58
 };
 
+/**
+ * @brief More Fragments flag, in host byte order within `offset_flags`.
+ */
+#define IP_V6_FRAG_MF 0x0001
+
+/**
+ * @brief Fragment offset bits (a multiple of 8 octets, already in place), in host byte order within `offset_flags`.
+ */
+#define IP_V6_FRAG_OFFSET_MASK 0xFFF8
+
 /**
  * @struct ip_v6_header
  * @brief 40-byte IPv6 header, packed wire layout, without extensions.
@@ -54,4 +65,33 @@ struct ip_v6_header
     uint8_t dst[16];             /**< Destination address (128-bit) */
 } __attribute__((packed));
 
+/**
+ * @struct ip_v6_fragment_header
+ * @brief 8-byte Fragment extension header, packed wire layout.
+ *
+ * @note RFC 8200 Section 4.5
+ */
+struct ip_v6_fragment_header
+{
+    uint8_t next_header;     /**< Header of the original packet's fragmentable part (e.g., IP_V6_ICMP_V6) */
+    uint8_t reserved;        /**< Must be zero */
+    uint16_t offset_flags;   /**< Fragment Offset (13 bits, in 8-octet units) + Reserved (2 bits) + M flag (1 bit) */
+    uint32_t identification; /**< Shared by every fragment of one original packet */
+} __attribute__((packed));
+
+/**
+ * @struct ip_v6_pseudo_header
+ * @brief Pseudo-header prepended (for checksumming only) to upper-layer segments, packed wire layout.
+ *
+ * @note RFC 8200 Section 8.1
+ */
+struct ip_v6_pseudo_header
+{
+    uint8_t src[16];             /**< Source address (128-bit) */
+    uint8_t dst[16];             /**< Final destination address (128-bit) */
+    uint32_t upper_layer_length; /**< Length of the upper-layer header and data */
+    uint8_t zero[3];             /**< Must be zero */
+    uint8_t next_header;         /**< Upper-layer protocol (e.g., IP_V6_ICMP_V6) */
+} __attribute__((packed));
+
 #endif /* IP_V6_H */
\ No newline at end of file
@@ -0,0 +1,196 @@
+/**
+ * @file kernel_timestamp.c
+ * @brief SO_TIMESTAMPING: transmit and receive timestamps taken by the kernel or the NIC instead of around syscalls.
+ *
+ * @author Jim Diroff II
+ */
+#include "kernel_timestamp.h"
+#include "timestamp.h"
+
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+
+/**
+ * @brief Room for the SCM_TIMESTAMPING block plus the extended error (and its offender address) beside it.
+ */
+#define KERNEL_TIMESTAMP_CONTROL_SIZE 256
+
+/**
+ * @brief Asks the NIC behind @p ifname to stamp every transmitted and received packet.
+ * @return 0 on success, -1 if the driver refuses (no PHC, or no "all packets" receive filter).
+ */
+static int enable_hardware(int sockfd, const char *ifname)
+{
+    struct hwtstamp_config hw;
+    memset(&hw, 0, sizeof(hw));
+    hw.tx_type = HWTSTAMP_TX_ON;
+    hw.rx_filter = HWTSTAMP_FILTER_ALL;
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    if (strlen(ifname) >= sizeof(ifr.ifr_name))
+    {
+        fprintf(stderr, "Error: Interface name '%s' is too long\n", ifname);
+        return -1;
+    }
+    strcpy(ifr.ifr_name, ifname);
+    ifr.ifr_data = (char *)&hw;
+
+    if (ioctl(sockfd, SIOCSHWTSTAMP, &ifr) != 0)
+    {
+        fprintf(stderr, "Error: Failed to enable hardware timestamps on '%s': %s\n", ifname, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+int kernel_timestamp_enable(int sockfd, const char *ifname)
+{
+    // 1. Software stamps in both directions; transmit stamps come back keyed and without the packet copy
+    unsigned int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                         SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+    // 2. Hardware stamps on top; the software ones stay on as a per-packet fallback
+    if (ifname)
+    {
+        if (enable_hardware(sockfd, ifname) == 0)
+        {
+            flags |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_OPT_TX_SWHW;
+        }
+        else
+        {
+            fprintf(stderr, "Warning: Falling back to kernel software timestamps\n");
+        }
+    }
+
+    if (setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) != 0)
+    {
+        perror("Error: Failed to enable SO_TIMESTAMPING");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Converts one timespec of the SCM_TIMESTAMPING block; a zero timespec means "not stamped".
+ */
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+    return ((uint64_t)ts->tv_sec * TIMESTAMP_NS_PER_SEC) + (uint64_t)ts->tv_nsec;
+}
+
+void kernel_timestamp_read(const struct msghdr *msg, struct kernel_timestamp *stamp)
+{
+    memset(stamp, 0, sizeof(struct kernel_timestamp));
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR((struct msghdr *)msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+        {
+            // ts[0] is the software stamp, ts[1] is unused, ts[2] is the raw hardware stamp
+            struct scm_timestamping tss;
+            memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+            stamp->software_ns = timespec_ns(&tss.ts[0]);
+            stamp->hardware_ns = timespec_ns(&tss.ts[2]);
+        }
+    }
+}
+
+int kernel_timestamp_read_tx(int sockfd, uint32_t *key, struct kernel_timestamp *stamp)
+{
+    uint8_t data[1];
+    union
+    {
+        struct cmsghdr align;
+        uint8_t bytes[KERNEL_TIMESTAMP_CONTROL_SIZE];
+    } control;
+
+    while (1)
+    {
+        struct iovec iov = {.iov_base = data, .iov_len = sizeof(data)};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.bytes;
+        msg.msg_controllen = sizeof(control.bytes);
+
+        if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+            perror("Error: Failed to read the socket error queue");
+            return -1;
+        }
+
+        // 1. The stamp itself
+        kernel_timestamp_read(&msg, stamp);
+
+        // 2. The extended error beside it carries the packet counter; anything but a send stamp is skipped
+        int found = 0;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+            {
+                struct sock_extended_err err;
+                memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+                if (err.ee_errno == ENOMSG && err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING && err.ee_info == SCM_TSTAMP_SND)
+                {
+                    *key = err.ee_data;
+                    found = 1;
+                }
+            }
+        }
+
+        if (found && (stamp->software_ns != 0 || stamp->hardware_ns != 0))
+        {
+            return 1;
+        }
+    }
+}
+
+uint8_t kernel_timestamp_rtt(const struct kernel_timestamp *tx, const struct kernel_timestamp *rx, uint64_t *rtt_ns)
+{
+    // Never mix clocks: each source's pair is only compared with itself
+    if (tx->hardware_ns != 0 && rx->hardware_ns >= tx->hardware_ns)
+    {
+        *rtt_ns = rx->hardware_ns - tx->hardware_ns;
+        return TIMESTAMP_SOURCE_HARDWARE;
+    }
+    if (tx->software_ns != 0 && rx->software_ns >= tx->software_ns)
+    {
+        *rtt_ns = rx->software_ns - tx->software_ns;
+        return TIMESTAMP_SOURCE_SOFTWARE;
+    }
+
+    return TIMESTAMP_SOURCE_USERSPACE;
+}
+
+const char *kernel_timestamp_source_name(uint8_t source)
+{
+    switch (source)
+    {
+    case TIMESTAMP_SOURCE_SOFTWARE:
+        return "software";
+    case TIMESTAMP_SOURCE_HARDWARE:
+        return "hardware";
+    default:
+        return "userspace";
+    }
+}
@@ -0,0 +1,98 @@
+/**
+ * @file kernel_timestamp.h
+ * @brief SO_TIMESTAMPING: transmit and receive timestamps taken by the kernel or the NIC instead of around syscalls.
+ *
+ * @note A round trip measured with clock_gettime() before `sendmmsg` and after `recvmsg` includes
+ *       the syscalls, the stack and any scheduling delay on either side. SO_TIMESTAMPING moves both
+ *       stamps to the driver boundary (software) or into the NIC itself (hardware). Receive stamps
+ *       arrive as a control message with the datagram; transmit stamps are looped back on the socket's
+ *       error queue, keyed by a per-socket packet counter (SOF_TIMESTAMPING_OPT_ID).
+ *
+ *       Software stamps are CLOCK_REALTIME and hardware stamps come from the NIC's clock, so a round
+ *       trip is only ever taken between two stamps of the same source.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef KERNEL_TIMESTAMP_H
+#define KERNEL_TIMESTAMP_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <time.h>
+
+/**
+ * @brief Control buffer bytes an SCM_TIMESTAMPING message takes (three timespecs: software, legacy, hardware).
+ */
+#define KERNEL_TIMESTAMP_CONTROL_SPACE CMSG_SPACE(3 * sizeof(struct timespec))
+
+/**
+ * @enum timestamp_source
+ * @brief Where the two stamps of a round trip were taken, from least to most precise.
+ */
+enum timestamp_source
+{
+    TIMESTAMP_SOURCE_USERSPACE = 0, /**< CLOCK_MONOTONIC read around the syscalls (or a payload stamp) */
+    TIMESTAMP_SOURCE_SOFTWARE,      /**< Kernel stamps at the driver boundary */
+    TIMESTAMP_SOURCE_HARDWARE,      /**< NIC stamps from its PTP hardware clock */
+    TIMESTAMP_SOURCE_COUNT
+};
+
+/**
+ * @struct kernel_timestamp
+ * @brief The stamps one packet was given; a source that did not stamp it is 0.
+ */
+struct kernel_timestamp
+{
+    uint64_t software_ns; /**< Kernel software stamp (CLOCK_REALTIME) */
+    uint64_t hardware_ns; /**< NIC hardware stamp (raw PHC time) */
+};
+
+/**
+ * @brief Turns on software transmit and receive timestamps on @p sockfd and, with @p ifname, NIC stamps too.
+ *
+ * Hardware stamping is a device-wide setting (SIOCSHWTSTAMP, all received packets), shared with
+ * anything else using the NIC's clock such as a PTP daemon. If the NIC or driver refuses it, a
+ * warning is printed and the socket keeps the software stamps.
+ *
+ * @param sockfd Raw socket to stamp.
+ * @param ifname Interface whose NIC should stamp in hardware, or NULL for software only.
+ * @return 0 on success, -1 if the kernel rejects SO_TIMESTAMPING.
+ */
+int kernel_timestamp_enable(int sockfd, const char *ifname);
+
+/**
+ * @brief Extracts the SCM_TIMESTAMPING control message of a received datagram.
+ * @param msg   Message header filled by `recvmsg`, with its control area.
+ * @param stamp Output; both fields 0 if the datagram was not stamped.
+ */
+void kernel_timestamp_read(const struct msghdr *msg, struct kernel_timestamp *stamp);
+
+/**
+ * @brief Reads one transmit stamp from the socket's error queue without blocking.
+ *
+ * A packet stamped by both the kernel and the NIC is reported twice, once per source.
+ *
+ * @param sockfd Socket with timestamps enabled.
+ * @param key    Output for the packet counter value the stamp belongs to (0 for the first packet sent after enabling).
+ * @param stamp  Output for the stamp.
+ * @return 1 if @p key and @p stamp were filled, 0 once the error queue is empty, -1 on socket failure.
+ */
+int kernel_timestamp_read_tx(int sockfd, uint32_t *key, struct kernel_timestamp *stamp);
+
+/**
+ * @brief Takes a round trip from the most precise source that stamped both directions.
+ * @param tx     Transmit stamps of the request.
+ * @param rx     Receive stamps of the reply.
+ * @param rtt_ns Output for the round trip, left untouched if no source stamped both.
+ * @return The @ref timestamp_source used, or @ref TIMESTAMP_SOURCE_USERSPACE if none applied.
+ */
+uint8_t kernel_timestamp_rtt(const struct kernel_timestamp *tx, const struct kernel_timestamp *rx, uint64_t *rtt_ns);
+
+/**
+ * @brief Names a @ref timestamp_source for reports.
+ * @param source A @ref timestamp_source value.
+ * @return A static string ("userspace", "software" or "hardware").
+ */
+const char *kernel_timestamp_source_name(uint8_t source);
+
+#endif /* KERNEL_TIMESTAMP_H */
@@ -5,11 +5,28 @@
  * @author Jim Diroff II
  */
 #include "app_config.h"
+#include "hdr_histogram.h"
 #include "icmp_executor.h"
+#include "icmp_receiver.h"
 #include "icmp_v4.h"
+#include "icmp_v6.h"
 #include "ip_common.h"
 #include "ip_v4.h"
+#include "ip_v6.h"
+#include "kernel_timestamp.h"
+#include "monitor.h"
+#include "packet_capture.h"
+#include "packet_replay.h"
+#include "payload.h"
+#include "pmtu_discovery.h"
+#include "probe_cookie.h"
+#include "result_log.h"
+#include "target_list.h"
+#include "timestamp.h"
+#include "traceroute.h"
+#include "worker_pool.h"
 
+#include <arpa/inet.h>
 #include <getopt.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -30,10 +47,21 @@ void init_default_config(struct app_config *config)
 
     config->quantity = 1;
     config->sleep_time = 1;
-    config->payload = "HELLO";
+    config->batch_size = 1;
+    config->rate_pps = 0;
+    config->rate_bps = 0;
+    config->burst = 1;
+    config->reply_timeout_ms = 1000;
+    config->threads = 1;
+    config->report_interval = 0;
+    config->replay_speed = 1.0;
+    config->payload = (const uint8_t *)"HELLO";
     config->payload_len = 5;
 
     config->ip_v4_src_addr = "127.0.0.1";
+    config->ip_v4_src.s_addr = htonl(INADDR_LOOPBACK);
+    config->ip_v6_src_addr = "::1";
+    config->ip_v6_src = in6addr_loopback;
     config->ip_v4_dst_addr = "127.0.0.1";
 
     config->ip_v4_ttl = IP_V4_STD_TTL;
@@ -44,31 +72,457 @@ void init_default_config(struct app_config *config)
     config->icmp_v4_code = ICMP_V4_ECHO_CODE;
 }
 
+/**
+ * @brief Prints one fping-style line per target: sent/received/loss and min/avg/max RTT.
+ * @param targets   Pointer to the probed targets.
+ * @param all_stats Per-target counters, one per entry in @p targets.
+ */
+void print_target_summary(const struct target_list *targets, const struct icmp_target_stats *all_stats)
+{
+    printf("\n");
+    for (uint32_t i = 0; i < targets->count; i++)
+    {
+        const struct icmp_target_stats *stats = &all_stats[i];
+        char dst[TARGET_LIST_ADDRSTRLEN];
+        target_list_format(targets, i, dst, sizeof(dst));
+
+        // Stateless mode counts a repeated reply again, so received can pass sent; loss then bottoms out at zero
+        uint32_t lost = (stats->sent > stats->received) ? stats->sent - stats->received : 0;
+        double loss = (stats->sent > 0) ? (100.0 * (double)lost / (double)stats->sent) : 0.0;
+        printf("%-15s : xmt/rcv/%%loss = %u/%u/%.0f%%", dst, stats->sent, stats->received, loss);
+        if (stats->received > 0)
+        {
+            printf(", min/avg/max = %.3f/%.3f/%.3f ms",
+                   (double)stats->rtt_min_ns / TIMESTAMP_NS_PER_MSEC,
+                   (double)stats->rtt_sum_ns / stats->received / TIMESTAMP_NS_PER_MSEC,
+                   (double)stats->rtt_max_ns / TIMESTAMP_NS_PER_MSEC);
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Prints one live statistics line: totals so far, rates over the last interval and RTT percentiles.
+ * @param elapsed_ns  Time since the run started.
+ * @param interval_ns Time since the previous line.
+ * @param now         Totals sampled now.
+ * @param previous    Totals sampled for the previous line.
+ * @param rtt         Round trips merged so far.
+ */
+void print_live_stats(uint64_t elapsed_ns, uint64_t interval_ns, const struct icmp_engine_result *now, const struct icmp_engine_result *previous, const struct hdr_histogram *rtt)
+{
+    double seconds = (double)interval_ns / TIMESTAMP_NS_PER_SEC;
+    double pps = (seconds > 0.0) ? (double)(now->sent - previous->sent) / seconds : 0.0;
+    double bps = (seconds > 0.0) ? (double)(now->bytes_sent - previous->bytes_sent) * 8.0 / seconds : 0.0;
+
+    printf("[%7.1fs] sent %llu (%.0f pps, %.2f Mbit/s) | rcvd %llu | lost %llu | rtt p50/p99 = %.3f/%.3f ms\n",
+           (double)elapsed_ns / TIMESTAMP_NS_PER_SEC, (unsigned long long)now->sent, pps, bps / 1e6,
+           (unsigned long long)now->received, (unsigned long long)now->lost,
+           (double)hdr_histogram_percentile(rtt, 50.0) / TIMESTAMP_NS_PER_MSEC,
+           (double)hdr_histogram_percentile(rtt, 99.0) / TIMESTAMP_NS_PER_MSEC);
+    fflush(stdout);
+}
+
+/**
+ * @brief Prints the final RTT distribution and the average transmit rate of the run.
+ * @param elapsed_ns Duration of the run.
+ * @param result     Final totals.
+ * @param rtt        Every round trip of the run.
+ */
+void print_run_summary(uint64_t elapsed_ns, const struct icmp_engine_result *result, const struct hdr_histogram *rtt)
+{
+    if (rtt->count > 0)
+    {
+        printf("rtt min/avg/max/stddev = %.3f/%.3f/%.3f/%.3f ms\n",
+               (double)rtt->min / TIMESTAMP_NS_PER_MSEC, hdr_histogram_mean(rtt) / TIMESTAMP_NS_PER_MSEC,
+               (double)rtt->max / TIMESTAMP_NS_PER_MSEC, hdr_histogram_stddev(rtt) / TIMESTAMP_NS_PER_MSEC);
+        printf("rtt p50/p90/p99/p99.9 = %.3f/%.3f/%.3f/%.3f ms\n",
+               (double)hdr_histogram_percentile(rtt, 50.0) / TIMESTAMP_NS_PER_MSEC,
+               (double)hdr_histogram_percentile(rtt, 90.0) / TIMESTAMP_NS_PER_MSEC,
+               (double)hdr_histogram_percentile(rtt, 99.0) / TIMESTAMP_NS_PER_MSEC,
+               (double)hdr_histogram_percentile(rtt, 99.9) / TIMESTAMP_NS_PER_MSEC);
+    }
+
+    double seconds = (double)elapsed_ns / TIMESTAMP_NS_PER_SEC;
+    if (seconds > 0.0)
+    {
+        printf("%.3f s elapsed, %.0f pps, %.2f Mbit/s average\n", seconds, (double)result->sent / seconds, (double)result->bytes_sent * 8.0 / seconds / 1e6);
+    }
+}
+
+/**
+ * @brief Prints how many round trips each timestamp source measured, most precise first.
+ * @param result Final totals.
+ */
+void print_timestamp_sources(const struct icmp_engine_result *result)
+{
+    printf("rtt timestamps =");
+    const char *separator = " ";
+    for (int source = TIMESTAMP_SOURCE_COUNT - 1; source >= 0; source--)
+    {
+        if (result->sources[source] > 0)
+        {
+            printf("%s%llu %s", separator, (unsigned long long)result->sources[source], kernel_timestamp_source_name((uint8_t)source));
+            separator = ", ";
+        }
+    }
+    printf("%s\n", (result->received == 0) ? " none" : "");
+}
+
+/**
+ * @brief Discovers and prints the path MTU to every target, one after another.
+ * @param config Pointer to the application configuration; @ref app_config::pmtu_max_size bounds the search.
+ * @return 0 if every discovery succeeded, -1 otherwise.
+ */
+int run_pmtu_discovery(const struct app_config *config)
+{
+    const struct target_list *targets = config->targets;
+    uint32_t min_mtu = (targets->family == AF_INET6) ? IP_V6_MIN_LINK_MTU : IP_V4_MIN_MTU;
+    if (config->pmtu_max_size < min_mtu)
+    {
+        fprintf(stderr, "Error: Maximum probe size %u is below the minimum MTU of %u\n", config->pmtu_max_size, min_mtu);
+        return -1;
+    }
+
+    printf("\n** Path MTU Discovery **\n");
+    printf("--------------------------------------------------\n");
+    printf("[Range]         %u-%u bytes, %u probes per round, %u ms per round\n", min_mtu, config->pmtu_max_size, PMTU_PROBES_PER_ROUND, config->reply_timeout_ms);
+    printf("--------------------------------------------------\n\n");
+    fflush(stdout);
+
+    int rc = 0;
+    for (uint32_t i = 0; i < targets->count; i++)
+    {
+        char dst[TARGET_LIST_ADDRSTRLEN];
+        target_list_format(targets, i, dst, sizeof(dst));
+
+        struct pmtu_result result;
+        if (pmtu_discover(config, i, config->pmtu_max_size, &result) != 0)
+        {
+            rc = -1;
+            continue;
+        }
+        printf("PMTU to %s: %u bytes (%u rounds, %u probes", dst, result.mtu, result.rounds, result.probes);
+        if (result.hint > 0)
+        {
+            printf(", next-hop MTU %u reported", result.hint);
+        }
+        printf(")\n");
+    }
+
+    return rc;
+}
+
+/**
+ * @brief Prints one traceroute hop: each distinct responder, followed by its round trips, then any unreachable marker.
+ * @param targets Pointer to the probed targets (selects the address family).
+ * @param result  Pointer to the trace.
+ * @param ttl     Hop to print.
+ */
+void print_traceroute_hop(const struct target_list *targets, const struct traceroute_result *result, uint32_t ttl)
+{
+    const struct traceroute_probe *probes = &result->probes[(size_t)(ttl - 1) * result->queries];
+    printf("%3u ", ttl);
+
+    const struct traceroute_probe *previous = NULL;
+    for (uint32_t q = 0; q < result->queries; q++)
+    {
+        const struct traceroute_probe *probe = &probes[q];
+        if (probe->status == TRACEROUTE_PENDING)
+        {
+            printf(" *");
+            continue;
+        }
+
+        // Name the responder whenever it differs from the previous answer (ECMP or a changing path)
+        uint8_t same = previous && ((targets->family == AF_INET6) ? memcmp(&previous->from6, &probe->from6, sizeof(struct in6_addr)) == 0
+                                                                  : previous->from.s_addr == probe->from.s_addr);
+        if (!same)
+        {
+            char from[INET6_ADDRSTRLEN];
+            inet_ntop(targets->family, (targets->family == AF_INET6) ? (const void *)&probe->from6 : (const void *)&probe->from, from, sizeof(from));
+            printf(" %s", from);
+        }
+        printf("  %.3f ms", (double)probe->rtt_ns / TIMESTAMP_NS_PER_MSEC);
+        if (probe->status == TRACEROUTE_UNREACHABLE)
+        {
+            printf(" !%u", probe->code);
+        }
+        previous = probe;
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Traces and prints the path to every target, one after another.
+ * @param config Pointer to the application configuration; @ref app_config::traceroute_hops bounds the trace.
+ * @return 0 if every trace ran, -1 otherwise.
+ */
+int run_traceroute(const struct app_config *config)
+{
+    const struct target_list *targets = config->targets;
+    int rc = 0;
+
+    for (uint32_t i = 0; i < targets->count; i++)
+    {
+        char dst[TARGET_LIST_ADDRSTRLEN];
+        target_list_format(targets, i, dst, sizeof(dst));
+
+        struct traceroute_result result;
+        if (traceroute_run(config, i, config->traceroute_hops, config->quantity, &result) != 0)
+        {
+            rc = -1;
+            continue;
+        }
+
+        printf("traceroute to %s, %u hops max, %u probe(s) per hop, %zu byte payload\n", dst, result.hops, result.queries, config->payload_len);
+        uint32_t last = (result.last_hop > 0) ? result.last_hop : result.hops;
+        for (uint32_t ttl = 1; ttl <= last; ttl++)
+        {
+            print_traceroute_hop(targets, &result, ttl);
+        }
+        printf("%u probes, %s in %.3f ms\n\n", result.hops * result.queries, (result.last_hop > 0) ? "path complete" : "destination not reached",
+               (double)result.elapsed_ns / TIMESTAMP_NS_PER_MSEC);
+        traceroute_result_free(&result);
+    }
+
+    return rc;
+}
+
+/**
+ * @brief Re-sends the IPv4/ICMP datagrams of a capture file and prints what went out.
+ * @param config Pointer to the application configuration; @ref app_config::replay_path names the file.
+ * @return 0 if every pass was sent, -1 otherwise.
+ */
+int run_replay(const struct app_config *config)
+{
+    struct packet_replay replay;
+    if (packet_replay_load(&replay, config->replay_path) != 0)
+    {
+        return -1;
+    }
+    if (replay.count == 0)
+    {
+        fprintf(stderr, "Error: Capture '%s' holds no outbound IPv4/ICMP datagrams (%llu packets skipped)\n", config->replay_path, (unsigned long long)replay.skipped);
+        packet_replay_free(&replay);
+        return -1;
+    }
+
+    printf("\n** Capture Replay **\n");
+    printf("--------------------------------------------------\n");
+    printf("[Capture]       %s: %u IPv4/ICMP datagram(s) over %.3f s, %llu other packet(s) skipped\n", config->replay_path, replay.count,
+           (double)replay.span_ns / 1e9, (unsigned long long)replay.skipped);
+    if (config->replay_speed > 0)
+    {
+        printf("[Timing]        %gx original speed, %u pass(es), up to %u per batch\n", config->replay_speed, config->quantity, config->batch_size);
+    }
+    else
+    {
+        printf("[Timing]        Back to back, %u pass(es), %u per batch\n", config->quantity, config->batch_size);
+    }
+    if (config->capture_path)
+    {
+        printf("[Capture Out]   pcapng -> %s\n", config->capture_path);
+    }
+    printf("--------------------------------------------------\n\n");
+    fflush(stdout);
+
+    // The replay sends from this thread, so it is the capture's only producer
+    struct packet_capture_stream *capture = config->capture ? packet_capture_stream_open(config->capture, 0) : NULL;
+    if (config->capture && !capture)
+    {
+        packet_replay_free(&replay);
+        return -1;
+    }
+
+    struct packet_replay_result result;
+    int rc = packet_replay_run(&replay, config, capture, &result);
+    if (capture)
+    {
+        packet_capture_flush(capture);
+    }
+
+    double seconds = (double)result.elapsed_ns / 1e9;
+    printf("%llu datagrams replayed in %llu batches, %.3f s (%.0f pps, %.2f Mbit/s)\n", (unsigned long long)result.sent, (unsigned long long)result.batches, seconds,
+           (seconds > 0) ? (double)result.sent / seconds : 0.0, (seconds > 0) ? (double)result.bytes_sent * 8.0 / seconds / 1e6 : 0.0);
+
+    packet_replay_free(&replay);
+    return rc;
+}
+
 int main(int argc, char *argv[])
 {
     struct app_config config;
     init_default_config(&config);
 
+    /** Destinations are parsed to binary exactly once, before anything is sent */
+    struct target_list targets;
+    target_list_init(&targets);
+    sa_family_t src_family = 0; /**< Family of an explicit `-s`, checked against the targets' */
+
+    /** The payload is generated once, after every option is known */
+    struct payload_spec payload_spec;
+    memset(&payload_spec, 0, sizeof(payload_spec));
+    payload_spec.fill = PAYLOAD_FILL_PATTERN;
+    payload_spec.pattern = config.payload;
+    payload_spec.pattern_len = config.payload_len;
+    const char *payload_desc = (const char *)config.payload; /**< For display */
+    uint8_t hex_pattern[PAYLOAD_MAX_PATTERN];
+
+    /** Daemon mode remembers where the targets came from, so SIGHUP can read them again */
+    struct monitor_config monitor;
+    memset(&monitor, 0, sizeof(monitor));
+
     /**
      * Arguments:
      *
-     * s:src, d:dst, p:payload, c:count, t:ttl, T:type, C:code, i:id, S:sequence, w:wait(sleep_time)
+     * s:src (IPv4 or IPv6), d:dst (address or CIDR, IPv4 or IPv6, repeatable), f:target file, p:payload, c:count, t:ttl, T:type, C:code, i:id, S:sequence, w:wait(sleep_time), b:batch,
+     * r:rate(pps), R:rate(bps), B:burst, W:reply timeout(ms), j:threads, I:TX ring interface, X:AF_XDP interface, Q:AF_XDP queue, M:next-hop MAC,
+     * U:io_uring, P:io_uring with submission queue polling, q:quiet (summary only), L:live statistics interval (seconds),
+     * o:binary result log file, l:payload size, x:hex payload pattern, g:random payload, F:payload file, E:embed send timestamp,
+     * D:don't fragment, m:path MTU discovery up to a maximum datagram size, H:traceroute up to a hop limit (-c = probes per hop),
+     * G:fragment datagrams larger than this MTU,
+     * Z:kernel timestamps ("sw", or "hw:<ifname>" for NIC hardware stamps), z:stateless probing (SipHash cookies, no in-flight table),
+     * K:monitoring daemon serving metrics on [addr:]port (-L = seconds between rounds), N:rounds kept per target in daemon mode,
+     * O:pcapng capture of every sent and received packet, y:replay the IPv4/ICMP datagrams of a pcap/pcapng file (-c = passes),
+     * A:replay speed (1 = original timing, 0 = back to back)
      */
     int opt;
-    while ((opt = getopt(argc, argv, "s:d:p:c:t:T:C:i:S:w:")) != -1)
+    while ((opt = getopt(argc, argv, "s:d:f:p:c:t:T:C:i:S:w:b:r:R:B:W:j:I:X:Q:M:L:o:l:x:F:m:H:G:Z:K:N:O:y:A:gEDUPqz")) != -1)
     {
         switch (opt)
         {
         case 's':
-            config.ip_v4_src_addr = optarg;
+            src_family = strchr(optarg, ':') ? AF_INET6 : AF_INET;
+            if (inet_pton(src_family, optarg, (src_family == AF_INET6) ? (void *)&config.ip_v6_src : (void *)&config.ip_v4_src) != 1)
+            {
+                fprintf(stderr, "Error: Invalid source address '%s'\n", optarg);
+                return -1;
+            }
+            if (src_family == AF_INET6)
+            {
+                config.ip_v6_src_addr = optarg;
+            }
+            else
+            {
+                config.ip_v4_src_addr = optarg;
+            }
             break;
         case 'd':
+            if (target_list_add_spec(&targets, optarg) != 0)
+            {
+                return -1;
+            }
             config.ip_v4_dst_addr = optarg;
+            if (monitor.source_count < MONITOR_MAX_SOURCES)
+            {
+                monitor.sources[monitor.source_count].spec = optarg;
+                monitor.sources[monitor.source_count++].is_file = 0;
+            }
+            else
+            {
+                monitor.sources_overflow = 1;
+            }
+            break;
+        case 'f':
+            if (target_list_load_file(&targets, optarg) != 0)
+            {
+                return -1;
+            }
+            config.ip_v4_dst_addr = optarg;
+            if (monitor.source_count < MONITOR_MAX_SOURCES)
+            {
+                monitor.sources[monitor.source_count].spec = optarg;
+                monitor.sources[monitor.source_count++].is_file = 1;
+            }
+            else
+            {
+                monitor.sources_overflow = 1;
+            }
             break;
         case 'p':
-            config.payload = optarg;
-            config.payload_len = strlen(config.payload);
+            payload_spec.fill = PAYLOAD_FILL_PATTERN;
+            payload_spec.pattern = (const uint8_t *)optarg;
+            payload_spec.pattern_len = strlen(optarg);
+            payload_desc = optarg;
+            break;
+        case 'x':
+            if (payload_parse_hex(optarg, hex_pattern, &payload_spec.pattern_len) != 0)
+            {
+                fprintf(stderr, "Error: Invalid hex pattern '%s'. Must be 1-%i bytes of hex digits\n", optarg, PAYLOAD_MAX_PATTERN);
+                return -1;
+            }
+            payload_spec.fill = PAYLOAD_FILL_PATTERN;
+            payload_spec.pattern = hex_pattern;
+            payload_desc = optarg;
+            break;
+        case 'l':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val < 0 || val > IP_V4_MAX_PACKET_SIZE)
+            {
+                fprintf(stderr, "Error: Invalid payload size '%s'. Must be 0-%i bytes\n", optarg, IP_V4_MAX_PACKET_SIZE);
+                return -1;
+            }
+            payload_spec.length = (size_t)val;
+            payload_spec.length_set = 1;
+            break;
+        }
+        case 'g':
+            payload_spec.fill = PAYLOAD_FILL_RANDOM;
+            payload_desc = "random";
+            break;
+        case 'F':
+            payload_spec.fill = PAYLOAD_FILL_FILE;
+            payload_spec.path = optarg;
+            payload_desc = optarg;
+            break;
+        case 'E':
+            payload_spec.stamp = 1;
+            break;
+        case 'z':
+            payload_spec.cookie = 1;
             break;
+        case 'D':
+            config.dont_fragment = 1;
+            break;
+        case 'm':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val < IP_V4_MIN_MTU || val > IP_V4_MAX_PACKET_SIZE)
+            {
+                fprintf(stderr, "Error: Invalid maximum probe size '%s'. Must be %i-%i bytes\n", optarg, IP_V4_MIN_MTU, IP_V4_MAX_PACKET_SIZE);
+                return -1;
+            }
+            config.pmtu_max_size = (uint32_t)val;
+            break;
+        }
+        case 'G':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val < IP_V4_MIN_MTU || val > IP_V4_MAX_PACKET_SIZE)
+            {
+                fprintf(stderr, "Error: Invalid fragment MTU '%s'. Must be %i-%i bytes\n", optarg, IP_V4_MIN_MTU, IP_V4_MAX_PACKET_SIZE);
+                return -1;
+            }
+            config.fragment_mtu = (uint32_t)val;
+            break;
+        }
+        case 'H':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val <= 0 || val > TRACEROUTE_MAX_HOPS)
+            {
+                fprintf(stderr, "Error: Invalid hop limit '%s'. Must be 1-%i\n", optarg, TRACEROUTE_MAX_HOPS);
+                return -1;
+            }
+            config.traceroute_hops = (uint32_t)val;
+            break;
+        }
         case 'c':
         {
             char *endptr;
@@ -153,39 +607,546 @@ int main(int argc, char *argv[])
             config.sleep_time = (uint8_t)val;
             break;
         }
+        case 'b':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val <= 0 || val > ICMP_SESSION_MAX_BATCH)
+            {
+                fprintf(stderr, "Error: Invalid batch size '%s'. Must be 1-%i\n", optarg, ICMP_SESSION_MAX_BATCH);
+                return -1;
+            }
+            config.batch_size = (uint32_t)val;
+            break;
+        }
+        case 'r':
+        case 'R':
+        {
+            char *endptr;
+            unsigned long long val = strtoull(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || optarg[0] == '-' || val == 0)
+            {
+                fprintf(stderr, "Error: Invalid rate '%s'. Must be a positive integer\n", optarg);
+                return -1;
+            }
+            if (opt == 'r')
+            {
+                config.rate_pps = (uint64_t)val;
+            }
+            else
+            {
+                config.rate_bps = (uint64_t)val;
+            }
+            break;
+        }
+        case 'B':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val <= 0 || val > UINT16_MAX)
+            {
+                fprintf(stderr, "Error: Invalid burst '%s'. Must be 1-%i\n", optarg, UINT16_MAX);
+                return -1;
+            }
+            config.burst = (uint32_t)val;
+            break;
+        }
+        case 'W':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val < 0 || val > UINT16_MAX)
+            {
+                fprintf(stderr, "Error: Invalid reply timeout '%s'. Must be 0-%i ms\n", optarg, UINT16_MAX);
+                return -1;
+            }
+            config.reply_timeout_ms = (uint32_t)val;
+            break;
+        }
+        case 'j':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val <= 0 || val > WORKER_POOL_MAX_THREADS)
+            {
+                fprintf(stderr, "Error: Invalid thread count '%s'. Must be 1-%i\n", optarg, WORKER_POOL_MAX_THREADS);
+                return -1;
+            }
+            config.threads = (uint32_t)val;
+            break;
+        }
+        case 'I':
+            config.tx_ring_ifname = optarg;
+            break;
+        case 'X':
+            config.xdp_ifname = optarg;
+            break;
+        case 'Q':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val < 0 || val >= XDP_SOCKET_MAP_ENTRIES)
+            {
+                fprintf(stderr, "Error: Invalid AF_XDP queue '%s'. Must be 0-%i\n", optarg, XDP_SOCKET_MAP_ENTRIES - 1);
+                return -1;
+            }
+            config.xdp_queue = (uint32_t)val;
+            break;
+        }
+        case 'q':
+            config.quiet = 1;
+            break;
+        case 'o':
+            config.result_log_path = optarg;
+            break;
+        case 'L':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val <= 0 || val > UINT16_MAX)
+            {
+                fprintf(stderr, "Error: Invalid report interval '%s'. Must be 1-%i seconds\n", optarg, UINT16_MAX);
+                return -1;
+            }
+            config.report_interval = (uint32_t)val;
+            break;
+        }
+        case 'K':
+            monitor.listen = optarg;
+            break;
+        case 'O':
+            config.capture_path = optarg;
+            break;
+        case 'y':
+            config.replay_path = optarg;
+            break;
+        case 'A':
+        {
+            char *endptr;
+            double val = strtod(optarg, &endptr);
+            if (optarg[0] == '\0' || *endptr != '\0' || !(val >= 0.0 && val <= 1e6))
+            {
+                fprintf(stderr, "Error: Invalid replay speed '%s'. Must be 0 (back to back) or a factor up to 1000000\n", optarg);
+                return -1;
+            }
+            config.replay_speed = val;
+            break;
+        }
+        case 'N':
+        {
+            char *endptr;
+            long val = strtol(optarg, &endptr, BASE10);
+            if (*endptr != '\0' || val <= 0 || val > UINT16_MAX)
+            {
+                fprintf(stderr, "Error: Invalid window length '%s'. Must be 1-%i rounds\n", optarg, UINT16_MAX);
+                return -1;
+            }
+            monitor.window = (uint32_t)val;
+            break;
+        }
+        case 'U':
+            config.use_uring = 1;
+            break;
+        case 'Z':
+            if (strcmp(optarg, "sw") == 0)
+            {
+                config.timestamp_ifname = NULL;
+            }
+            else if (strncmp(optarg, "hw:", 3) == 0 && optarg[3] != '\0')
+            {
+                config.timestamp_ifname = optarg + 3;
+            }
+            else
+            {
+                fprintf(stderr, "Error: Invalid timestamp source '%s'. Expected sw or hw:<ifname>\n", optarg);
+                return -1;
+            }
+            config.kernel_timestamps = 1;
+            break;
+        case 'P':
+            config.use_uring = 1;
+            config.uring_sq_poll = 1;
+            break;
+        case 'M':
+        {
+            unsigned int mac[6];
+            char trailing;
+            if (sscanf(optarg, "%2x:%2x:%2x:%2x:%2x:%2x%c", &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5], &trailing) != 6)
+            {
+                fprintf(stderr, "Error: Invalid MAC address '%s'. Expected aa:bb:cc:dd:ee:ff\n", optarg);
+                return -1;
+            }
+            for (int i = 0; i < 6; i++)
+            {
+                config.next_hop_mac[i] = (uint8_t)mac[i];
+            }
+            break;
+        }
         default:
-            fprintf(stderr, "Usage: %s [-s src_ip] [-d dst_ip] [-p payload] [-c count] "
-                            "[-t ttl] [-T type] [-C code] [-i id] [-S sequence] [-w wait]\n",
+            fprintf(stderr, "Usage: %s [-s src_ip] [-d dst_ip|cidr]... [-f target_file] [-p payload | -x hex | -g | -F file] [-l size] [-E | -z] [-D | -G frag_mtu] [-m max_mtu | -H max_hops] [-c count] "
+                            "[-t ttl] [-T type] [-C code] [-i id] [-S sequence] [-w wait] [-b batch] "
+                            "[-r pps | -R bps] [-B burst] [-W timeout_ms] [-j threads] [-q] [-L interval] [-o result_log] [-O capture.pcapng] [-K [addr:]port [-N rounds]] [-y replay.pcap [-A speed]] [-I tx_ring_ifname | -X xdp_ifname [-Q queue] | -U | -P] [-M next_hop_mac] [-Z sw|hw:ifname]\n",
                     argv[0]);
             return -1;
         }
     }
 
+    if (config.rate_pps > 0 && config.rate_bps > 0)
+    {
+        fprintf(stderr, "Error: -r (pps) and -R (bps) are mutually exclusive\n");
+        return -1;
+    }
+
+    if (config.tx_ring_ifname && config.xdp_ifname)
+    {
+        fprintf(stderr, "Error: -I (TX ring) and -X (AF_XDP) are mutually exclusive\n");
+        return -1;
+    }
+
+    if (config.use_uring && (config.tx_ring_ifname || config.xdp_ifname))
+    {
+        fprintf(stderr, "Error: -U/-P (io_uring) drives the raw socket and cannot be combined with -I or -X\n");
+        return -1;
+    }
+
+    /** Stamps are read from the raw socket's own receive and error queues, which only sendmmsg/recvmsg use */
+    if (config.kernel_timestamps && (config.tx_ring_ifname || config.xdp_ifname || config.use_uring))
+    {
+        fprintf(stderr, "Error: -Z (kernel timestamps) needs the raw socket backend and cannot be combined with -I, -X or -U/-P\n");
+        return -1;
+    }
+
+    /** Fragments are sent as scatter/gather messages on the raw socket, and probing the path MTU needs whole datagrams */
+    if (config.fragment_mtu > 0 && (config.dont_fragment || config.pmtu_max_size > 0 || config.traceroute_hops > 0 || config.tx_ring_ifname || config.xdp_ifname || config.use_uring))
+    {
+        fprintf(stderr, "Error: -G (fragmentation) needs the raw socket backend and cannot be combined with -D, -m, -H, -I, -X or -U/-P\n");
+        return -1;
+    }
+
+    /** A cookie replaces the stamp and the sequence, and there is no per-sequence table for transmit stamps to land in */
+    if (payload_spec.cookie && (payload_spec.stamp || config.kernel_timestamps || config.pmtu_max_size > 0 || config.traceroute_hops > 0))
+    {
+        fprintf(stderr, "Error: -z (stateless) carries its own send timestamp and cannot be combined with -E, -Z, -m or -H\n");
+        return -1;
+    }
+
+    /** One AF_XDP socket per queue, and the steering program matches a single identifier */
+    if (config.xdp_ifname && config.threads > 1)
+    {
+        fprintf(stderr, "Error: -X (AF_XDP) drives a single queue; use -j 1\n");
+        return -1;
+    }
+
+    /** A round is one bounded run; the per-run modes and the single result log and capture have no place between rounds */
+    if (monitor.listen && (config.pmtu_max_size > 0 || config.traceroute_hops > 0 || config.result_log_path || config.capture_path))
+    {
+        fprintf(stderr, "Error: -K (monitoring daemon) cannot be combined with -m, -H, -o or -O\n");
+        return -1;
+    }
+
+    /** Path MTU discovery and traceroute send from their own sockets, outside the workers that feed a capture */
+    if (config.capture_path && (config.pmtu_max_size > 0 || config.traceroute_hops > 0))
+    {
+        fprintf(stderr, "Error: -O (capture) cannot be combined with -m or -H\n");
+        return -1;
+    }
+
+    /** A replay re-sends finished datagrams over the raw socket; nothing is built, matched or logged */
+    if (config.replay_path && (monitor.listen || config.pmtu_max_size > 0 || config.traceroute_hops > 0 || config.result_log_path || config.tx_ring_ifname ||
+                               config.xdp_ifname || config.use_uring || config.fragment_mtu > 0 || config.report_interval > 0))
+    {
+        fprintf(stderr, "Error: -y (replay) sends through the raw socket and cannot be combined with -K, -m, -H, -o, -I, -X, -U/-P, -G or -L\n");
+        return -1;
+    }
+
+    if (!config.replay_path && config.replay_speed != 1.0)
+    {
+        fprintf(stderr, "Error: -A (replay speed) needs -y (replay)\n");
+        return -1;
+    }
+
+    if (!monitor.listen && monitor.window > 0)
+    {
+        fprintf(stderr, "Error: -N (window length) needs -K (monitoring daemon)\n");
+        return -1;
+    }
+
+    if (monitor.sources_overflow)
+    {
+        fprintf(stderr, "Error: -K (monitoring daemon) remembers at most %i -d/-f target specs for reloading\n", MONITOR_MAX_SOURCES);
+        return -1;
+    }
+
+    if (config.replay_path)
+    {
+        struct packet_capture capture;
+        if (config.capture_path)
+        {
+            if (packet_capture_open(&capture, config.capture_path, 1) != 0)
+            {
+                target_list_free(&targets);
+                return -1;
+            }
+            config.capture = &capture;
+        }
+        int rc = run_replay(&config);
+        if (config.capture && packet_capture_close(config.capture) != 0)
+        {
+            rc = -1;
+        }
+        target_list_free(&targets);
+        return rc;
+    }
+
+    if (targets.count == 0)
+    {
+        if (target_list_add_spec(&targets, config.ip_v4_dst_addr) != 0)
+        {
+            return -1;
+        }
+        monitor.sources[monitor.source_count++].spec = config.ip_v4_dst_addr;
+    }
+    if (monitor.window == 0)
+    {
+        monitor.window = MONITOR_DEFAULT_WINDOW;
+    }
+    monitor.interval = (config.report_interval > 0) ? config.report_interval : MONITOR_DEFAULT_INTERVAL;
+
+    if (src_family != 0 && src_family != targets.family)
+    {
+        fprintf(stderr, "Error: Source address family does not match the targets\n");
+        target_list_free(&targets);
+        return -1;
+    }
+
+    /** Interleave destinations so consecutive probes hit unrelated hosts and subnets */
+    if (targets.count > 1)
+    {
+        target_list_shuffle(&targets, timestamp_now_ns());
+    }
+    config.targets = &targets;
+
+    if (config.pmtu_max_size > 0 && config.traceroute_hops > 0)
+    {
+        fprintf(stderr, "Error: -m (path MTU discovery) and -H (traceroute) are mutually exclusive\n");
+        target_list_free(&targets);
+        return -1;
+    }
+
+    if (config.pmtu_max_size > 0)
+    {
+        int rc = run_pmtu_discovery(&config);
+        target_list_free(&targets);
+        return rc;
+    }
+
+    struct payload payload;
+    payload_spec.seed = timestamp_now_ns();
+    if (payload_build(&payload, &payload_spec) != 0)
+    {
+        target_list_free(&targets);
+        return -1;
+    }
+    config.payload = payload.data;
+    config.payload_len = payload.length;
+    config.payload_stamp = payload_spec.stamp;
+
+    /** One key per run: cookies from an earlier run, or forged by a third party, never verify */
+    struct probe_cookie_key cookie_key;
+    if (payload_spec.cookie)
+    {
+        if (probe_cookie_key_init(&cookie_key) != 0)
+        {
+            payload_free(&payload);
+            target_list_free(&targets);
+            return -1;
+        }
+        config.cookie_key = &cookie_key;
+    }
+
+    if (config.traceroute_hops > 0)
+    {
+        int rc = run_traceroute(&config);
+        payload_free(&payload);
+        target_list_free(&targets);
+        return rc;
+    }
+
     printf("\n** ICMP Protocol From Scratch **\n");
     printf("--------------------------------------------------\n");
-    printf("[Execution]     %u packet(s), %u second wait\n", config.quantity, config.sleep_time);
-    printf("[IPv4]          Src: %s -> Dst: %s | TTL: %u\n", config.ip_v4_src_addr, config.ip_v4_dst_addr, config.ip_v4_ttl);
-    printf("[ICMPv4]        Type: %u | Code: %u | ID: %u | Seq: %u\n", config.icmp_v4_type, config.icmp_v4_code, config.icmp_v4_identifier, config.icmp_v4_sequence);
+    printf("[Execution]     %u packet(s), %u second wait, %u per batch, %u thread(s)\n", config.quantity, config.sleep_time, config.batch_size, config.threads);
+    printf("[Replies]       %u ms timeout per request\n", config.reply_timeout_ms);
+    if (config.xdp_ifname)
+    {
+        printf("[Transmit]      AF_XDP on %s queue %u -> %02x:%02x:%02x:%02x:%02x:%02x\n", config.xdp_ifname, config.xdp_queue,
+               config.next_hop_mac[0], config.next_hop_mac[1], config.next_hop_mac[2],
+               config.next_hop_mac[3], config.next_hop_mac[4], config.next_hop_mac[5]);
+    }
+    else if (config.tx_ring_ifname)
+    {
+        printf("[Transmit]      PACKET_TX_RING on %s -> %02x:%02x:%02x:%02x:%02x:%02x\n", config.tx_ring_ifname,
+               config.next_hop_mac[0], config.next_hop_mac[1], config.next_hop_mac[2],
+               config.next_hop_mac[3], config.next_hop_mac[4], config.next_hop_mac[5]);
+    }
+    else if (config.use_uring)
+    {
+        printf("[Transmit]      io_uring on the raw socket%s\n", config.uring_sq_poll ? " (submission queue polling)" : "");
+    }
+    printf("[Pacing]        %llu pps | %llu bps | Burst: %u (0 rate = -w spacing)\n", (unsigned long long)config.rate_pps, (unsigned long long)config.rate_bps, config.burst);
+    if (targets.family == AF_INET6)
+    {
+        printf("[IPv6]          Src: %s -> Dst: %s (%u target(s)) | Hop Limit: %u\n", config.ip_v6_src_addr, config.ip_v4_dst_addr, targets.count, config.ip_v4_ttl);
+        printf("[ICMPv6]        Type: %u | Code: %u | ID: %u | Seq: %u\n", ICMP_V6_ECHO_REQUEST, config.icmp_v4_code, config.icmp_v4_identifier, config.icmp_v4_sequence);
+    }
+    else
+    {
+        printf("[IPv4]          Src: %s -> Dst: %s (%u target(s)) | TTL: %u\n", config.ip_v4_src_addr, config.ip_v4_dst_addr, targets.count, config.ip_v4_ttl);
+        printf("[ICMPv4]        Type: %u | Code: %u | ID: %u | Seq: %u\n", config.icmp_v4_type, config.icmp_v4_code, config.icmp_v4_identifier, config.icmp_v4_sequence);
+    }
+    if (config.result_log_path)
+    {
+        printf("[Results]       Binary log -> %s\n", config.result_log_path);
+    }
+    if (config.capture_path)
+    {
+        printf("[Capture]       pcapng of every sent and received packet -> %s\n", config.capture_path);
+    }
+    if (config.dont_fragment && targets.family == AF_INET)
+    {
+        printf("[Fragmentation] Don't Fragment set\n");
+    }
+    else if (config.fragment_mtu > 0)
+    {
+        printf("[Fragmentation] Datagrams over %u bytes split into fragments%s\n", config.fragment_mtu, (targets.family == AF_INET6) ? " (Fragment header)" : "");
+    }
+    if (config.kernel_timestamps)
+    {
+        printf("[Timestamps]    SO_TIMESTAMPING: kernel software%s%s\n", config.timestamp_ifname ? ", NIC hardware on " : "", config.timestamp_ifname ? config.timestamp_ifname : "");
+    }
+    if (config.cookie_key)
+    {
+        printf("[Stateless]     SipHash-2-4 cookies in sequence and payload, no in-flight table\n");
+    }
+    if (monitor.listen)
+    {
+        printf("[Monitoring]    Metrics on %s | a round every %u s | %u-round window | SIGHUP reloads targets\n", monitor.listen, monitor.interval, monitor.window);
+    }
     printf("[Payload Size]  %zu bytes\n", config.payload_len);
-    printf("[Payload]       %s\n", config.payload);
+    printf("[Payload]       %s%s\n", payload_desc, config.payload_stamp ? " (send timestamp embedded)" : (config.cookie_key ? " (cookie embedded)" : ""));
     printf("--------------------------------------------------\n\n");
 
-    /** Execute */
-    for (uint32_t i = 0; i < config.quantity; i++)
+    if (monitor.listen)
     {
-        /** Sequence is allowed to overflow back to `0` */
-        uint16_t current_seq = (uint16_t)(config.icmp_v4_sequence + i);
-        if (send_icmp_echo(&config, current_seq) != 0)
+        fflush(stdout);
+        int rc = monitor_run(&config, &targets, &monitor);
+        payload_free(&payload);
+        target_list_free(&targets);
+        return rc;
+    }
+
+    /**
+     * Every worker opens its own socket, templates, pacer and matcher on its own core.
+     * Each transmits under its own identifier, so replies are attributed without locks.
+     */
+    struct result_log log;
+    if (config.result_log_path)
+    {
+        if (result_log_open(&log, config.result_log_path, &targets, config.threads) != 0)
         {
-            fprintf(stderr, "Error: The packet transmission failed at packet %i\n", i);
+            payload_free(&payload);
+            target_list_free(&targets);
+            return -1;
+        }
+        config.result_log = &log;
+    }
+
+    struct packet_capture capture;
+    if (config.capture_path)
+    {
+        if (packet_capture_open(&capture, config.capture_path, config.threads) != 0)
+        {
+            if (config.result_log)
+            {
+                result_log_close(config.result_log);
+            }
+            payload_free(&payload);
+            target_list_free(&targets);
             return -1;
         }
+        config.capture = &capture;
+    }
 
-        if (i < config.quantity - 1)
+    struct worker_pool pool;
+    uint64_t start_ns = timestamp_now_ns();
+    int rc = worker_pool_start(&pool, &config);
+
+    // Sample the running workers once per interval; they are never paused or locked for it
+    if (config.report_interval > 0 && pool.count > 0)
+    {
+        uint64_t interval_ns = (uint64_t)config.report_interval * TIMESTAMP_NS_PER_SEC;
+        struct icmp_engine_result previous;
+        memset(&previous, 0, sizeof(previous));
+        uint64_t previous_ns = start_ns;
+
+        struct hdr_histogram live;
+        while (!worker_pool_wait(&pool, interval_ns))
         {
-            sleep(config.sleep_time);
+            struct icmp_engine_result now;
+            worker_pool_snapshot(&pool, &now, &live);
+            uint64_t now_ns = timestamp_now_ns();
+            print_live_stats(now_ns - start_ns, now_ns - previous_ns, &now, &previous, &live);
+            previous = now;
+            previous_ns = now_ns;
         }
     }
 
-    return 0;
+    if (worker_pool_join(&pool) != 0)
+    {
+        rc = -1;
+    }
+    uint64_t elapsed_ns = timestamp_now_ns() - start_ns;
+    if (config.result_log && result_log_close(config.result_log) != 0)
+    {
+        rc = -1;
+    }
+    if (config.capture && packet_capture_close(config.capture) != 0)
+    {
+        rc = -1;
+    }
+    const struct icmp_engine_result result = pool.total;
+
+    if (targets.count > 1)
+    {
+        printf("\n--- %u targets statistics ---\n", targets.count);
+    }
+    else
+    {
+        printf("\n--- %s statistics ---\n", config.ip_v4_dst_addr);
+    }
+    printf("%llu packets transmitted, %llu received, %llu duplicates, %.1f%% packet loss\n",
+           (unsigned long long)result.sent, (unsigned long long)result.received, (unsigned long long)result.duplicates,
+           (result.sent > 0) ? (100.0 * (double)result.lost / (double)result.sent) : 0.0);
+    print_run_summary(elapsed_ns, &result, &pool.rtt);
+    if (config.kernel_timestamps)
+    {
+        print_timestamp_sources(&result);
+    }
+    if (config.xdp_ifname)
+    {
+        printf("reassembly = %llu datagrams, %llu fragments dropped\n", (unsigned long long)result.reassembled, (unsigned long long)result.fragments_dropped);
+    }
+    if (config.capture)
+    {
+        printf("capture = %llu packets -> %s\n", (unsigned long long)capture.packets, config.capture_path);
+    }
+
+    if (targets.count > 1 && pool.stats)
+    {
+        print_target_summary(&targets, pool.stats);
+    }
+
+    worker_pool_free(&pool);
+    payload_free(&payload);
+    target_list_free(&targets);
+    return (rc == 0) ? 0 : -1;
 }
\ No newline at end of file
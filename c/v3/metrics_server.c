@@ -0,0 +1,324 @@
+/**
+ * @file metrics_server.c
+ * @brief Minimal HTTP/1.1 endpoint serving a Prometheus text exposition page from its own thread.
+ *
+ * @author Jim Diroff II
+ */
+
+#define _GNU_SOURCE /**< Exposes accept4() */
+
+#include "metrics_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/**
+ * @brief Content type of the Prometheus text exposition format.
+ */
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+int metrics_page_printf(struct metrics_page *page, const char *format, ...)
+{
+    for (;;)
+    {
+        size_t room = page->capacity - page->length;
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(page->data ? page->data + page->length : NULL, room, format, args);
+        va_end(args);
+        if (written < 0)
+        {
+            return -1;
+        }
+        if ((size_t)written < room)
+        {
+            page->length += (size_t)written;
+            return 0;
+        }
+
+        // Too small (the terminator needs a byte too): double until it fits, then format again
+        size_t capacity = page->capacity ? page->capacity : 4096;
+        while (capacity - page->length <= (size_t)written)
+        {
+            capacity *= 2;
+        }
+        char *data = realloc(page->data, capacity);
+        if (!data)
+        {
+            fprintf(stderr, "Error: Failed to grow the metrics page to %zu bytes\n", capacity);
+            return -1;
+        }
+        page->data = data;
+        page->capacity = capacity;
+    }
+}
+
+void metrics_page_free(struct metrics_page *page)
+{
+    free(page->data);
+    memset(page, 0, sizeof(struct metrics_page));
+}
+
+/**
+ * @brief Parses "port", "ipv4:port" or "[ipv6]:port" into a socket address.
+ * @return 0 on success, -1 on malformed input.
+ */
+static int parse_endpoint(const char *endpoint, struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    char host[INET6_ADDRSTRLEN];
+    const char *port_text = endpoint;
+    memset(addr, 0, sizeof(struct sockaddr_storage));
+    host[0] = '\0';
+
+    // 1. Split off the host, if any
+    if (endpoint[0] == '[')
+    {
+        const char *close = strchr(endpoint, ']');
+        if (!close || close[1] != ':' || (size_t)(close - endpoint - 1) >= sizeof(host))
+        {
+            return -1;
+        }
+        memcpy(host, endpoint + 1, (size_t)(close - endpoint - 1));
+        host[close - endpoint - 1] = '\0';
+        port_text = close + 2;
+    }
+    else if (strchr(endpoint, ':'))
+    {
+        const char *colon = strrchr(endpoint, ':');
+        if ((size_t)(colon - endpoint) >= sizeof(host))
+        {
+            return -1;
+        }
+        memcpy(host, endpoint, (size_t)(colon - endpoint));
+        host[colon - endpoint] = '\0';
+        port_text = colon + 1;
+    }
+
+    // 2. The port
+    char *endptr;
+    long port = strtol(port_text, &endptr, 10);
+    if (port_text[0] == '\0' || *endptr != '\0' || port <= 0 || port > UINT16_MAX)
+    {
+        return -1;
+    }
+
+    // 3. The address: IPv6 inside brackets, IPv4 otherwise, every IPv4 interface without a host
+    if (endpoint[0] == '[')
+    {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)addr;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons((uint16_t)port);
+        *addr_len = sizeof(struct sockaddr_in6);
+        return (inet_pton(AF_INET6, host, &sin6->sin6_addr) == 1) ? 0 : -1;
+    }
+
+    struct sockaddr_in *sin = (struct sockaddr_in *)addr;
+    sin->sin_family = AF_INET;
+    sin->sin_port = htons((uint16_t)port);
+    sin->sin_addr.s_addr = htonl(INADDR_ANY);
+    *addr_len = sizeof(struct sockaddr_in);
+    return (host[0] == '\0' || inet_pton(AF_INET, host, &sin->sin_addr) == 1) ? 0 : -1;
+}
+
+/**
+ * @brief Writes all of @p length bytes, or gives up at the first error or timeout.
+ */
+static int send_fully(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Answers one request on @p fd: the page for `GET /metrics`, a short error otherwise.
+ */
+static void serve_client(struct metrics_server *server, int fd)
+{
+    // 1. Read the request head; a client that stalls is cut off by the receive timeout
+    char request[METRICS_SERVER_REQUEST_MAX + 1];
+    size_t used = 0;
+    request[0] = '\0';
+    while (!strstr(request, "\r\n\r\n"))
+    {
+        if (used == METRICS_SERVER_REQUEST_MAX)
+        {
+            static const char too_large[] = "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            send_fully(fd, too_large, sizeof(too_large) - 1);
+            return;
+        }
+        ssize_t n = recv(fd, request + used, METRICS_SERVER_REQUEST_MAX - used, 0);
+        if (n <= 0)
+        {
+            return;
+        }
+        used += (size_t)n;
+        request[used] = '\0';
+    }
+
+    // 2. Route: only the metrics page exists (query strings are ignored)
+    const char *status = "200 OK";
+    const char *path = request + 4;
+    size_t path_len = strcspn(path, " ?\r\n");
+    if (strncmp(request, "GET ", 4) != 0)
+    {
+        status = "405 Method Not Allowed";
+    }
+    else if (path_len != strlen("/metrics") || strncmp(path, "/metrics", path_len) != 0)
+    {
+        status = "404 Not Found";
+    }
+
+    // 3. Copy the published page under the lock, then write it out without holding it
+    server->sending.length = 0;
+    if (status[0] == '2')
+    {
+        pthread_mutex_lock(&server->lock);
+        if (server->published.length > 0)
+        {
+            if (server->sending.capacity < server->published.length)
+            {
+                char *data = realloc(server->sending.data, server->published.length);
+                if (data)
+                {
+                    server->sending.data = data;
+                    server->sending.capacity = server->published.length;
+                }
+            }
+            if (server->sending.capacity >= server->published.length)
+            {
+                memcpy(server->sending.data, server->published.data, server->published.length);
+                server->sending.length = server->published.length;
+            }
+        }
+        pthread_mutex_unlock(&server->lock);
+    }
+
+    char head[256];
+    int head_len = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", status,
+                            METRICS_CONTENT_TYPE, server->sending.length);
+    if (send_fully(fd, head, (size_t)head_len) == 0 && server->sending.length > 0 && send_fully(fd, server->sending.data, server->sending.length) == 0)
+    {
+        __atomic_add_fetch(&server->scrapes, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Serving thread: accepts one connection at a time until @ref metrics_server::stopping is set.
+ */
+static void *server_main(void *arg)
+{
+    struct metrics_server *server = (struct metrics_server *)arg;
+    struct pollfd pfd = { .fd = server->listen_fd, .events = POLLIN };
+    struct timeval io_timeout = { .tv_sec = METRICS_SERVER_IO_TIMEOUT_MS / 1000, .tv_usec = (METRICS_SERVER_IO_TIMEOUT_MS % 1000) * 1000 };
+
+    while (!__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE))
+    {
+        if (poll(&pfd, 1, METRICS_SERVER_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &io_timeout, sizeof(io_timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &io_timeout, sizeof(io_timeout));
+        serve_client(server, fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+int metrics_server_open(struct metrics_server *server, const char *endpoint)
+{
+    memset(server, 0, sizeof(struct metrics_server));
+    server->listen_fd = -1;
+    pthread_mutex_init(&server->lock, NULL);
+
+    // 1. Resolve and bind the endpoint
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    if (parse_endpoint(endpoint, &addr, &addr_len) != 0)
+    {
+        fprintf(stderr, "Error: Invalid metrics endpoint '%s'. Expected port, ipv4:port or [ipv6]:port\n", endpoint);
+        metrics_server_close(server);
+        return -1;
+    }
+
+    server->listen_fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    if (server->listen_fd < 0 || setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(server->listen_fd, (struct sockaddr *)&addr, addr_len) != 0 || listen(server->listen_fd, SOMAXCONN) != 0)
+    {
+        fprintf(stderr, "Error: Failed to listen on '%s': %s\n", endpoint, strerror(errno));
+        metrics_server_close(server);
+        return -1;
+    }
+
+    // 2. The serving thread owns the socket from here on
+    if (pthread_create(&server->thread, NULL, server_main, server) != 0)
+    {
+        fprintf(stderr, "Error: Failed to start the metrics server\n");
+        metrics_server_close(server);
+        return -1;
+    }
+    server->thread_started = 1;
+
+    return 0;
+}
+
+void metrics_server_publish(struct metrics_server *server, struct metrics_page *page)
+{
+    pthread_mutex_lock(&server->lock);
+    struct metrics_page previous = server->published;
+    server->published = *page;
+    pthread_mutex_unlock(&server->lock);
+
+    *page = previous;
+    page->length = 0;
+}
+
+void metrics_server_close(struct metrics_server *server)
+{
+    if (server->thread_started)
+    {
+        __atomic_store_n(&server->stopping, 1, __ATOMIC_RELEASE);
+        pthread_join(server->thread, NULL);
+        server->thread_started = 0;
+    }
+    if (server->listen_fd >= 0)
+    {
+        close(server->listen_fd);
+        server->listen_fd = -1;
+    }
+
+    metrics_page_free(&server->published);
+    metrics_page_free(&server->sending);
+    pthread_mutex_destroy(&server->lock);
+}
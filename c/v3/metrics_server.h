@@ -0,0 +1,100 @@
+/**
+ * @file metrics_server.h
+ * @brief Minimal HTTP/1.1 endpoint serving a Prometheus text exposition page from its own thread.
+ *
+ * @note The page is rendered by whoever owns the data (between probing rounds) and handed over with
+ *       @ref metrics_server_publish, which only swaps two buffers under a mutex. The server thread
+ *       copies the current page under the same mutex and writes it out with no lock held, so a slow
+ *       or stalled scraper can never hold up the publisher, let alone the probing workers, which
+ *       never touch the server at all. One connection is served at a time with short I/O timeouts.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief How often the idle server thread checks whether it should stop, in milliseconds.
+ */
+#define METRICS_SERVER_POLL_MS 200
+
+/**
+ * @brief Longest request head accepted; anything larger is answered with 431.
+ */
+#define METRICS_SERVER_REQUEST_MAX 4096
+
+/**
+ * @brief Receive and send timeout per connection, in milliseconds.
+ */
+#define METRICS_SERVER_IO_TIMEOUT_MS 1000
+
+/**
+ * @struct metrics_page
+ * @brief A growable text buffer one exposition page is rendered into.
+ */
+struct metrics_page
+{
+    char *data;      /**< Page bytes (not terminated), or NULL while empty */
+    size_t length;   /**< Bytes in use */
+    size_t capacity; /**< Bytes allocated */
+};
+
+/**
+ * @brief Appends formatted text to @p page, growing it as needed.
+ * @param page   Pointer to the page.
+ * @param format printf-style format.
+ * @return 0 on success, -1 on allocation failure (the page keeps what it had).
+ */
+int metrics_page_printf(struct metrics_page *page, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Releases a page's buffer.
+ * @param page Pointer to the page.
+ */
+void metrics_page_free(struct metrics_page *page);
+
+/**
+ * @struct metrics_server
+ * @brief The listening socket, the serving thread and the published page.
+ */
+struct metrics_server
+{
+    int listen_fd;                 /**< Listening TCP socket, or -1 when closed */
+    pthread_t thread;              /**< Serving thread */
+    uint8_t thread_started;        /**< 1 once @ref thread has to be joined */
+    uint8_t stopping;              /**< Set (release) by @ref metrics_server_close; the thread exits within @ref METRICS_SERVER_POLL_MS */
+    pthread_mutex_t lock;          /**< Guards @ref published; held only for a swap or a copy */
+    struct metrics_page published; /**< The page scrapes are answered with */
+    struct metrics_page sending;   /**< The serving thread's private copy of @ref published */
+    uint64_t scrapes;              /**< Pages served (relaxed atomic) */
+};
+
+/**
+ * @brief Binds @p endpoint, starts listening and starts the serving thread.
+ *
+ * Forms accepted: "9100" (every IPv4 interface), "127.0.0.1:9100" and "[::1]:9100".
+ *
+ * @param server   Pointer to the caller-allocated server.
+ * @param endpoint Address and port to serve on.
+ * @return 0 on success, -1 on a malformed @p endpoint or socket failure (the reason is printed).
+ */
+int metrics_server_open(struct metrics_server *server, const char *endpoint);
+
+/**
+ * @brief Makes @p page the one served from now on, handing the previous page's buffer back in its place.
+ * @param server Pointer to an open server.
+ * @param page   The freshly rendered page; on return it holds the old buffer, emptied for the next render.
+ */
+void metrics_server_publish(struct metrics_server *server, struct metrics_page *page);
+
+/**
+ * @brief Stops the serving thread, closes the socket and frees the pages.
+ * @param server Pointer to the server.
+ */
+void metrics_server_close(struct metrics_server *server);
+
+#endif /* METRICS_SERVER_H */
@@ -0,0 +1,385 @@
+/**
+ * @file monitor.c
+ * @brief Continuous monitoring daemon: probing rounds forever, rolling windows, a metrics endpoint.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "monitor.h"
+#include "metrics_server.h"
+#include "rtt_window.h"
+#include "timestamp.h"
+#include "worker_pool.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+/**
+ * @brief Prefix of every exported metric name.
+ */
+#define MONITOR_METRIC_PREFIX "ip_stack_"
+
+/**
+ * @struct monitor_state
+ * @brief Daemon-wide counters exported next to the per-target windows.
+ */
+struct monitor_state
+{
+    uint64_t rounds;         /**< Rounds completed and recorded */
+    uint64_t round_failures; /**< Rounds a worker failed in (not recorded) */
+    uint64_t reloads;        /**< Target list reloads applied */
+    uint64_t reload_errors;  /**< Reloads rejected; the previous list stayed in use */
+    uint64_t duplicates;     /**< Replies that matched no outstanding request, over every round */
+    uint64_t round_ns;       /**< Duration of the latest round */
+};
+
+/**
+ * @brief Builds a fresh list from the remembered specs and swaps it in, carrying the windows over.
+ * @return 0 on success, -1 if the specs no longer parse or name no usable targets (nothing is changed).
+ */
+static int reload_targets(struct target_list *targets, const struct monitor_config *monitor, struct rtt_window *window, struct rtt_window_summary **summaries)
+{
+    // 1. Parse every spec again, exactly as the command line did
+    struct target_list next;
+    target_list_init(&next);
+    for (uint32_t i = 0; i < monitor->source_count; i++)
+    {
+        const struct monitor_source *source = &monitor->sources[i];
+        int rc = source->is_file ? target_list_load_file(&next, source->spec) : target_list_add_spec(&next, source->spec);
+        if (rc != 0)
+        {
+            target_list_free(&next);
+            return -1;
+        }
+    }
+
+    // 2. The sockets are bound to one family for the daemon's lifetime
+    if (next.count == 0 || next.family != targets->family)
+    {
+        fprintf(stderr, "Warning: The reloaded targets are empty or of another address family\n");
+        target_list_free(&next);
+        return -1;
+    }
+    if (next.count > 1)
+    {
+        target_list_shuffle(&next, timestamp_now_ns());
+    }
+
+    // 3. Move the history over, then replace the list in place
+    struct rtt_window_summary *resized = malloc((size_t)next.count * sizeof(struct rtt_window_summary));
+    if (!resized || rtt_window_remap(window, targets, &next) != 0)
+    {
+        free(resized);
+        target_list_free(&next);
+        return -1;
+    }
+
+    free(*summaries);
+    *summaries = resized;
+    target_list_free(targets);
+    *targets = next;
+    return 0;
+}
+
+/**
+ * @brief Appends one per-target metric family: its HELP and TYPE lines, then a sample per target.
+ * @param field Which summary value to export (see the switch).
+ * @return 0 on success, -1 on allocation failure.
+ */
+static int render_family(struct metrics_page *page, const char *name, const char *type, const char *help, const struct target_list *targets,
+                         const struct rtt_window_summary *summaries, int field)
+{
+    int rc = metrics_page_printf(page, "# HELP " MONITOR_METRIC_PREFIX "%s %s\n# TYPE " MONITOR_METRIC_PREFIX "%s %s\n", name, help, name, type);
+
+    for (uint32_t t = 0; rc == 0 && t < targets->count; t++)
+    {
+        const struct rtt_window_summary *summary = &summaries[t];
+        char addr[TARGET_LIST_ADDRSTRLEN];
+        target_list_format(targets, t, addr, sizeof(addr));
+
+        // Round trips only exist for targets that answered within the window
+        if (field >= 3 && summary->received == 0)
+        {
+            continue;
+        }
+
+        switch (field)
+        {
+        case 0:
+            rc = metrics_page_printf(page, MONITOR_METRIC_PREFIX "%s{target=\"%s\"} %llu\n", name, addr, (unsigned long long)summary->sent_total);
+            break;
+        case 1:
+            rc = metrics_page_printf(page, MONITOR_METRIC_PREFIX "%s{target=\"%s\"} %llu\n", name, addr, (unsigned long long)summary->received_total);
+            break;
+        case 2:
+            // Repeated stateless replies can push received past sent; the ratio never goes below zero
+            rc = metrics_page_printf(page, MONITOR_METRIC_PREFIX "%s{target=\"%s\"} %.6f\n", name, addr,
+                                     (summary->sent > summary->received) ? 1.0 - (double)summary->received / (double)summary->sent : 0.0);
+            break;
+        case 3:
+            rc = metrics_page_printf(page, MONITOR_METRIC_PREFIX "%s{target=\"%s\"} %.6f\n", name, addr, (double)summary->rtt_min_us / 1e6);
+            break;
+        case 4:
+            rc = metrics_page_printf(page, MONITOR_METRIC_PREFIX "%s{target=\"%s\"} %.6f\n", name, addr, (double)summary->rtt_sum_us / (double)summary->received / 1e6);
+            break;
+        case 5:
+            rc = metrics_page_printf(page, MONITOR_METRIC_PREFIX "%s{target=\"%s\"} %.6f\n", name, addr, (double)summary->rtt_max_us / 1e6);
+            break;
+        default:
+            rc = metrics_page_printf(page, MONITOR_METRIC_PREFIX "%s{target=\"%s\"} %.6f\n", name, addr, (double)summary->rtt_last_us / 1e6);
+            break;
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * @brief Renders the whole exposition page from the current windows and daemon counters.
+ * @return 0 on success, -1 on allocation failure.
+ */
+static int render_page(struct metrics_page *page, const struct target_list *targets, const struct rtt_window *window,
+                       const struct rtt_window_summary *summaries, const struct monitor_state *state)
+{
+    page->length = 0;
+
+    // 1. Daemon-wide series
+    int rc = metrics_page_printf(page,
+                                 "# HELP " MONITOR_METRIC_PREFIX "rounds_total Probing rounds completed.\n"
+                                 "# TYPE " MONITOR_METRIC_PREFIX "rounds_total counter\n" MONITOR_METRIC_PREFIX "rounds_total %llu\n"
+                                 "# HELP " MONITOR_METRIC_PREFIX "round_failures_total Probing rounds abandoned because a worker failed.\n"
+                                 "# TYPE " MONITOR_METRIC_PREFIX "round_failures_total counter\n" MONITOR_METRIC_PREFIX "round_failures_total %llu\n"
+                                 "# HELP " MONITOR_METRIC_PREFIX "target_reloads_total Target list reloads, by outcome.\n"
+                                 "# TYPE " MONITOR_METRIC_PREFIX "target_reloads_total counter\n"
+                                 MONITOR_METRIC_PREFIX "target_reloads_total{result=\"applied\"} %llu\n"
+                                 MONITOR_METRIC_PREFIX "target_reloads_total{result=\"rejected\"} %llu\n"
+                                 "# HELP " MONITOR_METRIC_PREFIX "duplicate_replies_total Replies that matched no outstanding request.\n"
+                                 "# TYPE " MONITOR_METRIC_PREFIX "duplicate_replies_total counter\n" MONITOR_METRIC_PREFIX "duplicate_replies_total %llu\n"
+                                 "# HELP " MONITOR_METRIC_PREFIX "round_duration_seconds Duration of the latest probing round.\n"
+                                 "# TYPE " MONITOR_METRIC_PREFIX "round_duration_seconds gauge\n" MONITOR_METRIC_PREFIX "round_duration_seconds %.6f\n"
+                                 "# HELP " MONITOR_METRIC_PREFIX "targets Destinations currently probed.\n"
+                                 "# TYPE " MONITOR_METRIC_PREFIX "targets gauge\n" MONITOR_METRIC_PREFIX "targets %u\n"
+                                 "# HELP " MONITOR_METRIC_PREFIX "window_rounds Rounds currently covered by the per-target windows.\n"
+                                 "# TYPE " MONITOR_METRIC_PREFIX "window_rounds gauge\n" MONITOR_METRIC_PREFIX "window_rounds %u\n",
+                                 (unsigned long long)state->rounds, (unsigned long long)state->round_failures, (unsigned long long)state->reloads,
+                                 (unsigned long long)state->reload_errors, (unsigned long long)state->duplicates, (double)state->round_ns / 1e9, targets->count,
+                                 window->filled);
+
+    // 2. Per-target series
+    if (rc == 0)
+    {
+        rc = render_family(page, "probes_sent_total", "counter", "Echo Requests sent to the target.", targets, summaries, 0);
+    }
+    if (rc == 0)
+    {
+        rc = render_family(page, "probes_received_total", "counter", "Echo Replies received from the target.", targets, summaries, 1);
+    }
+    if (rc == 0)
+    {
+        rc = render_family(page, "window_loss_ratio", "gauge", "Fraction of the window's requests left unanswered.", targets, summaries, 2);
+    }
+    if (rc == 0)
+    {
+        rc = render_family(page, "window_rtt_min_seconds", "gauge", "Lowest round mean round trip in the window.", targets, summaries, 3);
+    }
+    if (rc == 0)
+    {
+        rc = render_family(page, "window_rtt_avg_seconds", "gauge", "Mean round trip over every reply in the window.", targets, summaries, 4);
+    }
+    if (rc == 0)
+    {
+        rc = render_family(page, "window_rtt_max_seconds", "gauge", "Highest round mean round trip in the window.", targets, summaries, 5);
+    }
+    if (rc == 0)
+    {
+        rc = render_family(page, "last_rtt_seconds", "gauge", "Mean round trip of the latest round with replies.", targets, summaries, 6);
+    }
+
+    return rc;
+}
+
+/**
+ * @brief Waits until @p deadline_ns, handling the signals that arrive meanwhile.
+ * @param signal_fd signalfd for SIGINT, SIGTERM and SIGHUP.
+ * @param reload    Set to 1 when SIGHUP was received.
+ * @return 1 once the daemon should stop, 0 at the deadline (or as soon as a reload is due).
+ */
+static int wait_round(int signal_fd, uint64_t deadline_ns, uint8_t *reload)
+{
+    for (;;)
+    {
+        uint64_t now_ns = timestamp_now_ns();
+        int timeout_ms = (deadline_ns > now_ns) ? (int)((deadline_ns - now_ns + TIMESTAMP_NS_PER_MSEC - 1) / TIMESTAMP_NS_PER_MSEC) : 0;
+
+        struct pollfd pfd = { .fd = signal_fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0 && errno != EINTR)
+        {
+            perror("Warning: Failed to wait for signals");
+            return 0;
+        }
+
+        struct signalfd_siginfo info;
+        while (read(signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info))
+        {
+            if (info.ssi_signo == SIGHUP)
+            {
+                *reload = 1;
+            }
+            else
+            {
+                return 1;
+            }
+        }
+        if (*reload || ready == 0)
+        {
+            return 0;
+        }
+    }
+}
+
+int monitor_run(struct app_config *config, struct target_list *targets, const struct monitor_config *monitor)
+{
+    // 1. Signals become events before any thread exists, so every thread inherits the mask
+    sigset_t signals;
+    sigset_t previous_mask;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous_mask);
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0)
+    {
+        perror("Error: Failed to create the signal descriptor");
+        pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+        return -1;
+    }
+
+    // 2. Windows, their summaries, and the endpoint serving an (empty) first page
+    struct rtt_window window;
+    struct rtt_window_summary *summaries = malloc((size_t)targets->count * sizeof(struct rtt_window_summary));
+    struct metrics_server server;
+    struct metrics_page page;
+    struct monitor_state state;
+    memset(&page, 0, sizeof(page));
+    memset(&state, 0, sizeof(state));
+    if (!summaries || rtt_window_init(&window, targets->count, monitor->window) != 0)
+    {
+        fprintf(stderr, "Error: Failed to allocate the monitoring windows\n");
+        free(summaries);
+        close(signal_fd);
+        pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+        return -1;
+    }
+    if (metrics_server_open(&server, monitor->listen) != 0)
+    {
+        rtt_window_free(&window);
+        free(summaries);
+        close(signal_fd);
+        pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+        return -1;
+    }
+    rtt_window_summarize(&window, summaries);
+    if (render_page(&page, targets, &window, summaries, &state) == 0)
+    {
+        metrics_server_publish(&server, &page);
+    }
+
+    // 3. Rounds until told to stop
+    int status = 0;
+    uint8_t reload = 0;
+    uint8_t verbose = !config->quiet; /**< -q silences the round lines too; per-reply lines are never printed */
+    config->quiet = 1;
+    uint64_t interval_ns = (uint64_t)monitor->interval * TIMESTAMP_NS_PER_SEC;
+    for (;;)
+    {
+        uint64_t start_ns = timestamp_now_ns();
+        struct worker_pool pool;
+        int rc = worker_pool_run(&pool, config);
+        state.round_ns = timestamp_now_ns() - start_ns;
+
+        // A first round that fails is a setup problem (permissions, interface); later ones are transient
+        if (rc != 0)
+        {
+            state.round_failures++;
+            if (state.rounds == 0)
+            {
+                worker_pool_free(&pool);
+                status = -1;
+                break;
+            }
+            fprintf(stderr, "Warning: Round %llu failed; its results were discarded\n", (unsigned long long)(state.rounds + state.round_failures));
+        }
+        else
+        {
+            rtt_window_record(&window, pool.stats);
+            state.rounds++;
+            state.duplicates += pool.total.duplicates;
+            if (verbose)
+            {
+                uint64_t rtt_sum_ns = 0;
+                for (uint32_t t = 0; t < targets->count; t++)
+                {
+                    rtt_sum_ns += pool.stats[t].rtt_sum_ns;
+                }
+                printf("[Round %llu] %u target(s): %llu/%llu replies, %.1f%% loss, rtt avg %.3f ms, %.3f s\n", (unsigned long long)state.rounds, targets->count,
+                       (unsigned long long)pool.total.received, (unsigned long long)pool.total.sent,
+                       (pool.total.sent > 0) ? 100.0 * (double)pool.total.lost / (double)pool.total.sent : 0.0,
+                       (pool.total.received > 0) ? (double)rtt_sum_ns / (double)pool.total.received / 1e6 : 0.0, (double)state.round_ns / 1e9);
+                fflush(stdout);
+            }
+        }
+        worker_pool_free(&pool);
+
+        /** Sequences keep counting across rounds; a reply straggling in from an earlier round matches nothing */
+        config->icmp_v4_sequence = (uint16_t)(config->icmp_v4_sequence + (uint64_t)config->quantity * targets->count);
+
+        // 4. Publish, then sleep out the interval (a reload is applied as soon as it is asked for)
+        int stop = 0;
+        do
+        {
+            if (reload)
+            {
+                reload = 0;
+                if (reload_targets(targets, monitor, &window, &summaries) == 0)
+                {
+                    state.reloads++;
+                    printf("[Reload] %u target(s)\n", targets->count);
+                    fflush(stdout);
+                }
+                else
+                {
+                    state.reload_errors++;
+                    fprintf(stderr, "Warning: Target reload failed; still probing the previous %u target(s)\n", targets->count);
+                }
+            }
+
+            rtt_window_summarize(&window, summaries);
+            if (render_page(&page, targets, &window, summaries, &state) == 0)
+            {
+                metrics_server_publish(&server, &page);
+            }
+            stop = wait_round(signal_fd, start_ns + interval_ns, &reload);
+        } while (!stop && reload);
+
+        if (stop)
+        {
+            break;
+        }
+    }
+
+    metrics_server_close(&server);
+    metrics_page_free(&page);
+    rtt_window_free(&window);
+    free(summaries);
+    close(signal_fd);
+    pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+    return status;
+}
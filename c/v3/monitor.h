@@ -0,0 +1,74 @@
+/**
+ * @file monitor.h
+ * @brief Continuous monitoring daemon: probing rounds forever, rolling windows, a metrics endpoint.
+ *
+ * @note A one-shot run is bounded by `-c`. The daemon repeats such runs as rounds: every interval
+ *       it probes each target `-c` times through the regular worker pool, folds the per-target
+ *       outcomes into an @ref rtt_window, and renders a Prometheus page that a @ref metrics_server
+ *       thread serves until the next round replaces it. Each round continues the sequence space of
+ *       the last, so a straggling reply can never match a request of a later round.
+ *
+ *       SIGHUP re-reads the `-d`/`-f` target specs before the next round, keeping the history of
+ *       every target that is still listed. SIGINT or SIGTERM stop the daemon once the round in
+ *       flight has finished. Signals are taken through a signalfd, so no worker is ever interrupted.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include "app_config.h"
+#include "target_list.h"
+
+#include <stdint.h>
+
+/**
+ * @brief Target specs (`-d` and `-f`) remembered for reloading.
+ */
+#define MONITOR_MAX_SOURCES 64
+
+/**
+ * @brief Rounds kept per target when `-N` is not given.
+ */
+#define MONITOR_DEFAULT_WINDOW 60
+
+/**
+ * @brief Seconds between the starts of two rounds when `-L` is not given.
+ */
+#define MONITOR_DEFAULT_INTERVAL 10
+
+/**
+ * @struct monitor_source
+ * @brief One target spec as given on the command line.
+ */
+struct monitor_source
+{
+    const char *spec; /**< Address, CIDR range or file path */
+    uint8_t is_file;  /**< 1 if @ref spec names a target file (`-f`) */
+};
+
+/**
+ * @struct monitor_config
+ * @brief Daemon settings parsed from the command line.
+ */
+struct monitor_config
+{
+    const char *listen;                                 /**< Metrics endpoint (see @ref metrics_server_open), or NULL for a one-shot run */
+    uint32_t window;                                    /**< Rounds kept per target */
+    uint32_t interval;                                  /**< Seconds between the starts of two rounds */
+    struct monitor_source sources[MONITOR_MAX_SOURCES]; /**< Target specs in command line order */
+    uint32_t source_count;                              /**< Entries in @ref sources */
+    uint8_t sources_overflow;                           /**< 1 if more specs were given than @ref sources holds */
+};
+
+/**
+ * @brief Runs probing rounds until SIGINT or SIGTERM, serving their windows as metrics.
+ * @param config  Pointer to the validated application state; `config->targets` must be @p targets.
+ *                Its starting sequence advances with every round.
+ * @param targets The current target list, replaced in place when SIGHUP reloads it.
+ * @param monitor Pointer to the daemon settings.
+ * @return 0 after a clean stop, -1 if the endpoint could not be opened or the first round failed.
+ */
+int monitor_run(struct app_config *config, struct target_list *targets, const struct monitor_config *monitor);
+
+#endif /* MONITOR_H */
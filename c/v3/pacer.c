@@ -0,0 +1,80 @@
+/**
+ * @file pacer.c
+ * @brief Token bucket pacing engine driven by absolute CLOCK_MONOTONIC deadlines.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "pacer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Converts a token count into nanoseconds of schedule.
+ * @param pacer     Pointer to the pacer whose rate and carried remainder are used.
+ * @param count     Number of tokens.
+ * @param remainder Output for the new fractional remainder, committed only if the debit happens.
+ * @return The whole nanoseconds those tokens occupy.
+ */
+static uint64_t tokens_to_ns(const struct pacer *pacer, uint64_t count, uint64_t *remainder)
+{
+    unsigned __int128 scaled = ((unsigned __int128)count * pacer->period_ns) + pacer->remainder;
+    *remainder = (uint64_t)(scaled % pacer->tokens);
+    return (uint64_t)(scaled / pacer->tokens);
+}
+
+int pacer_init(struct pacer *pacer, uint64_t tokens, uint64_t period_ns, uint64_t burst_tokens)
+{
+    memset(pacer, 0, sizeof(struct pacer));
+
+    if (tokens == 0)
+    {
+        return 0; /**< Unlimited */
+    }
+
+    if (period_ns == 0)
+    {
+        fprintf(stderr, "Error: Pacing period must be non-zero\n");
+        return -1;
+    }
+
+    uint64_t unused_remainder;
+    pacer->tokens = tokens;
+    pacer->period_ns = period_ns;
+    pacer->tolerance_ns = tokens_to_ns(pacer, burst_tokens, &unused_remainder);
+
+    return 0;
+}
+
+int pacer_try(struct pacer *pacer, uint64_t cost, uint64_t now_ns, uint64_t *deadline_ns)
+{
+    if (pacer->tokens == 0)
+    {
+        return 1;
+    }
+
+    uint64_t remainder;
+    uint64_t interval_ns = tokens_to_ns(pacer, cost, &remainder);
+
+    // 1. Anchor the schedule with a full bucket on the first debit, or after falling behind by more
+    //    than the burst allowance plus one interval (idle time, not scheduling jitter)
+    if (!pacer->started || now_ns > pacer->next_ns + pacer->tolerance_ns + interval_ns)
+    {
+        pacer->next_ns = (now_ns > pacer->tolerance_ns) ? now_ns - pacer->tolerance_ns : 0;
+        pacer->started = 1;
+    }
+
+    // 2. Not yet: report the absolute deadline instead of blocking
+    if (pacer->next_ns > now_ns)
+    {
+        *deadline_ns = pacer->next_ns;
+        return 0;
+    }
+
+    // 3. Debit: the next deadline moves by exactly this transmission's share of the rate
+    pacer->next_ns += interval_ns;
+    pacer->remainder = remainder;
+
+    return 1;
+}
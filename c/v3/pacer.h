@@ -0,0 +1,51 @@
+/**
+ * @file pacer.h
+ * @brief Token bucket pacing engine driven by absolute CLOCK_MONOTONIC deadlines.
+ *
+ * @note Deadlines advance by exact intervals (with the sub-nanosecond remainder carried forward),
+ *       so oversleeping one deadline shortens the next wait instead of accumulating drift.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PACER_H
+#define PACER_H
+
+#include "timestamp.h"
+
+#include <stdint.h>
+
+/**
+ * @struct pacer
+ * @brief A token bucket: @ref tokens are granted every @ref period_ns, up to @ref tolerance_ns of them banked.
+ */
+struct pacer
+{
+    uint64_t tokens;        /**< Tokens granted per period (0 = unlimited, every wait returns immediately) */
+    uint64_t period_ns;     /**< Length of the refill period in nanoseconds */
+    uint64_t tolerance_ns;  /**< Burst allowance: how far ahead of schedule a debit may be granted */
+    uint64_t next_ns;       /**< Absolute CLOCK_MONOTONIC deadline of the next debit */
+    uint64_t remainder;     /**< Fractional nanoseconds (scaled by @ref tokens) carried between debits */
+    uint8_t started;        /**< Set once the first debit anchored the schedule */
+};
+
+/**
+ * @brief Initializes the bucket.
+ * @param pacer        Pointer to the caller-allocated pacer.
+ * @param tokens       Tokens granted per @p period_ns (e.g., packets or bits). 0 disables pacing.
+ * @param period_ns    Refill period in nanoseconds (e.g., @ref TIMESTAMP_NS_PER_SEC).
+ * @param burst_tokens Tokens that may be spent ahead of schedule after an idle stretch (0 = strict spacing).
+ * @return 0 on success, -1 if @p period_ns is 0 while pacing is enabled.
+ */
+int pacer_init(struct pacer *pacer, uint64_t tokens, uint64_t period_ns, uint64_t burst_tokens);
+
+/**
+ * @brief Debits @p cost tokens if they are available at @p now_ns, without blocking.
+ * @param pacer       Pointer to an initialized pacer.
+ * @param cost        Tokens consumed by the upcoming transmission.
+ * @param now_ns      Current CLOCK_MONOTONIC time (see @ref timestamp_now_ns).
+ * @param deadline_ns Output, set when not yet available: the absolute CLOCK_MONOTONIC time to retry at.
+ * @return 1 if the tokens were debited, 0 if the caller must wait until @p deadline_ns.
+ */
+int pacer_try(struct pacer *pacer, uint64_t cost, uint64_t now_ns, uint64_t *deadline_ns);
+
+#endif /* PACER_H */
@@ -11,7 +11,48 @@
 #include <arpa/inet.h>
 #include <string.h>
 
-size_t build_ip_v4_header(uint8_t *buffer, size_t capacity, const char *src_ip, const char *dst_ip, uint8_t ttl, uint16_t id, uint8_t protocol, size_t payload_len)
+/**
+ * @brief Copies @p length bytes over @p dst, folding every changed 16-bit word into @p checksum (RFC 1624).
+ * @return The updated checksum.
+ */
+static uint16_t patch_words(uint16_t checksum, uint8_t *dst, const void *src, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)src;
+    for (size_t i = 0; i + 1 < length; i += 2)
+    {
+        uint16_t old_word;
+        uint16_t new_word;
+        memcpy(&old_word, dst + i, sizeof(old_word));
+        memcpy(&new_word, bytes + i, sizeof(new_word));
+        if (old_word != new_word)
+        {
+            checksum = update_checksum_16(checksum, old_word, new_word);
+            memcpy(dst + i, &new_word, sizeof(new_word));
+        }
+    }
+
+    return checksum;
+}
+
+size_t build_ip_v4_header(uint8_t *buffer, size_t capacity, const char *src_ip, const char *dst_ip, uint8_t ttl, uint16_t id, uint16_t flags, uint8_t protocol, size_t payload_len)
+{
+    struct in_addr src;
+    struct in_addr dst;
+
+    if (!src_ip || inet_pton(AF_INET, src_ip, &src) != 1)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    if (!dst_ip || inet_pton(AF_INET, dst_ip, &dst) != 1)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    return build_ip_v4_header_addr(buffer, capacity, src, dst, ttl, id, flags, protocol, payload_len);
+}
+
+size_t build_ip_v4_header_addr(uint8_t *buffer, size_t capacity, struct in_addr src, struct in_addr dst, uint8_t ttl, uint16_t id, uint16_t flags, uint8_t protocol, size_t payload_len)
 {
     if (!buffer || capacity < sizeof(struct ip_v4_header))
     {
@@ -31,27 +72,44 @@ size_t build_ip_v4_header(uint8_t *buffer, size_t capacity, const char *src_ip,
     ip->total_length = htons((uint16_t)total_len);
     ip->type_of_service = 0;        /**< @todo Create enum for TOS values */
     ip->identification = htons(id); // <-- Updated: Dynamic ID
-    ip->flags_frag_offset = 0;      /**< @todo Add ability to set flags and fragmentation options */
+    ip->flags_frag_offset = htons(flags); /**< DF for path MTU probes, MF and the offset for fragments */
     ip->ttl = ttl;                  // <-- Updated: Dynamic TTL
     ip->protocol = protocol;
     ip->checksum = 0; /**< Set checksum to `0` before calculation */
+    ip->src = src.s_addr;
+    ip->dst = dst.s_addr;
+
+    ip->checksum = compute_checksum_fast(ip, sizeof(struct ip_v4_header));
+
+    return sizeof(struct ip_v4_header);
+}
 
-    if (inet_pton(AF_INET, src_ip, &ip->src) != 1)
+size_t build_ip_v6_header_addr(uint8_t *buffer, size_t capacity, const struct in6_addr *src, const struct in6_addr *dst, uint8_t hop_limit, uint8_t next_header, size_t payload_len)
+{
+    if (!buffer || !src || !dst || capacity < sizeof(struct ip_v6_header))
     {
         return 0; /**< @todo Unique error type */
     }
 
-    if (inet_pton(AF_INET, dst_ip, &ip->dst) != 1)
+    if (payload_len > UINT16_MAX || sizeof(struct ip_v6_header) + payload_len > capacity)
     {
-        return 0; /**< @todo Unique error type */
+        return 0; /**< @todo Jumbograms (RFC 2675) are not supported */
     }
 
-    ip->checksum = compute_checksum(ip, sizeof(struct ip_v4_header));
+    struct ip_v6_header *ip = (struct ip_v6_header *)buffer;
+    memset(ip, 0, sizeof(struct ip_v6_header));
 
-    return sizeof(struct ip_v4_header);
+    ip->version_class_flow = htonl((uint32_t)IP_V6 << 28); /**< @todo Traffic class and flow label */
+    ip->payload_length = htons((uint16_t)payload_len);
+    ip->next_header = next_header;
+    ip->hop_limit = hop_limit;
+    memcpy(ip->src, src->s6_addr, sizeof(ip->src));
+    memcpy(ip->dst, dst->s6_addr, sizeof(ip->dst));
+
+    return sizeof(struct ip_v6_header);
 }
 
-size_t build_icmp_v4_echo_request(uint8_t *buffer, size_t capacity, uint8_t type, uint8_t code, uint16_t id, uint16_t seq, const char *payload, size_t payload_len)
+size_t build_icmp_v4_echo_request(uint8_t *buffer, size_t capacity, uint8_t type, uint8_t code, uint16_t id, uint16_t seq, const void *payload, size_t payload_len)
 {
     // The total header is the base 4 bytes + the echo 4 bytes
     size_t header_len = sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header);
@@ -86,7 +144,321 @@ size_t build_icmp_v4_echo_request(uint8_t *buffer, size_t capacity, uint8_t type
     }
 
     // 4. Calculate the ICMP checksum (covers base header + echo header + payload)
-    icmp_base->checksum = compute_checksum(buffer, total_len);
+    icmp_base->checksum = compute_checksum_fast(buffer, total_len);
+
+    return total_len;
+}
+
+size_t build_icmp_v4_echo_template(struct icmp_v4_echo_template *tmpl, uint8_t *buffer, size_t capacity, struct in_addr src, struct in_addr dst, uint8_t ttl, uint8_t type, uint8_t code, uint16_t id, uint16_t seq, uint16_t flags, const void *payload, size_t payload_len)
+{
+    size_t ip_hdr_size = sizeof(struct ip_v4_header);
+    if (!tmpl || !buffer || capacity < ip_hdr_size)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    // 1. The ICMP segment goes first so the IPv4 header knows its payload length
+    size_t icmp_len = build_icmp_v4_echo_request(buffer + ip_hdr_size, capacity - ip_hdr_size, type, code, id, seq, payload, payload_len);
+    if (icmp_len == 0)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    // 2. The IPv4 header initially carries the same value as the sequence for tracking
+    size_t ip_len = build_ip_v4_header_addr(buffer, capacity, src, dst, ttl, seq, flags, IP_PROTO_ICMP_V4, icmp_len);
+    if (ip_len == 0)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    tmpl->buffer = buffer;
+    tmpl->length = ip_len + icmp_len;
+    tmpl->ip = (struct ip_v4_header *)buffer;
+    tmpl->icmp = (struct icmp_v4_header *)(buffer + ip_len);
+    tmpl->echo = (struct icmp_v4_echo_header *)(buffer + ip_len + sizeof(struct icmp_v4_header));
+
+    return tmpl->length;
+}
+
+void patch_icmp_v4_echo_template(struct icmp_v4_echo_template *tmpl, uint16_t ip_id, uint16_t seq)
+{
+    uint16_t new_ip_id = htons(ip_id);
+    uint16_t new_seq = htons(seq);
+
+    // Words are patched as stored (Network Byte Order); the ones' complement sum is order-agnostic
+    tmpl->ip->checksum = update_checksum_16(tmpl->ip->checksum, tmpl->ip->identification, new_ip_id);
+    tmpl->ip->identification = new_ip_id;
+
+    tmpl->icmp->checksum = update_checksum_16(tmpl->icmp->checksum, tmpl->echo->sequence, new_seq);
+    tmpl->echo->sequence = new_seq;
+}
+
+void patch_icmp_v4_echo_template_dst(struct icmp_v4_echo_template *tmpl, uint32_t dst)
+{
+    if (tmpl->ip->dst == dst)
+    {
+        return;
+    }
+
+    // The 32-bit address spans two checksum words; update each half as stored
+    uint16_t old_words[2];
+    uint16_t new_words[2];
+    memcpy(old_words, &tmpl->ip->dst, sizeof(old_words));
+    memcpy(new_words, &dst, sizeof(new_words));
+
+    tmpl->ip->checksum = update_checksum_16(tmpl->ip->checksum, old_words[0], new_words[0]);
+    tmpl->ip->checksum = update_checksum_16(tmpl->ip->checksum, old_words[1], new_words[1]);
+    tmpl->ip->dst = dst;
+}
+
+void patch_icmp_v4_echo_template_payload(struct icmp_v4_echo_template *tmpl, size_t offset, const void *data, size_t length)
+{
+    uint8_t *payload = (uint8_t *)(tmpl->echo + 1) + offset;
+    tmpl->icmp->checksum = patch_words(tmpl->icmp->checksum, payload, data, length);
+}
+
+size_t build_icmp_v6_echo_request(uint8_t *buffer, size_t capacity, uint8_t type, uint8_t code, uint16_t id, uint16_t seq, const void *payload, size_t payload_len)
+{
+    size_t header_len = sizeof(struct icmp_v6_header) + sizeof(struct icmp_v6_echo_header);
+    size_t total_len = header_len + payload_len;
+
+    if (!buffer || capacity < total_len)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    struct icmp_v6_header *icmp_base = (struct icmp_v6_header *)buffer;
+    icmp_base->type = type;
+    icmp_base->code = code;
+    icmp_base->checksum = 0; /**< Completed by the caller over the pseudo-header */
+
+    struct icmp_v6_echo_header *icmp_echo = (struct icmp_v6_echo_header *)(buffer + sizeof(struct icmp_v6_header));
+    icmp_echo->identifier = htons(id);
+    icmp_echo->sequence = htons(seq);
+
+    if (payload_len > 0 && payload != NULL)
+    {
+        memcpy(buffer + header_len, payload, payload_len);
+    }
 
     return total_len;
-}
\ No newline at end of file
+}
+
+size_t build_icmp_v6_echo_template(struct icmp_v6_echo_template *tmpl, uint8_t *buffer, size_t capacity, const struct in6_addr *src, const struct in6_addr *dst, uint8_t hop_limit, uint8_t code, uint16_t id, uint16_t seq, const void *payload, size_t payload_len)
+{
+    size_t ip_hdr_size = sizeof(struct ip_v6_header);
+    if (!tmpl || !buffer || capacity < ip_hdr_size)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    // 1. The ICMPv6 segment goes first so the IPv6 header knows its payload length
+    size_t icmp_len = build_icmp_v6_echo_request(buffer + ip_hdr_size, capacity - ip_hdr_size, ICMP_V6_ECHO_REQUEST, code, id, seq, payload, payload_len);
+    if (icmp_len == 0)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    size_t ip_len = build_ip_v6_header_addr(buffer, capacity, src, dst, hop_limit, IP_V6_ICMP_V6, icmp_len);
+    if (ip_len == 0)
+    {
+        return 0; /**< @todo Unique error type */
+    }
+
+    // 2. Checksum the pseudo-header and the segment separately; nothing is copied to join them
+    struct ip_v6_pseudo_header pseudo;
+    memset(&pseudo, 0, sizeof(pseudo));
+    memcpy(pseudo.src, src->s6_addr, sizeof(pseudo.src));
+    memcpy(pseudo.dst, dst->s6_addr, sizeof(pseudo.dst));
+    pseudo.upper_layer_length = htonl((uint32_t)icmp_len);
+    pseudo.next_header = IP_V6_ICMP_V6;
+
+    tmpl->buffer = buffer;
+    tmpl->length = ip_len + icmp_len;
+    tmpl->ip = (struct ip_v6_header *)buffer;
+    tmpl->icmp = (struct icmp_v6_header *)(buffer + ip_len);
+    tmpl->echo = (struct icmp_v6_echo_header *)(buffer + ip_len + sizeof(struct icmp_v6_header));
+    tmpl->icmp->checksum = combine_checksum(compute_checksum_fast(&pseudo, sizeof(pseudo)), compute_checksum_fast(tmpl->icmp, icmp_len));
+
+    return tmpl->length;
+}
+
+void patch_icmp_v6_echo_template(struct icmp_v6_echo_template *tmpl, uint16_t seq)
+{
+    uint16_t new_seq = htons(seq);
+
+    tmpl->icmp->checksum = update_checksum_16(tmpl->icmp->checksum, tmpl->echo->sequence, new_seq);
+    tmpl->echo->sequence = new_seq;
+}
+
+void patch_icmp_v6_echo_template_dst(struct icmp_v6_echo_template *tmpl, const struct in6_addr *dst)
+{
+    if (memcmp(tmpl->ip->dst, dst->s6_addr, sizeof(tmpl->ip->dst)) == 0)
+    {
+        return;
+    }
+
+    // The 128-bit address spans eight pseudo-header words; update each as stored
+    uint16_t old_words[8];
+    uint16_t new_words[8];
+    memcpy(old_words, tmpl->ip->dst, sizeof(old_words));
+    memcpy(new_words, dst->s6_addr, sizeof(new_words));
+
+    for (int i = 0; i < 8; i++)
+    {
+        if (old_words[i] != new_words[i])
+        {
+            tmpl->icmp->checksum = update_checksum_16(tmpl->icmp->checksum, old_words[i], new_words[i]);
+        }
+    }
+    memcpy(tmpl->ip->dst, dst->s6_addr, sizeof(tmpl->ip->dst));
+}
+
+void patch_icmp_v6_echo_template_payload(struct icmp_v6_echo_template *tmpl, size_t offset, const void *data, size_t length)
+{
+    uint8_t *payload = (uint8_t *)(tmpl->echo + 1) + offset;
+    tmpl->icmp->checksum = patch_words(tmpl->icmp->checksum, payload, data, length);
+}
+
+/**
+ * @brief Fragment data bytes that fit after @p header_len header bytes within @p mtu (a multiple of 8).
+ */
+static size_t fragment_chunk(uint32_t mtu, size_t header_len)
+{
+    return ((mtu - header_len) / 8) * 8;
+}
+
+/**
+ * @brief Points fragment @p index of @p train at its rebuilt header and its slice of the original.
+ */
+static void fragment_link(struct ip_fragment_train *train, uint32_t index, size_t header_len, const uint8_t *slice, size_t slice_len)
+{
+    train->iovecs[2 * index].iov_base = train->headers + (size_t)index * IP_FRAGMENT_HEADER_SPACE;
+    train->iovecs[2 * index].iov_len = header_len;
+    train->iovecs[2 * index + 1].iov_base = (void *)slice;
+    train->iovecs[2 * index + 1].iov_len = slice_len;
+}
+
+uint32_t ip_v4_fragment_count(size_t length, uint32_t mtu)
+{
+    if (length <= mtu)
+    {
+        return 1;
+    }
+    if (mtu < IP_V4_MIN_MTU || length < sizeof(struct ip_v4_header))
+    {
+        return 0;
+    }
+
+    size_t chunk = fragment_chunk(mtu, sizeof(struct ip_v4_header));
+    return (uint32_t)((length - sizeof(struct ip_v4_header) + chunk - 1) / chunk);
+}
+
+uint32_t fragment_ip_v4_datagram(struct ip_fragment_train *train, const uint8_t *datagram, size_t length, uint32_t mtu)
+{
+    const struct ip_v4_header *ip = (const struct ip_v4_header *)datagram;
+
+    // 1. Only whole, option-free datagrams that may be fragmented are split
+    if (!train || !datagram || length < sizeof(struct ip_v4_header) || (ip->version_ihl & 0x0F) != IP_V4_MIN_IHL ||
+        ntohs(ip->total_length) != length || (ntohs(ip->flags_frag_offset) & (IP_V4_FLAG_DF | IP_V4_FLAG_MF | IP_V4_FRAG_OFFSET_MASK)) != 0)
+    {
+        return 0; /**< @todo Options would have to be filtered by their copied flag for later fragments */
+    }
+
+    uint32_t count = ip_v4_fragment_count(length, mtu);
+    if (count == 0 || count > train->capacity)
+    {
+        return 0;
+    }
+
+    // 2. Each fragment: a copy of the header with its own length, offset and checksum, then its slice in place
+    const uint8_t *payload = datagram + sizeof(struct ip_v4_header);
+    size_t payload_len = length - sizeof(struct ip_v4_header);
+    size_t chunk = (count == 1) ? payload_len : fragment_chunk(mtu, sizeof(struct ip_v4_header));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        size_t offset = (size_t)i * chunk;
+        size_t slice_len = (payload_len - offset < chunk) ? payload_len - offset : chunk;
+
+        struct ip_v4_header *frag = (struct ip_v4_header *)(train->headers + (size_t)i * IP_FRAGMENT_HEADER_SPACE);
+        memcpy(frag, ip, sizeof(struct ip_v4_header));
+        frag->total_length = htons((uint16_t)(sizeof(struct ip_v4_header) + slice_len));
+        frag->flags_frag_offset = htons((uint16_t)((offset / 8) | ((i + 1 < count) ? IP_V4_FLAG_MF : 0)));
+        frag->checksum = 0;
+        frag->checksum = compute_checksum_fast(frag, sizeof(struct ip_v4_header));
+
+        fragment_link(train, i, sizeof(struct ip_v4_header), payload + offset, slice_len);
+    }
+
+    train->count = count;
+    return count;
+}
+
+uint32_t ip_v6_fragment_count(size_t length, uint32_t mtu)
+{
+    if (length <= mtu)
+    {
+        return 1;
+    }
+    if (mtu < IP_V6_MIN_LINK_MTU || length < sizeof(struct ip_v6_header))
+    {
+        return 0;
+    }
+
+    size_t chunk = fragment_chunk(mtu, sizeof(struct ip_v6_header) + sizeof(struct ip_v6_fragment_header));
+    return (uint32_t)((length - sizeof(struct ip_v6_header) + chunk - 1) / chunk);
+}
+
+uint32_t fragment_ip_v6_packet(struct ip_fragment_train *train, const uint8_t *packet, size_t length, uint32_t mtu, uint32_t identification)
+{
+    const struct ip_v6_header *ip = (const struct ip_v6_header *)packet;
+
+    // 1. Without extension headers the whole payload is the fragmentable part
+    if (!train || !packet || length < sizeof(struct ip_v6_header) || ntohs(ip->payload_length) != length - sizeof(struct ip_v6_header) ||
+        ip->next_header == IP_V6_FRAGMENT)
+    {
+        return 0; /**< @todo Hop-by-Hop and Routing headers would belong to the unfragmentable part */
+    }
+
+    uint32_t count = ip_v6_fragment_count(length, mtu);
+    if (count == 0 || count > train->capacity)
+    {
+        return 0;
+    }
+
+    const uint8_t *payload = packet + sizeof(struct ip_v6_header);
+    size_t payload_len = length - sizeof(struct ip_v6_header);
+    if (count == 1)
+    {
+        memcpy(train->headers, ip, sizeof(struct ip_v6_header));
+        fragment_link(train, 0, sizeof(struct ip_v6_header), payload, payload_len);
+        train->count = 1;
+        return 1;
+    }
+
+    // 2. Each fragment: the base header pointing at a Fragment header, then its slice in place
+    size_t header_len = sizeof(struct ip_v6_header) + sizeof(struct ip_v6_fragment_header);
+    size_t chunk = fragment_chunk(mtu, header_len);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        size_t offset = (size_t)i * chunk;
+        size_t slice_len = (payload_len - offset < chunk) ? payload_len - offset : chunk;
+
+        uint8_t *block = train->headers + (size_t)i * IP_FRAGMENT_HEADER_SPACE;
+        struct ip_v6_header *base = (struct ip_v6_header *)block;
+        memcpy(base, ip, sizeof(struct ip_v6_header));
+        base->payload_length = htons((uint16_t)(sizeof(struct ip_v6_fragment_header) + slice_len));
+        base->next_header = IP_V6_FRAGMENT;
+
+        struct ip_v6_fragment_header *frag = (struct ip_v6_fragment_header *)(block + sizeof(struct ip_v6_header));
+        frag->next_header = ip->next_header;
+        frag->reserved = 0;
+        frag->offset_flags = htons((uint16_t)(offset | ((i + 1 < count) ? IP_V6_FRAG_MF : 0)));
+        frag->identification = htonl(identification);
+
+        fragment_link(train, i, header_len, payload + offset, slice_len);
+    }
+
+    train->count = count;
+    return count;
+}
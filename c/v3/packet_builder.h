@@ -8,10 +8,14 @@
 #define PACKET_BUILDER_H
 
 #include "icmp_v4.h"
+#include "icmp_v6.h"
 #include "ip_v4.h"
+#include "ip_v6.h"
 
+#include <netinet/in.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 /**
  * @brief Constructs an IPv4 header in the provided buffer.
@@ -21,11 +25,41 @@
  * @param dst_ip      Destination IP address as a string (e.g., "8.8.8.8").
  * @param ttl         Time to Live (TTL) for the IP packet.
  * @param id          Identification field for the IP packet.
+ * @param flags       Flags and fragment offset (host byte order), e.g. @ref IP_V4_FLAG_DF.
  * @param protocol    The Layer 4 protocol ID (e.g., IP_PROTO_ICMP_V4).
  * @param payload_len The size of the payload following this header.
  * @return size_t     The number of bytes written (20), or 0 on error.
  */
-size_t build_ip_v4_header(uint8_t *buffer, size_t capacity, const char *src_ip, const char *dst_ip, uint8_t ttl, uint16_t id, uint8_t protocol, size_t payload_len);
+size_t build_ip_v4_header(uint8_t *buffer, size_t capacity, const char *src_ip, const char *dst_ip, uint8_t ttl, uint16_t id, uint16_t flags, uint8_t protocol, size_t payload_len);
+
+/**
+ * @brief Constructs an IPv4 header from pre-parsed binary addresses; never touches string parsing.
+ * @param buffer      The memory block where the packet will be built.
+ * @param capacity    The absolute maximum size of the buffer (to prevent overflow).
+ * @param src         Source address (Network Byte Order).
+ * @param dst         Destination address (Network Byte Order).
+ * @param ttl         Time to Live (TTL) for the IP packet.
+ * @param id          Identification field for the IP packet.
+ * @param flags       Flags and fragment offset (host byte order), e.g. @ref IP_V4_FLAG_DF.
+ * @param protocol    The Layer 4 protocol ID (e.g., IP_PROTO_ICMP_V4).
+ * @param payload_len The size of the payload following this header.
+ * @return size_t     The number of bytes written (20), or 0 on error.
+ */
+size_t build_ip_v4_header_addr(uint8_t *buffer, size_t capacity, struct in_addr src, struct in_addr dst, uint8_t ttl, uint16_t id, uint16_t flags, uint8_t protocol, size_t payload_len);
+
+/**
+ * @brief Constructs a base IPv6 header (no extensions) from pre-parsed binary addresses.
+ * @param buffer      The memory block where the packet will be built.
+ * @param capacity    The absolute maximum size of the buffer (to prevent overflow).
+ * @param src         Source address.
+ * @param dst         Destination address.
+ * @param hop_limit   Hop limit for the IP packet.
+ * @param next_header The header following this one (e.g., IP_V6_ICMP_V6).
+ * @param payload_len The size of everything following this header.
+ * @return size_t     The number of bytes written (40), or 0 on error.
+ * @note IPv6 has no header checksum; upper layers cover the addresses via their pseudo-header.
+ */
+size_t build_ip_v6_header_addr(uint8_t *buffer, size_t capacity, const struct in6_addr *src, const struct in6_addr *dst, uint8_t hop_limit, uint8_t next_header, size_t payload_len);
 /**
  * @brief Constructs an ICMPv4 header and copies the payload into the buffer.
  * @param buffer      The memory block where the packet will be built.
@@ -38,6 +72,206 @@ size_t build_ip_v4_header(uint8_t *buffer, size_t capacity, const char *src_ip,
  * @param payload_len The length of the payload in bytes.
  * @return size_t     The total number of bytes written (Header + Payload), or 0 on error.
  */
-size_t build_icmp_v4_echo_request(uint8_t *buffer, size_t capacity, uint8_t type, uint8_t code, uint16_t id, uint16_t seq, const char *payload, size_t payload_len);
+size_t build_icmp_v4_echo_request(uint8_t *buffer, size_t capacity, uint8_t type, uint8_t code, uint16_t id, uint16_t seq, const void *payload, size_t payload_len);
+
+/**
+ * @struct icmp_v4_echo_template
+ * @brief A fully built IPv4 + ICMPv4 Echo datagram that is patched in place per packet.
+ *
+ * @note Only the IPv4 `identification` and ICMP `sequence` change between packets, so both
+ *       checksums are carried forward with RFC 1624 updates instead of being recomputed.
+ */
+struct icmp_v4_echo_template
+{
+    uint8_t *buffer;                  /**< Caller-owned memory holding the datagram */
+    size_t length;                    /**< Total datagram length (IPv4 header + ICMP segment) */
+    struct ip_v4_header *ip;          /**< View of the IPv4 header at the start of @ref buffer */
+    struct icmp_v4_header *icmp;      /**< View of the ICMPv4 base header */
+    struct icmp_v4_echo_header *echo; /**< View of the ICMPv4 Echo fields */
+};
+
+/**
+ * @brief Builds a complete IPv4 + ICMPv4 Echo datagram once, to be patched by @ref patch_icmp_v4_echo_template.
+ * @param tmpl        The template to initialize.
+ * @param buffer      The memory block where the datagram will be built. Must outlive the template.
+ * @param capacity    The absolute maximum size of the buffer.
+ * @param src         Source address (Network Byte Order).
+ * @param dst         Destination address (Network Byte Order).
+ * @param ttl         Time to Live (TTL) for the IP packet.
+ * @param type        ICMP Message Type (e.g., Echo Request).
+ * @param code        ICMP Message Code.
+ * @param id          Session Identifier.
+ * @param seq         Initial Sequence Number (also used as the initial IP Identification).
+ * @param flags       IPv4 flags and fragment offset (host byte order), e.g. @ref IP_V4_FLAG_DF.
+ * @param payload     Pointer to the payload data.
+ * @param payload_len The length of the payload in bytes.
+ * @return size_t     The total number of bytes in the datagram, or 0 on error.
+ */
+size_t build_icmp_v4_echo_template(struct icmp_v4_echo_template *tmpl, uint8_t *buffer, size_t capacity, struct in_addr src, struct in_addr dst, uint8_t ttl, uint8_t type, uint8_t code, uint16_t id, uint16_t seq, uint16_t flags, const void *payload, size_t payload_len);
+
+/**
+ * @brief Rewrites the IP Identification and ICMP Sequence fields in O(1), regardless of payload size.
+ * @param tmpl  A template initialized by @ref build_icmp_v4_echo_template.
+ * @param ip_id New IPv4 Identification value (host byte order).
+ * @param seq   New ICMP Sequence Number (host byte order).
+ */
+void patch_icmp_v4_echo_template(struct icmp_v4_echo_template *tmpl, uint16_t ip_id, uint16_t seq);
+
+/**
+ * @brief Retargets the template to another destination in O(1), updating only the IPv4 checksum.
+ * @param tmpl A template initialized by @ref build_icmp_v4_echo_template.
+ * @param dst  New destination address (Network Byte Order, as in `struct in_addr`).
+ * @note The ICMPv4 checksum does not cover the IPv4 header, so it is left untouched.
+ */
+void patch_icmp_v4_echo_template_dst(struct icmp_v4_echo_template *tmpl, uint32_t dst);
+
+/**
+ * @brief Overwrites @p length payload bytes at @p offset, carrying the ICMPv4 checksum forward per changed word.
+ * @param tmpl   A template initialized by @ref build_icmp_v4_echo_template.
+ * @param offset Even offset from the start of the payload.
+ * @param data   Replacement bytes.
+ * @param length Even number of bytes, within the payload.
+ */
+void patch_icmp_v4_echo_template_payload(struct icmp_v4_echo_template *tmpl, size_t offset, const void *data, size_t length);
+
+/**
+ * @brief Constructs an ICMPv6 Echo header and copies the payload into the buffer.
+ * @param buffer      The memory block where the segment will be built.
+ * @param capacity    The absolute maximum size of the buffer.
+ * @param type        ICMPv6 Message Type (e.g., Echo Request).
+ * @param code        ICMPv6 Message Code.
+ * @param id          Session Identifier.
+ * @param seq         Sequence Number.
+ * @param payload     Pointer to the payload data.
+ * @param payload_len The length of the payload in bytes.
+ * @return size_t     The total number of bytes written (Header + Payload), or 0 on error.
+ * @note The checksum is left `0`: it covers the IPv6 pseudo-header, which only the caller knows.
+ */
+size_t build_icmp_v6_echo_request(uint8_t *buffer, size_t capacity, uint8_t type, uint8_t code, uint16_t id, uint16_t seq, const void *payload, size_t payload_len);
+
+/**
+ * @struct icmp_v6_echo_template
+ * @brief A fully built IPv6 + ICMPv6 Echo datagram that is patched in place per packet.
+ *
+ * @note IPv6 has no header checksum. The ICMPv6 checksum covers the pseudo-header, so both a new
+ *       sequence and a new destination are carried forward with RFC 1624 updates.
+ */
+struct icmp_v6_echo_template
+{
+    uint8_t *buffer;                  /**< Caller-owned memory holding the datagram */
+    size_t length;                    /**< Total datagram length (IPv6 header + ICMPv6 segment) */
+    struct ip_v6_header *ip;          /**< View of the IPv6 header at the start of @ref buffer */
+    struct icmp_v6_header *icmp;      /**< View of the ICMPv6 base header */
+    struct icmp_v6_echo_header *echo; /**< View of the ICMPv6 Echo fields */
+};
+
+/**
+ * @brief Builds a complete IPv6 + ICMPv6 Echo Request once, to be patched by @ref patch_icmp_v6_echo_template.
+ * @param tmpl        The template to initialize.
+ * @param buffer      The memory block where the datagram will be built. Must outlive the template.
+ * @param capacity    The absolute maximum size of the buffer.
+ * @param src         Source address.
+ * @param dst         Destination address.
+ * @param hop_limit   Hop limit for the IP packet.
+ * @param code        ICMPv6 Message Code.
+ * @param id          Session Identifier.
+ * @param seq         Initial Sequence Number.
+ * @param payload     Pointer to the payload data.
+ * @param payload_len The length of the payload in bytes.
+ * @return size_t     The total number of bytes in the datagram, or 0 on error.
+ */
+size_t build_icmp_v6_echo_template(struct icmp_v6_echo_template *tmpl, uint8_t *buffer, size_t capacity, const struct in6_addr *src, const struct in6_addr *dst, uint8_t hop_limit, uint8_t code, uint16_t id, uint16_t seq, const void *payload, size_t payload_len);
+
+/**
+ * @brief Rewrites the ICMPv6 Sequence field in O(1), regardless of payload size.
+ * @param tmpl A template initialized by @ref build_icmp_v6_echo_template.
+ * @param seq  New ICMPv6 Sequence Number (host byte order).
+ */
+void patch_icmp_v6_echo_template(struct icmp_v6_echo_template *tmpl, uint16_t seq);
+
+/**
+ * @brief Retargets the template to another destination in O(1), updating the pseudo-header coverage.
+ * @param tmpl A template initialized by @ref build_icmp_v6_echo_template.
+ * @param dst  New destination address.
+ */
+void patch_icmp_v6_echo_template_dst(struct icmp_v6_echo_template *tmpl, const struct in6_addr *dst);
+
+/**
+ * @brief Overwrites @p length payload bytes at @p offset, carrying the ICMPv6 checksum forward per changed word.
+ * @param tmpl   A template initialized by @ref build_icmp_v6_echo_template.
+ * @param offset Even offset from the start of the payload.
+ * @param data   Replacement bytes.
+ * @param length Even number of bytes, within the payload.
+ */
+void patch_icmp_v6_echo_template_payload(struct icmp_v6_echo_template *tmpl, size_t offset, const void *data, size_t length);
+
+/**
+ * @brief Bytes reserved per fragment for its rebuilt headers: an option-free IPv4 header, or an IPv6 base
+ *        header plus a Fragment header, rounded up to a cache line.
+ */
+#define IP_FRAGMENT_HEADER_SPACE 64
+
+/**
+ * @struct ip_fragment_train
+ * @brief The fragments of one datagram, laid out for `sendmmsg`: rebuilt headers plus slices of the original.
+ *
+ * @note Only headers are written when a datagram is split. Each fragment is a pair of I/O vectors:
+ *       its own header block, then a pointer into the original datagram's payload, so no payload byte
+ *       is ever copied. The original must stay unchanged until the fragments have been sent.
+ */
+struct ip_fragment_train
+{
+    uint8_t *headers;     /**< Caller-owned memory, @ref IP_FRAGMENT_HEADER_SPACE bytes per fragment */
+    struct iovec *iovecs; /**< Caller-owned, two per fragment: its header block, then its slice of the payload */
+    uint32_t capacity;    /**< Fragments @ref headers and @ref iovecs hold */
+    uint32_t count;       /**< Fragments of the last datagram split */
+};
+
+/**
+ * @brief Number of fragments an option-free IPv4 datagram of @p length bytes is split into for @p mtu.
+ * @param length Datagram length, IPv4 header included.
+ * @param mtu    Largest fragment, IPv4 header included (at least @ref IP_V4_MIN_MTU).
+ * @return 1 if the datagram fits as is, the fragment count otherwise, or 0 if @p mtu is too small.
+ */
+uint32_t ip_v4_fragment_count(size_t length, uint32_t mtu);
+
+/**
+ * @brief Splits an option-free IPv4 datagram into fragments of at most @p mtu bytes (RFC 791).
+ *
+ * Every fragment repeats the original header with its own Total Length, More Fragments flag, offset
+ * and checksum; the Identification is shared. The upper-layer checksum is not touched, as the
+ * receiver verifies it over the reassembled datagram.
+ *
+ * @param train    Train with room for @ref ip_v4_fragment_count fragments.
+ * @param datagram A complete datagram, neither already a fragment nor marked Don't Fragment.
+ * @param length   Bytes at @p datagram.
+ * @param mtu      Largest fragment, IPv4 header included.
+ * @return The number of fragments (1 if the datagram fits as is), or 0 on error.
+ */
+uint32_t fragment_ip_v4_datagram(struct ip_fragment_train *train, const uint8_t *datagram, size_t length, uint32_t mtu);
+
+/**
+ * @brief Number of fragments an IPv6 packet (no extension headers) of @p length bytes is split into for @p mtu.
+ * @param length Packet length, IPv6 header included.
+ * @param mtu    Largest fragment, IPv6 and Fragment headers included (at least @ref IP_V6_MIN_LINK_MTU).
+ * @return 1 if the packet fits as is, the fragment count otherwise, or 0 if @p mtu is too small.
+ */
+uint32_t ip_v6_fragment_count(size_t length, uint32_t mtu);
+
+/**
+ * @brief Splits an IPv6 packet without extension headers into fragments of at most @p mtu bytes (RFC 8200 Section 4.5).
+ *
+ * Every fragment repeats the base header, with Next Header set to @ref IP_V6_FRAGMENT, followed by a
+ * Fragment header naming the original next header. A packet that fits is passed through unchanged,
+ * without an atomic Fragment header (RFC 8021).
+ *
+ * @param train          Train with room for @ref ip_v6_fragment_count fragments.
+ * @param packet         A complete packet, IPv6 header included.
+ * @param length         Bytes at @p packet.
+ * @param mtu            Largest fragment, IPv6 and Fragment headers included.
+ * @param identification Fragment Identification shared by every fragment of the packet.
+ * @return The number of fragments (1 if the packet fits as is), or 0 on error.
+ */
+uint32_t fragment_ip_v6_packet(struct ip_fragment_train *train, const uint8_t *packet, size_t length, uint32_t mtu, uint32_t identification);
 
 #endif /* PACKET_BUILDER_H */
\ No newline at end of file
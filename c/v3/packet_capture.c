@@ -0,0 +1,175 @@
+/**
+ * @file packet_capture.c
+ * @brief pcapng capture of every transmitted and received packet, written by a background thread.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "packet_capture.h"
+#include "timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief pcapng block types and option codes used here.
+ */
+#define PCAPNG_SECTION_HEADER 0x0A0D0D0A
+#define PCAPNG_INTERFACE_DESCRIPTION 0x00000001
+#define PCAPNG_ENHANCED_PACKET 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_OPT_END 0
+#define PCAPNG_OPT_EPB_FLAGS 2
+#define PCAPNG_OPT_IF_TSRESOL 9
+
+/**
+ * @brief Largest packet captured in full; IP datagrams never exceed it.
+ */
+#define PACKET_CAPTURE_SNAPLEN 65535
+
+/**
+ * @brief Fixed bytes of an Enhanced Packet Block around its data: header fields, `epb_flags`, end of options, trailing length.
+ */
+#define PACKET_CAPTURE_EPB_OVERHEAD (28 + 8 + 4 + 4)
+
+_Static_assert(PACKET_CAPTURE_BLOCK_SIZE >= PACKET_CAPTURE_EPB_OVERHEAD + PACKET_CAPTURE_SNAPLEN + 3, "a block must hold the largest packet");
+
+/**
+ * @brief Packs an option code and length (or any two 16-bit fields) into the 32-bit word they share.
+ * @note pcapng is written in host byte order, so the first field has to land at the lower address on either order.
+ */
+static uint32_t pack_pair(uint16_t first, uint16_t second)
+{
+    uint16_t pair[2] = { first, second };
+    uint32_t word;
+    memcpy(&word, pair, sizeof(word));
+    return word;
+}
+
+int packet_capture_open(struct packet_capture *capture, const char *path, uint32_t stream_count)
+{
+    memset(capture, 0, sizeof(struct packet_capture));
+    capture->writer.fd = -1;
+
+    // 1. Timestamps are taken from CLOCK_MONOTONIC; the offset turns them into wall-clock time
+    struct timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    uint64_t realtime_ns = (uint64_t)realtime.tv_sec * TIMESTAMP_NS_PER_SEC + (uint64_t)realtime.tv_nsec;
+    capture->realtime_offset_ns = (int64_t)(realtime_ns - timestamp_now_ns());
+
+    capture->streams = calloc(stream_count, sizeof(struct packet_capture_stream));
+    if (!capture->streams)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u capture streams\n", stream_count);
+        return -1;
+    }
+    capture->stream_count = stream_count;
+
+    // 2. Section header (the magic tells readers the byte order, version 1.0, unknown section length), then the
+    //    only interface: raw IP datagrams with nanosecond timestamps (if_tsresol 10^-9, padded to 32 bits)
+    const uint8_t tsresol[4] = { 9, 0, 0, 0 };
+    uint32_t tsresol_word;
+    memcpy(&tsresol_word, tsresol, sizeof(tsresol_word));
+
+    uint32_t header[] = {
+        PCAPNG_SECTION_HEADER, 28, PCAPNG_BYTE_ORDER_MAGIC, pack_pair(1, 0), UINT32_MAX, UINT32_MAX, 28,
+        PCAPNG_INTERFACE_DESCRIPTION, 32, pack_pair(PACKET_CAPTURE_LINKTYPE_RAW, 0), PACKET_CAPTURE_SNAPLEN,
+        pack_pair(PCAPNG_OPT_IF_TSRESOL, 1), tsresol_word, PCAPNG_OPT_END, 32,
+    };
+
+    // 3. Blocks hold whole EPBs of any length, so each is written trimmed and O_DIRECT does not apply
+    if (block_writer_open(&capture->writer, path, "capture", PACKET_CAPTURE_BLOCK_SIZE, stream_count, 0, header, sizeof(header)) != 0)
+    {
+        free(capture->streams);
+        capture->streams = NULL;
+        capture->stream_count = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+struct packet_capture_stream *packet_capture_stream_open(struct packet_capture *capture, uint32_t index)
+{
+    struct packet_capture_stream *stream = &capture->streams[index];
+
+    stream->ring = block_writer_stream_open(&capture->writer, index);
+    if (!stream->ring)
+    {
+        return NULL;
+    }
+    stream->realtime_offset_ns = capture->realtime_offset_ns;
+
+    return stream;
+}
+
+void packet_capture_append(struct packet_capture_stream *stream, uint64_t timestamp_ns, enum packet_capture_direction direction, const struct iovec *iov, int iovcnt)
+{
+    // 1. Sizes: the packet is truncated to the snap length, its data padded to 32 bits
+    size_t original = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        original += iov[i].iov_len;
+    }
+    size_t captured = (original < PACKET_CAPTURE_SNAPLEN) ? original : PACKET_CAPTURE_SNAPLEN;
+    size_t padded = (captured + 3) & ~(size_t)3;
+    uint32_t total = (uint32_t)(PACKET_CAPTURE_EPB_OVERHEAD + padded);
+    if (stream->fill + total > PACKET_CAPTURE_BLOCK_SIZE)
+    {
+        block_writer_stream_publish(stream->ring, stream->fill);
+        stream->fill = 0;
+    }
+
+    // 2. Header fields
+    uint8_t *block = block_writer_stream_block(stream->ring) + stream->fill;
+    uint64_t realtime_ns = timestamp_ns + (uint64_t)stream->realtime_offset_ns;
+    uint32_t fields[7] = { PCAPNG_ENHANCED_PACKET, total, 0, (uint32_t)(realtime_ns >> 32), (uint32_t)realtime_ns, (uint32_t)captured, (uint32_t)original };
+    memcpy(block, fields, sizeof(fields));
+
+    // 3. The data, gathered and zero padded
+    uint8_t *cursor = block + sizeof(fields);
+    size_t remaining = captured;
+    for (int i = 0; i < iovcnt && remaining > 0; i++)
+    {
+        size_t piece = (iov[i].iov_len < remaining) ? iov[i].iov_len : remaining;
+        memcpy(cursor, iov[i].iov_base, piece);
+        cursor += piece;
+        remaining -= piece;
+    }
+    memset(cursor, 0, padded - captured);
+    cursor += padded - captured;
+
+    // 4. epb_flags carries the direction, then the end of options and the trailing length
+    uint32_t trailer[4] = { pack_pair(PCAPNG_OPT_EPB_FLAGS, 4), (uint32_t)direction, PCAPNG_OPT_END, total };
+    memcpy(cursor, trailer, sizeof(trailer));
+
+    stream->fill += total;
+    stream->packets++;
+}
+
+void packet_capture_flush(struct packet_capture_stream *stream)
+{
+    if (stream->fill > 0)
+    {
+        block_writer_stream_publish(stream->ring, stream->fill);
+        stream->fill = 0;
+    }
+}
+
+int packet_capture_close(struct packet_capture *capture)
+{
+    int rc = block_writer_close(&capture->writer);
+
+    capture->packets = 0;
+    for (uint32_t i = 0; i < capture->stream_count; i++)
+    {
+        capture->packets += capture->streams[i].packets;
+    }
+    free(capture->streams);
+
+    capture->streams = NULL;
+    capture->stream_count = 0;
+    return rc;
+}
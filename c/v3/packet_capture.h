@@ -0,0 +1,116 @@
+/**
+ * @file packet_capture.h
+ * @brief pcapng capture of every transmitted and received packet, written by a background thread.
+ *
+ * @note Each worker owns one block_writer.h stream and packs complete Enhanced Packet Blocks into its
+ *       blocks; a block is written trimmed to the bytes it holds, through the page cache. The hot
+ *       loop only copies bytes.
+ *
+ *       Packets are captured as IP datagrams (LINKTYPE_RAW) on one interface with nanosecond
+ *       timestamps, and every packet carries its direction in `epb_flags`. Outbound packets are the
+ *       templates exactly as patched for the wire (each fragment of a split datagram on its own);
+ *       inbound ones are whatever the receive path read, before matching. IPv6 raw sockets never
+ *       deliver the IPv6 header, so one is rebuilt from the sender, the local source and the hop
+ *       limit. Streams are written block by block, so packets of different workers interleave out of
+ *       timestamp order; readers sort by timestamp.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include "block_writer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Bytes per block handed from a worker to the writer (holds at least one largest packet).
+ */
+#define PACKET_CAPTURE_BLOCK_SIZE (256 * 1024)
+
+/**
+ * @brief Link type of every captured packet: a bare IPv4 or IPv6 datagram.
+ */
+#define PACKET_CAPTURE_LINKTYPE_RAW 101
+
+/**
+ * @enum packet_capture_direction
+ * @brief Direction recorded in a packet's `epb_flags` option (the pcapng encoding).
+ */
+enum packet_capture_direction
+{
+    PACKET_CAPTURE_INBOUND = 1, /**< Read by the receive path */
+    PACKET_CAPTURE_OUTBOUND = 2 /**< Handed to the transmit path */
+};
+
+/**
+ * @struct packet_capture_stream
+ * @brief One worker's view of its block ring.
+ */
+struct packet_capture_stream
+{
+    struct block_writer_stream *ring; /**< The worker's ring, or NULL if unused */
+    int64_t realtime_offset_ns;       /**< CLOCK_REALTIME minus CLOCK_MONOTONIC, copied from the capture */
+    uint32_t fill;                    /**< Bytes in the block being filled (producer only) */
+    uint64_t packets;                 /**< Packets appended (producer only) */
+};
+
+/**
+ * @struct packet_capture
+ * @brief The capture file and its streams.
+ */
+struct packet_capture
+{
+    struct block_writer writer;            /**< File, rings and writer thread */
+    int64_t realtime_offset_ns;            /**< Converts the monotonic packet timestamps to the wall-clock time pcapng expects */
+    struct packet_capture_stream *streams; /**< One stream per producer */
+    uint32_t stream_count;                 /**< Entries in @ref streams */
+    uint64_t packets;                      /**< Packets of every stream, totalled by @ref packet_capture_close */
+};
+
+/**
+ * @brief Creates @p path, writes the section header and interface description, and starts the writer thread.
+ * @param capture      Pointer to the caller-allocated capture.
+ * @param path         File to create (truncated if it exists).
+ * @param stream_count Number of producers (workers).
+ * @return 0 on success, -1 on failure (the capture is left closed and the reason printed).
+ */
+int packet_capture_open(struct packet_capture *capture, const char *path, uint32_t stream_count);
+
+/**
+ * @brief Allocates stream @p index. Call from the producing thread before its first append.
+ * @param capture Pointer to an open capture.
+ * @param index   Stream index, below `stream_count`.
+ * @return The stream, or NULL on allocation failure.
+ */
+struct packet_capture_stream *packet_capture_stream_open(struct packet_capture *capture, uint32_t index);
+
+/**
+ * @brief Appends one packet, gathered from @p iov, handing the block to the writer once the next would not fit.
+ * @param stream       Pointer to the producer's stream.
+ * @param timestamp_ns CLOCK_MONOTONIC time the packet was sent or received.
+ * @param direction    A @ref packet_capture_direction value.
+ * @param iov          The packet's pieces, in order.
+ * @param iovcnt       Entries in @p iov.
+ */
+void packet_capture_append(struct packet_capture_stream *stream, uint64_t timestamp_ns, enum packet_capture_direction direction, const struct iovec *iov, int iovcnt);
+
+/**
+ * @brief Hands the partially filled block to the writer. Producer only.
+ * @param stream Pointer to the producer's stream.
+ */
+void packet_capture_flush(struct packet_capture_stream *stream);
+
+/**
+ * @brief Writes out every published block, stops the writer and closes the file. Safe to call on a closed capture.
+ *
+ * Every producer must have flushed and stopped appending.
+ *
+ * @param capture Pointer to the capture.
+ * @return 0 if every block reached the file, -1 otherwise.
+ */
+int packet_capture_close(struct packet_capture *capture);
+
+#endif /* PACKET_CAPTURE_H */
@@ -0,0 +1,219 @@
+/**
+ * @file packet_parser.c
+ * @brief The inverse of packet_builder.c: validated, zero-copy views of received ICMP and ICMPv6 packets.
+ *
+ * @author Jim Diroff II
+ */
+#include "packet_parser.h"
+#include "checksum.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+
+/**
+ * @brief Fills @p view from an IPv4 header. A quote may be cut short; a received datagram may not.
+ * @param quote 1 if the datagram is quoted in an error, so its payload may be shorter than its total length.
+ * @return A @ref packet_parse_result.
+ */
+static int view_ip_v4(const uint8_t *datagram, size_t length, uint8_t quote, struct ip_v4_view *view)
+{
+    memset(view, 0, sizeof(struct ip_v4_view));
+    if (length < sizeof(struct ip_v4_header))
+    {
+        return PACKET_PARSE_TRUNCATED;
+    }
+
+    // 1. Version and IHL; options are whatever lies between the fixed header and the IHL
+    const struct ip_v4_header *ip = (const struct ip_v4_header *)datagram;
+    size_t header_len = (size_t)(ip->version_ihl & 0x0F) * 4;
+    if ((ip->version_ihl >> 4) != 4 || header_len < sizeof(struct ip_v4_header))
+    {
+        return PACKET_PARSE_MALFORMED;
+    }
+    if (length < header_len)
+    {
+        return PACKET_PARSE_TRUNCATED;
+    }
+
+    // 2. The total length bounds the payload (link-layer padding is ignored); only a quote may stop short of it
+    size_t total_len = ntohs(ip->total_length);
+    if (total_len < header_len)
+    {
+        return PACKET_PARSE_MALFORMED;
+    }
+    if (total_len > length && !quote)
+    {
+        return PACKET_PARSE_TRUNCATED;
+    }
+
+    view->header = ip;
+    view->header_len = header_len;
+    view->options = (header_len > sizeof(struct ip_v4_header)) ? datagram + sizeof(struct ip_v4_header) : NULL;
+    view->options_len = header_len - sizeof(struct ip_v4_header);
+    view->payload = datagram + header_len;
+    view->payload_len = ((total_len < length) ? total_len : length) - header_len;
+    return PACKET_PARSE_OK;
+}
+
+int packet_parse_ip_v4(const uint8_t *datagram, size_t length, unsigned int flags, struct ip_v4_view *view)
+{
+    int rc = view_ip_v4(datagram, length, 0, view);
+    if (rc != PACKET_PARSE_OK)
+    {
+        return rc;
+    }
+
+    // A header that includes its own valid checksum sums to zero
+    if ((flags & PACKET_PARSE_VERIFY_IP) && compute_checksum_fast(view->header, view->header_len) != 0)
+    {
+        return PACKET_PARSE_BAD_IP_CHECKSUM;
+    }
+
+    return PACKET_PARSE_OK;
+}
+
+/**
+ * @brief Parses the datagram quoted by an ICMPv4 error, down to its Echo fields when it was an Echo Request.
+ */
+static void parse_quote_v4(struct icmp_v4_view *view)
+{
+    if (view_ip_v4(view->data, view->data_len, 1, &view->quoted) != PACKET_PARSE_OK)
+    {
+        memset(&view->quoted, 0, sizeof(view->quoted));
+        return;
+    }
+
+    // Only the first fragment carries the transport header; RFC 792 guarantees 8 bytes of it
+    const struct ip_v4_view *quoted = &view->quoted;
+    if (quoted->header->protocol != IPPROTO_ICMP || (ntohs(quoted->header->flags_frag_offset) & IP_V4_FRAG_OFFSET_MASK) != 0 ||
+        quoted->payload_len < sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header))
+    {
+        return;
+    }
+
+    view->quoted_icmp = (const struct icmp_v4_header *)quoted->payload;
+    if (view->quoted_icmp->type == ICMP_V4_ECHO_REQUEST)
+    {
+        view->quoted_echo = (const struct icmp_v4_echo_header *)(view->quoted_icmp + 1);
+    }
+}
+
+int packet_parse_icmp_v4(const uint8_t *datagram, size_t length, unsigned int flags, struct icmp_v4_view *view)
+{
+    memset(view, 0, sizeof(struct icmp_v4_view));
+
+    // 1. The IPv4 header, of whatever IHL
+    int rc = packet_parse_ip_v4(datagram, length, flags, &view->ip);
+    if (rc != PACKET_PARSE_OK)
+    {
+        return rc;
+    }
+    if (view->ip.header->protocol != IPPROTO_ICMP || (ntohs(view->ip.header->flags_frag_offset) & IP_V4_FRAG_OFFSET_MASK) != 0)
+    {
+        return PACKET_PARSE_NOT_ICMP;
+    }
+
+    // 2. The ICMP message, checksummed over exactly the bytes the IPv4 header says it carries
+    if (view->ip.payload_len < sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header))
+    {
+        return PACKET_PARSE_TRUNCATED;
+    }
+    view->icmp = (const struct icmp_v4_header *)view->ip.payload;
+    view->icmp_len = view->ip.payload_len;
+    if ((flags & PACKET_PARSE_VERIFY_ICMP) && compute_checksum_fast(view->icmp, view->icmp_len) != 0)
+    {
+        return PACKET_PARSE_BAD_ICMP_CHECKSUM;
+    }
+
+    // 3. Type-specific views; both layouts put 4 bytes of fields after the base header
+    const uint8_t *fields = (const uint8_t *)(view->icmp + 1);
+    view->data = fields + sizeof(struct icmp_v4_echo_header);
+    view->data_len = view->icmp_len - sizeof(struct icmp_v4_header) - sizeof(struct icmp_v4_echo_header);
+    switch (view->icmp->type)
+    {
+    case ICMP_V4_ECHO_REQUEST:
+    case ICMP_V4_ECHO_REPLY:
+        view->echo = (const struct icmp_v4_echo_header *)fields;
+        break;
+    case ICMP_V4_DEST_UNREACHABLE:
+    case ICMP_V4_TIME_EXCEEDED:
+        view->error = (const struct icmp_v4_error_header *)fields;
+        parse_quote_v4(view);
+        break;
+    default:
+        break;
+    }
+
+    return PACKET_PARSE_OK;
+}
+
+/**
+ * @brief Sums the ICMPv6 message with its pseudo-header; a message carrying a valid checksum sums to zero.
+ */
+static uint16_t checksum_v6(const uint8_t *message, size_t length, const struct in6_addr *src, const struct in6_addr *dst)
+{
+    struct ip_v6_pseudo_header pseudo;
+    memset(&pseudo, 0, sizeof(pseudo));
+    memcpy(pseudo.src, src->s6_addr, sizeof(pseudo.src));
+    memcpy(pseudo.dst, dst->s6_addr, sizeof(pseudo.dst));
+    pseudo.upper_layer_length = htonl((uint32_t)length);
+    pseudo.next_header = IP_V6_ICMP_V6;
+
+    return combine_checksum(compute_checksum_fast(&pseudo, sizeof(pseudo)), compute_checksum_fast(message, length));
+}
+
+int packet_parse_icmp_v6(const uint8_t *message, size_t length, const struct in6_addr *src, const struct in6_addr *dst, unsigned int flags, struct icmp_v6_view *view)
+{
+    memset(view, 0, sizeof(struct icmp_v6_view));
+
+    // 1. The ICMPv6 message; every type used here has 4 bytes of fields after the base header
+    if (length < sizeof(struct icmp_v6_header) + sizeof(struct icmp_v6_echo_header))
+    {
+        return PACKET_PARSE_TRUNCATED;
+    }
+    if ((flags & PACKET_PARSE_VERIFY_ICMP) && src && dst && checksum_v6(message, length, src, dst) != 0)
+    {
+        return PACKET_PARSE_BAD_ICMP_CHECKSUM;
+    }
+
+    view->icmp = (const struct icmp_v6_header *)message;
+    view->icmp_len = length;
+    const uint8_t *fields = (const uint8_t *)(view->icmp + 1);
+    view->data = fields + sizeof(struct icmp_v6_echo_header);
+    view->data_len = length - sizeof(struct icmp_v6_header) - sizeof(struct icmp_v6_echo_header);
+
+    // 2. Type-specific views
+    switch (view->icmp->type)
+    {
+    case ICMP_V6_ECHO_REQUEST:
+    case ICMP_V6_ECHO_REPLY:
+        view->echo = (const struct icmp_v6_echo_header *)fields;
+        return PACKET_PARSE_OK;
+    case ICMP_V6_DEST_UNREACHABLE:
+    case ICMP_V6_PACKET_TOO_BIG:
+    case ICMP_V6_TIME_EXCEEDED:
+        view->error = (const struct icmp_v6_error_header *)fields;
+        break;
+    default:
+        return PACKET_PARSE_OK;
+    }
+
+    // 3. The quoted packet: its IPv6 header, then ICMPv6 directly (we never send extension headers)
+    if (view->data_len < sizeof(struct ip_v6_header))
+    {
+        return PACKET_PARSE_OK;
+    }
+    view->quoted = (const struct ip_v6_header *)view->data;
+    if (view->quoted->next_header != IP_V6_ICMP_V6 || view->data_len < sizeof(struct ip_v6_header) + sizeof(struct icmp_v6_header) + sizeof(struct icmp_v6_echo_header))
+    {
+        return PACKET_PARSE_OK;
+    }
+
+    view->quoted_icmp = (const struct icmp_v6_header *)(view->quoted + 1);
+    if (view->quoted_icmp->type == ICMP_V6_ECHO_REQUEST)
+    {
+        view->quoted_echo = (const struct icmp_v6_echo_header *)(view->quoted_icmp + 1);
+    }
+
+    return PACKET_PARSE_OK;
+}
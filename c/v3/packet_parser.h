@@ -0,0 +1,130 @@
+/**
+ * @file packet_parser.h
+ * @brief The inverse of packet_builder.h: validated, zero-copy views of received ICMP and ICMPv6 packets.
+ *
+ * @note Every view points into the caller's buffer; nothing is copied, and a view is only valid while
+ *       that buffer is. Lengths are bounded both by the buffer and by the packet's own length fields,
+ *       so trailing link-layer padding is never mistaken for payload. For error messages
+ *       (Destination Unreachable, Time Exceeded, Packet Too Big), the quoted original datagram is
+ *       parsed as well, down to the Echo fields when the original was one of ours.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PACKET_PARSER_H
+#define PACKET_PARSER_H
+
+#include "icmp_v4.h"
+#include "icmp_v6.h"
+#include "ip_v4.h"
+#include "ip_v6.h"
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Verify the IPv4 header checksum (the kernel already has, for socket deliveries).
+ */
+#define PACKET_PARSE_VERIFY_IP 0x1
+
+/**
+ * @brief Verify the ICMP checksum, or the ICMPv6 checksum over its pseudo-header.
+ */
+#define PACKET_PARSE_VERIFY_ICMP 0x2
+
+/**
+ * @enum packet_parse_result
+ * @brief Why a buffer was rejected.
+ */
+enum packet_parse_result
+{
+    PACKET_PARSE_OK = 0,           /**< Every view was filled */
+    PACKET_PARSE_TRUNCATED,        /**< Shorter than its headers or than its own length fields */
+    PACKET_PARSE_MALFORMED,        /**< Wrong IP version or an IHL below 5 */
+    PACKET_PARSE_NOT_ICMP,         /**< Carries another protocol, or is a non-first fragment */
+    PACKET_PARSE_BAD_IP_CHECKSUM,  /**< IPv4 header checksum mismatch */
+    PACKET_PARSE_BAD_ICMP_CHECKSUM /**< ICMP or ICMPv6 checksum mismatch */
+};
+
+/**
+ * @struct ip_v4_view
+ * @brief An IPv4 header of any IHL and the bytes it carries.
+ */
+struct ip_v4_view
+{
+    const struct ip_v4_header *header; /**< Fixed part of the header */
+    size_t header_len;                 /**< IHL in bytes (20-60) */
+    const uint8_t *options;            /**< Options between the fixed header and the payload (NULL if none) */
+    size_t options_len;                /**< Bytes at @ref options */
+    const uint8_t *payload;            /**< First byte after the header */
+    size_t payload_len;                /**< Payload bytes present (less than the total length says, for quoted datagrams) */
+};
+
+/**
+ * @struct icmp_v4_view
+ * @brief A received IPv4 datagram carrying ICMP.
+ */
+struct icmp_v4_view
+{
+    struct ip_v4_view ip;                          /**< The datagram's own IPv4 header */
+    const struct icmp_v4_header *icmp;             /**< ICMP base header */
+    size_t icmp_len;                               /**< ICMP message bytes (header and data) */
+    const struct icmp_v4_echo_header *echo;        /**< Echo fields of an Echo Request or Reply, else NULL */
+    const uint8_t *data;                           /**< Echo payload, or the quoted datagram of an error */
+    size_t data_len;                               /**< Bytes at @ref data */
+    const struct icmp_v4_error_header *error;      /**< Error fields of a Destination Unreachable or Time Exceeded, else NULL */
+    struct ip_v4_view quoted;                      /**< Quoted original datagram (errors only; `header` NULL otherwise) */
+    const struct icmp_v4_header *quoted_icmp;      /**< Quoted ICMP header, if the original was ICMP and 8 bytes of it are quoted */
+    const struct icmp_v4_echo_header *quoted_echo; /**< Quoted Echo fields, if the original was an Echo Request */
+};
+
+/**
+ * @struct icmp_v6_view
+ * @brief A received ICMPv6 message (raw IPv6 sockets deliver it without the IPv6 header).
+ */
+struct icmp_v6_view
+{
+    const struct icmp_v6_header *icmp;             /**< ICMPv6 base header */
+    size_t icmp_len;                               /**< ICMPv6 message bytes (header and data) */
+    const struct icmp_v6_echo_header *echo;        /**< Echo fields of an Echo Request or Reply, else NULL */
+    const uint8_t *data;                           /**< Echo payload, or the quoted packet of an error */
+    size_t data_len;                               /**< Bytes at @ref data */
+    const struct icmp_v6_error_header *error;      /**< Error fields of a Destination Unreachable, Packet Too Big or Time Exceeded, else NULL */
+    const struct ip_v6_header *quoted;             /**< Quoted original IPv6 header (errors only), else NULL */
+    const struct icmp_v6_header *quoted_icmp;      /**< Quoted ICMPv6 header, if the original carried ICMPv6 directly */
+    const struct icmp_v6_echo_header *quoted_echo; /**< Quoted Echo fields, if the original was an Echo Request */
+};
+
+/**
+ * @brief Validates an IPv4 header, honoring its IHL, and bounds its payload by the total length.
+ * @param datagram Buffer starting at the IPv4 header.
+ * @param length   Bytes at @p datagram.
+ * @param flags    @ref PACKET_PARSE_VERIFY_IP to verify the header checksum.
+ * @param view     Output for the header view.
+ * @return A @ref packet_parse_result.
+ */
+int packet_parse_ip_v4(const uint8_t *datagram, size_t length, unsigned int flags, struct ip_v4_view *view);
+
+/**
+ * @brief Parses an IPv4 datagram carrying ICMP, including the quoted datagram of an error.
+ * @param datagram Buffer starting at the IPv4 header (as delivered by a raw IPv4 socket).
+ * @param length   Bytes at @p datagram.
+ * @param flags    Any of @ref PACKET_PARSE_VERIFY_IP and @ref PACKET_PARSE_VERIFY_ICMP.
+ * @param view     Output for the views.
+ * @return A @ref packet_parse_result.
+ */
+int packet_parse_icmp_v4(const uint8_t *datagram, size_t length, unsigned int flags, struct icmp_v4_view *view);
+
+/**
+ * @brief Parses an ICMPv6 message, including the quoted packet of an error.
+ * @param message Buffer starting at the ICMPv6 header.
+ * @param length  Bytes at @p message.
+ * @param src     Source of the enclosing IPv6 packet (only read to verify the checksum).
+ * @param dst     Destination of the enclosing IPv6 packet (only read to verify the checksum).
+ * @param flags   @ref PACKET_PARSE_VERIFY_ICMP to verify the checksum (needs both addresses; raw IPv6 sockets already have).
+ * @param view    Output for the views.
+ * @return A @ref packet_parse_result.
+ */
+int packet_parse_icmp_v6(const uint8_t *message, size_t length, const struct in6_addr *src, const struct in6_addr *dst, unsigned int flags, struct icmp_v6_view *view);
+
+#endif /* PACKET_PARSER_H */
@@ -0,0 +1,57 @@
+/**
+ * @file packet_pool.h
+ * @brief Preallocated, cache-line-aligned datagram buffers, right-sized for one session's packets.
+ *
+ * @note Each buffer starts on its own cache line, so patching one packet's header never touches the
+ *       line holding a neighbour's. The pool is never zeroed as a whole: the builders write every
+ *       header byte and copy the payload themselves.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Alignment and stride granularity of every buffer (one cache line).
+ */
+#define PACKET_POOL_ALIGNMENT 64
+
+/**
+ * @struct packet_pool
+ * @brief A fixed number of equally sized buffers in one aligned allocation.
+ */
+struct packet_pool
+{
+    uint8_t *memory;   /**< Backing allocation, aligned to @ref PACKET_POOL_ALIGNMENT, or NULL when released */
+    size_t packet_len; /**< Usable bytes per buffer */
+    size_t stride;     /**< Distance between buffers: @ref packet_len rounded up to a whole cache line */
+    uint32_t count;    /**< Number of buffers */
+};
+
+/**
+ * @brief Allocates @p count buffers of @p packet_len bytes each.
+ * @param pool       Pointer to the caller-allocated pool.
+ * @param count      Number of buffers (at least 1).
+ * @param packet_len Bytes per buffer, headers included (at least 1).
+ * @return 0 on success, -1 on invalid sizes or allocation failure (the pool is left empty).
+ */
+int packet_pool_init(struct packet_pool *pool, uint32_t count, size_t packet_len);
+
+/**
+ * @brief Points at buffer @p index.
+ * @param pool  Pointer to an initialized pool.
+ * @param index Buffer index, below `count`.
+ * @return The buffer, valid until the pool is released.
+ */
+uint8_t *packet_pool_buffer(const struct packet_pool *pool, uint32_t index);
+
+/**
+ * @brief Releases the pool's memory. Safe to call on an already released pool.
+ * @param pool Pointer to the pool.
+ */
+void packet_pool_free(struct packet_pool *pool);
+
+#endif /* PACKET_POOL_H */
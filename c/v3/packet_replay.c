@@ -0,0 +1,574 @@
+/**
+ * @file packet_replay.c
+ * @brief Re-sending the IPv4/ICMP datagrams of a pcap or pcapng file at original or scaled timing.
+ *
+ * @author Jim Diroff II
+ */
+#define _GNU_SOURCE /**< Exposes struct mmsghdr */
+
+#include "packet_replay.h"
+#include "icmp_executor.h"
+#include "ip_common.h"
+#include "ip_v4.h"
+#include "timestamp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Classic pcap magics as read in host byte order, for microsecond and nanosecond timestamps.
+ */
+#define PCAP_MAGIC_USEC 0xA1B2C3D4
+#define PCAP_MAGIC_NSEC 0xA1B23C4D
+#define PCAP_FILE_HEADER_LEN 24
+#define PCAP_RECORD_HEADER_LEN 16
+
+/**
+ * @brief pcapng block types and option codes read here.
+ */
+#define PCAPNG_SECTION_HEADER 0x0A0D0D0A
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_INTERFACE_DESCRIPTION 1
+#define PCAPNG_SIMPLE_PACKET 3
+#define PCAPNG_ENHANCED_PACKET 6
+#define PCAPNG_OPT_END 0
+#define PCAPNG_OPT_EPB_FLAGS 2
+#define PCAPNG_OPT_IF_TSRESOL 9
+#define PCAPNG_EPB_INBOUND 1
+
+/**
+ * @brief Link types whose frames are unwrapped here.
+ */
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_LINUX_SLL2 276
+
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_VLAN 0x8100
+#define ETHERTYPE_QINQ 0x88A8
+
+/**
+ * @struct replay_interface
+ * @brief What a pcapng Interface Description Block says about its packets.
+ */
+struct replay_interface
+{
+    uint16_t linktype; /**< LINKTYPE_* of every packet on the interface */
+    uint64_t units;    /**< Timestamp units per second (if_tsresol, 10^6 by default), or 0 if unusable */
+};
+
+/**
+ * @brief Reads a 16-bit field in the file's byte order.
+ */
+static uint16_t read_u16(const uint8_t *p, int swap)
+{
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return swap ? __builtin_bswap16(value) : value;
+}
+
+/**
+ * @brief Reads a 32-bit field in the file's byte order.
+ */
+static uint32_t read_u32(const uint8_t *p, int swap)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return swap ? __builtin_bswap32(value) : value;
+}
+
+/**
+ * @brief Reads a 16-bit field in network byte order.
+ */
+static uint16_t read_be16(const uint8_t *p)
+{
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return ntohs(value);
+}
+
+/**
+ * @brief Converts a timestamp of @p units per second to nanoseconds without overflowing on fine resolutions.
+ */
+static uint64_t to_ns(uint64_t timestamp, uint64_t units)
+{
+    return (timestamp / units) * TIMESTAMP_NS_PER_SEC + (uint64_t)((unsigned __int128)(timestamp % units) * TIMESTAMP_NS_PER_SEC / units);
+}
+
+/**
+ * @brief Strips the link layer off one frame and indexes it if what remains is a whole IPv4 datagram carrying ICMP.
+ * @return 0 on success (kept or skipped), -1 on allocation failure.
+ */
+static int keep_frame(struct packet_replay *replay, uint32_t linktype, const uint8_t *frame, size_t caplen, uint64_t time_ns)
+{
+    replay->frames++;
+
+    // 1. Find the network layer
+    size_t offset = 0;
+    uint16_t ethertype = 0;
+    switch (linktype)
+    {
+    case LINKTYPE_ETHERNET:
+        offset = 14;
+        ethertype = (caplen >= offset) ? read_be16(frame + 12) : 0;
+        if (ethertype == ETHERTYPE_VLAN || ethertype == ETHERTYPE_QINQ)
+        {
+            offset = 18;
+            ethertype = (caplen >= offset) ? read_be16(frame + 16) : 0;
+        }
+        break;
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+        ethertype = ETHERTYPE_IPV4;
+        break;
+    case LINKTYPE_LINUX_SLL:
+        offset = 16;
+        ethertype = (caplen >= offset) ? read_be16(frame + 14) : 0;
+        break;
+    case LINKTYPE_LINUX_SLL2:
+        offset = 20;
+        ethertype = (caplen >= offset) ? read_be16(frame) : 0;
+        break;
+    default:
+        break;
+    }
+
+    // 2. A whole IPv4 datagram (its Total Length within what was captured) whose protocol is ICMP
+    const uint8_t *datagram = frame + offset;
+    size_t available = (caplen > offset) ? caplen - offset : 0;
+    const struct ip_v4_header *ip = (const struct ip_v4_header *)datagram;
+    size_t header_len = (available >= sizeof(struct ip_v4_header)) ? (size_t)(ip->version_ihl & 0x0F) * 4 : 0;
+    size_t total_len = (header_len > 0) ? ntohs(ip->total_length) : 0;
+    if (ethertype != ETHERTYPE_IPV4 || header_len < sizeof(struct ip_v4_header) || (ip->version_ihl >> 4) != 4 || ip->protocol != IP_PROTO_ICMP_V4 ||
+        total_len < header_len || total_len > available || replay->count == UINT32_MAX)
+    {
+        replay->skipped++;
+        return 0;
+    }
+
+    // 3. Index it in place; the mapping outlives the index
+    if (replay->count == replay->capacity)
+    {
+        uint32_t capacity = replay->capacity ? replay->capacity * 2 : 1024;
+        struct packet_replay_datagram *datagrams = realloc(replay->datagrams, (size_t)capacity * sizeof(struct packet_replay_datagram));
+        if (!datagrams)
+        {
+            fprintf(stderr, "Error: Failed to index %u replay datagrams\n", capacity);
+            return -1;
+        }
+        replay->datagrams = datagrams;
+        replay->capacity = capacity;
+    }
+
+    struct packet_replay_datagram *entry = &replay->datagrams[replay->count];
+    entry->data = datagram;
+    entry->length = (uint32_t)total_len;
+    entry->order = replay->count;
+    entry->time_ns = time_ns;
+    replay->count++;
+    return 0;
+}
+
+/**
+ * @brief Indexes a classic pcap file: one global header, then a record header before every packet.
+ * @return 0 on success, -1 on a malformed file or allocation failure.
+ */
+static int load_pcap(struct packet_replay *replay, const char *path, int swap, uint64_t units)
+{
+    const uint8_t *file = replay->map;
+    uint32_t linktype = read_u32(file + 20, swap) & 0xFFFF;
+
+    size_t offset = PCAP_FILE_HEADER_LEN;
+    while (offset + PCAP_RECORD_HEADER_LEN <= replay->map_len)
+    {
+        const uint8_t *record = file + offset;
+        uint64_t seconds = read_u32(record, swap);
+        uint64_t fraction = read_u32(record + 4, swap);
+        uint32_t caplen = read_u32(record + 8, swap);
+        if (caplen > replay->map_len - offset - PCAP_RECORD_HEADER_LEN)
+        {
+            fprintf(stderr, "Error: Capture '%s' is truncated at byte %zu\n", path, offset);
+            return -1;
+        }
+
+        if (keep_frame(replay, linktype, record + PCAP_RECORD_HEADER_LEN, caplen, seconds * TIMESTAMP_NS_PER_SEC + to_ns(fraction, units)) != 0)
+        {
+            return -1;
+        }
+        offset += PCAP_RECORD_HEADER_LEN + caplen;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reads the options of an Interface Description Block for its timestamp resolution.
+ * @return Timestamp units per second, or 0 for a resolution too fine to represent.
+ */
+static uint64_t interface_units(const uint8_t *options, size_t length, int swap)
+{
+    uint64_t units = 1000000;
+    size_t offset = 0;
+    while (offset + 4 <= length)
+    {
+        uint16_t code = read_u16(options + offset, swap);
+        uint16_t option_len = read_u16(options + offset + 2, swap);
+        if (code == PCAPNG_OPT_END || offset + 4 + option_len > length)
+        {
+            break;
+        }
+        if (code == PCAPNG_OPT_IF_TSRESOL && option_len >= 1)
+        {
+            // Top bit set: a negative power of two; clear: a negative power of ten
+            uint8_t resolution = options[offset + 4];
+            uint8_t exponent = resolution & 0x7F;
+            if (resolution & 0x80)
+            {
+                units = (exponent < 64) ? (uint64_t)1 << exponent : 0;
+            }
+            else
+            {
+                units = 1;
+                for (uint8_t i = 0; i < exponent && units != 0; i++)
+                {
+                    units = (units <= UINT64_MAX / 10) ? units * 10 : 0;
+                }
+            }
+        }
+        offset += 4 + (((size_t)option_len + 3) & ~(size_t)3);
+    }
+
+    return units;
+}
+
+/**
+ * @brief Reads the direction out of an Enhanced Packet Block's `epb_flags` option.
+ * @return 1 if the packet is marked inbound, 0 otherwise (including when the option is absent).
+ */
+static int epb_inbound(const uint8_t *options, size_t length, int swap)
+{
+    size_t offset = 0;
+    while (offset + 4 <= length)
+    {
+        uint16_t code = read_u16(options + offset, swap);
+        uint16_t option_len = read_u16(options + offset + 2, swap);
+        if (code == PCAPNG_OPT_END || offset + 4 + option_len > length)
+        {
+            break;
+        }
+        if (code == PCAPNG_OPT_EPB_FLAGS && option_len == 4)
+        {
+            return (read_u32(options + offset + 4, swap) & 0x3) == PCAPNG_EPB_INBOUND;
+        }
+        offset += 4 + (((size_t)option_len + 3) & ~(size_t)3);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Indexes a pcapng file: sections of blocks, each section with its own byte order and interfaces.
+ * @return 0 on success, -1 on a malformed file or allocation failure.
+ */
+static int load_pcapng(struct packet_replay *replay, const char *path)
+{
+    const uint8_t *file = replay->map;
+    struct replay_interface interfaces[PACKET_REPLAY_MAX_INTERFACES];
+    uint32_t interface_count = 0;
+    uint64_t last_ns = 0;
+    int swap = 0;
+
+    size_t offset = 0;
+    while (offset + 12 <= replay->map_len)
+    {
+        const uint8_t *block = file + offset;
+
+        // 1. A section header sets the byte order of everything up to the next one (its type reads the same either way)
+        uint32_t type = read_u32(block, 0);
+        if (type == PCAPNG_SECTION_HEADER)
+        {
+            uint32_t magic = read_u32(block + 8, 0);
+            if (magic != PCAPNG_BYTE_ORDER_MAGIC && magic != __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC))
+            {
+                fprintf(stderr, "Error: Capture '%s' has an invalid section header at byte %zu\n", path, offset);
+                return -1;
+            }
+            swap = (magic != PCAPNG_BYTE_ORDER_MAGIC);
+            interface_count = 0;
+        }
+        else
+        {
+            type = read_u32(block, swap);
+        }
+
+        uint32_t block_len = read_u32(block + 4, swap);
+        if (block_len < 12 || (block_len & 3) != 0 || block_len > replay->map_len - offset)
+        {
+            fprintf(stderr, "Error: Capture '%s' has a malformed block at byte %zu\n", path, offset);
+            return -1;
+        }
+        const uint8_t *body = block + 8;
+        size_t body_len = block_len - 12;
+
+        // 2. Interfaces describe how to read the packets that follow; packets of unusable ones are skipped
+        int rc = 0;
+        if (type == PCAPNG_INTERFACE_DESCRIPTION && body_len >= 8)
+        {
+            if (interface_count < PACKET_REPLAY_MAX_INTERFACES)
+            {
+                interfaces[interface_count].linktype = read_u16(body, swap);
+                interfaces[interface_count].units = interface_units(body + 8, body_len - 8, swap);
+            }
+            interface_count++;
+        }
+        else if (type == PCAPNG_ENHANCED_PACKET && body_len >= 20)
+        {
+            uint32_t interface = read_u32(body, swap);
+            uint64_t timestamp = ((uint64_t)read_u32(body + 4, swap) << 32) | read_u32(body + 8, swap);
+            uint32_t caplen = read_u32(body + 12, swap);
+            size_t padded = ((size_t)caplen + 3) & ~(size_t)3;
+            if (padded > body_len - 20)
+            {
+                fprintf(stderr, "Error: Capture '%s' has a malformed packet block at byte %zu\n", path, offset);
+                return -1;
+            }
+
+            if (interface >= interface_count || interface >= PACKET_REPLAY_MAX_INTERFACES || interfaces[interface].units == 0 ||
+                epb_inbound(body + 20 + padded, body_len - 20 - padded, swap))
+            {
+                replay->frames++;
+                replay->skipped++;
+            }
+            else
+            {
+                last_ns = to_ns(timestamp, interfaces[interface].units);
+                rc = keep_frame(replay, interfaces[interface].linktype, body + 20, caplen, last_ns);
+            }
+        }
+        else if (type == PCAPNG_SIMPLE_PACKET && body_len >= 4)
+        {
+            // No timestamp of its own: it goes out right after the packet before it
+            uint32_t original = read_u32(body, swap);
+            size_t caplen = (original < body_len - 4) ? original : body_len - 4;
+            if (interface_count == 0)
+            {
+                replay->frames++;
+                replay->skipped++;
+            }
+            else
+            {
+                rc = keep_frame(replay, interfaces[0].linktype, body + 4, caplen, last_ns);
+            }
+        }
+
+        if (rc != 0)
+        {
+            return -1;
+        }
+        offset += block_len;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Orders datagrams by capture time, then by position in the file.
+ */
+static int compare_datagrams(const void *a, const void *b)
+{
+    const struct packet_replay_datagram *x = (const struct packet_replay_datagram *)a;
+    const struct packet_replay_datagram *y = (const struct packet_replay_datagram *)b;
+    if (x->time_ns != y->time_ns)
+    {
+        return (x->time_ns < y->time_ns) ? -1 : 1;
+    }
+    return (x->order < y->order) ? -1 : (x->order > y->order);
+}
+
+int packet_replay_load(struct packet_replay *replay, const char *path)
+{
+    memset(replay, 0, sizeof(struct packet_replay));
+
+    // 1. Map the whole file; datagrams are sent straight out of the mapping
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error: Failed to open capture '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < PCAP_FILE_HEADER_LEN)
+    {
+        fprintf(stderr, "Error: Capture '%s' is not a regular file holding a capture header\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Error: Failed to map capture '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    replay->map = (const uint8_t *)map;
+    replay->map_len = (size_t)st.st_size;
+
+    // 2. The magic tells the format, and for classic pcap the byte order and timestamp resolution
+    uint32_t magic = read_u32(replay->map, 0);
+    int rc;
+    if (magic == PCAPNG_SECTION_HEADER)
+    {
+        rc = load_pcapng(replay, path);
+    }
+    else if (magic == PCAP_MAGIC_USEC || magic == __builtin_bswap32(PCAP_MAGIC_USEC))
+    {
+        rc = load_pcap(replay, path, magic != PCAP_MAGIC_USEC, 1000000);
+    }
+    else if (magic == PCAP_MAGIC_NSEC || magic == __builtin_bswap32(PCAP_MAGIC_NSEC))
+    {
+        rc = load_pcap(replay, path, magic != PCAP_MAGIC_NSEC, TIMESTAMP_NS_PER_SEC);
+    }
+    else
+    {
+        fprintf(stderr, "Error: '%s' is neither a pcap nor a pcapng capture\n", path);
+        rc = -1;
+    }
+    if (rc != 0)
+    {
+        packet_replay_free(replay);
+        return -1;
+    }
+
+    // 3. Captures interleave their writers out of order; sending needs capture order, relative to the first datagram
+    if (replay->count > 0)
+    {
+        qsort(replay->datagrams, replay->count, sizeof(struct packet_replay_datagram), compare_datagrams);
+        uint64_t first_ns = replay->datagrams[0].time_ns;
+        for (uint32_t i = 0; i < replay->count; i++)
+        {
+            replay->datagrams[i].time_ns -= first_ns;
+        }
+        replay->span_ns = replay->datagrams[replay->count - 1].time_ns;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Sleeps until CLOCK_MONOTONIC reaches @p deadline_ns.
+ */
+static void wait_until(uint64_t deadline_ns)
+{
+    struct timespec deadline = { .tv_sec = (time_t)(deadline_ns / TIMESTAMP_NS_PER_SEC), .tv_nsec = (long)(deadline_ns % TIMESTAMP_NS_PER_SEC) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+    {
+    }
+}
+
+int packet_replay_run(const struct packet_replay *replay, const struct app_config *config, struct packet_capture_stream *capture, struct packet_replay_result *result)
+{
+    memset(result, 0, sizeof(struct packet_replay_result));
+
+    // 1. One raw socket and one batch of messages, each pointed at a datagram in the mapping when sent
+    int sockfd = icmp_socket_open(AF_INET, config->icmp_v4_identifier, 0);
+    if (sockfd < 0)
+    {
+        return -1;
+    }
+    uint32_t batch = config->batch_size;
+    struct mmsghdr *msgs = calloc(batch, sizeof(struct mmsghdr));
+    struct iovec *iovecs = calloc(batch, sizeof(struct iovec));
+    struct sockaddr_in *addrs = calloc(batch, sizeof(struct sockaddr_in));
+    if (!msgs || !iovecs || !addrs)
+    {
+        fprintf(stderr, "Error: Failed to allocate a replay batch of %u\n", batch);
+        free(msgs);
+        free(iovecs);
+        free(addrs);
+        close(sockfd);
+        return -1;
+    }
+    for (uint32_t i = 0; i < batch; i++)
+    {
+        addrs[i].sin_family = AF_INET;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // 2. Every pass restarts the capture's clock; a datagram is due at its capture offset divided by the speed
+    int status = 0;
+    double speed = config->replay_speed;
+    uint64_t start_ns = timestamp_now_ns();
+    for (uint32_t pass = 0; pass < config->quantity && status == 0; pass++)
+    {
+        uint64_t pass_ns = timestamp_now_ns();
+        uint32_t next = 0;
+        while (next < replay->count)
+        {
+            if (speed > 0)
+            {
+                wait_until(pass_ns + (uint64_t)((double)replay->datagrams[next].time_ns / speed));
+            }
+
+            // 3. Everything due by now leaves in one call (up to the batch size), late or not
+            uint64_t now_ns = timestamp_now_ns();
+            uint32_t count = 0;
+            while (next + count < replay->count && count < batch &&
+                   (speed <= 0 || pass_ns + (uint64_t)((double)replay->datagrams[next + count].time_ns / speed) <= now_ns))
+            {
+                const struct packet_replay_datagram *datagram = &replay->datagrams[next + count];
+                iovecs[count].iov_base = (void *)datagram->data;
+                iovecs[count].iov_len = datagram->length;
+                memcpy(&addrs[count].sin_addr, datagram->data + offsetof(struct ip_v4_header, dst), sizeof(struct in_addr));
+                count++;
+            }
+
+            if (icmp_socket_send_messages(sockfd, msgs, count) != 0)
+            {
+                status = -1;
+                break;
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                result->bytes_sent += iovecs[i].iov_len;
+                if (capture)
+                {
+                    packet_capture_append(capture, now_ns, PACKET_CAPTURE_OUTBOUND, &iovecs[i], 1);
+                }
+            }
+            result->sent += count;
+            result->batches++;
+            next += count;
+        }
+    }
+    result->elapsed_ns = timestamp_now_ns() - start_ns;
+
+    free(msgs);
+    free(iovecs);
+    free(addrs);
+    close(sockfd);
+    return status;
+}
+
+void packet_replay_free(struct packet_replay *replay)
+{
+    if (replay->map)
+    {
+        munmap((void *)replay->map, replay->map_len);
+    }
+    free(replay->datagrams);
+    memset(replay, 0, sizeof(struct packet_replay));
+}
@@ -0,0 +1,93 @@
+/**
+ * @file packet_replay.h
+ * @brief Re-sending the IPv4/ICMP datagrams of a pcap or pcapng file at original or scaled timing.
+ *
+ * @note The file is mapped and indexed once: every frame whose link layer is understood (Ethernet
+ *       with up to one VLAN tag, raw IP, Linux cooked v1/v2) and that holds a whole IPv4 datagram
+ *       carrying ICMP is kept, in timestamp order. Packets a pcapng capture marks as inbound (such
+ *       as the replies in one written by packet_capture.h) are skipped, so replaying a capture
+ *       re-sends only its requests. Datagrams go out unchanged through the raw socket, batched with
+ *       `sendmmsg`: everything due at the same moment leaves in one call.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PACKET_REPLAY_H
+#define PACKET_REPLAY_H
+
+#include "app_config.h"
+#include "packet_capture.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Interfaces a pcapng section may describe; packets of later ones are skipped.
+ */
+#define PACKET_REPLAY_MAX_INTERFACES 64
+
+/**
+ * @struct packet_replay_datagram
+ * @brief One kept datagram, pointing into the mapped file.
+ */
+struct packet_replay_datagram
+{
+    const uint8_t *data; /**< The IPv4 datagram, header first */
+    uint32_t length;     /**< Bytes in the datagram (its Total Length; link-layer padding dropped) */
+    uint32_t order;      /**< Position in the file, to keep equal timestamps in file order */
+    uint64_t time_ns;    /**< Capture time relative to the earliest kept datagram */
+};
+
+/**
+ * @struct packet_replay
+ * @brief An indexed capture file.
+ */
+struct packet_replay
+{
+    const uint8_t *map;                       /**< Read-only mapping of the whole file, or NULL */
+    size_t map_len;                           /**< Bytes mapped */
+    struct packet_replay_datagram *datagrams; /**< Kept datagrams, in timestamp order */
+    uint32_t count;                           /**< Entries in @ref datagrams */
+    uint32_t capacity;                        /**< Allocated entries in @ref datagrams */
+    uint64_t frames;                          /**< Packets read from the file */
+    uint64_t skipped;                         /**< Packets that were inbound, truncated, of another link type or not IPv4/ICMP */
+    uint64_t span_ns;                         /**< Time from the first kept datagram to the last */
+};
+
+/**
+ * @struct packet_replay_result
+ * @brief Totals of one replay.
+ */
+struct packet_replay_result
+{
+    uint64_t sent;       /**< Datagrams handed to the kernel */
+    uint64_t bytes_sent; /**< Their bytes, IP headers included */
+    uint64_t batches;    /**< `sendmmsg` calls made */
+    uint64_t elapsed_ns; /**< Wall time from the first send to the last */
+};
+
+/**
+ * @brief Maps @p path and indexes its IPv4/ICMP datagrams. Classic pcap (either byte order, micro- or
+ *        nanosecond timestamps) and pcapng are recognized by their magic.
+ * @param replay Pointer to the caller-allocated replay.
+ * @param path   Capture file to read.
+ * @return 0 on success (possibly with no datagrams kept), -1 on an unreadable or malformed file (the reason is printed).
+ */
+int packet_replay_load(struct packet_replay *replay, const char *path);
+
+/**
+ * @brief Sends every kept datagram `config->quantity` times over, each pass at the capture's timing divided by `config->replay_speed`.
+ * @param replay  Pointer to a loaded replay with at least one datagram.
+ * @param config  Pointer to the validated application state (batch size, quantity, speed).
+ * @param capture Capture stream the sent datagrams are teed into, or NULL.
+ * @param result  Output for the totals.
+ * @return 0 on success, -1 on socket or transmission failure.
+ */
+int packet_replay_run(const struct packet_replay *replay, const struct app_config *config, struct packet_capture_stream *capture, struct packet_replay_result *result);
+
+/**
+ * @brief Unmaps the file and frees the index. Safe to call on a freed replay.
+ * @param replay Pointer to the replay.
+ */
+void packet_replay_free(struct packet_replay *replay);
+
+#endif /* PACKET_REPLAY_H */
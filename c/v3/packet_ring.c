@@ -0,0 +1,258 @@
+/**
+ * @file packet_ring.c
+ * @brief Memory-mapped AF_PACKET transmit ring (PACKET_MMAP / PACKET_TX_RING).
+ *
+ * @author Jim Diroff II
+ */
+
+#include "packet_ring.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief Offset of the frame's link-layer data from the start of its slot (TPACKET_V2 layout).
+ */
+#define PACKET_RING_DATA_OFFSET (TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+
+/**
+ * @brief How long @ref packet_ring_acquire waits for the kernel to release a frame before giving up.
+ */
+#define PACKET_RING_ACQUIRE_TIMEOUT_MS 5000
+
+/**
+ * @brief Polling step while waiting for a frame to come back.
+ */
+#define PACKET_RING_POLL_MS 10
+
+/**
+ * @brief Returns the TPACKET_V2 header at the start of frame @p index.
+ */
+static struct tpacket2_hdr *frame_header(const struct packet_ring *ring, uint32_t index)
+{
+    uint32_t block = index / ring->frames_per_block;
+    uint32_t slot = index % ring->frames_per_block;
+    return (struct tpacket2_hdr *)(ring->map + ((size_t)block * ring->block_size) + ((size_t)slot * ring->frame_size));
+}
+
+int packet_ring_open(struct packet_ring *ring, const char *ifname, const uint8_t dst_mac[ETHER_ADDR_LEN], uint16_t ethertype, size_t max_packet_len, uint32_t min_frames)
+{
+    memset(ring, 0, sizeof(struct packet_ring));
+    ring->fd = -1;
+    ring->ethertype = ethertype;
+    memcpy(ring->dst_mac, dst_mac, ETHER_ADDR_LEN);
+
+    ring->ifindex = (int)if_nametoindex(ifname);
+    if (ring->ifindex == 0)
+    {
+        fprintf(stderr, "Error: Unknown interface '%s'\n", ifname);
+        return -1;
+    }
+
+    // 1. Protocol 0: this socket only transmits, so it never receives a copy of the traffic
+    ring->fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (ring->fd < 0)
+    {
+        perror("Error: Failed to open AF_PACKET socket");
+        return -1;
+    }
+
+    // 2. Interface properties: hardware address for the frame header, MTU for the size check
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    if (ioctl(ring->fd, SIOCGIFHWADDR, &ifr) < 0)
+    {
+        perror("Error: Failed to read the interface hardware address");
+        packet_ring_close(ring);
+        return -1;
+    }
+    memcpy(ring->src_mac, ifr.ifr_hwaddr.sa_data, ETHER_ADDR_LEN);
+
+    if (ioctl(ring->fd, SIOCGIFMTU, &ifr) < 0)
+    {
+        perror("Error: Failed to read the interface MTU");
+        packet_ring_close(ring);
+        return -1;
+    }
+    ring->mtu = (uint32_t)ifr.ifr_mtu;
+    if (max_packet_len > ring->mtu)
+    {
+        fprintf(stderr, "Error: %zu byte datagrams exceed the %u byte MTU of '%s'\n", max_packet_len, ring->mtu, ifname);
+        packet_ring_close(ring);
+        return -1;
+    }
+
+    // 3. Size the ring: whole frames per block, blocks a power-of-two number of pages
+    int version = TPACKET_V2;
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+    {
+        perror("Error: Failed to select TPACKET_V2");
+        packet_ring_close(ring);
+        return -1;
+    }
+
+    /** Skipping the qdisc layer is an optimization only; older kernels simply keep it */
+    int bypass = 1;
+    setsockopt(ring->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &bypass, sizeof(bypass));
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    ring->frame_size = TPACKET_ALIGN(PACKET_RING_DATA_OFFSET + ETHER_HDR_LEN + max_packet_len);
+    ring->block_size = (uint32_t)page_size;
+    while (ring->block_size < ring->frame_size)
+    {
+        ring->block_size <<= 1;
+    }
+    ring->frames_per_block = ring->block_size / ring->frame_size;
+
+    uint32_t block_count = (min_frames + ring->frames_per_block - 1) / ring->frames_per_block;
+    ring->frame_count = block_count * ring->frames_per_block;
+
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = ring->block_size;
+    req.tp_block_nr = block_count;
+    req.tp_frame_size = ring->frame_size;
+    req.tp_frame_nr = ring->frame_count;
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0)
+    {
+        perror("Error: Failed to create the PACKET_TX_RING");
+        packet_ring_close(ring);
+        return -1;
+    }
+
+    ring->map_len = (size_t)block_count * ring->block_size;
+    void *map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("Error: Failed to map the PACKET_TX_RING");
+        ring->map_len = 0;
+        packet_ring_close(ring);
+        return -1;
+    }
+    ring->map = map;
+
+    // 4. Bind to the interface so every frame leaves through it
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_ifindex = ring->ifindex;
+    if (bind(ring->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("Error: Failed to bind the AF_PACKET socket");
+        packet_ring_close(ring);
+        return -1;
+    }
+
+    // 5. The link-layer header is constant for the whole run: write it once per frame
+    struct ether_header eth;
+    memcpy(eth.ether_dhost, ring->dst_mac, ETHER_ADDR_LEN);
+    memcpy(eth.ether_shost, ring->src_mac, ETHER_ADDR_LEN);
+    eth.ether_type = htons(ethertype);
+    for (uint32_t i = 0; i < ring->frame_count; i++)
+    {
+        memcpy((uint8_t *)frame_header(ring, i) + PACKET_RING_DATA_OFFSET, &eth, sizeof(eth));
+    }
+
+    return 0;
+}
+
+uint8_t *packet_ring_frame_data(const struct packet_ring *ring, uint32_t index)
+{
+    return (uint8_t *)frame_header(ring, index) + PACKET_RING_DATA_OFFSET + ETHER_HDR_LEN;
+}
+
+int packet_ring_acquire(struct packet_ring *ring, uint32_t *index)
+{
+    struct tpacket2_hdr *hdr = frame_header(ring, ring->head);
+
+    int waited_ms = 0;
+    while (1)
+    {
+        uint32_t status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+        if (status == TP_STATUS_AVAILABLE)
+        {
+            break;
+        }
+        if (status & TP_STATUS_WRONG_FORMAT)
+        {
+            fprintf(stderr, "Error: The kernel rejected TX ring frame %u\n", ring->head);
+            return -1;
+        }
+        if (waited_ms >= PACKET_RING_ACQUIRE_TIMEOUT_MS)
+        {
+            fprintf(stderr, "Error: TX ring frame %u was never released by the kernel\n", ring->head);
+            return -1;
+        }
+
+        // The frame is still queued or in flight; make sure it was kicked, then wait for completion
+        if (packet_ring_flush(ring) != 0)
+        {
+            return -1;
+        }
+        struct pollfd pfd = {.fd = ring->fd, .events = POLLOUT};
+        poll(&pfd, 1, PACKET_RING_POLL_MS);
+        waited_ms += PACKET_RING_POLL_MS;
+    }
+
+    *index = ring->head;
+    return 0;
+}
+
+void packet_ring_commit(struct packet_ring *ring, size_t packet_len)
+{
+    struct tpacket2_hdr *hdr = frame_header(ring, ring->head);
+    hdr->tp_len = (uint32_t)(ETHER_HDR_LEN + packet_len);
+
+    // Publish the frame only once its contents are complete
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    ring->head = (ring->head + 1) % ring->frame_count;
+}
+
+int packet_ring_flush(struct packet_ring *ring)
+{
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_ifindex = ring->ifindex;
+    addr.sll_protocol = htons(ring->ethertype);
+    addr.sll_halen = ETHER_ADDR_LEN;
+    memcpy(addr.sll_addr, ring->dst_mac, ETHER_ADDR_LEN);
+
+    while (sendto(ring->fd, NULL, 0, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        perror("Error: Failed to flush the PACKET_TX_RING");
+        return -1;
+    }
+
+    return 0;
+}
+
+void packet_ring_close(struct packet_ring *ring)
+{
+    if (ring->map)
+    {
+        munmap(ring->map, ring->map_len);
+        ring->map = NULL;
+        ring->map_len = 0;
+    }
+
+    if (ring->fd >= 0)
+    {
+        close(ring->fd);
+        ring->fd = -1;
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * @file packet_ring.h
+ * @brief Memory-mapped AF_PACKET transmit ring (PACKET_MMAP / PACKET_TX_RING).
+ *
+ * @note Frames are written once into the shared ring and patched in place, then handed to the
+ *       kernel with a single kick per batch; no per-packet copy from user memory happens.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PACKET_RING_H
+#define PACKET_RING_H
+
+#include <net/ethernet.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Smallest ring the session asks for, so the kernel can drain one batch while the next is patched.
+ */
+#define PACKET_RING_MIN_FRAMES 256
+
+/**
+ * @struct packet_ring
+ * @brief One TX ring bound to a single interface, with a prewritten Ethernet header in every frame.
+ */
+struct packet_ring
+{
+    int fd;                          /**< AF_PACKET socket owning the ring, or -1 when closed */
+    int ifindex;                     /**< Interface the ring transmits on */
+    uint16_t ethertype;              /**< Ethernet type of every frame (host byte order) */
+    uint8_t *map;                    /**< Shared ring memory */
+    size_t map_len;                  /**< Bytes mapped at @ref map */
+    uint32_t block_size;             /**< Bytes per ring block (a power-of-two multiple of the page size) */
+    uint32_t frame_size;             /**< Bytes per frame, header included */
+    uint32_t frames_per_block;       /**< Frames packed into each block */
+    uint32_t frame_count;            /**< Total frames in the ring */
+    uint32_t head;                   /**< Next frame to fill */
+    uint32_t mtu;                    /**< Interface MTU; longer L3 datagrams are rejected at open */
+    uint8_t src_mac[ETHER_ADDR_LEN]; /**< Interface hardware address */
+    uint8_t dst_mac[ETHER_ADDR_LEN]; /**< Next-hop hardware address */
+};
+
+/**
+ * @brief Creates the ring on @p ifname and prewrites the Ethernet header in every frame.
+ * @param ring           Pointer to the caller-allocated ring.
+ * @param ifname         Interface to transmit on (e.g., "eth0").
+ * @param dst_mac        Next-hop hardware address (all zeroes is fine on loopback).
+ * @param ethertype      Ethernet type of every frame (ETHERTYPE_IP or ETHERTYPE_IPV6).
+ * @param max_packet_len Largest L3 datagram that will be placed in a frame.
+ * @param min_frames     Lower bound on the number of frames.
+ * @return 0 on success, -1 on failure (the ring is left closed and the reason printed).
+ */
+int packet_ring_open(struct packet_ring *ring, const char *ifname, const uint8_t dst_mac[ETHER_ADDR_LEN], uint16_t ethertype, size_t max_packet_len, uint32_t min_frames);
+
+/**
+ * @brief Points at the L3 area (just past the Ethernet header) of frame @p index.
+ * @param ring  Pointer to an open ring.
+ * @param index Frame index, below `frame_count`.
+ * @return The frame's datagram memory, valid for as long as the ring is open.
+ */
+uint8_t *packet_ring_frame_data(const struct packet_ring *ring, uint32_t index);
+
+/**
+ * @brief Waits until the frame at the head is back in user ownership.
+ * @param ring  Pointer to an open ring.
+ * @param index Output for the head frame's index.
+ * @return 0 on success, -1 if the kernel rejected a frame or never released it.
+ */
+int packet_ring_acquire(struct packet_ring *ring, uint32_t *index);
+
+/**
+ * @brief Marks the head frame (L3 length @p packet_len) ready to send and advances the head.
+ * @param ring       Pointer to an open ring.
+ * @param packet_len Length of the datagram in the frame, the Ethernet header excluded.
+ */
+void packet_ring_commit(struct packet_ring *ring, size_t packet_len);
+
+/**
+ * @brief Kicks the kernel once to transmit every committed frame.
+ * @param ring Pointer to an open ring.
+ * @return 0 on success, -1 on failure.
+ */
+int packet_ring_flush(struct packet_ring *ring);
+
+/**
+ * @brief Unmaps the ring and closes its socket. Safe to call on an already closed ring.
+ * @param ring Pointer to the ring.
+ */
+void packet_ring_close(struct packet_ring *ring);
+
+#endif /* PACKET_RING_H */
@@ -0,0 +1,214 @@
+/**
+ * @file payload.c
+ * @brief Echo payload generation: text, repeated byte patterns, random fill, mapped files and RTT stamps.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "payload.h"
+#include "probe_cookie.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Maps @p spec's file read-only, truncated to the requested length.
+ * @return 0 on success, -1 on failure.
+ */
+static int map_file(struct payload *payload, const struct payload_spec *spec)
+{
+    int fd = open(spec->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error: Failed to open payload file '%s': %s\n", spec->path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        fprintf(stderr, "Error: Payload file '%s' is not a regular file\n", spec->path);
+        close(fd);
+        return -1;
+    }
+
+    size_t length = (size_t)st.st_size;
+    if (spec->length_set && spec->length < length)
+    {
+        length = spec->length;
+    }
+    if (spec->length_set && spec->length > length)
+    {
+        fprintf(stderr, "Error: Payload file '%s' holds %zu bytes, fewer than the %zu requested\n", spec->path, length, spec->length);
+        close(fd);
+        return -1;
+    }
+
+    // An empty mapping is invalid; an empty file simply yields an empty payload
+    if (length > 0)
+    {
+        payload->map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (payload->map == MAP_FAILED)
+        {
+            payload->map = NULL;
+            fprintf(stderr, "Error: Failed to map payload file '%s': %s\n", spec->path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        payload->map_len = length;
+        payload->data = (const uint8_t *)payload->map;
+    }
+    payload->length = length;
+
+    close(fd); /**< The mapping keeps the file referenced */
+    return 0;
+}
+
+/**
+ * @brief Fills @p length bytes with the splitmix64 sequence from @p seed.
+ */
+static void fill_random(uint8_t *buffer, size_t length, uint64_t seed)
+{
+    uint64_t state = seed;
+    for (size_t i = 0; i < length; i += sizeof(uint64_t))
+    {
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+
+        size_t n = (length - i < sizeof(z)) ? length - i : sizeof(z);
+        memcpy(buffer + i, &z, n);
+    }
+}
+
+int payload_build(struct payload *payload, const struct payload_spec *spec)
+{
+    memset(payload, 0, sizeof(struct payload));
+
+    // 1. Files are used in place, unless a stamp or cookie needs more room than they hold
+    size_t reserved = spec->cookie ? PROBE_COOKIE_SIZE : (spec->stamp ? PAYLOAD_STAMP_SIZE : 0);
+    if (spec->fill == PAYLOAD_FILL_FILE)
+    {
+        if (map_file(payload, spec) != 0)
+        {
+            return -1;
+        }
+        if (payload->length >= reserved)
+        {
+            return 0;
+        }
+    }
+
+    // 2. Everything else is generated into one private buffer
+    size_t length = spec->length_set ? spec->length : spec->pattern_len;
+    if (spec->fill == PAYLOAD_FILL_FILE)
+    {
+        length = payload->length;
+    }
+    size_t buffer_len = (length < reserved) ? reserved : length;
+    if (buffer_len == 0)
+    {
+        return 0;
+    }
+
+    payload->owned = calloc(1, buffer_len);
+    if (!payload->owned)
+    {
+        fprintf(stderr, "Error: Failed to allocate a %zu byte payload\n", buffer_len);
+        payload_free(payload);
+        return -1;
+    }
+
+    if (spec->fill == PAYLOAD_FILL_FILE)
+    {
+        memcpy(payload->owned, payload->data, length);
+    }
+    else if (spec->fill == PAYLOAD_FILL_RANDOM)
+    {
+        fill_random(payload->owned, length, spec->seed);
+    }
+    else if (spec->pattern_len > 0)
+    {
+        for (size_t i = 0; i < length; i += spec->pattern_len)
+        {
+            size_t n = (length - i < spec->pattern_len) ? length - i : spec->pattern_len;
+            memcpy(payload->owned + i, spec->pattern, n);
+        }
+    }
+
+    if (payload->map)
+    {
+        munmap(payload->map, payload->map_len);
+        payload->map = NULL;
+        payload->map_len = 0;
+    }
+    payload->data = payload->owned;
+    payload->length = buffer_len;
+    return 0;
+}
+
+/**
+ * @brief Value of one hex digit, or -1.
+ */
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+int payload_parse_hex(const char *hex, uint8_t *out, size_t *out_len)
+{
+    if (hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X'))
+    {
+        hex += 2;
+    }
+
+    size_t digits = strlen(hex);
+    if (digits == 0 || digits % 2 != 0 || digits / 2 > PAYLOAD_MAX_PATTERN)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < digits / 2; i++)
+    {
+        int high = hex_digit(hex[2 * i]);
+        int low = hex_digit(hex[2 * i + 1]);
+        if (high < 0 || low < 0)
+        {
+            return -1;
+        }
+        out[i] = (uint8_t)((high << 4) | low);
+    }
+
+    *out_len = digits / 2;
+    return 0;
+}
+
+void payload_free(struct payload *payload)
+{
+    if (payload->map)
+    {
+        munmap(payload->map, payload->map_len);
+    }
+    free(payload->owned);
+    memset(payload, 0, sizeof(struct payload));
+}
@@ -0,0 +1,114 @@
+/**
+ * @file payload.h
+ * @brief Echo payload generation: text, repeated byte patterns, random fill, mapped files and RTT stamps.
+ *
+ * @note A payload is produced once, before any template is built; the builders copy it into each
+ *       template exactly once. File payloads are mapped read-only rather than read into the heap.
+ *       With a stamp, the first @ref PAYLOAD_STAMP_SIZE bytes are rewritten per packet instead
+ *       (see @ref payload_stamp), so a reply alone is enough to compute its round trip.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Longest binary pattern accepted by @ref payload_parse_hex.
+ */
+#define PAYLOAD_MAX_PATTERN 64
+
+/**
+ * @brief Marker identifying a @ref payload_stamp ("STMP" in ASCII).
+ */
+#define PAYLOAD_STAMP_MAGIC 0x504D5453U
+
+/**
+ * @struct payload_stamp
+ * @brief Per-packet header at the start of a stamped payload (host byte order; only ever read back by us).
+ */
+struct payload_stamp
+{
+    uint64_t send_ns;    /**< CLOCK_MONOTONIC transmit timestamp */
+    uint32_t magic;      /**< @ref PAYLOAD_STAMP_MAGIC */
+    uint16_t identifier; /**< Echo identifier of the packet, repeated so foreign stamps are rejected */
+    uint16_t sequence;   /**< Echo sequence of the packet */
+};
+
+/**
+ * @brief Bytes a stamp occupies at the start of the payload.
+ */
+#define PAYLOAD_STAMP_SIZE sizeof(struct payload_stamp)
+
+/**
+ * @enum payload_fill
+ * @brief How the payload bytes are produced.
+ */
+enum payload_fill
+{
+    PAYLOAD_FILL_PATTERN = 0, /**< The pattern (text or hex), repeated to the requested length */
+    PAYLOAD_FILL_RANDOM,      /**< Pseudo-random bytes, generated once */
+    PAYLOAD_FILL_FILE         /**< The contents of a file, mapped read-only */
+};
+
+/**
+ * @struct payload_spec
+ * @brief What the command line asked for.
+ */
+struct payload_spec
+{
+    enum payload_fill fill; /**< Source of the bytes */
+    const uint8_t *pattern; /**< Pattern bytes for @ref PAYLOAD_FILL_PATTERN */
+    size_t pattern_len;     /**< Bytes at @ref pattern (0 = zero fill) */
+    const char *path;       /**< File for @ref PAYLOAD_FILL_FILE */
+    size_t length;          /**< Requested payload size */
+    uint8_t length_set;     /**< 1 if @ref length was given; otherwise the pattern or file decides */
+    uint8_t stamp;          /**< 1 to reserve the leading bytes for a @ref payload_stamp */
+    uint8_t cookie;         /**< 1 to reserve the leading bytes for a `probe_cookie` instead (stateless mode) */
+    uint64_t seed;          /**< Seed for @ref PAYLOAD_FILL_RANDOM */
+};
+
+/**
+ * @struct payload
+ * @brief The generated payload and whatever backs it.
+ */
+struct payload
+{
+    const uint8_t *data; /**< Payload bytes (NULL when empty) */
+    size_t length;       /**< Bytes at @ref data */
+    uint8_t *owned;      /**< Heap copy backing @ref data, or NULL */
+    void *map;           /**< File mapping backing @ref data, or NULL */
+    size_t map_len;      /**< Bytes mapped at @ref map */
+};
+
+/**
+ * @brief Produces the payload described by @p spec.
+ *
+ * A pattern without an explicit length is used as-is; a file without one is used whole, and with one
+ * is truncated to it. A stamped payload is zero-padded to at least @ref PAYLOAD_STAMP_SIZE bytes, and
+ * one carrying a cookie to at least `PROBE_COOKIE_SIZE`.
+ *
+ * @param payload Pointer to the caller-allocated payload.
+ * @param spec    Pointer to the requested payload.
+ * @return 0 on success, -1 on failure (the payload is left empty and the reason printed).
+ */
+int payload_build(struct payload *payload, const struct payload_spec *spec);
+
+/**
+ * @brief Parses a hex string such as "deadbeef" (an optional "0x" prefix is allowed) into bytes.
+ * @param hex     The string.
+ * @param out     Output buffer, at least @ref PAYLOAD_MAX_PATTERN bytes.
+ * @param out_len Output for the number of bytes.
+ * @return 0 on success, -1 on an odd length, a non-hex digit or more than @ref PAYLOAD_MAX_PATTERN bytes.
+ */
+int payload_parse_hex(const char *hex, uint8_t *out, size_t *out_len);
+
+/**
+ * @brief Releases the payload's heap copy or file mapping. Safe to call on an empty payload.
+ * @param payload Pointer to the payload.
+ */
+void payload_free(struct payload *payload);
+
+#endif /* PAYLOAD_H */
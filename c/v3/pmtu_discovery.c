@@ -0,0 +1,332 @@
+/**
+ * @file pmtu_discovery.c
+ * @brief Path MTU discovery: pipelined rounds of Don't Fragment Echo Requests that narrow the size range.
+ *
+ * @author Jim Diroff II
+ */
+#include "pmtu_discovery.h"
+#include "icmp_executor.h"
+#include "icmp_receiver.h"
+#include "packet_builder.h"
+#include "packet_parser.h"
+#include "target_list.h"
+#include "timestamp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @enum pmtu_outcome
+ * @brief What became of one probe.
+ */
+enum pmtu_outcome
+{
+    PMTU_PENDING = 0,  /**< Neither answered nor refused yet (a timeout once the round ends) */
+    PMTU_ANSWERED = 1, /**< Echo Reply received: the size fits the path */
+    PMTU_REFUSED = 2   /**< Too big: refused locally or by a router */
+};
+
+/**
+ * @struct pmtu_round
+ * @brief The probes of one round, indexed by their offset from the round's first sequence.
+ */
+struct pmtu_round
+{
+    uint32_t sizes[PMTU_PROBES_PER_ROUND];   /**< Datagram size of each probe */
+    uint8_t outcomes[PMTU_PROBES_PER_ROUND]; /**< A @ref pmtu_outcome per probe */
+    uint32_t count;                          /**< Probes in the round */
+    uint32_t pending;                        /**< Probes still waiting for an answer */
+    uint16_t first_sequence;                 /**< Sequence of probe 0 */
+    uint32_t hint;                           /**< Smallest next-hop MTU reported during the round, or 0 */
+};
+
+/**
+ * @brief Builds a @p size byte DF Echo Request for @p seq and sends it.
+ * @return 0 if sent, 1 if the kernel refused it as larger than the outgoing link (EMSGSIZE), -1 on failure.
+ */
+static int send_probe(int sockfd, const struct app_config *config, uint32_t target, uint8_t *buffer, uint32_t size, uint16_t seq)
+{
+    const struct target_list *targets = config->targets;
+    size_t length;
+    ssize_t sent;
+
+    // The buffer past the headers is never written, so every payload reads back as zeros
+    if (targets->family == AF_INET6)
+    {
+        struct icmp_v6_echo_template tmpl;
+        size_t payload_len = size - sizeof(struct ip_v6_header) - sizeof(struct icmp_v6_header) - sizeof(struct icmp_v6_echo_header);
+        length = build_icmp_v6_echo_template(&tmpl, buffer, size, &config->ip_v6_src, &targets->addrs6[target], config->ip_v4_ttl,
+                                             ICMP_V6_ECHO_CODE, config->icmp_v4_identifier, seq, NULL, payload_len);
+
+        struct sockaddr_in6 addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = targets->addrs6[target];
+        sent = (length > 0) ? sendto(sockfd, buffer, length, 0, (const struct sockaddr *)&addr, sizeof(addr)) : -1;
+    }
+    else
+    {
+        struct icmp_v4_echo_template tmpl;
+        size_t payload_len = size - sizeof(struct ip_v4_header) - sizeof(struct icmp_v4_header) - sizeof(struct icmp_v4_echo_header);
+        length = build_icmp_v4_echo_template(&tmpl, buffer, size, config->ip_v4_src, targets->addrs[target], config->ip_v4_ttl,
+                                             ICMP_V4_ECHO_REQUEST, ICMP_V4_ECHO_CODE, config->icmp_v4_identifier, seq, IP_V4_FLAG_DF, NULL, payload_len);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr = targets->addrs[target];
+        sent = (length > 0) ? sendto(sockfd, buffer, length, 0, (const struct sockaddr *)&addr, sizeof(addr)) : -1;
+    }
+
+    if (length == 0)
+    {
+        fprintf(stderr, "Error: Failed to build a %u byte probe\n", size);
+        return -1;
+    }
+    if (sent < 0 && errno == EMSGSIZE)
+    {
+        return 1;
+    }
+    if (sent < 0)
+    {
+        perror("Error: Failed to send probe");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Resolves the probe carrying @p seq, if it belongs to the round and is still pending.
+ */
+static void resolve(struct pmtu_round *round, uint16_t seq, uint8_t outcome)
+{
+    uint16_t index = (uint16_t)(seq - round->first_sequence);
+    if (index < round->count && round->outcomes[index] == PMTU_PENDING)
+    {
+        round->outcomes[index] = outcome;
+        round->pending--;
+    }
+}
+
+/**
+ * @brief Applies one received datagram (IPv4, header included) or ICMPv6 message from @p src6 to the round.
+ */
+static void receive_one(struct pmtu_round *round, const struct app_config *config, uint32_t target, const uint8_t *data, size_t length, const struct in6_addr *src6)
+{
+    const struct target_list *targets = config->targets;
+    struct icmp_error error;
+
+    // 1. Echo Replies from the target itself (our own reflected requests carry the request type)
+    if (targets->family == AF_INET6)
+    {
+        struct icmp_v6_view view;
+        if (packet_parse_icmp_v6(data, length, NULL, NULL, 0, &view) == PACKET_PARSE_OK && view.icmp->type == ICMP_V6_ECHO_REPLY &&
+            ntohs(view.echo->identifier) == config->icmp_v4_identifier && memcmp(src6, &targets->addrs6[target], sizeof(struct in6_addr)) == 0)
+        {
+            resolve(round, ntohs(view.echo->sequence), PMTU_ANSWERED);
+            return;
+        }
+        if (!icmp_parse_error_v6(data, length, src6, &error) || memcmp(&error.original6, &targets->addrs6[target], sizeof(struct in6_addr)) != 0)
+        {
+            return;
+        }
+    }
+    else
+    {
+        struct icmp_v4_view view;
+        if (packet_parse_icmp_v4(data, length, PACKET_PARSE_VERIFY_ICMP, &view) == PACKET_PARSE_OK && view.icmp->type == ICMP_V4_ECHO_REPLY &&
+            ntohs(view.echo->identifier) == config->icmp_v4_identifier && view.ip.header->src == targets->addrs[target].s_addr)
+        {
+            resolve(round, ntohs(view.echo->sequence), PMTU_ANSWERED);
+            return;
+        }
+        if (!icmp_parse_error_v4(data, length, &error) || error.original.s_addr != targets->addrs[target].s_addr)
+        {
+            return;
+        }
+    }
+
+    // 2. Errors about our probes: only "too big" says anything about the size; anything else is a failure
+    if (error.identifier != config->icmp_v4_identifier)
+    {
+        return;
+    }
+    uint8_t too_big = (error.type == ICMP_V6_PACKET_TOO_BIG && targets->family == AF_INET6) ||
+                      (error.type == ICMP_V4_DEST_UNREACHABLE && error.code == ICMP_V4_FRAG_NEEDED && targets->family == AF_INET);
+    if (too_big && error.mtu > 0 && (round->hint == 0 || error.mtu < round->hint))
+    {
+        round->hint = error.mtu;
+    }
+    resolve(round, error.sequence, PMTU_REFUSED);
+}
+
+/**
+ * @brief Reads answers until every probe of the round is resolved or @p deadline_ns passes.
+ * @return 0 on success, -1 on socket failure.
+ */
+static int collect(int sockfd, struct pmtu_round *round, const struct app_config *config, uint32_t target, uint8_t *buffer, size_t capacity, uint64_t deadline_ns)
+{
+    while (round->pending > 0)
+    {
+        uint64_t now_ns = timestamp_now_ns();
+        if (now_ns >= deadline_ns)
+        {
+            return 0;
+        }
+
+        struct pollfd pfd = {.fd = sockfd, .events = POLLIN};
+        int timeout_ms = (int)((deadline_ns - now_ns + TIMESTAMP_NS_PER_MSEC - 1) / TIMESTAMP_NS_PER_MSEC);
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0 && errno != EINTR)
+        {
+            perror("Error: poll failed");
+            return -1;
+        }
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        struct sockaddr_in6 sender;
+        socklen_t sender_len = sizeof(sender);
+        ssize_t n = recvfrom(sockfd, buffer, capacity, MSG_DONTWAIT, (struct sockaddr *)&sender, &sender_len);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            continue;
+        }
+        if (n < 0)
+        {
+            perror("Error: Failed to receive packet");
+            return -1;
+        }
+        receive_one(round, config, target, buffer, (size_t)n, &sender.sin6_addr);
+    }
+
+    return 0;
+}
+
+int pmtu_discover(const struct app_config *config, uint32_t target, uint32_t max_size, struct pmtu_result *result)
+{
+    memset(result, 0, sizeof(struct pmtu_result));
+    const struct target_list *targets = config->targets;
+    uint8_t v6 = (targets->family == AF_INET6);
+
+    // 1. The search range: the family's minimum MTU is assumed until a reply confirms it
+    uint32_t lo = v6 ? IP_V6_MIN_LINK_MTU : IP_V4_MIN_MTU;
+    uint32_t hi = max_size;
+    uint8_t confirmed = 0;
+    if (hi < lo)
+    {
+        fprintf(stderr, "Error: Maximum probe size %u is below the minimum MTU of %u\n", hi, lo);
+        return -1;
+    }
+
+    int sockfd = icmp_socket_open(targets->family, config->icmp_v4_identifier, 1);
+    uint8_t *packet = calloc(1, max_size);
+    uint8_t *incoming = malloc(IP_V4_MAX_PACKET_SIZE);
+    if (sockfd < 0 || !packet || !incoming)
+    {
+        if (sockfd >= 0)
+        {
+            fprintf(stderr, "Error: Failed to allocate the probe buffers\n");
+            close(sockfd);
+        }
+        free(packet);
+        free(incoming);
+        return -1;
+    }
+
+    // A whole round of maximum-size replies (and, on IPv4, our reflected requests) must fit in the queue at once
+    int rcvbuf = (int)((size_t)PMTU_PROBES_PER_ROUND * 2 * (max_size + IP_V6_BASE_HEADER_LENGTH));
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) != 0 &&
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) != 0)
+    {
+        fprintf(stderr, "Warning: Failed to enlarge the receive buffer; large replies may be dropped\n");
+    }
+
+    int rc = 0;
+    uint16_t seq = config->icmp_v4_sequence;
+    while ((hi > lo || !confirmed) && result->rounds < PMTU_MAX_ROUNDS)
+    {
+        // 2. Spread the probes evenly over (lo, hi], hi itself last; the first round also confirms lo
+        struct pmtu_round round;
+        memset(&round, 0, sizeof(round));
+        round.first_sequence = seq;
+        if (!confirmed)
+        {
+            round.sizes[round.count++] = lo;
+        }
+        uint32_t span = hi - lo;
+        uint32_t steps = PMTU_PROBES_PER_ROUND - round.count;
+        steps = (span < steps) ? span : steps;
+        for (uint32_t i = 1; i <= steps; i++)
+        {
+            round.sizes[round.count++] = lo + (uint32_t)(((uint64_t)span * i + steps - 1) / steps);
+        }
+
+        // 3. Send the whole round back-to-back; a size the local link refuses needs no round trip
+        for (uint32_t i = 0; i < round.count && rc == 0; i++)
+        {
+            int sent = send_probe(sockfd, config, target, packet, round.sizes[i], (uint16_t)(seq + i));
+            if (sent < 0)
+            {
+                rc = -1;
+            }
+            round.outcomes[i] = (sent == 1) ? PMTU_REFUSED : PMTU_PENDING;
+            round.pending += (sent == 0);
+        }
+        seq = (uint16_t)(seq + round.count);
+        result->probes += round.count;
+        result->rounds++;
+        if (rc != 0 || collect(sockfd, &round, config, target, incoming, IP_V4_MAX_PACKET_SIZE,
+                              timestamp_now_ns() + (uint64_t)config->reply_timeout_ms * TIMESTAMP_NS_PER_MSEC) != 0)
+        {
+            rc = -1;
+            break;
+        }
+
+        // 4. Narrow: the largest answer is the new floor; the smallest refusal or timeout caps the ceiling
+        for (uint32_t i = 0; i < round.count; i++)
+        {
+            if (round.outcomes[i] == PMTU_ANSWERED && round.sizes[i] >= lo)
+            {
+                lo = round.sizes[i];
+                confirmed = 1;
+            }
+        }
+        for (uint32_t i = 0; i < round.count; i++)
+        {
+            if (round.outcomes[i] != PMTU_ANSWERED && round.sizes[i] > lo && round.sizes[i] - 1 < hi)
+            {
+                hi = round.sizes[i] - 1;
+            }
+        }
+        if (round.hint > 0)
+        {
+            result->hint = (result->hint == 0 || round.hint < result->hint) ? round.hint : result->hint;
+            hi = (round.hint < hi) ? round.hint : hi;
+        }
+        hi = (hi < lo) ? lo : hi;
+
+        if (!confirmed)
+        {
+            char dst[TARGET_LIST_ADDRSTRLEN];
+            target_list_format(targets, target, dst, sizeof(dst));
+            fprintf(stderr, "Error: No Echo Reply from %s, not even at %u bytes\n", dst, lo);
+            rc = -1;
+            break;
+        }
+    }
+
+    result->mtu = lo;
+    free(packet);
+    free(incoming);
+    close(sockfd);
+    return rc;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file pmtu_discovery.h
+ * @brief Path MTU discovery: pipelined rounds of Don't Fragment Echo Requests that narrow the size range.
+ *
+ * @note Instead of a sequential ladder (one size per round trip), every round sends up to
+ *       @ref PMTU_PROBES_PER_ROUND probes at once, spread evenly over the sizes still in doubt.
+ *       A reply raises the lower bound, and a local EMSGSIZE, an ICMP "fragmentation needed" / Packet
+ *       Too Big or a timeout lowers the upper one. A reported next-hop MTU caps the upper bound
+ *       directly. Each round divides the range by the probe count, so even a 65535-byte range
+ *       settles in four round trips.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PMTU_DISCOVERY_H
+#define PMTU_DISCOVERY_H
+
+#include "app_config.h"
+
+#include <stdint.h>
+
+/**
+ * @brief Probes in flight per round.
+ */
+#define PMTU_PROBES_PER_ROUND 16
+
+/**
+ * @brief Safety cap on rounds; the range normally collapses long before.
+ */
+#define PMTU_MAX_ROUNDS 32
+
+/**
+ * @struct pmtu_result
+ * @brief Outcome of one discovery.
+ */
+struct pmtu_result
+{
+    uint32_t mtu;    /**< Largest datagram (IP header included) that was answered */
+    uint32_t rounds; /**< Round trips the discovery took */
+    uint32_t probes; /**< Echo Requests sent */
+    uint32_t hint;   /**< Smallest next-hop MTU a router reported, or 0 */
+};
+
+/**
+ * @brief Discovers the path MTU to target @p target, between the family's minimum MTU and @p max_size.
+ *
+ * Probes use the configured source, TTL, identifier and first sequence, always with DF set, and wait
+ * `reply_timeout_ms` per round. Their payload is zero-filled to the probed size.
+ *
+ * @param config   Pointer to the application configuration (its target list selects the family).
+ * @param target   Index of the destination in the target list.
+ * @param max_size Largest datagram to try (IP header included).
+ * @param result   Output for the discovered MTU and counters.
+ * @return 0 on success, -1 if the socket failed or not even the minimum size was answered.
+ */
+int pmtu_discover(const struct app_config *config, uint32_t target, uint32_t max_size, struct pmtu_result *result);
+
+#endif /* PMTU_DISCOVERY_H */
@@ -0,0 +1,158 @@
+/**
+ * @file probe_cookie.c
+ * @brief Stateless probing: SipHash cookies that let a reply be validated and timed from its contents alone.
+ *
+ * @author Jim Diroff II
+ */
+#include "probe_cookie.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/random.h>
+
+/**
+ * @brief Bytes of MAC input: a 16-byte address field (IPv4 zero-padded), send time, target and identifier.
+ */
+#define PROBE_COOKIE_MESSAGE_SIZE 30
+
+int probe_cookie_key_init(struct probe_cookie_key *key)
+{
+    uint8_t bytes[16];
+    size_t filled = 0;
+    while (filled < sizeof(bytes))
+    {
+        ssize_t rc = getrandom(bytes + filled, sizeof(bytes) - filled, 0);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("Error: Failed to draw the cookie key");
+            return -1;
+        }
+        filled += (size_t)rc;
+    }
+
+    memcpy(&key->k0, bytes, sizeof(key->k0));
+    memcpy(&key->k1, bytes + 8, sizeof(key->k1));
+    return 0;
+}
+
+/**
+ * @brief Rotates @p x left by @p b bits.
+ */
+static inline uint64_t rotl(uint64_t x, int b)
+{
+    return (x << b) | (x >> (64 - b));
+}
+
+/**
+ * @brief One SipRound over the four state words.
+ */
+#define SIPROUND(v0, v1, v2, v3) \
+    do                           \
+    {                            \
+        v0 += v1;                \
+        v1 = rotl(v1, 13);       \
+        v1 ^= v0;                \
+        v0 = rotl(v0, 32);       \
+        v2 += v3;                \
+        v3 = rotl(v3, 16);       \
+        v3 ^= v2;                \
+        v0 += v3;                \
+        v3 = rotl(v3, 21);       \
+        v3 ^= v0;                \
+        v2 += v1;                \
+        v1 = rotl(v1, 17);       \
+        v1 ^= v2;                \
+        v2 = rotl(v2, 32);       \
+    } while (0)
+
+/**
+ * @brief Reads 8 little-endian bytes, whatever the host byte order.
+ */
+static inline uint64_t load_le64(const uint8_t *p)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+uint64_t probe_cookie_siphash(const struct probe_cookie_key *key, const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    // 1. Initialization: the key XORed into the "somepseudorandomlygeneratedbytes" constants
+    uint64_t v0 = key->k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = key->k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = key->k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = key->k1 ^ 0x7465646279746573ULL;
+
+    // 2. Compression: two rounds per full 8-byte word
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t m = load_le64(bytes + i);
+        v3 ^= m;
+        SIPROUND(v0, v1, v2, v3);
+        SIPROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    // 3. The last word holds the remaining bytes and the message length in its top byte
+    uint64_t last = (uint64_t)length << 56;
+    for (size_t j = 0; i + j < length; j++)
+    {
+        last |= (uint64_t)bytes[i + j] << (8 * j);
+    }
+    v3 ^= last;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= last;
+
+    // 4. Finalization: four rounds
+    v2 ^= 0xff;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/**
+ * @brief MAC over everything a reply must agree on: who was probed, by which session, when and as which target.
+ */
+static uint64_t cookie_mac(const struct probe_cookie_key *key, const void *addr, size_t addr_len, uint16_t identifier, uint32_t target, uint64_t send_ns)
+{
+    uint8_t message[PROBE_COOKIE_MESSAGE_SIZE];
+    memset(message, 0, sizeof(message));
+    memcpy(message, addr, (addr_len < 16) ? addr_len : 16);
+    memcpy(message + 16, &send_ns, sizeof(send_ns));
+    memcpy(message + 24, &target, sizeof(target));
+    memcpy(message + 28, &identifier, sizeof(identifier));
+
+    return probe_cookie_siphash(key, message, sizeof(message));
+}
+
+uint16_t probe_cookie_make(const struct probe_cookie_key *key, const void *addr, size_t addr_len, uint16_t identifier, uint32_t target, uint64_t send_ns,
+                           struct probe_cookie *cookie)
+{
+    uint64_t mac = cookie_mac(key, addr, addr_len, identifier, target, send_ns);
+
+    cookie->send_ns = send_ns;
+    cookie->target = target;
+    cookie->tag = (uint32_t)(mac >> 32);
+    return (uint16_t)mac;
+}
+
+int probe_cookie_check(const struct probe_cookie_key *key, const void *addr, size_t addr_len, uint16_t identifier, uint16_t sequence, const struct probe_cookie *cookie)
+{
+    uint64_t mac = cookie_mac(key, addr, addr_len, identifier, cookie->target, cookie->send_ns);
+    return (uint16_t)mac == sequence && (uint32_t)(mac >> 32) == cookie->tag;
+}
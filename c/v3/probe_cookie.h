@@ -0,0 +1,91 @@
+/**
+ * @file probe_cookie.h
+ * @brief Stateless probing: SipHash cookies that let a reply be validated and timed from its contents alone.
+ *
+ * @note With an in-flight table, every outstanding probe holds a slot until it is answered or
+ *       expires. A cookie moves that state into the probe itself: the payload carries the send time
+ *       and target index, and a keyed SipHash-2-4 of the destination, identifier, target and send time
+ *       is split between the Echo sequence (16 bits) and the payload (32 bits). A reply that echoes a
+ *       cookie whose MAC verifies was provably caused by one of our requests to that destination, so
+ *       memory stays constant however many probes are outstanding.
+ *
+ *       The key is drawn from the kernel's CSPRNG once per run, so cookies cannot be forged by hosts
+ *       that never saw a request, nor replayed into a later run.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef PROBE_COOKIE_H
+#define PROBE_COOKIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @struct probe_cookie_key
+ * @brief The 128-bit SipHash key of a run.
+ */
+struct probe_cookie_key
+{
+    uint64_t k0; /**< Key bytes 0-7 (little-endian) */
+    uint64_t k1; /**< Key bytes 8-15 (little-endian) */
+};
+
+/**
+ * @struct probe_cookie
+ * @brief Per-packet header at the start of a cookie payload (host byte order; only ever read back by us).
+ */
+struct probe_cookie
+{
+    uint64_t send_ns; /**< CLOCK_MONOTONIC transmit timestamp */
+    uint32_t target;  /**< Index of the destination in the sender's target list */
+    uint32_t tag;     /**< High 32 bits of the MAC; the low 16 travel as the Echo sequence */
+};
+
+/**
+ * @brief Bytes a cookie occupies at the start of the payload.
+ */
+#define PROBE_COOKIE_SIZE sizeof(struct probe_cookie)
+
+/**
+ * @brief Draws a fresh key from getrandom(2).
+ * @param key Output for the key.
+ * @return 0 on success, -1 if the kernel could not supply random bytes.
+ */
+int probe_cookie_key_init(struct probe_cookie_key *key);
+
+/**
+ * @brief SipHash-2-4 of @p length bytes at @p data.
+ * @param key    The key.
+ * @param data   Message bytes.
+ * @param length Bytes at @p data.
+ * @return The 64-bit MAC.
+ */
+uint64_t probe_cookie_siphash(const struct probe_cookie_key *key, const void *data, size_t length);
+
+/**
+ * @brief Fills the cookie for one probe and returns the sequence it must be sent with.
+ * @param key        The run's key.
+ * @param addr       Destination address (4 or 16 bytes, Network Byte Order).
+ * @param addr_len   Bytes at @p addr.
+ * @param identifier Echo identifier of the probe (host byte order).
+ * @param target     Index of the destination in the target list.
+ * @param send_ns    Transmit timestamp.
+ * @param cookie     Output for the payload cookie.
+ * @return The Echo sequence (host byte order).
+ */
+uint16_t probe_cookie_make(const struct probe_cookie_key *key, const void *addr, size_t addr_len, uint16_t identifier, uint32_t target, uint64_t send_ns,
+                           struct probe_cookie *cookie);
+
+/**
+ * @brief Verifies a cookie echoed back by @p addr.
+ * @param key        The run's key.
+ * @param addr       Source of the reply (4 or 16 bytes, Network Byte Order), i.e. the probed destination.
+ * @param addr_len   Bytes at @p addr.
+ * @param identifier Echo identifier of the reply (host byte order).
+ * @param sequence   Echo sequence of the reply (host byte order).
+ * @param cookie     Cookie copied out of the reply's payload.
+ * @return 1 if the reply answers a probe this key produced for @p addr, 0 otherwise.
+ */
+int probe_cookie_check(const struct probe_cookie_key *key, const void *addr, size_t addr_len, uint16_t identifier, uint16_t sequence, const struct probe_cookie *cookie);
+
+#endif /* PROBE_COOKIE_H */
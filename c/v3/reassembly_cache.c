@@ -0,0 +1,369 @@
+/**
+ * @file reassembly_cache.c
+ * @brief Bounded IPv4 / IPv6 fragment reassembly for replies that bypass the kernel stack.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "reassembly_cache.h"
+#include "checksum.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Outcome of adding a fragment's range to a slot.
+ */
+enum reassembly_insert
+{
+    REASSEMBLY_INSERT_NEW = 0,   /**< New bytes; copy them into the slab */
+    REASSEMBLY_INSERT_DUPLICATE, /**< Already covered by an identical or wider range; ignore it */
+    REASSEMBLY_INSERT_REJECT     /**< Inconsistent with what was received; drop the slot */
+};
+
+int reassembly_cache_init(struct reassembly_cache *cache, uint32_t capacity, uint64_t timeout_ns)
+{
+    memset(cache, 0, sizeof(struct reassembly_cache));
+    cache->capacity = capacity;
+    cache->timeout_ns = timeout_ns;
+
+    cache->slots = calloc(capacity, sizeof(struct reassembly_slot));
+    cache->slabs = malloc((size_t)capacity * REASSEMBLY_CACHE_SLAB_SIZE);
+    if (!cache->slots || !cache->slabs)
+    {
+        fprintf(stderr, "Error: Failed to allocate the reassembly cache\n");
+        reassembly_cache_close(cache);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+        cache->slots[i].slab = cache->slabs + (size_t)i * REASSEMBLY_CACHE_SLAB_SIZE;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Returns the slot holding @p key, claiming one (free, else the oldest) if none does.
+ *
+ * Every expired slot passed on the way is reclaimed, so stale fragments never outlive their
+ * timeout by more than one lookup.
+ */
+static struct reassembly_slot *find_slot(struct reassembly_cache *cache, const struct reassembly_key *key, uint64_t now_ns)
+{
+    struct reassembly_slot *free_slot = NULL;
+    struct reassembly_slot *oldest = NULL;
+
+    for (uint32_t i = 0; i < cache->capacity; i++)
+    {
+        struct reassembly_slot *slot = &cache->slots[i];
+        if (slot->in_use && slot->deadline_ns <= now_ns)
+        {
+            slot->in_use = 0;
+            cache->expired++;
+        }
+
+        if (!slot->in_use)
+        {
+            free_slot = free_slot ? free_slot : slot;
+            continue;
+        }
+        if (memcmp(&slot->key, key, sizeof(struct reassembly_key)) == 0)
+        {
+            return slot;
+        }
+        if (!oldest || slot->deadline_ns < oldest->deadline_ns)
+        {
+            oldest = slot;
+        }
+    }
+
+    struct reassembly_slot *slot = free_slot;
+    if (!slot)
+    {
+        slot = oldest;
+        cache->displaced++;
+    }
+
+    slot->key = *key;
+    slot->deadline_ns = now_ns + cache->timeout_ns;
+    slot->total = 0;
+    slot->header_len = 0;
+    slot->interval_count = 0;
+    slot->in_use = 1;
+    return slot;
+}
+
+/**
+ * @brief Records `[start, end)` as received, merging it with the ranges it touches.
+ * @param slot  The slot.
+ * @param start First byte of the fragment within the fragmentable part.
+ * @param end   One past its last byte.
+ * @param last  1 if the fragment is the last one (its end is the datagram's length).
+ * @return A @ref reassembly_insert value.
+ */
+static int insert_interval(struct reassembly_slot *slot, uint32_t start, uint32_t end, int last)
+{
+    struct reassembly_interval *intervals = slot->intervals;
+    uint32_t count = slot->interval_count;
+
+    // 1. The length is fixed by the last fragment; nothing may disagree with it
+    if (last)
+    {
+        if ((slot->total != 0 && slot->total != end) || (count > 0 && intervals[count - 1].end > end))
+        {
+            return REASSEMBLY_INSERT_REJECT;
+        }
+    }
+    else if (slot->total != 0 && end >= slot->total)
+    {
+        return REASSEMBLY_INSERT_REJECT;
+    }
+
+    // 2. An exact retransmission is harmless; any other overlap is rejected (RFC 5722)
+    uint32_t at = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (start < intervals[i].end && end > intervals[i].start)
+        {
+            return (start >= intervals[i].start && end <= intervals[i].end) ? REASSEMBLY_INSERT_DUPLICATE : REASSEMBLY_INSERT_REJECT;
+        }
+        if (intervals[i].end <= start)
+        {
+            at = i + 1;
+        }
+    }
+
+    // 3. Merge with the neighbours it touches, else open a new range (bounded, so holes cannot pile up)
+    int merge_left = at > 0 && intervals[at - 1].end == start;
+    int merge_right = at < count && intervals[at].start == end;
+    if (merge_left && merge_right)
+    {
+        intervals[at - 1].end = intervals[at].end;
+        memmove(&intervals[at], &intervals[at + 1], (count - at - 1) * sizeof(struct reassembly_interval));
+        count--;
+    }
+    else if (merge_left)
+    {
+        intervals[at - 1].end = end;
+    }
+    else if (merge_right)
+    {
+        intervals[at].start = start;
+    }
+    else
+    {
+        if (count == REASSEMBLY_CACHE_MAX_INTERVALS)
+        {
+            return REASSEMBLY_INSERT_REJECT;
+        }
+        memmove(&intervals[at + 1], &intervals[at], (count - at) * sizeof(struct reassembly_interval));
+        intervals[at].start = start;
+        intervals[at].end = end;
+        count++;
+    }
+
+    slot->interval_count = (uint8_t)count;
+    if (last)
+    {
+        slot->total = end;
+    }
+    return REASSEMBLY_INSERT_NEW;
+}
+
+/**
+ * @brief Whether one range covers the whole fragmentable part, now that its length is known.
+ */
+static int slot_complete(const struct reassembly_slot *slot)
+{
+    return slot->total != 0 && slot->interval_count == 1 && slot->intervals[0].start == 0 && slot->intervals[0].end == slot->total;
+}
+
+/**
+ * @brief Files one fragment's bytes under its slot.
+ * @return A @ref reassembly_insert value; on @ref REASSEMBLY_INSERT_REJECT the slot has been released.
+ */
+static int add_fragment(struct reassembly_cache *cache, struct reassembly_slot *slot, const uint8_t *data, uint32_t start, uint32_t length, int last)
+{
+    int rc = insert_interval(slot, start, start + length, last);
+    if (rc == REASSEMBLY_INSERT_REJECT)
+    {
+        slot->in_use = 0;
+        cache->dropped++;
+        return rc;
+    }
+    if (rc == REASSEMBLY_INSERT_NEW)
+    {
+        memcpy(slot->slab + REASSEMBLY_CACHE_HEADER_SPACE + start, data, length);
+    }
+
+    return rc;
+}
+
+int reassembly_cache_add_v4(struct reassembly_cache *cache, const uint8_t *datagram, size_t length, uint64_t now_ns, const uint8_t **out, size_t *out_len)
+{
+    // 1. A well-formed fragment: valid header, every non-last fragment a multiple of 8 bytes
+    const struct ip_v4_header *ip = (const struct ip_v4_header *)datagram;
+    if (length < sizeof(struct ip_v4_header) || (ip->version_ihl >> 4) != IP_V4)
+    {
+        cache->dropped++;
+        return -1;
+    }
+
+    size_t header_len = (size_t)(ip->version_ihl & 0x0F) * 4;
+    size_t total_length = ntohs(ip->total_length);
+    uint16_t field = ntohs(ip->flags_frag_offset);
+    uint32_t start = (uint32_t)(field & IP_V4_FRAG_OFFSET_MASK) * 8;
+    int last = !(field & IP_V4_FLAG_MF);
+    if (header_len < IP_V4_MIN_IHL * 4 || total_length <= header_len || total_length > length || !ip_v4_is_fragment(field) ||
+        compute_checksum_fast(datagram, header_len) != 0)
+    {
+        cache->dropped++;
+        return -1;
+    }
+
+    uint32_t data_len = (uint32_t)(total_length - header_len);
+    if ((!last && (data_len % 8) != 0) || start + data_len > IP_V4_MAX_PACKET_SIZE - IP_V4_MIN_IHL * 4)
+    {
+        cache->dropped++;
+        return -1;
+    }
+
+    // 2. Find the datagram's slot and file the bytes; the first fragment also supplies the header
+    struct reassembly_key key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.src, &ip->src, sizeof(ip->src));
+    memcpy(key.dst, &ip->dst, sizeof(ip->dst));
+    key.identification = ntohs(ip->identification);
+    key.protocol = ip->protocol;
+    key.family = IP_V4;
+
+    struct reassembly_slot *slot = find_slot(cache, &key, now_ns);
+    int rc = add_fragment(cache, slot, datagram + header_len, start, data_len, last);
+    if (rc == REASSEMBLY_INSERT_REJECT)
+    {
+        return -1;
+    }
+    if (rc == REASSEMBLY_INSERT_NEW && start == 0)
+    {
+        memcpy(slot->header, datagram, header_len);
+        slot->header_len = (uint16_t)header_len;
+    }
+    if (!slot_complete(slot))
+    {
+        return 0;
+    }
+
+    // 3. Rebuild the datagram around the first header, as if it had never been fragmented
+    slot->in_use = 0;
+    if (slot->header_len + slot->total > IP_V4_MAX_PACKET_SIZE)
+    {
+        cache->dropped++;
+        return -1;
+    }
+
+    uint8_t *whole = slot->slab + REASSEMBLY_CACHE_HEADER_SPACE - slot->header_len;
+    memcpy(whole, slot->header, slot->header_len);
+    struct ip_v4_header *rebuilt = (struct ip_v4_header *)whole;
+    rebuilt->total_length = htons((uint16_t)(slot->header_len + slot->total));
+    rebuilt->flags_frag_offset = htons(ntohs(rebuilt->flags_frag_offset) & (uint16_t)~(IP_V4_FLAG_MF | IP_V4_FRAG_OFFSET_MASK));
+    rebuilt->checksum = 0;
+    rebuilt->checksum = compute_checksum_fast(whole, slot->header_len);
+
+    *out = whole;
+    *out_len = slot->header_len + slot->total;
+    cache->completed++;
+    return 1;
+}
+
+int reassembly_cache_add_v6(struct reassembly_cache *cache, const uint8_t *packet, size_t length, uint64_t now_ns, const uint8_t **out, size_t *out_len,
+                            uint8_t *next_header)
+{
+    // 1. A well-formed fragment: the fragment header right after the fixed header
+    const struct ip_v6_header *ip = (const struct ip_v6_header *)packet;
+    const size_t fixed = sizeof(struct ip_v6_header) + sizeof(struct ip_v6_fragment_header);
+    if (length < fixed || ip->next_header != IP_V6_FRAGMENT)
+    {
+        cache->dropped++;
+        return -1;
+    }
+
+    size_t payload_length = ntohs(ip->payload_length);
+    if (payload_length <= sizeof(struct ip_v6_fragment_header) || payload_length > length - sizeof(struct ip_v6_header))
+    {
+        cache->dropped++;
+        return -1;
+    }
+
+    const struct ip_v6_fragment_header *frag = (const struct ip_v6_fragment_header *)(packet + sizeof(struct ip_v6_header));
+    uint16_t field = ntohs(frag->offset_flags);
+    uint32_t start = field & IP_V6_FRAG_OFFSET_MASK;
+    int last = !(field & IP_V6_FRAG_MF);
+    uint32_t data_len = (uint32_t)(payload_length - sizeof(struct ip_v6_fragment_header));
+    const uint8_t *data = packet + fixed;
+
+    // An atomic fragment is a whole packet on its own (RFC 6946), and never touches the cache
+    if (start == 0 && last)
+    {
+        *out = data;
+        *out_len = data_len;
+        *next_header = frag->next_header;
+        return 1;
+    }
+    if ((!last && (data_len % 8) != 0) || start + data_len > IP_V4_MAX_PACKET_SIZE)
+    {
+        cache->dropped++;
+        return -1;
+    }
+
+    // 2. Find the packet's slot and file the bytes
+    struct reassembly_key key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.src, ip->src, sizeof(ip->src));
+    memcpy(key.dst, ip->dst, sizeof(ip->dst));
+    key.identification = ntohl(frag->identification);
+    key.protocol = frag->next_header;
+    key.family = IP_V6;
+
+    struct reassembly_slot *slot = find_slot(cache, &key, now_ns);
+    if (add_fragment(cache, slot, data, start, data_len, last) == REASSEMBLY_INSERT_REJECT)
+    {
+        return -1;
+    }
+    if (!slot_complete(slot))
+    {
+        return 0;
+    }
+
+    // 3. The upper-layer message starts right after the header room
+    slot->in_use = 0;
+    *out = slot->slab + REASSEMBLY_CACHE_HEADER_SPACE;
+    *out_len = slot->total;
+    *next_header = slot->key.protocol;
+    cache->completed++;
+    return 1;
+}
+
+void reassembly_cache_expire(struct reassembly_cache *cache, uint64_t now_ns)
+{
+    for (uint32_t i = 0; i < cache->capacity; i++)
+    {
+        struct reassembly_slot *slot = &cache->slots[i];
+        if (slot->in_use && slot->deadline_ns <= now_ns)
+        {
+            slot->in_use = 0;
+            cache->expired++;
+        }
+    }
+}
+
+void reassembly_cache_close(struct reassembly_cache *cache)
+{
+    free(cache->slots);
+    free(cache->slabs);
+    cache->slots = NULL;
+    cache->slabs = NULL;
+}
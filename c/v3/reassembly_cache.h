@@ -0,0 +1,167 @@
+/**
+ * @file reassembly_cache.h
+ * @brief Bounded IPv4 / IPv6 fragment reassembly for replies that bypass the kernel stack.
+ *
+ * @note The raw sockets only ever see datagrams the kernel has already reassembled, but an AF_XDP
+ *       port receives frames straight off the wire: a large Echo Reply arrives as a train of
+ *       fragments, and only the first carries the ICMP header. This cache puts them back together.
+ *
+ *       Everything is preallocated: a fixed number of slots, each with a slab big enough for the
+ *       largest datagram, so a flood of fragments can never make it allocate. Each slot records the
+ *       byte ranges received so far as a short sorted list of intervals; the holes are the gaps
+ *       between them. A datagram is complete once the last fragment fixed its length and a single
+ *       interval covers it all. Slots are reclaimed aggressively:
+ *         - a slot expires once the reply timeout has passed since its first fragment (its request
+ *           is lost by then anyway), checked on every lookup;
+ *         - when every slot is busy, the oldest is displaced;
+ *         - overlapping fragments (RFC 5722), too many holes, or inconsistent lengths drop the slot.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef REASSEMBLY_CACHE_H
+#define REASSEMBLY_CACHE_H
+
+#include "ip_v4.h"
+#include "ip_v6.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Datagrams under reassembly at once, per receiver.
+ */
+#define REASSEMBLY_CACHE_SLOTS 16
+
+/**
+ * @brief Received ranges a slot tracks; a datagram split into more disjoint pieces than this is dropped.
+ */
+#define REASSEMBLY_CACHE_MAX_INTERVALS 16
+
+/**
+ * @brief Room kept in front of each slab for the rebuilt IPv4 header (the largest IHL).
+ */
+#define REASSEMBLY_CACHE_HEADER_SPACE 60
+
+/**
+ * @brief Bytes of one slab: header room plus the largest fragmentable part.
+ */
+#define REASSEMBLY_CACHE_SLAB_SIZE (REASSEMBLY_CACHE_HEADER_SPACE + IP_V4_MAX_PACKET_SIZE)
+
+/**
+ * @struct reassembly_key
+ * @brief What makes two fragments parts of the same datagram (RFC 791 / RFC 8200 Section 4.5).
+ */
+struct reassembly_key
+{
+    uint8_t src[16];         /**< Source address (IPv4 in the first 4 bytes, rest zero) */
+    uint8_t dst[16];         /**< Destination address (IPv4 in the first 4 bytes, rest zero) */
+    uint32_t identification; /**< IPv4 Identification or IPv6 fragment header Identification (host byte order) */
+    uint8_t protocol;        /**< IPv4 protocol, or the next header after the IPv6 fragment header */
+    uint8_t family;          /**< IP_V4 or IP_V6 */
+};
+
+/**
+ * @struct reassembly_interval
+ * @brief One received byte range of the fragmentable part, `[start, end)`.
+ */
+struct reassembly_interval
+{
+    uint32_t start; /**< First byte */
+    uint32_t end;   /**< One past the last byte */
+};
+
+/**
+ * @struct reassembly_slot
+ * @brief One datagram under reassembly and the slab its fragments are copied into.
+ */
+struct reassembly_slot
+{
+    struct reassembly_key key;                                            /**< Datagram the slot holds */
+    uint64_t deadline_ns;                                                 /**< When the slot expires, counted from its first fragment */
+    uint32_t total;                                                       /**< Length of the fragmentable part once the last fragment arrived, else 0 */
+    uint16_t header_len;                                                  /**< IPv4 header bytes kept from the first fragment, 0 until it arrives */
+    uint8_t in_use;                                                       /**< 1 while the slot holds a datagram */
+    uint8_t interval_count;                                               /**< Entries in @ref intervals */
+    struct reassembly_interval intervals[REASSEMBLY_CACHE_MAX_INTERVALS]; /**< Received ranges, sorted and never adjacent */
+    uint8_t header[REASSEMBLY_CACHE_HEADER_SPACE];                        /**< IPv4 header of the first fragment */
+    uint8_t *slab;                                                        /**< @ref REASSEMBLY_CACHE_SLAB_SIZE bytes; data starts after the header room */
+};
+
+/**
+ * @struct reassembly_cache
+ * @brief The slots, their slabs and the outcome counters.
+ */
+struct reassembly_cache
+{
+    struct reassembly_slot *slots; /**< @ref capacity slots */
+    uint8_t *slabs;                /**< One allocation backing every slot's slab */
+    uint32_t capacity;             /**< Number of slots */
+    uint64_t timeout_ns;           /**< Lifetime of a slot from its first fragment */
+    uint64_t completed;            /**< Datagrams handed back whole */
+    uint64_t expired;              /**< Slots reclaimed by their timeout */
+    uint64_t displaced;            /**< Slots reclaimed because every slot was busy */
+    uint64_t dropped;              /**< Fragments rejected: malformed, overlapping, or splitting a datagram too finely */
+};
+
+/**
+ * @brief Whether an IPv4 flags / fragment offset field (host byte order) marks a fragment.
+ */
+static inline int ip_v4_is_fragment(uint16_t flags_frag_offset)
+{
+    return (flags_frag_offset & (IP_V4_FLAG_MF | IP_V4_FRAG_OFFSET_MASK)) != 0;
+}
+
+/**
+ * @brief Preallocates @p capacity slots and their slabs.
+ * @param cache      Pointer to the caller-allocated cache.
+ * @param capacity   Datagrams under reassembly at once (e.g. @ref REASSEMBLY_CACHE_SLOTS).
+ * @param timeout_ns How long a datagram may take to complete, from its first fragment.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int reassembly_cache_init(struct reassembly_cache *cache, uint32_t capacity, uint64_t timeout_ns);
+
+/**
+ * @brief Adds one IPv4 fragment.
+ *
+ * The header checksum is verified here, since nothing in the kernel has looked at the frame. On
+ * completion the datagram is rebuilt around the first fragment's header, with its lengths, flags
+ * and checksum corrected, exactly as if it had arrived whole.
+ *
+ * @param cache      Pointer to the cache.
+ * @param datagram   IPv4 fragment, header included (see @ref ip_v4_is_fragment).
+ * @param length     Bytes at @p datagram.
+ * @param now_ns     CLOCK_MONOTONIC time of reception.
+ * @param out        Output for the reassembled datagram, valid until the next call on @p cache.
+ * @param out_len    Output for the bytes at @p out.
+ * @return 1 if the fragment completed a datagram, 0 if it is held, -1 if it was dropped.
+ */
+int reassembly_cache_add_v4(struct reassembly_cache *cache, const uint8_t *datagram, size_t length, uint64_t now_ns, const uint8_t **out, size_t *out_len);
+
+/**
+ * @brief Adds one IPv6 fragment whose fragment header directly follows the fixed header.
+ * @param cache       Pointer to the cache.
+ * @param packet      IPv6 packet, fixed header included.
+ * @param length      Bytes at @p packet.
+ * @param now_ns      CLOCK_MONOTONIC time of reception.
+ * @param out         Output for the reassembled upper-layer message (e.g. ICMPv6), valid until the next call on @p cache.
+ * @param out_len     Output for the bytes at @p out.
+ * @param next_header Output for the protocol of @p out.
+ * @return 1 if the fragment completed a packet, 0 if it is held, -1 if it was dropped.
+ */
+int reassembly_cache_add_v6(struct reassembly_cache *cache, const uint8_t *packet, size_t length, uint64_t now_ns, const uint8_t **out, size_t *out_len,
+                            uint8_t *next_header);
+
+/**
+ * @brief Reclaims every slot whose timeout has passed.
+ * @param cache  Pointer to the cache.
+ * @param now_ns Current CLOCK_MONOTONIC time.
+ */
+void reassembly_cache_expire(struct reassembly_cache *cache, uint64_t now_ns);
+
+/**
+ * @brief Frees the slots and slabs.
+ * @param cache Pointer to the cache.
+ */
+void reassembly_cache_close(struct reassembly_cache *cache);
+
+#endif /* REASSEMBLY_CACHE_H */
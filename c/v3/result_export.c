@@ -0,0 +1,206 @@
+/**
+ * @file result_export.c
+ * @brief Converts a binary result log (`-o`) to JSON lines or CSV on stdout.
+ *
+ * Timestamps are written as Unix nanoseconds (the log's monotonic timestamps plus its realtime offset).
+ * Build as its own executable, next to the main one:
+ * @code
+ * gcc -std=gnu17 -O2 -pthread result_export.c result_log.c block_writer.c timestamp.c -o ip_stack_v3_export
+ * @endcode
+ *
+ * @author Jim Diroff II
+ */
+#include "result_log.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @enum export_format
+ * @brief Output encodings.
+ */
+enum export_format
+{
+    EXPORT_JSON = 0, /**< One JSON object per record */
+    EXPORT_CSV = 1   /**< A header row, then one row per record */
+};
+
+/**
+ * @brief Printable names of the @ref result_log_status values.
+ */
+static const char *status_name(uint8_t status)
+{
+    switch (status)
+    {
+    case RESULT_LOG_REPLY:
+        return "reply";
+    case RESULT_LOG_TIMEOUT:
+        return "timeout";
+    case RESULT_LOG_DISPLACED:
+        return "displaced";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Reads exactly @p length bytes, or reports a truncated log.
+ * @return 0 on success, -1 on a short read.
+ */
+static int read_exact(FILE *file, void *buffer, size_t length, const char *what)
+{
+    if (fread(buffer, 1, length, file) != length)
+    {
+        fprintf(stderr, "Error: The result log is truncated (%s)\n", what);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints one record in @p format.
+ */
+static void print_record(enum export_format format, const struct result_record *record, const char *target, int64_t realtime_offset_ns)
+{
+    unsigned long long send_ns = (unsigned long long)((int64_t)record->send_ns + realtime_offset_ns);
+    unsigned long long recv_ns = (record->status == RESULT_LOG_REPLY) ? (unsigned long long)((int64_t)record->recv_ns + realtime_offset_ns) : 0;
+    unsigned long long rtt_ns = (record->status == RESULT_LOG_REPLY) ? (unsigned long long)(record->recv_ns - record->send_ns) : 0;
+
+    if (format == EXPORT_CSV)
+    {
+        printf("%s,%u,%u,%s,%llu,%llu,%llu,%u,%u\n", target, record->identifier, record->sequence, status_name(record->status),
+               send_ns, recv_ns, rtt_ns, record->ttl, record->length);
+        return;
+    }
+
+    printf("{\"target\":\"%s\",\"identifier\":%u,\"sequence\":%u,\"status\":\"%s\",\"send_ns\":%llu",
+           target, record->identifier, record->sequence, status_name(record->status), send_ns);
+    if (record->status == RESULT_LOG_REPLY)
+    {
+        printf(",\"recv_ns\":%llu,\"rtt_ns\":%llu,\"ttl\":%u,\"length\":%u", recv_ns, rtt_ns, record->ttl, record->length);
+    }
+    printf("}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    enum export_format format = EXPORT_JSON;
+
+    /**
+     * Arguments:
+     *
+     * f:format (json or csv)
+     */
+    int opt;
+    while ((opt = getopt(argc, argv, "f:")) != -1)
+    {
+        if (opt == 'f' && strcmp(optarg, "json") == 0)
+        {
+            format = EXPORT_JSON;
+        }
+        else if (opt == 'f' && strcmp(optarg, "csv") == 0)
+        {
+            format = EXPORT_CSV;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-f json|csv] result_log\n", argv[0]);
+            return -1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "Usage: %s [-f json|csv] result_log\n", argv[0]);
+        return -1;
+    }
+
+    FILE *file = fopen(argv[optind], "rb");
+    if (!file)
+    {
+        perror("Error: Failed to open the result log");
+        return -1;
+    }
+
+    // 1. Validate the header before trusting any size in it
+    struct result_log_header header;
+    if (read_exact(file, &header, sizeof(header), "header") != 0)
+    {
+        fclose(file);
+        return -1;
+    }
+    if (memcmp(header.magic, RESULT_LOG_MAGIC, sizeof(header.magic)) != 0 || header.version != RESULT_LOG_VERSION ||
+        header.record_size != sizeof(struct result_record) || (header.family != 4 && header.family != 6) ||
+        header.records_offset < sizeof(header) + (uint64_t)header.target_count * 16)
+    {
+        fprintf(stderr, "Error: '%s' is not a version %d result log\n", argv[optind], RESULT_LOG_VERSION);
+        fclose(file);
+        return -1;
+    }
+
+    // 2. Format the target table once; records only carry an index into it
+    char (*names)[INET6_ADDRSTRLEN] = calloc(header.target_count ? header.target_count : 1, INET6_ADDRSTRLEN);
+    if (!names)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u target names\n", header.target_count);
+        fclose(file);
+        return -1;
+    }
+    for (uint32_t i = 0; i < header.target_count; i++)
+    {
+        uint8_t addr[16];
+        if (read_exact(file, addr, sizeof(addr), "target table") != 0)
+        {
+            free(names);
+            fclose(file);
+            return -1;
+        }
+        inet_ntop((header.family == 6) ? AF_INET6 : AF_INET, addr, names[i], INET6_ADDRSTRLEN);
+    }
+
+    if (fseeko(file, (off_t)header.records_offset, SEEK_SET) != 0)
+    {
+        perror("Error: Failed to seek to the first record");
+        free(names);
+        fclose(file);
+        return -1;
+    }
+
+    // 3. Stream the records, skipping block padding
+    if (format == EXPORT_CSV)
+    {
+        printf("target,identifier,sequence,status,send_ns,recv_ns,rtt_ns,ttl,length\n");
+    }
+
+    struct result_record records[RESULT_LOG_BLOCK_RECORDS];
+    size_t n;
+    int status = 0;
+    while ((n = fread(records, sizeof(struct result_record), RESULT_LOG_BLOCK_RECORDS, file)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (records[i].status == RESULT_LOG_PADDING)
+            {
+                continue;
+            }
+            if (records[i].target >= header.target_count)
+            {
+                fprintf(stderr, "Error: Record with target %u outside the target table\n", records[i].target);
+                status = -1;
+                continue;
+            }
+            print_record(format, &records[i], names[records[i].target], header.realtime_offset_ns);
+        }
+    }
+    if (ferror(file))
+    {
+        perror("Error: Failed to read the result log");
+        status = -1;
+    }
+
+    free(names);
+    fclose(file);
+    return status;
+}
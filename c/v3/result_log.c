@@ -0,0 +1,154 @@
+/**
+ * @file result_log.c
+ * @brief Streaming binary log of every probe's outcome, written by a background thread.
+ *
+ * @author Jim Diroff II
+ */
+#include "result_log.h"
+#include "timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+_Static_assert(sizeof(struct result_record) == 32, "result_record is part of the file format");
+_Static_assert(sizeof(struct result_log_header) == 64, "result_log_header is part of the file format");
+_Static_assert(RESULT_LOG_BLOCK_SIZE % RESULT_LOG_ALIGNMENT == 0, "blocks must keep every write aligned");
+
+/**
+ * @brief Bytes per target table entry.
+ */
+#define RESULT_LOG_ADDR_SIZE 16
+
+/**
+ * @brief Builds the header and target table, padded to the first block offset.
+ * @param targets Every probed destination.
+ * @param length  Output for the buffer's length.
+ * @return The aligned buffer (freed by the caller), or NULL on allocation failure.
+ */
+static uint8_t *build_header(const struct target_list *targets, size_t *length)
+{
+    size_t table_bytes = (size_t)targets->count * RESULT_LOG_ADDR_SIZE;
+    size_t header_bytes = (sizeof(struct result_log_header) + table_bytes + RESULT_LOG_ALIGNMENT - 1) & ~(size_t)(RESULT_LOG_ALIGNMENT - 1);
+
+    uint8_t *buffer = aligned_alloc(RESULT_LOG_ALIGNMENT, header_bytes);
+    if (!buffer)
+    {
+        fprintf(stderr, "Error: Failed to allocate the result log header\n");
+        return NULL;
+    }
+    memset(buffer, 0, header_bytes);
+
+    // 1. Timestamps stay monotonic in the records; the offset lets readers convert them to wall-clock time
+    struct timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    uint64_t realtime_ns = (uint64_t)realtime.tv_sec * TIMESTAMP_NS_PER_SEC + (uint64_t)realtime.tv_nsec;
+
+    struct result_log_header *header = (struct result_log_header *)buffer;
+    memcpy(header->magic, RESULT_LOG_MAGIC, sizeof(header->magic));
+    header->version = RESULT_LOG_VERSION;
+    header->record_size = sizeof(struct result_record);
+    header->family = (targets->family == AF_INET6) ? 6 : 4;
+    header->target_count = targets->count;
+    header->records_offset = header_bytes;
+    header->realtime_offset_ns = (int64_t)(realtime_ns - timestamp_now_ns());
+
+    // 2. The target table, so every record's index resolves without the original command line
+    uint8_t *table = buffer + sizeof(struct result_log_header);
+    for (uint32_t i = 0; i < targets->count; i++)
+    {
+        if (targets->family == AF_INET6)
+        {
+            memcpy(table + (size_t)i * RESULT_LOG_ADDR_SIZE, &targets->addrs6[i], sizeof(struct in6_addr));
+        }
+        else
+        {
+            memcpy(table + (size_t)i * RESULT_LOG_ADDR_SIZE, &targets->addrs[i], sizeof(struct in_addr));
+        }
+    }
+
+    *length = header_bytes;
+    return buffer;
+}
+
+int result_log_open(struct result_log *log, const char *path, const struct target_list *targets, uint32_t stream_count)
+{
+    memset(log, 0, sizeof(struct result_log));
+    log->writer.fd = -1;
+
+    // 1. One (lazily filled) stream per producer
+    log->streams = calloc(stream_count, sizeof(struct result_log_stream));
+    if (!log->streams)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u result log streams\n", stream_count);
+        return -1;
+    }
+    log->stream_count = stream_count;
+
+    // 2. Whole blocks only, so O_DIRECT applies; the log is durable once closed
+    size_t header_len = 0;
+    uint8_t *header = build_header(targets, &header_len);
+    int rc = header ? block_writer_open(&log->writer, path, "result log", RESULT_LOG_BLOCK_SIZE, stream_count, BLOCK_WRITER_DIRECT | BLOCK_WRITER_SYNC, header, header_len) : -1;
+    free(header);
+    if (rc != 0)
+    {
+        free(log->streams);
+        log->streams = NULL;
+        log->stream_count = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+struct result_log_stream *result_log_stream_open(struct result_log *log, uint32_t index, uint32_t target_offset)
+{
+    struct result_log_stream *stream = &log->streams[index];
+
+    stream->ring = block_writer_stream_open(&log->writer, index);
+    if (!stream->ring)
+    {
+        return NULL;
+    }
+    stream->target_offset = target_offset;
+
+    return stream;
+}
+
+void result_log_append(struct result_log_stream *stream, const struct result_record *record)
+{
+    struct result_record *slot = (struct result_record *)block_writer_stream_block(stream->ring) + stream->fill;
+    *slot = *record;
+    slot->target += stream->target_offset;
+
+    if (++stream->fill == RESULT_LOG_BLOCK_RECORDS)
+    {
+        stream->fill = 0;
+        block_writer_stream_publish(stream->ring, RESULT_LOG_BLOCK_SIZE);
+    }
+}
+
+void result_log_flush(struct result_log_stream *stream)
+{
+    if (stream->fill == 0)
+    {
+        return;
+    }
+
+    // Whole blocks keep every write aligned; zeroed records read back as padding
+    struct result_record *block = (struct result_record *)block_writer_stream_block(stream->ring);
+    memset(block + stream->fill, 0, (RESULT_LOG_BLOCK_RECORDS - stream->fill) * sizeof(struct result_record));
+    stream->fill = 0;
+    block_writer_stream_publish(stream->ring, RESULT_LOG_BLOCK_SIZE);
+}
+
+int result_log_close(struct result_log *log)
+{
+    int rc = block_writer_close(&log->writer);
+
+    free(log->streams);
+    log->streams = NULL;
+    log->stream_count = 0;
+    return rc;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file result_log.h
+ * @brief Streaming binary log of every probe's outcome, written by a background thread.
+ *
+ * @note Each worker owns one block_writer.h stream and fills its blocks with fixed-size records. Blocks
+ *       are always written whole, so the file can bypass the page cache with O_DIRECT where the file
+ *       system supports it, and it is made durable on close. The hot loop never makes a system call
+ *       for logging.
+ *
+ *       File layout: a @ref result_log_header, the probed targets as 16-byte addresses (IPv4 in the
+ *       first 4 bytes), zero padding to @ref RESULT_LOG_ALIGNMENT, then blocks of @ref result_record.
+ *       Unused records at the end of a block are zeroed (@ref RESULT_LOG_PADDING).
+ *
+ * @author Jim Diroff II
+ */
+#ifndef RESULT_LOG_H
+#define RESULT_LOG_H
+
+#include "block_writer.h"
+#include "target_list.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief File magic, without a terminator.
+ */
+#define RESULT_LOG_MAGIC "ICMPRLOG"
+
+/**
+ * @brief Format version written into (and required from) the header.
+ */
+#define RESULT_LOG_VERSION 1
+
+/**
+ * @brief Alignment of the first block's offset (keeps every write O_DIRECT-friendly on common devices).
+ */
+#define RESULT_LOG_ALIGNMENT BLOCK_WRITER_ALIGNMENT
+
+/**
+ * @brief Bytes per block handed from a worker to the writer.
+ */
+#define RESULT_LOG_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @enum result_log_status
+ * @brief Outcome of one probe.
+ */
+enum result_log_status
+{
+    RESULT_LOG_PADDING = 0,  /**< Not a record: filler at the end of a partially used block */
+    RESULT_LOG_REPLY = 1,    /**< Answered; the receive timestamp, TTL and length are valid */
+    RESULT_LOG_TIMEOUT = 2,  /**< No reply within the reply timeout */
+    RESULT_LOG_DISPLACED = 3 /**< Still pending when its sequence number came round again */
+};
+
+/**
+ * @struct result_record
+ * @brief One probe outcome (32 bytes, host byte order, CLOCK_MONOTONIC timestamps).
+ */
+struct result_record
+{
+    uint64_t send_ns;    /**< Send timestamp */
+    uint64_t recv_ns;    /**< Receive timestamp (0 unless @ref RESULT_LOG_REPLY) */
+    uint32_t target;     /**< Index into the header's target table */
+    uint16_t identifier; /**< Echo identifier the probe carried */
+    uint16_t sequence;   /**< Echo sequence number the probe carried */
+    uint8_t ttl;         /**< TTL or hop limit of the reply */
+    uint8_t status;      /**< A @ref result_log_status value */
+    uint16_t length;     /**< Bytes received (as in @ref icmp_reply) */
+    uint32_t reserved;   /**< Zero */
+};
+
+/**
+ * @brief Records per block.
+ */
+#define RESULT_LOG_BLOCK_RECORDS (RESULT_LOG_BLOCK_SIZE / sizeof(struct result_record))
+
+/**
+ * @struct result_log_header
+ * @brief Fixed header at offset 0 (64 bytes, host byte order).
+ */
+struct result_log_header
+{
+    char magic[8];              /**< @ref RESULT_LOG_MAGIC */
+    uint32_t version;           /**< @ref RESULT_LOG_VERSION */
+    uint32_t record_size;       /**< `sizeof(struct result_record)` */
+    uint32_t family;            /**< 4 or 6: how to read the target table */
+    uint32_t target_count;      /**< Addresses in the target table */
+    uint64_t records_offset;    /**< File offset of the first block */
+    int64_t realtime_offset_ns; /**< CLOCK_REALTIME minus CLOCK_MONOTONIC when the log was opened */
+    uint64_t reserved[3];       /**< Zero */
+};
+
+/**
+ * @struct result_log_stream
+ * @brief One worker's view of its block ring.
+ */
+struct result_log_stream
+{
+    struct block_writer_stream *ring; /**< The worker's ring, or NULL if unused */
+    uint32_t target_offset;           /**< Added to the worker's target index to index the shared target table */
+    uint32_t fill;                    /**< Records in the block being filled (producer only) */
+};
+
+/**
+ * @struct result_log
+ * @brief The log file and its streams.
+ */
+struct result_log
+{
+    struct block_writer writer;        /**< File, rings and writer thread */
+    struct result_log_stream *streams; /**< One stream per producer */
+    uint32_t stream_count;             /**< Entries in @ref streams */
+};
+
+/**
+ * @brief Creates @p path, writes the header and target table, and starts the writer thread.
+ * @param log          Pointer to the caller-allocated log.
+ * @param path         File to create (truncated if it exists).
+ * @param targets      Every probed destination, in the indexing order of the records.
+ * @param stream_count Number of producers (workers).
+ * @return 0 on success, -1 on failure (the log is left closed and the reason printed).
+ */
+int result_log_open(struct result_log *log, const char *path, const struct target_list *targets, uint32_t stream_count);
+
+/**
+ * @brief Allocates stream @p index. Call from the producing thread before its first append.
+ * @param log           Pointer to an open log.
+ * @param index         Stream index, below `stream_count`.
+ * @param target_offset Offset of the producer's targets in the shared target table.
+ * @return The stream, or NULL on allocation failure.
+ */
+struct result_log_stream *result_log_stream_open(struct result_log *log, uint32_t index, uint32_t target_offset);
+
+/**
+ * @brief Appends one record, handing the block to the writer once it is full.
+ * @param stream Pointer to the producer's stream.
+ * @param record Record to copy; its target is relative to the stream's target offset.
+ */
+void result_log_append(struct result_log_stream *stream, const struct result_record *record);
+
+/**
+ * @brief Hands the partially filled block to the writer, zeroing its unused records. Producer only.
+ * @param stream Pointer to the producer's stream.
+ */
+void result_log_flush(struct result_log_stream *stream);
+
+/**
+ * @brief Writes out every published block, stops the writer and closes the file. Safe to call on a closed log.
+ *
+ * Every producer must have flushed and stopped appending.
+ *
+ * @param log Pointer to the log.
+ * @return 0 if every block reached the file, -1 otherwise.
+ */
+int result_log_close(struct result_log *log);
+
+#endif /* RESULT_LOG_H */
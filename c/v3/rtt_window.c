@@ -0,0 +1,199 @@
+/**
+ * @file rtt_window.c
+ * @brief Rolling per-target loss and round-trip windows over the last N probing rounds.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "rtt_window.h"
+#include "timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @struct window_key
+ * @brief A destination and its position in a list, for matching targets across a reload.
+ */
+struct window_key
+{
+    uint8_t addr[16]; /**< Address bytes (IPv4 in the first 4, rest zero) */
+    uint32_t index;   /**< Position in the list */
+};
+
+/**
+ * @brief Allocates the arrays for @p targets x @p length cells (zeroed) and sets the shape.
+ */
+static int window_alloc(struct rtt_window *window, uint32_t targets, uint32_t length)
+{
+    memset(window, 0, sizeof(struct rtt_window));
+    window->targets = targets;
+    window->length = length;
+
+    size_t cells = (size_t)targets * length;
+    window->sent = calloc(cells, sizeof(uint16_t));
+    window->received = calloc(cells, sizeof(uint16_t));
+    window->rtt_us = calloc(cells, sizeof(uint32_t));
+    window->sent_total = calloc(targets, sizeof(uint64_t));
+    window->received_total = calloc(targets, sizeof(uint64_t));
+    if ((cells > 0 && (!window->sent || !window->received || !window->rtt_us)) || (targets > 0 && (!window->sent_total || !window->received_total)))
+    {
+        fprintf(stderr, "Error: Failed to allocate the round-trip windows for %u targets\n", targets);
+        rtt_window_free(window);
+        return -1;
+    }
+
+    return 0;
+}
+
+int rtt_window_init(struct rtt_window *window, uint32_t targets, uint32_t length)
+{
+    return window_alloc(window, targets, length);
+}
+
+void rtt_window_record(struct rtt_window *window, const struct icmp_target_stats *stats)
+{
+    size_t base = (size_t)window->head * window->targets;
+
+    for (uint32_t t = 0; t < window->targets; t++)
+    {
+        uint64_t sent = stats[t].sent;
+        uint64_t received = stats[t].received;
+        uint64_t rtt_us = (received > 0) ? stats[t].rtt_sum_ns / received / TIMESTAMP_NS_PER_USEC : 0;
+
+        window->sent[base + t] = (uint16_t)((sent < UINT16_MAX) ? sent : UINT16_MAX);
+        window->received[base + t] = (uint16_t)((received < UINT16_MAX) ? received : UINT16_MAX);
+        window->rtt_us[base + t] = (uint32_t)((rtt_us < UINT32_MAX) ? rtt_us : UINT32_MAX);
+        window->sent_total[t] += sent;
+        window->received_total[t] += received;
+    }
+
+    window->head = (window->head + 1) % window->length;
+    if (window->filled < window->length)
+    {
+        window->filled++;
+    }
+}
+
+void rtt_window_summarize(const struct rtt_window *window, struct rtt_window_summary *summaries)
+{
+    // 1. Lifetime totals, and the accumulators each round folds into
+    for (uint32_t t = 0; t < window->targets; t++)
+    {
+        memset(&summaries[t], 0, sizeof(struct rtt_window_summary));
+        summaries[t].rtt_min_us = UINT32_MAX;
+        summaries[t].sent_total = window->sent_total[t];
+        summaries[t].received_total = window->received_total[t];
+    }
+
+    // 2. Oldest round first, so the last round with replies is the one left in `rtt_last_us`
+    uint32_t oldest = (window->head + window->length - window->filled) % window->length;
+    for (uint32_t k = 0; k < window->filled; k++)
+    {
+        size_t base = (size_t)((oldest + k) % window->length) * window->targets;
+        for (uint32_t t = 0; t < window->targets; t++)
+        {
+            struct rtt_window_summary *summary = &summaries[t];
+            uint16_t received = window->received[base + t];
+            uint32_t rtt_us = window->rtt_us[base + t];
+
+            summary->sent += window->sent[base + t];
+            if (received > 0)
+            {
+                summary->received += received;
+                summary->rtt_sum_us += (uint64_t)rtt_us * received; /**< A round's mean weighs as many replies as it had */
+                summary->rtt_min_us = (rtt_us < summary->rtt_min_us) ? rtt_us : summary->rtt_min_us;
+                summary->rtt_max_us = (rtt_us > summary->rtt_max_us) ? rtt_us : summary->rtt_max_us;
+                summary->rtt_last_us = rtt_us;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Copies list entry @p index into a comparable key.
+ */
+static void window_key_of(const struct target_list *list, uint32_t index, struct window_key *key)
+{
+    memset(key, 0, sizeof(struct window_key));
+    if (list->family == AF_INET6)
+    {
+        memcpy(key->addr, &list->addrs6[index], sizeof(struct in6_addr));
+    }
+    else
+    {
+        memcpy(key->addr, &list->addrs[index], sizeof(struct in_addr));
+    }
+    key->index = index;
+}
+
+static int window_key_compare(const void *a, const void *b)
+{
+    return memcmp(((const struct window_key *)a)->addr, ((const struct window_key *)b)->addr, sizeof(((const struct window_key *)a)->addr));
+}
+
+int rtt_window_remap(struct rtt_window *window, const struct target_list *previous, const struct target_list *next)
+{
+    // 1. The previous list sorted by address, so each reloaded target finds its history in O(log n)
+    struct window_key *keys = malloc(((size_t)previous->count + 1) * sizeof(struct window_key));
+    struct rtt_window remapped;
+    if (!keys)
+    {
+        fprintf(stderr, "Error: Failed to allocate the round-trip window index\n");
+        return -1;
+    }
+    if (window_alloc(&remapped, next->count, window->length) != 0)
+    {
+        free(keys);
+        return -1;
+    }
+    for (uint32_t i = 0; i < previous->count; i++)
+    {
+        window_key_of(previous, i, &keys[i]);
+    }
+    qsort(keys, previous->count, sizeof(struct window_key), window_key_compare);
+
+    // 2. Carry every surviving target's rounds and totals over; new targets start empty
+    remapped.head = window->head;
+    remapped.filled = window->filled;
+    for (uint32_t j = 0; j < next->count; j++)
+    {
+        struct window_key key;
+        window_key_of(next, j, &key);
+        const struct window_key *found = bsearch(&key, keys, previous->count, sizeof(struct window_key), window_key_compare);
+        if (!found)
+        {
+            continue;
+        }
+
+        uint32_t i = found->index;
+        for (uint32_t r = 0; r < window->length; r++)
+        {
+            remapped.sent[(size_t)r * next->count + j] = window->sent[(size_t)r * window->targets + i];
+            remapped.received[(size_t)r * next->count + j] = window->received[(size_t)r * window->targets + i];
+            remapped.rtt_us[(size_t)r * next->count + j] = window->rtt_us[(size_t)r * window->targets + i];
+        }
+        remapped.sent_total[j] = window->sent_total[i];
+        remapped.received_total[j] = window->received_total[i];
+    }
+
+    free(keys);
+    rtt_window_free(window);
+    *window = remapped;
+    return 0;
+}
+
+void rtt_window_free(struct rtt_window *window)
+{
+    free(window->sent);
+    free(window->received);
+    free(window->rtt_us);
+    free(window->sent_total);
+    free(window->received_total);
+    window->sent = NULL;
+    window->received = NULL;
+    window->rtt_us = NULL;
+    window->sent_total = NULL;
+    window->received_total = NULL;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file rtt_window.h
+ * @brief Rolling per-target loss and round-trip windows over the last N probing rounds.
+ *
+ * @note One ring per target would scatter a round's update across the heap. Instead every field is
+ *       one flat array in round-major order: the columns of one round lie next to each other,
+ *       one per target, and all targets share a single head. Recording a round and summarizing
+ *       the window are both sequential sweeps, and a target/round cell costs 8 bytes.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef RTT_WINDOW_H
+#define RTT_WINDOW_H
+
+#include "icmp_receiver.h"
+#include "target_list.h"
+
+#include <stdint.h>
+
+/**
+ * @struct rtt_window
+ * @brief @ref length rounds of outcomes for @ref targets destinations, plus lifetime totals.
+ */
+struct rtt_window
+{
+    uint32_t targets;         /**< Destinations tracked, in target list order */
+    uint32_t length;          /**< Rounds kept per destination */
+    uint32_t head;            /**< Round slot the next round is written to */
+    uint32_t filled;          /**< Round slots holding a round (at most @ref length) */
+    uint16_t *sent;           /**< Requests per round and target: `[round * targets + target]` */
+    uint16_t *received;       /**< Replies per round and target, same layout */
+    uint32_t *rtt_us;         /**< Mean round trip of the round's replies in microseconds (0 without replies), same layout */
+    uint64_t *sent_total;     /**< Requests per target since it was first listed */
+    uint64_t *received_total; /**< Replies per target since it was first listed */
+};
+
+/**
+ * @struct rtt_window_summary
+ * @brief One destination's window, folded for reporting.
+ */
+struct rtt_window_summary
+{
+    uint64_t sent;           /**< Requests in the window */
+    uint64_t received;       /**< Replies in the window */
+    uint32_t rtt_min_us;     /**< Lowest round mean in the window (UINT32_MAX without replies) */
+    uint32_t rtt_max_us;     /**< Highest round mean in the window */
+    uint64_t rtt_sum_us;     /**< Round trips summed over every reply in the window; the average is this over @ref received */
+    uint32_t rtt_last_us;    /**< Mean round trip of the latest round with replies (0 if none) */
+    uint64_t sent_total;     /**< Lifetime requests */
+    uint64_t received_total; /**< Lifetime replies */
+};
+
+/**
+ * @brief Allocates an empty window.
+ * @param window  Pointer to the caller-allocated window.
+ * @param targets Destinations to track.
+ * @param length  Rounds to keep per destination (at least 1).
+ * @return 0 on success, -1 on allocation failure.
+ */
+int rtt_window_init(struct rtt_window *window, uint32_t targets, uint32_t length);
+
+/**
+ * @brief Writes one round's per-target outcomes into the head slot, overwriting the oldest round once full.
+ * @param window Pointer to the window.
+ * @param stats  One entry per target, in target list order (e.g. `worker_pool::stats`).
+ */
+void rtt_window_record(struct rtt_window *window, const struct icmp_target_stats *stats);
+
+/**
+ * @brief Folds every destination's window into @p summaries.
+ * @param window    Pointer to the window.
+ * @param summaries Output with one entry per target.
+ */
+void rtt_window_summarize(const struct rtt_window *window, struct rtt_window_summary *summaries);
+
+/**
+ * @brief Rebuilds the window for a reloaded target list, keeping the history of every destination still listed.
+ * @param window   Pointer to the window, tracking @p previous.
+ * @param previous The list the window was tracking.
+ * @param next     The reloaded list (same family).
+ * @return 0 on success, -1 on allocation failure (the window is left unchanged).
+ */
+int rtt_window_remap(struct rtt_window *window, const struct target_list *previous, const struct target_list *next);
+
+/**
+ * @brief Releases the window's arrays.
+ * @param window Pointer to the window.
+ */
+void rtt_window_free(struct rtt_window *window);
+
+#endif /* RTT_WINDOW_H */
@@ -0,0 +1,237 @@
+/**
+ * @file socket_filter.c
+ * @brief Classic BPF receive filters that drop foreign ICMP traffic in the kernel, before it is queued.
+ *
+ * @author Jim Diroff II
+ */
+#include "socket_filter.h"
+#include "icmp_v4.h"
+#include "icmp_v6.h"
+#include "ip_v6.h"
+
+#include <errno.h>
+#include <linux/filter.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @enum filter_label
+ * @brief Jump targets, resolved to relative offsets once the program is complete.
+ */
+enum filter_label
+{
+    LABEL_NEXT = 0, /**< Fall through to the next instruction */
+    LABEL_ACCEPT,   /**< Queue the whole packet */
+    LABEL_DROP,     /**< Discard the packet */
+    LABEL_ECHO,     /**< Check the identifier of an Echo Reply */
+    LABEL_QUOTE,    /**< Check the identifier of the Echo Request an error quotes */
+    LABEL_COUNT
+};
+
+/**
+ * @struct filter_program
+ * @brief A program under construction: instructions plus the labels their jumps refer to.
+ */
+struct filter_program
+{
+    struct sock_filter insns[SOCKET_FILTER_MAX_INSNS]; /**< Emitted instructions */
+    uint8_t jt[SOCKET_FILTER_MAX_INSNS];               /**< Label each conditional jump takes when true */
+    uint8_t jf[SOCKET_FILTER_MAX_INSNS];               /**< Label each conditional jump takes when false */
+    uint32_t labels[LABEL_COUNT];                      /**< Instruction index of each placed label */
+    uint32_t len;                                      /**< Instructions emitted */
+};
+
+/**
+ * @brief Appends a non-jump instruction.
+ */
+static void emit(struct filter_program *prog, uint16_t code, uint32_t k)
+{
+    if (prog->len < SOCKET_FILTER_MAX_INSNS)
+    {
+        prog->insns[prog->len] = (struct sock_filter)BPF_STMT(code, k);
+        prog->jt[prog->len] = LABEL_NEXT;
+        prog->jf[prog->len] = LABEL_NEXT;
+    }
+    prog->len++;
+}
+
+/**
+ * @brief Appends a conditional jump comparing the accumulator with @p k.
+ */
+static void emit_jump(struct filter_program *prog, uint16_t code, uint32_t k, uint8_t jt, uint8_t jf)
+{
+    if (prog->len < SOCKET_FILTER_MAX_INSNS)
+    {
+        prog->insns[prog->len] = (struct sock_filter)BPF_JUMP(code, k, 0, 0);
+        prog->jt[prog->len] = jt;
+        prog->jf[prog->len] = jf;
+    }
+    prog->len++;
+}
+
+/**
+ * @brief Places @p label at the next instruction.
+ */
+static void mark(struct filter_program *prog, uint8_t label)
+{
+    prog->labels[label] = prog->len;
+}
+
+/**
+ * @brief Accepts if the identifier in the accumulator lies in the range, otherwise drops.
+ */
+static void emit_identifier_check(struct filter_program *prog, uint16_t first, uint32_t count)
+{
+    if (count >= 65536)
+    {
+        emit(prog, BPF_RET | BPF_K, UINT32_MAX);
+        return;
+    }
+
+    uint32_t last = (uint32_t)first + count - 1;
+    if (last <= UINT16_MAX)
+    {
+        // first <= id <= last
+        emit_jump(prog, BPF_JMP | BPF_JGE | BPF_K, first, LABEL_NEXT, LABEL_DROP);
+        emit_jump(prog, BPF_JMP | BPF_JGT | BPF_K, last, LABEL_DROP, LABEL_ACCEPT);
+    }
+    else
+    {
+        // The range wraps: id >= first, or id <= last - 65536
+        emit_jump(prog, BPF_JMP | BPF_JGE | BPF_K, first, LABEL_ACCEPT, LABEL_NEXT);
+        emit_jump(prog, BPF_JMP | BPF_JGT | BPF_K, last & UINT16_MAX, LABEL_DROP, LABEL_ACCEPT);
+    }
+}
+
+/**
+ * @brief IPv4: the program sees the IPv4 header first, so every ICMP offset is relative to X = IHL * 4.
+ */
+static void generate_v4(struct filter_program *prog, uint16_t first, uint32_t count, uint8_t accept_errors)
+{
+    // 1. Dispatch on the ICMP type
+    emit(prog, BPF_LDX | BPF_B | BPF_MSH, 0);
+    emit(prog, BPF_LD | BPF_B | BPF_IND, 0);
+    emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V4_ECHO_REPLY, LABEL_ECHO, LABEL_NEXT);
+    if (accept_errors)
+    {
+        emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V4_DEST_UNREACHABLE, LABEL_QUOTE, LABEL_NEXT);
+        emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V4_TIME_EXCEEDED, LABEL_QUOTE, LABEL_DROP);
+    }
+    else
+    {
+        emit(prog, BPF_RET | BPF_K, 0);
+    }
+
+    // 2. Echo Reply: identifier at ICMP offset 4
+    mark(prog, LABEL_ECHO);
+    emit(prog, BPF_LD | BPF_H | BPF_IND, 4);
+    emit_identifier_check(prog, first, count);
+
+    // 3. Error: the quoted IPv4 header starts at ICMP offset 8; advance X past it to its ICMP header
+    if (accept_errors)
+    {
+        mark(prog, LABEL_QUOTE);
+        emit(prog, BPF_LD | BPF_B | BPF_IND, 8);
+        emit(prog, BPF_ALU | BPF_AND | BPF_K, 0x0F);
+        emit(prog, BPF_ALU | BPF_LSH | BPF_K, 2);
+        emit(prog, BPF_ALU | BPF_ADD | BPF_X, 0);
+        emit(prog, BPF_MISC | BPF_TAX, 0);
+        emit(prog, BPF_LD | BPF_B | BPF_IND, 8);
+        emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V4_ECHO_REQUEST, LABEL_NEXT, LABEL_DROP);
+        emit(prog, BPF_LD | BPF_H | BPF_IND, 8 + 4);
+        emit_identifier_check(prog, first, count);
+    }
+}
+
+/**
+ * @brief IPv6: the program sees the ICMPv6 message itself, so every offset is absolute.
+ */
+static void generate_v6(struct filter_program *prog, uint16_t first, uint32_t count, uint8_t accept_errors)
+{
+    size_t quote = sizeof(struct icmp_v6_header) + sizeof(struct icmp_v6_error_header);
+
+    // 1. Dispatch on the ICMPv6 type
+    emit(prog, BPF_LD | BPF_B | BPF_ABS, 0);
+    emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V6_ECHO_REPLY, LABEL_ECHO, LABEL_NEXT);
+    if (accept_errors)
+    {
+        emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V6_DEST_UNREACHABLE, LABEL_QUOTE, LABEL_NEXT);
+        emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V6_PACKET_TOO_BIG, LABEL_QUOTE, LABEL_NEXT);
+        emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V6_TIME_EXCEEDED, LABEL_QUOTE, LABEL_DROP);
+    }
+    else
+    {
+        emit(prog, BPF_RET | BPF_K, 0);
+    }
+
+    // 2. Echo Reply: identifier at offset 4
+    mark(prog, LABEL_ECHO);
+    emit(prog, BPF_LD | BPF_H | BPF_ABS, 4);
+    emit_identifier_check(prog, first, count);
+
+    // 3. Error: a quoted IPv6 header (next header ICMPv6, as we send no extensions), then our Echo Request
+    if (accept_errors)
+    {
+        mark(prog, LABEL_QUOTE);
+        emit(prog, BPF_LD | BPF_B | BPF_ABS, (uint32_t)(quote + offsetof(struct ip_v6_header, next_header)));
+        emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, IP_V6_ICMP_V6, LABEL_NEXT, LABEL_DROP);
+        emit(prog, BPF_LD | BPF_B | BPF_ABS, (uint32_t)(quote + sizeof(struct ip_v6_header)));
+        emit_jump(prog, BPF_JMP | BPF_JEQ | BPF_K, ICMP_V6_ECHO_REQUEST, LABEL_NEXT, LABEL_DROP);
+        emit(prog, BPF_LD | BPF_H | BPF_ABS, (uint32_t)(quote + sizeof(struct ip_v6_header) + 4));
+        emit_identifier_check(prog, first, count);
+    }
+}
+
+int socket_filter_attach(int sockfd, sa_family_t family, uint16_t first_identifier, uint32_t count, uint8_t accept_errors)
+{
+    if (count == 0 || count > 65536)
+    {
+        fprintf(stderr, "Error: Invalid identifier count %u for the socket filter\n", count);
+        return -1;
+    }
+
+    // 1. Generate the program, with the shared accept and drop exits last
+    struct filter_program prog;
+    memset(&prog, 0, sizeof(prog));
+    if (family == AF_INET6)
+    {
+        generate_v6(&prog, first_identifier, count, accept_errors);
+    }
+    else
+    {
+        generate_v4(&prog, first_identifier, count, accept_errors);
+    }
+    mark(&prog, LABEL_ACCEPT);
+    emit(&prog, BPF_RET | BPF_K, UINT32_MAX);
+    mark(&prog, LABEL_DROP);
+    emit(&prog, BPF_RET | BPF_K, 0);
+    if (prog.len > SOCKET_FILTER_MAX_INSNS)
+    {
+        fprintf(stderr, "Error: Socket filter needs %u instructions (limit %i)\n", prog.len, SOCKET_FILTER_MAX_INSNS);
+        return -1;
+    }
+
+    // 2. Resolve labels into the forward offsets classic BPF requires
+    for (uint32_t i = 0; i < prog.len; i++)
+    {
+        if (prog.jt[i] != LABEL_NEXT)
+        {
+            prog.insns[i].jt = (uint8_t)(prog.labels[prog.jt[i]] - i - 1);
+        }
+        if (prog.jf[i] != LABEL_NEXT)
+        {
+            prog.insns[i].jf = (uint8_t)(prog.labels[prog.jf[i]] - i - 1);
+        }
+    }
+
+    // 3. The kernel validates the program (forward jumps only, in-bounds, ending in a return)
+    struct sock_fprog fprog = {.len = (unsigned short)prog.len, .filter = prog.insns};
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) != 0)
+    {
+        fprintf(stderr, "Error: Failed to attach the socket filter: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
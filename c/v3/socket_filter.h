@@ -0,0 +1,38 @@
+/**
+ * @file socket_filter.h
+ * @brief Classic BPF receive filters that drop foreign ICMP traffic in the kernel, before it is queued.
+ *
+ * @note A raw ICMP socket is handed a copy of every ICMP packet the host receives. On a busy host most
+ *       of them are other programs' pings, our own reflected requests or unrelated errors, each one a
+ *       wakeup and a copy only to be discarded by the matcher. The filter generated here passes only
+ *       Echo Replies carrying one of our identifiers and, on request, the ICMP errors that quote one of
+ *       our Echo Requests. The matcher still checks everything it receives; the filter only thins the
+ *       stream.
+ *
+ *       Raw IPv4 sockets run the filter on the IPv4 header; raw IPv6 sockets on the ICMPv6 message.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef SOCKET_FILTER_H
+#define SOCKET_FILTER_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Upper bound on instructions in a generated program.
+ */
+#define SOCKET_FILTER_MAX_INSNS 48
+
+/**
+ * @brief Generates and attaches the receive filter (`SO_ATTACH_FILTER`) to a raw ICMP or ICMPv6 socket.
+ * @param sockfd           Raw socket opened for @p family.
+ * @param family           AF_INET or AF_INET6.
+ * @param first_identifier First Echo identifier to pass (host byte order).
+ * @param count            Identifiers to pass, from @p first_identifier upward (wrapping past 65535); 1-65536.
+ * @param accept_errors    1 to also pass Destination Unreachable, Time Exceeded (and Packet Too Big) errors quoting those identifiers.
+ * @return 0 on success, -1 on failure (the socket is left unfiltered).
+ */
+int socket_filter_attach(int sockfd, sa_family_t family, uint16_t first_identifier, uint32_t count, uint8_t accept_errors);
+
+#endif /* SOCKET_FILTER_H */
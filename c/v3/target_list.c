@@ -0,0 +1,277 @@
+/**
+ * @file target_list.c
+ * @brief Destination list for multi-target probing: parsed once to binary, then permuted.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "target_list.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BASE10 10
+
+/**
+ * @brief Longest accepted spec, e.g. a full IPv6 address with "/128" plus slack for whitespace.
+ */
+#define TARGET_SPEC_MAX_LEN 64
+
+/**
+ * @brief Ensures room for @p extra more entries, growing geometrically.
+ * @return 0 on success, -1 on overflow or allocation failure.
+ */
+static int reserve(struct target_list *list, uint64_t extra)
+{
+    uint64_t needed = (uint64_t)list->count + extra;
+    if (needed > UINT32_MAX)
+    {
+        fprintf(stderr, "Error: Target list exceeds %u entries\n", UINT32_MAX);
+        return -1;
+    }
+
+    if (needed <= list->capacity)
+    {
+        return 0;
+    }
+
+    uint64_t capacity = (list->capacity > 0) ? list->capacity : 16;
+    while (capacity < needed)
+    {
+        capacity *= 2;
+    }
+    if (capacity > UINT32_MAX)
+    {
+        capacity = UINT32_MAX;
+    }
+
+    void **array = (list->family == AF_INET6) ? (void **)&list->addrs6 : (void **)&list->addrs;
+    size_t entry_size = (list->family == AF_INET6) ? sizeof(struct in6_addr) : sizeof(struct in_addr);
+    void *addrs = realloc(*array, (size_t)capacity * entry_size);
+    if (!addrs)
+    {
+        fprintf(stderr, "Error: Failed to allocate %llu targets\n", (unsigned long long)capacity);
+        return -1;
+    }
+
+    *array = addrs;
+    list->capacity = (uint32_t)capacity;
+    return 0;
+}
+
+void target_list_init(struct target_list *list)
+{
+    memset(list, 0, sizeof(struct target_list));
+}
+
+int target_list_add_spec(struct target_list *list, const char *spec)
+{
+    char address[TARGET_SPEC_MAX_LEN];
+    size_t spec_len = strlen(spec);
+    if (spec_len == 0 || spec_len >= sizeof(address))
+    {
+        fprintf(stderr, "Error: Invalid target '%s'\n", spec);
+        return -1;
+    }
+    memcpy(address, spec, spec_len + 1);
+
+    // 1. Split an optional "/prefix"; the family sets its bounds
+    sa_family_t family = strchr(address, ':') ? AF_INET6 : AF_INET;
+    long max_prefix = (family == AF_INET6) ? 128 : 32;
+    long min_prefix = (family == AF_INET6) ? TARGET_LIST_MIN_PREFIX_V6 : TARGET_LIST_MIN_PREFIX;
+    long prefix = max_prefix;
+    char *slash = strchr(address, '/');
+    if (slash)
+    {
+        *slash = '\0';
+        char *endptr;
+        prefix = strtol(slash + 1, &endptr, BASE10);
+        if (slash[1] == '\0' || *endptr != '\0' || prefix < min_prefix || prefix > max_prefix)
+        {
+            fprintf(stderr, "Error: Invalid prefix in '%s'. Must be /%li-/%li\n", spec, min_prefix, max_prefix);
+            return -1;
+        }
+    }
+
+    if (list->family != 0 && list->family != family)
+    {
+        fprintf(stderr, "Error: Target '%s' mixes IPv4 and IPv6 in one run\n", spec);
+        return -1;
+    }
+
+    if (family == AF_INET6)
+    {
+        struct in6_addr base;
+        if (inet_pton(AF_INET6, address, &base) != 1)
+        {
+            fprintf(stderr, "Error: Invalid target address '%s'\n", spec);
+            return -1;
+        }
+        list->family = AF_INET6;
+
+        // 2. Only the low 32 bits can vary (prefix >= /104); there is no broadcast to skip
+        uint32_t host_bits = (uint32_t)(128 - prefix);
+        uint32_t mask = (host_bits == 32) ? 0 : (UINT32_MAX << host_bits);
+        uint32_t low;
+        memcpy(&low, &base.s6_addr[12], sizeof(low));
+        uint32_t first = ntohl(low) & mask;
+        uint64_t size = (uint64_t)1 << host_bits;
+
+        if (reserve(list, size) != 0)
+        {
+            return -1;
+        }
+
+        for (uint64_t i = 0; i < size; i++)
+        {
+            struct in6_addr *addr = &list->addrs6[list->count++];
+            *addr = base;
+            low = htonl(first + (uint32_t)i);
+            memcpy(&addr->s6_addr[12], &low, sizeof(low));
+        }
+
+        return 0;
+    }
+
+    struct in_addr base;
+    if (inet_pton(AF_INET, address, &base) != 1)
+    {
+        fprintf(stderr, "Error: Invalid target address '%s'\n", spec);
+        return -1;
+    }
+    list->family = AF_INET;
+
+    // 2. Expand the range in host byte order; skip network/broadcast where they exist
+    uint32_t mask = UINT32_MAX << (32 - prefix);
+    uint32_t first = ntohl(base.s_addr) & mask;
+    uint64_t size = (uint64_t)1 << (32 - prefix);
+    if (prefix <= 30)
+    {
+        first++;
+        size -= 2;
+    }
+
+    if (reserve(list, size) != 0)
+    {
+        return -1;
+    }
+
+    for (uint64_t i = 0; i < size; i++)
+    {
+        list->addrs[list->count++].s_addr = htonl(first + (uint32_t)i);
+    }
+
+    return 0;
+}
+
+int target_list_load_file(struct target_list *list, const char *path)
+{
+    FILE *file = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    if (!file)
+    {
+        perror("Error: Failed to open target file");
+        return -1;
+    }
+
+    char line[256];
+    unsigned long line_number = 0;
+    int status = 0;
+
+    while (status == 0 && fgets(line, sizeof(line), file))
+    {
+        line_number++;
+
+        // Strip comments and surrounding whitespace
+        char *comment = strchr(line, '#');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+
+        char *start = line;
+        while (isspace((unsigned char)*start))
+        {
+            start++;
+        }
+
+        char *end = start + strlen(start);
+        while (end > start && isspace((unsigned char)end[-1]))
+        {
+            *--end = '\0';
+        }
+
+        if (*start != '\0' && target_list_add_spec(list, start) != 0)
+        {
+            fprintf(stderr, "Error: Rejected target at %s line %lu\n", path, line_number);
+            status = -1;
+        }
+    }
+
+    if (status == 0 && ferror(file))
+    {
+        perror("Error: Failed to read target file");
+        status = -1;
+    }
+
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+
+    return status;
+}
+
+/**
+ * @brief SplitMix64 step: a small, well-distributed generator that is plenty for a shuffle.
+ */
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void target_list_shuffle(struct target_list *list, uint64_t seed)
+{
+    uint64_t state = seed;
+
+    for (uint32_t i = list->count; i > 1; i--)
+    {
+        uint32_t j = (uint32_t)(splitmix64(&state) % i);
+        if (list->family == AF_INET6)
+        {
+            struct in6_addr tmp = list->addrs6[i - 1];
+            list->addrs6[i - 1] = list->addrs6[j];
+            list->addrs6[j] = tmp;
+        }
+        else
+        {
+            struct in_addr tmp = list->addrs[i - 1];
+            list->addrs[i - 1] = list->addrs[j];
+            list->addrs[j] = tmp;
+        }
+    }
+}
+
+void target_list_format(const struct target_list *list, uint32_t index, char *buffer, size_t size)
+{
+    if (list->family == AF_INET6)
+    {
+        inet_ntop(AF_INET6, &list->addrs6[index], buffer, (socklen_t)size);
+    }
+    else
+    {
+        inet_ntop(AF_INET, &list->addrs[index], buffer, (socklen_t)size);
+    }
+}
+
+void target_list_free(struct target_list *list)
+{
+    free(list->addrs);
+    free(list->addrs6);
+    memset(list, 0, sizeof(struct target_list));
+}
@@ -0,0 +1,90 @@
+/**
+ * @file target_list.h
+ * @brief Destination list for multi-target probing: parsed once to binary, then permuted.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef TARGET_LIST_H
+#define TARGET_LIST_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Shortest accepted CIDR prefix (a /8 expands to ~16.7 million targets).
+ */
+#define TARGET_LIST_MIN_PREFIX 8
+
+/**
+ * @brief Shortest accepted IPv6 CIDR prefix (a /104 expands to the same ~16.7 million targets).
+ */
+#define TARGET_LIST_MIN_PREFIX_V6 104
+
+/**
+ * @brief Buffer size that fits any formatted target of either family.
+ */
+#define TARGET_LIST_ADDRSTRLEN INET6_ADDRSTRLEN
+
+/**
+ * @struct target_list
+ * @brief Growable array of destinations in Network Byte Order, all of one address family.
+ */
+struct target_list
+{
+    sa_family_t family;      /**< AF_INET or AF_INET6, fixed by the first target added (0 while empty) */
+    struct in_addr *addrs;   /**< IPv4 destinations, in probing order once shuffled (NULL for IPv6 lists) */
+    struct in6_addr *addrs6; /**< IPv6 destinations, in probing order once shuffled (NULL for IPv4 lists) */
+    uint32_t count;          /**< Number of valid entries in the family's array */
+    uint32_t capacity;       /**< Allocated entries in the family's array */
+};
+
+/**
+ * @brief Initializes an empty list.
+ * @param list Pointer to the caller-allocated list.
+ */
+void target_list_init(struct target_list *list);
+
+/**
+ * @brief Appends a single address ("192.0.2.1", "2001:db8::1") or a CIDR range ("192.0.2.0/24", "2001:db8::/120").
+ *
+ * For IPv4 prefixes up to /30 the network and broadcast addresses are skipped, as they do not answer Echo.
+ * IPv4 and IPv6 targets cannot be mixed in one list.
+ *
+ * @param list Pointer to the list.
+ * @param spec Address or range string.
+ * @return 0 on success, -1 on a malformed spec or allocation failure.
+ */
+int target_list_add_spec(struct target_list *list, const char *spec);
+
+/**
+ * @brief Appends every spec in a file: one address or CIDR range per line, `#` starts a comment.
+ * @param list Pointer to the list.
+ * @param path File to read ("-" reads standard input).
+ * @return 0 on success, -1 if the file cannot be read or contains a malformed line.
+ */
+int target_list_load_file(struct target_list *list, const char *path);
+
+/**
+ * @brief Permutes the list (Fisher-Yates) so consecutive probes hit unrelated hosts and subnets.
+ * @param list Pointer to the list.
+ * @param seed Seed for the permutation; the same seed reproduces the same order.
+ */
+void target_list_shuffle(struct target_list *list, uint64_t seed);
+
+/**
+ * @brief Formats the target at @p index for display.
+ * @param list   Pointer to the list.
+ * @param index  Entry to format.
+ * @param buffer Output buffer of at least @ref TARGET_LIST_ADDRSTRLEN bytes.
+ * @param size   Size of @p buffer.
+ */
+void target_list_format(const struct target_list *list, uint32_t index, char *buffer, size_t size);
+
+/**
+ * @brief Releases the list's memory.
+ * @param list Pointer to the list.
+ */
+void target_list_free(struct target_list *list);
+
+#endif /* TARGET_LIST_H */
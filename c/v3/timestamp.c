@@ -0,0 +1,20 @@
+/**
+ * @file timestamp.c
+ * @brief Monotonic clock helpers shared by pacing, RTT measurement and reporting.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "timestamp.h"
+
+#include <time.h>
+
+uint64_t timestamp_now_ns(void)
+{
+    struct timespec ts;
+
+    // CLOCK_MONOTONIC is mandatory on every supported platform; it can only fail on a bad pointer
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * TIMESTAMP_NS_PER_SEC) + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file timestamp.h
+ * @brief Monotonic clock helpers shared by pacing, RTT measurement and reporting.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <stdint.h>
+
+/**
+ * @brief Nanoseconds per second.
+ */
+#define TIMESTAMP_NS_PER_SEC 1000000000ULL
+
+/**
+ * @brief Nanoseconds per millisecond.
+ */
+#define TIMESTAMP_NS_PER_MSEC 1000000ULL
+
+/**
+ * @brief Nanoseconds per microsecond.
+ */
+#define TIMESTAMP_NS_PER_USEC 1000ULL
+
+/**
+ * @brief Reads CLOCK_MONOTONIC as a single nanosecond count.
+ * @return Nanoseconds since an arbitrary, fixed point in the past. Immune to wall-clock steps.
+ */
+uint64_t timestamp_now_ns(void);
+
+#endif /* TIMESTAMP_H */
@@ -0,0 +1,404 @@
+/**
+ * @file traceroute.c
+ * @brief Single-round traceroute: every TTL is probed at once and the path rebuilt from the answers.
+ *
+ * @author Jim Diroff II
+ */
+#define _GNU_SOURCE /**< Exposes sendmmsg() and struct mmsghdr */
+
+#include "traceroute.h"
+#include "icmp_executor.h"
+#include "icmp_receiver.h"
+#include "packet_builder.h"
+#include "packet_parser.h"
+#include "target_list.h"
+#include "timestamp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief Bytes of the per-probe compensation word at the start of the payload.
+ */
+#define TRACEROUTE_COMPENSATION_SIZE 2
+
+/**
+ * @struct traceroute_burst
+ * @brief Every probe of one trace, prebuilt and handed to the kernel together.
+ */
+struct traceroute_burst
+{
+    uint8_t *packets;          /**< `count` datagrams of `stride` bytes each */
+    size_t stride;             /**< Bytes per datagram */
+    struct iovec *iovecs;      /**< One I/O vector per datagram */
+    struct mmsghdr *msgs;      /**< One message per datagram, all to the same address */
+    uint64_t *send_ns;         /**< Send timestamp of each datagram */
+    uint32_t count;            /**< Datagrams in the burst */
+    struct sockaddr_in addr;   /**< Destination (IPv4) */
+    struct sockaddr_in6 addr6; /**< Destination (IPv6) */
+};
+
+/**
+ * @brief Builds probe @p index (TTL `index / queries + 1`) into its slot of the burst.
+ * @return 0 on success, -1 if the datagram does not fit.
+ */
+static int build_probe(struct traceroute_burst *burst, const struct app_config *config, uint32_t target, uint32_t index, uint32_t queries, uint8_t *payload, size_t payload_len)
+{
+    const struct target_list *targets = config->targets;
+    uint16_t seq = (uint16_t)(config->icmp_v4_sequence + index);
+    uint8_t ttl = (uint8_t)(index / queries + 1);
+    uint8_t *buffer = burst->packets + (size_t)index * burst->stride;
+
+    // The sequence word plus its ones' complement always sums to 0xFFFF, so the ICMP checksum never changes
+    uint16_t compensation = (uint16_t)~htons(seq);
+    memcpy(payload, &compensation, sizeof(compensation));
+
+    size_t length;
+    if (targets->family == AF_INET6)
+    {
+        struct icmp_v6_echo_template tmpl;
+        length = build_icmp_v6_echo_template(&tmpl, buffer, burst->stride, &config->ip_v6_src, &targets->addrs6[target], ttl,
+                                             ICMP_V6_ECHO_CODE, config->icmp_v4_identifier, seq, payload, payload_len);
+    }
+    else
+    {
+        struct icmp_v4_echo_template tmpl;
+        length = build_icmp_v4_echo_template(&tmpl, buffer, burst->stride, config->ip_v4_src, targets->addrs[target], ttl,
+                                             ICMP_V4_ECHO_REQUEST, ICMP_V4_ECHO_CODE, config->icmp_v4_identifier, seq,
+                                             config->dont_fragment ? IP_V4_FLAG_DF : 0, payload, payload_len);
+    }
+    if (length == 0)
+    {
+        return -1;
+    }
+
+    burst->iovecs[index].iov_base = buffer;
+    burst->iovecs[index].iov_len = length;
+    burst->msgs[index].msg_hdr.msg_iov = &burst->iovecs[index];
+    burst->msgs[index].msg_hdr.msg_iovlen = 1;
+    if (targets->family == AF_INET6)
+    {
+        burst->msgs[index].msg_hdr.msg_name = &burst->addr6;
+        burst->msgs[index].msg_hdr.msg_namelen = sizeof(burst->addr6);
+    }
+    else
+    {
+        burst->msgs[index].msg_hdr.msg_name = &burst->addr;
+        burst->msgs[index].msg_hdr.msg_namelen = sizeof(burst->addr);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Releases the burst's buffers. Safe to call on a partially allocated burst.
+ */
+static void burst_free(struct traceroute_burst *burst)
+{
+    free(burst->packets);
+    free(burst->iovecs);
+    free(burst->msgs);
+    free(burst->send_ns);
+    memset(burst, 0, sizeof(struct traceroute_burst));
+}
+
+/**
+ * @brief Allocates and builds every probe for TTLs 1 to @p hops, @p queries each.
+ * @return 0 on success, -1 on failure.
+ */
+static int burst_build(struct traceroute_burst *burst, const struct app_config *config, uint32_t target, uint32_t hops, uint32_t queries)
+{
+    const struct target_list *targets = config->targets;
+    memset(burst, 0, sizeof(struct traceroute_burst));
+    burst->count = hops * queries;
+
+    // 1. One payload: the compensation word, then the configured bytes
+    size_t payload_len = TRACEROUTE_COMPENSATION_SIZE + config->payload_len;
+    size_t headers = (targets->family == AF_INET6) ? sizeof(struct ip_v6_header) + sizeof(struct icmp_v6_header) + sizeof(struct icmp_v6_echo_header)
+                                                   : sizeof(struct ip_v4_header) + sizeof(struct icmp_v4_header) + sizeof(struct icmp_v4_echo_header);
+    burst->stride = headers + payload_len;
+    if ((targets->family == AF_INET && burst->stride > IP_V4_MAX_PACKET_SIZE) ||
+        (targets->family == AF_INET6 && burst->stride - sizeof(struct ip_v6_header) > UINT16_MAX))
+    {
+        fprintf(stderr, "Error: Payload of %zu bytes does not fit a traceroute probe\n", config->payload_len);
+        return -1;
+    }
+
+    uint8_t *payload = malloc(payload_len);
+    burst->packets = malloc((size_t)burst->count * burst->stride);
+    burst->iovecs = calloc(burst->count, sizeof(struct iovec));
+    burst->msgs = calloc(burst->count, sizeof(struct mmsghdr));
+    burst->send_ns = calloc(burst->count, sizeof(uint64_t));
+    if (!payload || !burst->packets || !burst->iovecs || !burst->msgs || !burst->send_ns)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u traceroute probes\n", burst->count);
+        free(payload);
+        burst_free(burst);
+        return -1;
+    }
+    if (config->payload_len > 0)
+    {
+        memcpy(payload + TRACEROUTE_COMPENSATION_SIZE, config->payload, config->payload_len);
+    }
+
+    // 2. Every probe goes to the same address; only the TTL, sequence and compensation word differ
+    burst->addr.sin_family = AF_INET;
+    burst->addr6.sin6_family = AF_INET6;
+    if (targets->family == AF_INET6)
+    {
+        burst->addr6.sin6_addr = targets->addrs6[target];
+    }
+    else
+    {
+        burst->addr.sin_addr = targets->addrs[target];
+    }
+
+    for (uint32_t i = 0; i < burst->count; i++)
+    {
+        if (build_probe(burst, config, target, i, queries, payload, payload_len) != 0)
+        {
+            fprintf(stderr, "Error: Failed to build traceroute probe %u\n", i);
+            free(payload);
+            burst_free(burst);
+            return -1;
+        }
+    }
+
+    free(payload);
+    return 0;
+}
+
+/**
+ * @brief Sends the whole burst, retrying partial `sendmmsg` results.
+ * @return 0 on success, -1 on failure.
+ */
+static int burst_send(int sockfd, struct traceroute_burst *burst)
+{
+    uint32_t sent = 0;
+    while (sent < burst->count)
+    {
+        uint32_t count = burst->count - sent;
+        count = (count < ICMP_SESSION_MAX_BATCH) ? count : ICMP_SESSION_MAX_BATCH;
+
+        uint64_t now_ns = timestamp_now_ns();
+        int rc = sendmmsg(sockfd, &burst->msgs[sent], count, 0);
+        if (rc < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (rc <= 0)
+        {
+            perror("Error: Failed to send traceroute probes");
+            return -1;
+        }
+        for (int i = 0; i < rc; i++)
+        {
+            burst->send_ns[sent + (uint32_t)i] = now_ns;
+        }
+        sent += (uint32_t)rc;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Records the answer to the probe carrying @p seq, if it is ours and still unanswered.
+ */
+static void record(struct traceroute_result *result, const struct traceroute_burst *burst, uint16_t first_sequence, uint16_t seq,
+                   uint8_t status, uint8_t code, const struct in_addr *from, const struct in6_addr *from6, uint64_t recv_ns)
+{
+    uint16_t index = (uint16_t)(seq - first_sequence);
+    if (index >= burst->count || result->probes[index].status != TRACEROUTE_PENDING)
+    {
+        return;
+    }
+
+    struct traceroute_probe *probe = &result->probes[index];
+    probe->status = status;
+    probe->code = code;
+    probe->rtt_ns = recv_ns - burst->send_ns[index];
+    if (from)
+    {
+        probe->from = *from;
+    }
+    if (from6)
+    {
+        probe->from6 = *from6;
+    }
+
+    // The path ends at the nearest TTL the destination answered or was declared unreachable at
+    uint32_t ttl = index / result->queries + 1;
+    if (status != TRACEROUTE_HOP && (result->last_hop == 0 || ttl < result->last_hop))
+    {
+        result->last_hop = ttl;
+    }
+}
+
+/**
+ * @brief Sorts one received datagram (IPv4, header included) or ICMPv6 message from @p src6 into the result.
+ */
+static void receive_one(struct traceroute_result *result, const struct traceroute_burst *burst, const struct app_config *config, uint32_t target,
+                        const uint8_t *data, size_t length, const struct in6_addr *src6, uint64_t recv_ns)
+{
+    const struct target_list *targets = config->targets;
+    uint16_t first = config->icmp_v4_sequence;
+    struct icmp_error error;
+
+    if (targets->family == AF_INET6)
+    {
+        // 1. Echo Reply: the destination itself
+        struct icmp_v6_view view;
+        if (packet_parse_icmp_v6(data, length, NULL, NULL, 0, &view) == PACKET_PARSE_OK && view.icmp->type == ICMP_V6_ECHO_REPLY &&
+            ntohs(view.echo->identifier) == config->icmp_v4_identifier && memcmp(src6, &targets->addrs6[target], sizeof(struct in6_addr)) == 0)
+        {
+            record(result, burst, first, ntohs(view.echo->sequence), TRACEROUTE_REACHED, 0, NULL, src6, recv_ns);
+            return;
+        }
+
+        // 2. Errors quoting one of our probes: a router on the way, or the end of the road
+        if (icmp_parse_error_v6(data, length, src6, &error) && error.identifier == config->icmp_v4_identifier &&
+            memcmp(&error.original6, &targets->addrs6[target], sizeof(struct in6_addr)) == 0)
+        {
+            uint8_t status = (error.type == ICMP_V6_TIME_EXCEEDED) ? TRACEROUTE_HOP : TRACEROUTE_UNREACHABLE;
+            record(result, burst, first, error.sequence, status, error.code, NULL, &error.reporter6, recv_ns);
+        }
+        return;
+    }
+
+    // 1. Echo Reply: the destination itself
+    struct icmp_v4_view view;
+    if (packet_parse_icmp_v4(data, length, PACKET_PARSE_VERIFY_ICMP, &view) == PACKET_PARSE_OK && view.icmp->type == ICMP_V4_ECHO_REPLY &&
+        ntohs(view.echo->identifier) == config->icmp_v4_identifier && view.ip.header->src == targets->addrs[target].s_addr)
+    {
+        struct in_addr from = {.s_addr = view.ip.header->src};
+        record(result, burst, first, ntohs(view.echo->sequence), TRACEROUTE_REACHED, 0, &from, NULL, recv_ns);
+        return;
+    }
+
+    // 2. Errors quoting one of our probes: a router on the way, or the end of the road
+    if (icmp_parse_error_v4(data, length, &error) && error.identifier == config->icmp_v4_identifier && error.original.s_addr == targets->addrs[target].s_addr)
+    {
+        uint8_t status = (error.type == ICMP_V4_TIME_EXCEEDED) ? TRACEROUTE_HOP : TRACEROUTE_UNREACHABLE;
+        record(result, burst, first, error.sequence, status, error.code, &error.reporter, NULL, recv_ns);
+    }
+}
+
+/**
+ * @brief Reports whether every probe up to the last needed TTL has been answered.
+ */
+static int complete(const struct traceroute_result *result)
+{
+    uint32_t needed = (result->last_hop > 0) ? result->last_hop * result->queries : result->hops * result->queries;
+    for (uint32_t i = 0; i < needed; i++)
+    {
+        if (result->probes[i].status == TRACEROUTE_PENDING)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int traceroute_run(const struct app_config *config, uint32_t target, uint32_t hops, uint32_t queries, struct traceroute_result *result)
+{
+    memset(result, 0, sizeof(struct traceroute_result));
+    if (hops == 0 || hops > TRACEROUTE_MAX_HOPS || queries == 0 || queries > TRACEROUTE_MAX_QUERIES)
+    {
+        fprintf(stderr, "Error: Invalid traceroute of %u hops and %u probes per hop\n", hops, queries);
+        return -1;
+    }
+
+    // 1. Socket (with ICMPv6 errors let through), answer slots and the prebuilt burst
+    int sockfd = icmp_socket_open(config->targets->family, config->icmp_v4_identifier, 1);
+    if (sockfd < 0)
+    {
+        return -1;
+    }
+
+    struct traceroute_burst burst;
+    result->probes = calloc((size_t)hops * queries, sizeof(struct traceroute_probe));
+    if (!result->probes)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u traceroute answers\n", hops * queries);
+        close(sockfd);
+        return -1;
+    }
+    result->hops = hops;
+    result->queries = queries;
+    uint8_t *incoming = malloc(IP_V4_MAX_PACKET_SIZE);
+    if (!incoming || burst_build(&burst, config, target, hops, queries) != 0)
+    {
+        if (!incoming)
+        {
+            fprintf(stderr, "Error: Failed to allocate the receive buffer\n");
+        }
+        free(incoming);
+        traceroute_result_free(result);
+        close(sockfd);
+        return -1;
+    }
+
+    // 2. Every TTL at once
+    int rc = burst_send(sockfd, &burst);
+    uint64_t start_ns = burst.send_ns[0];
+    uint64_t deadline_ns = timestamp_now_ns() + (uint64_t)config->reply_timeout_ms * TIMESTAMP_NS_PER_MSEC;
+
+    // 3. Sort the answers into hops until the path is complete or the timeout passes
+    uint64_t now_ns = timestamp_now_ns();
+    while (rc == 0 && !complete(result) && now_ns < deadline_ns)
+    {
+        struct pollfd pfd = {.fd = sockfd, .events = POLLIN};
+        int ready = poll(&pfd, 1, (int)((deadline_ns - now_ns + TIMESTAMP_NS_PER_MSEC - 1) / TIMESTAMP_NS_PER_MSEC));
+        if (ready < 0 && errno != EINTR)
+        {
+            perror("Error: poll failed");
+            rc = -1;
+        }
+
+        while (rc == 0 && ready > 0)
+        {
+            struct sockaddr_in6 sender;
+            socklen_t sender_len = sizeof(sender);
+            ssize_t n = recvfrom(sockfd, incoming, IP_V4_MAX_PACKET_SIZE, MSG_DONTWAIT, (struct sockaddr *)&sender, &sender_len);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            if (n < 0)
+            {
+                perror("Error: Failed to receive packet");
+                rc = -1;
+                break;
+            }
+            receive_one(result, &burst, config, target, incoming, (size_t)n, &sender.sin6_addr, timestamp_now_ns());
+        }
+        now_ns = timestamp_now_ns();
+    }
+    result->elapsed_ns = timestamp_now_ns() - start_ns;
+
+    free(incoming);
+    burst_free(&burst);
+    close(sockfd);
+    if (rc != 0)
+    {
+        traceroute_result_free(result);
+    }
+    return rc;
+}
+
+void traceroute_result_free(struct traceroute_result *result)
+{
+    free(result->probes);
+    memset(result, 0, sizeof(struct traceroute_result));
+}
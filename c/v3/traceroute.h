@@ -0,0 +1,103 @@
+/**
+ * @file traceroute.h
+ * @brief Single-round traceroute: every TTL is probed at once and the path rebuilt from the answers.
+ *
+ * @note A classic traceroute waits for each hop before probing the next. Here the probes for every
+ *       TTL from 1 to the hop limit leave in one `sendmmsg` burst, and the Time Exceeded messages,
+ *       Destination Unreachables and Echo Replies are sorted back into hops as they arrive, so the
+ *       whole path takes about one round trip to the farthest hop.
+ *
+ *       A probe's position is carried in its Echo sequence (and the IPv4 identification, which the
+ *       builder sets to the same value); both come back quoted in every ICMP error.
+ *
+ *       Probes are Paris-style: load balancers hash the first transport bytes, which for ICMP are the
+ *       type, code and checksum. Every probe carries the same identifier, and a compensation word at the
+ *       start of its payload keeps the checksum identical (sequence plus its ones' complement is
+ *       constant), so every probe follows the same ECMP path.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef TRACEROUTE_H
+#define TRACEROUTE_H
+
+#include "app_config.h"
+
+#include <netinet/in.h>
+#include <stdint.h>
+
+/**
+ * @brief Largest hop limit a traceroute accepts.
+ */
+#define TRACEROUTE_MAX_HOPS 255
+
+/**
+ * @brief Hop limit when none is given.
+ */
+#define TRACEROUTE_DEFAULT_HOPS 30
+
+/**
+ * @brief Largest number of probes per hop.
+ */
+#define TRACEROUTE_MAX_QUERIES 8
+
+/**
+ * @enum traceroute_status
+ * @brief What answered one probe.
+ */
+enum traceroute_status
+{
+    TRACEROUTE_PENDING = 0,    /**< No answer within the reply timeout */
+    TRACEROUTE_HOP = 1,        /**< Time Exceeded from a router on the path */
+    TRACEROUTE_REACHED = 2,    /**< Echo Reply from the destination itself */
+    TRACEROUTE_UNREACHABLE = 3 /**< Destination Unreachable, from a router or the destination */
+};
+
+/**
+ * @struct traceroute_probe
+ * @brief The answer to one probe.
+ */
+struct traceroute_probe
+{
+    struct in_addr from;   /**< Host that answered (IPv4) */
+    struct in6_addr from6; /**< Host that answered (IPv6) */
+    uint64_t rtt_ns;       /**< Receive timestamp minus send timestamp */
+    uint8_t status;        /**< A @ref traceroute_status value */
+    uint8_t code;          /**< ICMP code of a @ref TRACEROUTE_UNREACHABLE answer */
+};
+
+/**
+ * @struct traceroute_result
+ * @brief Every probe's answer, `queries` consecutive entries per TTL.
+ */
+struct traceroute_result
+{
+    struct traceroute_probe *probes; /**< `hops * queries` entries; probe `q` of TTL `t` is at `(t - 1) * queries + q` */
+    uint32_t hops;                   /**< Highest TTL probed */
+    uint32_t queries;                /**< Probes per TTL */
+    uint32_t last_hop;               /**< Lowest TTL at which the destination (or an unreachable) answered, or 0 */
+    uint64_t elapsed_ns;             /**< From the first send until the last needed answer (or the timeout) */
+};
+
+/**
+ * @brief Traces the path to target @p target.
+ *
+ * Probes use the configured source, identifier, first sequence and payload (after the 2-byte
+ * compensation word). Reception stops once every TTL up to @ref traceroute_result::last_hop is
+ * answered, or `reply_timeout_ms` after the burst.
+ *
+ * @param config  Pointer to the application configuration (its target list selects the family).
+ * @param target  Index of the destination in the target list.
+ * @param hops    Highest TTL to probe, 1-@ref TRACEROUTE_MAX_HOPS.
+ * @param queries Probes per TTL, 1-@ref TRACEROUTE_MAX_QUERIES.
+ * @param result  Output for the answers; release with @ref traceroute_result_free.
+ * @return 0 on success, -1 on failure (the result is left empty and the reason printed).
+ */
+int traceroute_run(const struct app_config *config, uint32_t target, uint32_t hops, uint32_t queries, struct traceroute_result *result);
+
+/**
+ * @brief Releases the answers. Safe to call on an empty result.
+ * @param result Pointer to the result.
+ */
+void traceroute_result_free(struct traceroute_result *result);
+
+#endif /* TRACEROUTE_H */
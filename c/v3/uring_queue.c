@@ -0,0 +1,501 @@
+/**
+ * @file uring_queue.c
+ * @brief io_uring submission and completion queues driving asynchronous sends and multishot receives on one raw socket.
+ *
+ * @note Built on the raw `io_uring_setup`/`io_uring_enter`/`io_uring_register` system calls; no liburing dependency.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "uring_queue.h"
+#include "ip_v4.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief `user_data` of the multishot receive; sends carry their slot index, which is always smaller.
+ */
+#define URING_QUEUE_RECV_TAG (1ULL << 32)
+
+/**
+ * @brief Provided buffer group of the receive buffers.
+ */
+#define URING_QUEUE_BUFFER_GROUP 0
+
+/**
+ * @brief Registered file index of the raw socket.
+ */
+#define URING_QUEUE_SOCKET_INDEX 0
+
+/**
+ * @brief How long the submission poller spins without work before it sleeps and needs a wakeup.
+ */
+#define URING_QUEUE_SQ_IDLE_MS 100
+
+/**
+ * @brief Extra room for IPv4 options on replies, beyond the minimum header our requests carry.
+ */
+#define URING_QUEUE_IP_OPTIONS_SLACK (IP_V4_MAX_IHL * 4 - IP_V4_MIN_IHL * 4)
+
+static int sys_io_uring_setup(uint32_t entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, uint32_t opcode, const void *arg, uint32_t nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static uint32_t next_power_of_two(uint32_t value)
+{
+    uint32_t power = 1;
+    while (power < value)
+    {
+        power <<= 1;
+    }
+    return power;
+}
+
+/**
+ * @brief Reserves the next submission entry; the ring holds more entries than slots plus the receive, so one is always free.
+ */
+static struct io_uring_sqe *next_sqe(struct uring_queue *queue)
+{
+    struct io_uring_sqe *sqe = &queue->sqes[(*queue->sq_tail + queue->sq_pending) & queue->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    queue->sq_pending++;
+    return sqe;
+}
+
+/**
+ * @brief Queues the multishot receive; it keeps posting one completion per datagram until buffers run out.
+ */
+static void arm_receive(struct uring_queue *queue)
+{
+    struct io_uring_sqe *sqe = next_sqe(queue);
+    sqe->opcode = (queue->family == AF_INET6) ? IORING_OP_RECVMSG : IORING_OP_RECV;
+    sqe->fd = URING_QUEUE_SOCKET_INDEX;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = URING_QUEUE_BUFFER_GROUP;
+    sqe->user_data = URING_QUEUE_RECV_TAG;
+    if (queue->family == AF_INET6)
+    {
+        sqe->addr = (uint64_t)(uintptr_t)&queue->recv_msg;
+    }
+
+    queue->recv_armed = 1;
+}
+
+/**
+ * @brief Consumes every posted completion: sends free their slot, receives are queued as ready buffers.
+ */
+static void reap_completions(struct uring_queue *queue)
+{
+    uint32_t head = *queue->cq_head;
+    uint32_t tail = __atomic_load_n(queue->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail)
+    {
+        const struct io_uring_cqe *cqe = &queue->cqes[head & queue->cq_mask];
+
+        if (cqe->user_data == URING_QUEUE_RECV_TAG)
+        {
+            queue->recv_armed = (cqe->flags & IORING_CQE_F_MORE) ? queue->recv_armed : 0;
+            if (cqe->res >= 0 && (cqe->flags & IORING_CQE_F_BUFFER))
+            {
+                // Each buffer id is outstanding at most once, so the ready queue can never overflow
+                uint32_t at = (queue->ready_head + queue->ready_count) & (URING_QUEUE_RECV_BUFFERS - 1);
+                queue->ready[at] = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                queue->ready_len[at] = (uint32_t)cqe->res;
+                queue->ready_count++;
+            }
+            else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED && queue->error == 0)
+            {
+                queue->error = -cqe->res; /**< Running out of buffers only pauses reception until they are released */
+            }
+        }
+        else
+        {
+            queue->slot_free[queue->slot_free_count++] = (uint32_t)cqe->user_data;
+            if (cqe->res < 0 && queue->error == 0)
+            {
+                queue->error = -cqe->res;
+            }
+        }
+
+        head++;
+    }
+
+    __atomic_store_n(queue->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Reports a recorded asynchronous failure.
+ * @return -1 if one was recorded, 0 otherwise.
+ */
+static int check_error(const struct uring_queue *queue)
+{
+    if (queue->error == 0)
+    {
+        return 0;
+    }
+
+    fprintf(stderr, "Error: An io_uring socket operation failed: %s\n", strerror(queue->error));
+    return -1;
+}
+
+int uring_queue_open(struct uring_queue *queue, int sockfd, sa_family_t family, uint32_t send_slots, size_t max_packet_len, uint8_t sq_poll)
+{
+    memset(queue, 0, sizeof(struct uring_queue));
+    queue->fd = -1;
+    queue->family = family;
+    queue->sq_poll = sq_poll;
+
+    // 1. Room for every slot plus the receive in the submission queue, and for all of them at once in the completion queue
+    uint32_t slots = (send_slots > URING_QUEUE_MIN_SLOTS) ? send_slots : URING_QUEUE_MIN_SLOTS;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | (sq_poll ? IORING_SETUP_SQPOLL : 0);
+    params.cq_entries = next_power_of_two(slots + URING_QUEUE_RECV_BUFFERS + 1);
+    params.sq_thread_idle = URING_QUEUE_SQ_IDLE_MS;
+
+    queue->fd = sys_io_uring_setup(next_power_of_two(slots + 1), &params);
+    if (queue->fd < 0)
+    {
+        queue->fd = -1;
+        perror("Error: Failed to create the io_uring instance");
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+    {
+        fprintf(stderr, "Error: The kernel's io_uring lacks single-mmap rings or overflow protection\n");
+        uring_queue_close(queue);
+        return -1;
+    }
+
+    // 2. Map the submission and completion rings (one mapping) and the entry array
+    size_t sq_len = params.sq_off.array + (params.sq_entries * sizeof(uint32_t));
+    size_t cq_len = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+    queue->ring_map_len = (sq_len > cq_len) ? sq_len : cq_len;
+    queue->ring_map = mmap(NULL, queue->ring_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, queue->fd, IORING_OFF_SQ_RING);
+    queue->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    queue->sqes = mmap(NULL, queue->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, queue->fd, IORING_OFF_SQES);
+    if (queue->ring_map == MAP_FAILED || queue->sqes == MAP_FAILED)
+    {
+        perror("Error: Failed to map the io_uring rings");
+        queue->ring_map = (queue->ring_map == MAP_FAILED) ? NULL : queue->ring_map;
+        queue->sqes = (queue->sqes == MAP_FAILED) ? NULL : queue->sqes;
+        uring_queue_close(queue);
+        return -1;
+    }
+
+    uint8_t *ring = queue->ring_map;
+    queue->sq_head = (uint32_t *)(ring + params.sq_off.head);
+    queue->sq_tail = (uint32_t *)(ring + params.sq_off.tail);
+    queue->sq_flags = (uint32_t *)(ring + params.sq_off.flags);
+    queue->sq_array = (uint32_t *)(ring + params.sq_off.array);
+    queue->sq_mask = *(const uint32_t *)(ring + params.sq_off.ring_mask);
+    queue->cq_head = (uint32_t *)(ring + params.cq_off.head);
+    queue->cq_tail = (uint32_t *)(ring + params.cq_off.tail);
+    queue->cq_mask = *(const uint32_t *)(ring + params.cq_off.ring_mask);
+    queue->cqes = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+
+    // Ring position i always submits entry i, so the index array is written once
+    for (uint32_t i = 0; i < params.sq_entries; i++)
+    {
+        queue->sq_array[i] = i;
+    }
+
+    // 3. Register the socket, so no submission takes a file reference
+    int fds[1] = {sockfd};
+    if (sys_io_uring_register(queue->fd, IORING_REGISTER_FILES, fds, 1) < 0)
+    {
+        perror("Error: Failed to register the socket with io_uring");
+        uring_queue_close(queue);
+        return -1;
+    }
+
+    // 4. Provided buffers: the kernel picks one per received datagram, with no receive buffer passed per call
+    size_t payload_len = max_packet_len + URING_QUEUE_IP_OPTIONS_SLACK;
+    if (family == AF_INET6)
+    {
+        payload_len += sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in6) + CMSG_SPACE(sizeof(int));
+    }
+    queue->recv_buffer_len = (payload_len + 63) & ~(size_t)63;
+    queue->buf_ring_len = URING_QUEUE_RECV_BUFFERS * sizeof(struct io_uring_buf);
+    void *buf_ring = mmap(NULL, queue->buf_ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    queue->buf_ring = (buf_ring == MAP_FAILED) ? NULL : buf_ring;
+    queue->recv_memory = calloc(URING_QUEUE_RECV_BUFFERS, queue->recv_buffer_len);
+    queue->ready = calloc(URING_QUEUE_RECV_BUFFERS, sizeof(uint16_t));
+    queue->ready_len = calloc(URING_QUEUE_RECV_BUFFERS, sizeof(uint32_t));
+    queue->slot_free = calloc(slots, sizeof(uint32_t));
+    if (!queue->buf_ring || !queue->recv_memory || !queue->ready || !queue->ready_len || !queue->slot_free)
+    {
+        fprintf(stderr, "Error: Failed to allocate the io_uring buffers\n");
+        uring_queue_close(queue);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)queue->buf_ring;
+    reg.ring_entries = URING_QUEUE_RECV_BUFFERS;
+    reg.bgid = URING_QUEUE_BUFFER_GROUP;
+    if (sys_io_uring_register(queue->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        perror("Error: Failed to register the io_uring receive buffers");
+        uring_queue_close(queue);
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < URING_QUEUE_RECV_BUFFERS; i++)
+    {
+        uring_queue_release(queue, i);
+    }
+
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        queue->slot_free[i] = slots - 1 - i;
+    }
+    queue->slot_free_count = slots;
+    queue->send_slots = slots;
+
+    // 5. Arm the receive: IPv6 also asks for the sender and the hop limit
+    queue->recv_msg.msg_namelen = sizeof(struct sockaddr_in6);
+    queue->recv_msg.msg_controllen = CMSG_SPACE(sizeof(int));
+    arm_receive(queue);
+    if (uring_queue_submit(queue) != 0)
+    {
+        uring_queue_close(queue);
+        return -1;
+    }
+
+    return 0;
+}
+
+int uring_queue_acquire(struct uring_queue *queue, uint32_t *slot)
+{
+    reap_completions(queue);
+
+    while (queue->slot_free_count == 0)
+    {
+        // Every slot is queued or in flight: make sure they were submitted, then wait for a completion
+        if (check_error(queue) != 0 || uring_queue_submit(queue) != 0)
+        {
+            return -1;
+        }
+
+        if (sys_io_uring_enter(queue->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+        {
+            perror("Error: Failed to wait for io_uring completions");
+            return -1;
+        }
+        reap_completions(queue);
+    }
+
+    if (check_error(queue) != 0)
+    {
+        return -1;
+    }
+
+    *slot = queue->slot_free[--queue->slot_free_count];
+    return 0;
+}
+
+void uring_queue_send(struct uring_queue *queue, uint32_t slot, const void *data, size_t length, const struct sockaddr *addr, socklen_t addrlen)
+{
+    // A plain send with a destination (sendto) needs no per-packet msghdr for the kernel to copy in
+    struct io_uring_sqe *sqe = next_sqe(queue);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = URING_QUEUE_SOCKET_INDEX;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = (uint32_t)length;
+    sqe->addr2 = (uint64_t)(uintptr_t)addr;
+    sqe->addr_len = (uint16_t)addrlen;
+    sqe->user_data = slot;
+}
+
+/**
+ * @brief Publishes the queued entries and makes the kernel consume them, ignoring any recorded error.
+ */
+static int submit_pending(struct uring_queue *queue)
+{
+    if (queue->sq_pending == 0)
+    {
+        return 0;
+    }
+
+    uint32_t to_submit = queue->sq_pending;
+    queue->sq_pending = 0;
+    __atomic_store_n(queue->sq_tail, *queue->sq_tail + to_submit, __ATOMIC_RELEASE);
+
+    // 1. The poller picks up new entries by itself; it only needs a system call once it went idle
+    if (queue->sq_poll)
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if ((__atomic_load_n(queue->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP) &&
+            sys_io_uring_enter(queue->fd, 0, 0, IORING_ENTER_SQ_WAKEUP) < 0)
+        {
+            perror("Error: Failed to wake the io_uring submission poller");
+            return -1;
+        }
+        return 0;
+    }
+
+    // 2. Otherwise one call submits the whole batch, resuming if it was interrupted part way
+    while (to_submit > 0)
+    {
+        int rc = sys_io_uring_enter(queue->fd, to_submit, 0, 0);
+        if (rc < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            {
+                reap_completions(queue);
+                continue;
+            }
+            perror("Error: Failed to submit to io_uring");
+            return -1;
+        }
+        to_submit -= (uint32_t)rc;
+    }
+
+    return 0;
+}
+
+int uring_queue_submit(struct uring_queue *queue)
+{
+    if (check_error(queue) != 0)
+    {
+        return -1;
+    }
+
+    return submit_pending(queue);
+}
+
+int uring_queue_receive(struct uring_queue *queue, struct uring_message *message)
+{
+    // Re-arm once every buffer is back: arming earlier would only end again with -ENOBUFS
+    if (!queue->recv_armed && queue->ready_count == 0)
+    {
+        arm_receive(queue);
+        if (uring_queue_submit(queue) != 0)
+        {
+            return -1;
+        }
+    }
+
+    reap_completions(queue);
+    if (check_error(queue) != 0)
+    {
+        return -1;
+    }
+    if (queue->ready_count == 0)
+    {
+        return 0;
+    }
+
+    uint16_t buffer = queue->ready[queue->ready_head];
+    size_t length = queue->ready_len[queue->ready_head];
+    queue->ready_head = (queue->ready_head + 1) & (URING_QUEUE_RECV_BUFFERS - 1);
+    queue->ready_count--;
+
+    const uint8_t *data = queue->recv_memory + ((size_t)buffer * queue->recv_buffer_len);
+    memset(message, 0, sizeof(struct uring_message));
+    message->buffer = buffer;
+
+    if (queue->family != AF_INET6)
+    {
+        message->data = data;
+        message->length = length;
+        return 1;
+    }
+
+    // 1. A multishot recvmsg buffer holds a header, then the name and control areas at their full reserved sizes
+    const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out *)data;
+    size_t offset = sizeof(struct io_uring_recvmsg_out) + queue->recv_msg.msg_namelen + queue->recv_msg.msg_controllen;
+    if (length < offset)
+    {
+        message->length = 0; /**< Nothing usable; the caller still releases the buffer */
+        return 1;
+    }
+
+    message->sender = (const struct sockaddr_in6 *)(data + sizeof(struct io_uring_recvmsg_out));
+    message->control = data + sizeof(struct io_uring_recvmsg_out) + queue->recv_msg.msg_namelen;
+    message->control_len = (out->controllen < queue->recv_msg.msg_controllen) ? out->controllen : queue->recv_msg.msg_controllen;
+    message->data = data + offset;
+    message->length = (out->payloadlen < length - offset) ? out->payloadlen : length - offset;
+    return 1;
+}
+
+void uring_queue_release(struct uring_queue *queue, uint16_t buffer)
+{
+    // At most URING_QUEUE_RECV_BUFFERS buffers exist, so the ring always has room
+    struct io_uring_buf *buf = &queue->buf_ring->bufs[queue->buf_tail & (URING_QUEUE_RECV_BUFFERS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(queue->recv_memory + ((size_t)buffer * queue->recv_buffer_len));
+    buf->len = (uint32_t)queue->recv_buffer_len;
+    buf->bid = buffer;
+    queue->buf_tail++;
+    __atomic_store_n(&queue->buf_ring->tail, queue->buf_tail, __ATOMIC_RELEASE);
+}
+
+void uring_queue_close(struct uring_queue *queue)
+{
+    if (queue->fd >= 0)
+    {
+        // 1. Sends still in flight read their slots; let them finish before the caller frees the templates
+        int rc = submit_pending(queue);
+        while (rc == 0 && queue->slot_free_count < queue->send_slots)
+        {
+            if (sys_io_uring_enter(queue->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            {
+                break;
+            }
+            reap_completions(queue);
+        }
+
+        // 2. Closing the instance cancels the multishot receive and drops every registration
+        close(queue->fd);
+        queue->fd = -1;
+    }
+
+    if (queue->ring_map)
+    {
+        munmap(queue->ring_map, queue->ring_map_len);
+        queue->ring_map = NULL;
+    }
+    if (queue->sqes)
+    {
+        munmap(queue->sqes, queue->sqes_len);
+        queue->sqes = NULL;
+    }
+    if (queue->buf_ring)
+    {
+        munmap(queue->buf_ring, queue->buf_ring_len);
+        queue->buf_ring = NULL;
+    }
+
+    free(queue->recv_memory);
+    free(queue->ready);
+    free(queue->ready_len);
+    free(queue->slot_free);
+    queue->recv_memory = NULL;
+    queue->ready = NULL;
+    queue->ready_len = NULL;
+    queue->slot_free = NULL;
+    queue->send_slots = 0;
+    queue->slot_free_count = 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file uring_queue.h
+ * @brief io_uring submission and completion queues driving asynchronous sends and multishot receives on one raw socket.
+ *
+ * @note Send slots are handed out from a free stack and come back when their completion is reaped, so a
+ *       slot's datagram and address are never rewritten while the kernel may still read them.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef URING_QUEUE_H
+#define URING_QUEUE_H
+
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Provided buffers the kernel fills with replies (also the buffer ring size; a power of two).
+ */
+#define URING_QUEUE_RECV_BUFFERS 1024
+
+/**
+ * @brief Smallest number of send slots, so short batches still keep a useful number of sends in flight.
+ */
+#define URING_QUEUE_MIN_SLOTS 256
+
+/**
+ * @struct uring_message
+ * @brief One received datagram, still in its provided buffer.
+ */
+struct uring_message
+{
+    const uint8_t *data;                /**< Payload: the whole IPv4 datagram, or the ICMPv6 message */
+    size_t length;                      /**< Bytes at @ref data */
+    const struct sockaddr_in6 *sender;  /**< Sender address (IPv6 only, NULL for IPv4) */
+    const void *control;                /**< Ancillary data (IPv6 only) */
+    size_t control_len;                 /**< Bytes at @ref control */
+    uint16_t buffer;                    /**< Provided buffer id, to pass to @ref uring_queue_release */
+};
+
+/**
+ * @struct uring_queue
+ * @brief One io_uring instance bound to a registered raw socket.
+ *
+ * IPv4 replies arrive through a multishot `recv`; IPv6 replies through a multishot `recvmsg`, since
+ * the hop limit is only available as ancillary data. Both pick their buffers from a registered ring.
+ */
+struct uring_queue
+{
+    int fd;                             /**< io_uring instance, or -1 when closed */
+    sa_family_t family;                 /**< AF_INET or AF_INET6, selecting the receive operation */
+    uint8_t sq_poll;                    /**< 1 if a kernel thread polls the submission queue */
+    void *ring_map;                     /**< Shared submission/completion ring mapping */
+    size_t ring_map_len;                /**< Bytes mapped at @ref ring_map */
+    struct io_uring_sqe *sqes;          /**< Submission queue entries */
+    size_t sqes_len;                    /**< Bytes mapped at @ref sqes */
+    uint32_t *sq_head;                  /**< Shared submission head (advanced by the kernel) */
+    uint32_t *sq_tail;                  /**< Shared submission tail (advanced by us) */
+    uint32_t *sq_flags;                 /**< Shared submission flags (IORING_SQ_NEED_WAKEUP) */
+    uint32_t *sq_array;                 /**< Index array mapping ring positions to entries */
+    uint32_t sq_mask;                   /**< Submission ring mask */
+    uint32_t sq_pending;                /**< Entries queued since the last submission */
+    uint32_t *cq_head;                  /**< Shared completion head (advanced by us) */
+    uint32_t *cq_tail;                  /**< Shared completion tail (advanced by the kernel) */
+    uint32_t cq_mask;                   /**< Completion ring mask */
+    struct io_uring_cqe *cqes;          /**< Completion queue entries */
+    uint32_t send_slots;                /**< Sends that may be in flight at once */
+    uint32_t *slot_free;                /**< Stack of send slots owned by user space */
+    uint32_t slot_free_count;           /**< Entries in @ref slot_free */
+    struct io_uring_buf_ring *buf_ring; /**< Registered provided buffer ring */
+    size_t buf_ring_len;                /**< Bytes mapped at @ref buf_ring */
+    uint8_t *recv_memory;               /**< Backing memory of every provided buffer */
+    size_t recv_buffer_len;             /**< Bytes per provided buffer */
+    uint16_t buf_tail;                  /**< Our copy of the buffer ring tail */
+    struct msghdr recv_msg;             /**< Layout template of the IPv6 multishot `recvmsg` */
+    uint8_t recv_armed;                 /**< 1 while the multishot receive is active */
+    uint16_t *ready;                    /**< Buffer ids of replies reaped while waiting for send slots */
+    uint32_t *ready_len;                /**< Completion result of each @ref ready entry */
+    uint32_t ready_head;                /**< First unread entry of @ref ready */
+    uint32_t ready_count;               /**< Entries in @ref ready */
+    int error;                          /**< First asynchronous send or receive error (`errno` value), or 0 */
+};
+
+/**
+ * @brief Creates the rings, registers @p sockfd and the receive buffers, and arms the multishot receive.
+ * @param queue          Pointer to the caller-allocated queue.
+ * @param sockfd         Raw socket to send and receive on (not owned; must outlive the queue).
+ * @param family         AF_INET or AF_INET6, matching @p sockfd.
+ * @param send_slots     Lower bound on the number of concurrent sends.
+ * @param max_packet_len Largest datagram expected back, headers included.
+ * @param sq_poll        1 to let a kernel thread poll the submission queue instead of calling `io_uring_enter`.
+ * @return 0 on success, -1 on failure (the queue is left closed and the reason printed).
+ */
+int uring_queue_open(struct uring_queue *queue, int sockfd, sa_family_t family, uint32_t send_slots, size_t max_packet_len, uint8_t sq_poll);
+
+/**
+ * @brief Takes a free send slot, reaping completions (and waiting for one if every slot is in flight).
+ * @param queue Pointer to an open queue.
+ * @param slot  Output for the slot, below `send_slots`.
+ * @return 0 on success, -1 if a send failed or the wait failed.
+ */
+int uring_queue_acquire(struct uring_queue *queue, uint32_t *slot);
+
+/**
+ * @brief Queues a send of @p length bytes at @p data to @p addr; the slot returns to the free stack on completion.
+ * @param queue   Pointer to an open queue.
+ * @param slot    Slot obtained from @ref uring_queue_acquire. @p data and @p addr must stay untouched until it is free again.
+ * @param data    Datagram to send.
+ * @param length  Bytes at @p data.
+ * @param addr    Destination address.
+ * @param addrlen Bytes at @p addr.
+ */
+void uring_queue_send(struct uring_queue *queue, uint32_t slot, const void *data, size_t length, const struct sockaddr *addr, socklen_t addrlen);
+
+/**
+ * @brief Hands every queued entry to the kernel with at most one system call (none while the poller is awake).
+ * @param queue Pointer to an open queue.
+ * @return 0 on success, -1 on failure or after an asynchronous send error.
+ */
+int uring_queue_submit(struct uring_queue *queue);
+
+/**
+ * @brief Returns the next received datagram without blocking, re-arming the multishot receive when it ended.
+ * @param queue   Pointer to an open queue.
+ * @param message Output for the datagram, valid until released.
+ * @return 1 if @p message was filled, 0 if nothing is queued, -1 on a receive failure.
+ */
+int uring_queue_receive(struct uring_queue *queue, struct uring_message *message);
+
+/**
+ * @brief Returns a provided buffer to the kernel.
+ * @param queue  Pointer to an open queue.
+ * @param buffer Buffer id from @ref uring_queue_receive.
+ */
+void uring_queue_release(struct uring_queue *queue, uint16_t buffer);
+
+/**
+ * @brief Waits for outstanding sends, then releases the rings and buffers. Safe to call on a closed queue.
+ * @param queue Pointer to the queue.
+ */
+void uring_queue_close(struct uring_queue *queue);
+
+#endif /* URING_QUEUE_H */
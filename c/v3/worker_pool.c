@@ -0,0 +1,422 @@
+/**
+ * @file worker_pool.c
+ * @brief Multi-threaded execution: one pinned worker per core, each with its own socket, templates and matcher.
+ *
+ * @author Jim Diroff II
+ */
+#define _GNU_SOURCE /**< Exposes CPU_SET and pthread_attr_setaffinity_np() */
+
+#include "worker_pool.h"
+#include "icmp_executor.h"
+#include "pacer.h"
+#include "packet_capture.h"
+#include "result_log.h"
+#include "timestamp.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Longest sleep between two checks of the workers' finished flags.
+ */
+#define WORKER_POOL_WAIT_STEP_NS (10 * TIMESTAMP_NS_PER_MSEC)
+
+/**
+ * @brief Maps the pacing options onto a token bucket.
+ *
+ * `-r` counts packets and `-R` counts IPv4 bits; without either, `-w` grants one batch per wait period.
+ *
+ * @param pacer       Pointer to the pacer to initialize.
+ * @param config      Pointer to the validated application state.
+ * @param packet_len  Size of one datagram in bytes, used for bit rates.
+ * @param packet_cost Output for the number of tokens a single packet consumes.
+ * @return 0 on success, -1 on failure.
+ */
+static int init_pacer_from_config(struct pacer *pacer, const struct app_config *config, size_t packet_len, uint64_t *packet_cost)
+{
+    uint64_t tokens = 0;
+    uint64_t period_ns = TIMESTAMP_NS_PER_SEC;
+    *packet_cost = 1;
+
+    if (config->rate_bps > 0)
+    {
+        tokens = config->rate_bps;
+        *packet_cost = (uint64_t)packet_len * 8;
+    }
+    else if (config->rate_pps > 0)
+    {
+        tokens = config->rate_pps;
+    }
+    else if (config->sleep_time > 0)
+    {
+        tokens = config->batch_size;
+        period_ns = (uint64_t)config->sleep_time * TIMESTAMP_NS_PER_SEC;
+    }
+
+    return pacer_init(pacer, tokens, period_ns, (uint64_t)(config->burst - 1) * *packet_cost);
+}
+
+/**
+ * @brief Splits @p total into @p parts shares, handing the remainder to the first workers.
+ */
+static uint64_t share_of(uint64_t total, uint32_t parts, uint32_t index)
+{
+    return (total / parts) + ((index < total % parts) ? 1 : 0);
+}
+
+/**
+ * @brief Opens, paces and runs one worker's share, keeping the matcher for reporting.
+ * @param worker The worker.
+ * @return 0 on success, -1 on failure.
+ */
+static int worker_run(struct worker *worker)
+{
+    // Everything is allocated from the worker's own thread, so memory lands near its pinned core
+    struct icmp_session session;
+    if (icmp_session_open(&session, &worker->config) != 0)
+    {
+        return -1;
+    }
+
+    struct pacer pacer;
+    uint64_t packet_cost;
+    if (init_pacer_from_config(&pacer, &worker->config, session.packet_len, &packet_cost) != 0)
+    {
+        icmp_session_close(&session);
+        return -1;
+    }
+
+    if (icmp_receiver_init(&worker->receiver, session.sockfd, worker->config.icmp_v4_identifier, &worker->targets, (uint64_t)worker->config.reply_timeout_ms * TIMESTAMP_NS_PER_MSEC) != 0)
+    {
+        icmp_session_close(&session);
+        return -1;
+    }
+
+    icmp_receiver_attach_histogram(&worker->receiver, &worker->rtt);
+    if (worker->config.payload_stamp)
+    {
+        icmp_receiver_use_stamps(&worker->receiver);
+    }
+    if (worker->config.cookie_key)
+    {
+        icmp_receiver_use_cookies(&worker->receiver, worker->config.cookie_key);
+    }
+    if (session.kernel_timestamps && icmp_receiver_use_kernel_timestamps(&worker->receiver) != 0)
+    {
+        icmp_session_close(&session);
+        return -1;
+    }
+    struct result_log_stream *log = NULL;
+    if (worker->config.result_log)
+    {
+        log = result_log_stream_open(worker->config.result_log, worker->index, worker->first_target);
+        if (!log)
+        {
+            icmp_session_close(&session);
+            return -1;
+        }
+        icmp_receiver_attach_log(&worker->receiver, log);
+    }
+    struct packet_capture_stream *capture = NULL;
+    if (worker->config.capture)
+    {
+        capture = packet_capture_stream_open(worker->config.capture, worker->index);
+        if (!capture)
+        {
+            icmp_session_close(&session);
+            return -1;
+        }
+        icmp_session_attach_capture(&session, capture);
+        icmp_receiver_attach_capture(&worker->receiver, capture, &worker->config.ip_v6_src);
+    }
+    if (session.use_xdp)
+    {
+        icmp_receiver_attach_xdp(&worker->receiver, &session.xdp);
+        if (icmp_receiver_use_reassembly(&worker->receiver) != 0)
+        {
+            icmp_session_close(&session);
+            return -1;
+        }
+    }
+    if (session.use_uring)
+    {
+        icmp_receiver_attach_uring(&worker->receiver, &session.uring);
+    }
+
+    int status = icmp_engine_run(&session, &worker->receiver, &pacer, packet_cost, &worker->result);
+    if (log)
+    {
+        result_log_flush(log);
+    }
+    if (capture)
+    {
+        packet_capture_flush(capture);
+    }
+
+    icmp_session_close(&session);
+    return status;
+}
+
+/**
+ * @brief Thread entry point: runs the worker, then flags it finished for @ref worker_pool_wait.
+ * @param arg The worker.
+ * @return NULL; the outcome is left in the worker's `status`.
+ */
+static void *worker_main(void *arg)
+{
+    struct worker *worker = (struct worker *)arg;
+    worker->status = worker_run(worker);
+    __atomic_store_n(&worker->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief Prepares thread attributes that pin a new worker to the next CPU it is allowed to run on.
+ * @param attr    Initialized attributes to set the affinity in.
+ * @param allowed The process's CPU affinity mask.
+ * @param cursor  Rotating position in @p allowed, advanced past the chosen CPU.
+ * @note The affinity is part of the attributes, so the thread starts on its core and its setup allocations land there.
+ */
+static void pin_attr(pthread_attr_t *attr, const cpu_set_t *allowed, int *cursor)
+{
+    if (CPU_COUNT(allowed) == 0)
+    {
+        return;
+    }
+
+    while (!CPU_ISSET(*cursor % CPU_SETSIZE, allowed))
+    {
+        (*cursor)++;
+    }
+    int cpu = *cursor % CPU_SETSIZE;
+    (*cursor)++;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
+
+/**
+ * @brief Adds one worker's per-target counters into the pool's merged array.
+ */
+static void merge_target_stats(struct worker_pool *pool, const struct worker *worker)
+{
+    if (!worker->receiver.stats)
+    {
+        return; /**< The worker failed before its matcher existed */
+    }
+
+    for (uint32_t i = 0; i < worker->targets.count; i++)
+    {
+        const struct icmp_target_stats *src = &worker->receiver.stats[i];
+        struct icmp_target_stats *dst = &pool->stats[worker->first_target + i];
+
+        dst->sent += src->sent;
+        dst->received += src->received;
+        dst->rtt_sum_ns += src->rtt_sum_ns;
+        dst->rtt_min_ns = (src->rtt_min_ns < dst->rtt_min_ns) ? src->rtt_min_ns : dst->rtt_min_ns;
+        dst->rtt_max_ns = (src->rtt_max_ns > dst->rtt_max_ns) ? src->rtt_max_ns : dst->rtt_max_ns;
+    }
+}
+
+int worker_pool_start(struct worker_pool *pool, const struct app_config *config)
+{
+    memset(pool, 0, sizeof(struct worker_pool));
+    hdr_histogram_init(&pool->rtt);
+    const struct target_list *targets = config->targets;
+
+    // 1. Size the pool: never more workers than the work can be divided into
+    uint32_t count = config->threads;
+    pool->shared_targets = (targets->count < count);
+    if (pool->shared_targets && config->quantity < count)
+    {
+        count = config->quantity;
+    }
+    if (count > targets->count && !pool->shared_targets)
+    {
+        count = targets->count;
+    }
+
+    pool->workers = calloc(count, sizeof(struct worker));
+    pool->stats = calloc(targets->count, sizeof(struct icmp_target_stats));
+    if (!pool->workers || !pool->stats)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u workers\n", count);
+        worker_pool_free(pool);
+        pool->status = -1;
+        return -1;
+    }
+    for (uint32_t i = 0; i < targets->count; i++)
+    {
+        pool->stats[i].rtt_min_ns = UINT64_MAX;
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int cpu_cursor = 0;
+
+    // 2. Carve out each worker's identifier, targets, quantity and rate share, then start it
+    uint32_t next_target = 0;
+    int status = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        struct worker *worker = &pool->workers[i];
+        worker->index = i;
+        worker->config = *config;
+        hdr_histogram_init(&worker->rtt); /**< Before the thread exists, so snapshots never see it half-initialized */
+
+        /** Identifier space is partitioned; overflow back to `0` keeps slices disjoint */
+        worker->config.icmp_v4_identifier = (uint16_t)(config->icmp_v4_identifier + i);
+
+        if (pool->shared_targets)
+        {
+            worker->first_target = 0;
+            worker->targets.count = targets->count;
+            worker->config.quantity = (uint32_t)share_of(config->quantity, count, i);
+        }
+        else
+        {
+            worker->first_target = next_target;
+            worker->targets.count = (uint32_t)share_of(targets->count, count, i);
+            next_target += worker->targets.count;
+        }
+        worker->targets.family = targets->family;
+        worker->targets.addrs = (targets->family == AF_INET) ? targets->addrs + worker->first_target : NULL;
+        worker->targets.addrs6 = (targets->family == AF_INET6) ? targets->addrs6 + worker->first_target : NULL;
+        worker->targets.capacity = worker->targets.count;
+        worker->config.targets = &worker->targets;
+
+        worker->config.rate_pps = share_of(config->rate_pps, count, i);
+        worker->config.rate_bps = share_of(config->rate_bps, count, i);
+        if ((config->rate_pps > 0 && worker->config.rate_pps == 0) || (config->rate_bps > 0 && worker->config.rate_bps == 0))
+        {
+            worker->config.rate_pps = (config->rate_pps > 0) ? 1 : 0; /**< Rates below one per worker round up */
+            worker->config.rate_bps = (config->rate_bps > 0) ? 1 : 0;
+        }
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pin_attr(&attr, &allowed, &cpu_cursor);
+        int created = pthread_create(&worker->thread, &attr, worker_main, worker);
+        pthread_attr_destroy(&attr);
+        if (created != 0)
+        {
+            fprintf(stderr, "Error: Failed to start worker %u\n", i);
+            status = -1;
+            break;
+        }
+        pool->count++;
+    }
+
+    pool->status = status;
+    return status;
+}
+
+int worker_pool_wait(struct worker_pool *pool, uint64_t timeout_ns)
+{
+    uint64_t deadline_ns = timestamp_now_ns() + timeout_ns;
+
+    for (;;)
+    {
+        uint32_t finished = 0;
+        for (uint32_t i = 0; i < pool->count; i++)
+        {
+            finished += __atomic_load_n(&pool->workers[i].finished, __ATOMIC_ACQUIRE);
+        }
+        if (finished == pool->count)
+        {
+            return 1;
+        }
+
+        uint64_t now_ns = timestamp_now_ns();
+        if (now_ns >= deadline_ns)
+        {
+            return 0;
+        }
+
+        uint64_t step_ns = deadline_ns - now_ns;
+        step_ns = (step_ns < WORKER_POOL_WAIT_STEP_NS) ? step_ns : WORKER_POOL_WAIT_STEP_NS;
+        struct timespec pause = { .tv_sec = 0, .tv_nsec = (long)step_ns };
+        nanosleep(&pause, NULL);
+    }
+}
+
+void worker_pool_snapshot(const struct worker_pool *pool, struct icmp_engine_result *totals, struct hdr_histogram *rtt)
+{
+    memset(totals, 0, sizeof(struct icmp_engine_result));
+    hdr_histogram_init(rtt);
+
+    for (uint32_t i = 0; i < pool->count; i++)
+    {
+        const struct icmp_engine_result *result = &pool->workers[i].result;
+        totals->sent += __atomic_load_n(&result->sent, __ATOMIC_RELAXED);
+        totals->received += __atomic_load_n(&result->received, __ATOMIC_RELAXED);
+        totals->duplicates += __atomic_load_n(&result->duplicates, __ATOMIC_RELAXED);
+        totals->lost += __atomic_load_n(&result->lost, __ATOMIC_RELAXED);
+        totals->bytes_sent += __atomic_load_n(&result->bytes_sent, __ATOMIC_RELAXED);
+        for (int s = 0; s < TIMESTAMP_SOURCE_COUNT; s++)
+        {
+            totals->sources[s] += __atomic_load_n(&result->sources[s], __ATOMIC_RELAXED);
+        }
+        totals->reassembled += __atomic_load_n(&result->reassembled, __ATOMIC_RELAXED);
+        totals->fragments_dropped += __atomic_load_n(&result->fragments_dropped, __ATOMIC_RELAXED);
+        hdr_histogram_merge(rtt, &pool->workers[i].rtt);
+    }
+}
+
+int worker_pool_join(struct worker_pool *pool)
+{
+    // Join and aggregate the per-thread counters
+    for (uint32_t i = 0; i < pool->count; i++)
+    {
+        struct worker *worker = &pool->workers[i];
+        pthread_join(worker->thread, NULL);
+
+        if (worker->status != 0)
+        {
+            pool->status = -1;
+        }
+        pool->total.sent += worker->result.sent;
+        pool->total.received += worker->result.received;
+        pool->total.duplicates += worker->result.duplicates;
+        pool->total.lost += worker->result.lost;
+        pool->total.bytes_sent += worker->result.bytes_sent;
+        for (int s = 0; s < TIMESTAMP_SOURCE_COUNT; s++)
+        {
+            pool->total.sources[s] += worker->result.sources[s];
+        }
+        pool->total.reassembled += worker->result.reassembled;
+        pool->total.fragments_dropped += worker->result.fragments_dropped;
+        hdr_histogram_merge(&pool->rtt, &worker->rtt);
+        merge_target_stats(pool, worker);
+    }
+
+    return pool->status;
+}
+
+int worker_pool_run(struct worker_pool *pool, const struct app_config *config)
+{
+    if (worker_pool_start(pool, config) != 0 && pool->count == 0)
+    {
+        return -1;
+    }
+
+    return worker_pool_join(pool);
+}
+
+void worker_pool_free(struct worker_pool *pool)
+{
+    for (uint32_t i = 0; i < pool->count; i++)
+    {
+        icmp_receiver_close(&pool->workers[i].receiver);
+    }
+
+    free(pool->workers);
+    free(pool->stats);
+    memset(pool, 0, sizeof(struct worker_pool));
+}
@@ -0,0 +1,110 @@
+/**
+ * @file worker_pool.h
+ * @brief Multi-threaded execution: one pinned worker per core, each with its own socket, templates and matcher.
+ *
+ * @note Workers share nothing on the hot path. Each one transmits under its own Echo identifier
+ *       (`-i` + worker index), so every raw socket can attribute replies to its owner without locks.
+ *
+ * @author Jim Diroff II
+ */
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "app_config.h"
+#include "hdr_histogram.h"
+#include "icmp_engine.h"
+#include "icmp_receiver.h"
+#include "target_list.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * @brief Upper bound on worker threads.
+ */
+#define WORKER_POOL_MAX_THREADS 256
+
+/**
+ * @struct worker
+ * @brief One worker's private state. Only the owning thread touches it until the pool is joined.
+ */
+struct worker
+{
+    pthread_t thread;                 /**< The worker's thread */
+    uint32_t index;                   /**< Position in the pool; also the identifier offset */
+    struct app_config config;         /**< Private copy: own identifier, target slice, quantity and rate share */
+    struct target_list targets;       /**< Non-owning view into the shared target list */
+    uint32_t first_target;            /**< Offset of @ref targets in the shared list */
+    struct icmp_receiver receiver;    /**< The worker's matcher, kept until the pool is released for reporting */
+    struct icmp_engine_result result; /**< The worker's own totals, published while running */
+    struct hdr_histogram rtt;         /**< The worker's round trips; written only by its thread */
+    uint8_t finished;                 /**< Set (release) once the thread is done with its session */
+    int status;                       /**< 0 on success, -1 if the worker failed */
+};
+
+/**
+ * @struct worker_pool
+ * @brief The workers of one run and their aggregate results.
+ */
+struct worker_pool
+{
+    struct worker *workers;          /**< @ref count workers */
+    uint32_t count;                  /**< Number of workers actually started */
+    uint8_t shared_targets;          /**< 1 if every worker probes every target (fewer targets than workers) */
+    struct icmp_engine_result total; /**< Sum of every worker's totals */
+    struct icmp_target_stats *stats; /**< Per-target counters merged across workers, in shared list order */
+    struct hdr_histogram rtt;        /**< Round trips merged across workers */
+    int status;                      /**< 0 while every worker started and succeeded, -1 otherwise */
+};
+
+/**
+ * @brief Splits the run across `config->threads` workers and starts them.
+ *
+ * With at least as many targets as workers, each worker owns a contiguous slice of the (permuted) target list.
+ * Otherwise every worker probes every target and the per-target quantity is divided between them.
+ * Rates given with `-r`/`-R` are divided between workers; `-w` spacing applies to each worker.
+ *
+ * @param pool   Pointer to the caller-allocated pool.
+ * @param config Pointer to the validated application state, including the target list. Must outlive the pool.
+ * @return 0 if every worker started, -1 otherwise. Any workers that did start must still be joined.
+ */
+int worker_pool_start(struct worker_pool *pool, const struct app_config *config);
+
+/**
+ * @brief Waits until every started worker has finished, or @p timeout_ns has passed.
+ * @param pool       Pointer to a started pool.
+ * @param timeout_ns Longest time to wait.
+ * @return 1 once every worker has finished, 0 on timeout.
+ */
+int worker_pool_wait(struct worker_pool *pool, uint64_t timeout_ns);
+
+/**
+ * @brief Samples the running totals and round trips of every worker without stopping them.
+ * @param pool   Pointer to a started pool.
+ * @param totals Output for the summed totals.
+ * @param rtt    Output for the merged round trips (overwritten).
+ */
+void worker_pool_snapshot(const struct worker_pool *pool, struct icmp_engine_result *totals, struct hdr_histogram *rtt);
+
+/**
+ * @brief Joins every started worker and merges its totals, round trips and per-target counters into the pool.
+ * @param pool Pointer to a started pool.
+ * @return 0 if every worker started and succeeded, -1 otherwise (results are still merged for reporting).
+ */
+int worker_pool_join(struct worker_pool *pool);
+
+/**
+ * @brief Starts the workers and joins them (@ref worker_pool_start followed by @ref worker_pool_join).
+ * @param pool   Pointer to the caller-allocated pool.
+ * @param config Pointer to the validated application state, including the target list.
+ * @return 0 if every worker succeeded, -1 otherwise (results are still merged for reporting).
+ */
+int worker_pool_run(struct worker_pool *pool, const struct app_config *config);
+
+/**
+ * @brief Releases the workers and the merged counters.
+ * @param pool Pointer to the pool.
+ */
+void worker_pool_free(struct worker_pool *pool);
+
+#endif /* WORKER_POOL_H */
@@ -0,0 +1,567 @@
+/**
+ * @file xdp_socket.c
+ * @brief AF_XDP kernel-bypass port: one UMEM shared by TX and RX, with fill and completion rings.
+ *
+ * @note Built on the raw `bpf()` and AF_XDP socket interfaces; no libbpf/libxdp dependency.
+ *
+ * @author Jim Diroff II
+ */
+
+#include "xdp_socket.h"
+#include "ip_v4.h"
+#include "ip_v6.h"
+#include "icmp_v4.h"
+#include "icmp_v6.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief How long @ref xdp_socket_acquire_tx waits for a completion before giving up.
+ */
+#define XDP_SOCKET_ACQUIRE_TIMEOUT_MS 5000
+
+/**
+ * @brief Polling step while waiting for completions.
+ */
+#define XDP_SOCKET_POLL_MS 10
+
+/**
+ * @brief Largest steering program, in instructions.
+ */
+#define XDP_PROGRAM_MAX_INSNS 64
+
+static int sys_bpf(enum bpf_cmd cmd, union bpf_attr *attr)
+{
+    return (int)syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/**
+ * @struct xdp_program
+ * @brief A tiny two-pass assembler: jumps name a label, offsets are fixed up once every label is placed.
+ */
+struct xdp_program
+{
+    struct bpf_insn insns[XDP_PROGRAM_MAX_INSNS]; /**< Emitted instructions */
+    int jump_label[XDP_PROGRAM_MAX_INSNS];        /**< Label each jump targets, or -1 */
+    int label_at[8];                              /**< Instruction index of each label */
+    int count;                                    /**< Instructions emitted */
+};
+
+/**
+ * @brief Labels of the steering program.
+ */
+enum xdp_program_label
+{
+    XDP_LABEL_V4,
+    XDP_LABEL_V6,
+    XDP_LABEL_V6_ICMP,
+    XDP_LABEL_IDENTIFIER,
+    XDP_LABEL_REDIRECT,
+    XDP_LABEL_PASS
+};
+
+static void emit(struct xdp_program *p, uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm, int label)
+{
+    struct bpf_insn *insn = &p->insns[p->count];
+    memset(insn, 0, sizeof(*insn));
+    insn->code = code;
+    insn->dst_reg = dst & 0x0F;
+    insn->src_reg = src & 0x0F;
+    insn->off = off;
+    insn->imm = imm;
+    p->jump_label[p->count] = label;
+    p->count++;
+}
+
+static void place(struct xdp_program *p, int label)
+{
+    p->label_at[label] = p->count;
+}
+
+/**
+ * @brief Assembles the steering program.
+ *
+ * Redirects a frame to the XSKMAP slot of its receive queue only if it is an IPv4 (IHL 5) or IPv6
+ * (no extension headers) Echo Reply carrying @p identifier, or any fragment of an ICMP / ICMPv6
+ * datagram. Only the first fragment carries the identifier, and the kernel could never reassemble
+ * a datagram whose first fragment was taken, so every fragment goes to the socket's reassembly
+ * cache instead. Everything else returns XDP_PASS, as do frames whose queue has no socket (the
+ * redirect's fallback action).
+ */
+static void assemble_steering_program(struct xdp_program *p, int map_fd, uint16_t identifier)
+{
+    memset(p, 0, sizeof(struct xdp_program));
+    const int none = -1;
+
+    // r6 = ctx, r2 = data, r3 = data_end
+    emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0, none);
+    emit(p, BPF_LDX | BPF_MEM | BPF_W, 2, 1, offsetof(struct xdp_md, data), 0, none);
+    emit(p, BPF_LDX | BPF_MEM | BPF_W, 3, 1, offsetof(struct xdp_md, data_end), 0, none);
+
+    // Ethernet type
+    emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0, none);
+    emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, ETHER_HDR_LEN, none);
+    emit(p, BPF_JMP | BPF_JGT | BPF_X, 4, 3, 0, 0, XDP_LABEL_PASS);
+    emit(p, BPF_LDX | BPF_MEM | BPF_H, 5, 2, 12, 0, none);
+    emit(p, BPF_JMP | BPF_JEQ | BPF_K, 5, 0, 0, htons(ETHERTYPE_IP), XDP_LABEL_V4);
+    emit(p, BPF_JMP | BPF_JEQ | BPF_K, 5, 0, 0, htons(ETHERTYPE_IPV6), XDP_LABEL_V6);
+    emit(p, BPF_JMP | BPF_JA, 0, 0, 0, 0, XDP_LABEL_PASS);
+
+    // IPv4: version/IHL, protocol, ICMP type; r5 = identifier
+    const int v4_icmp = ETHER_HDR_LEN + sizeof(struct ip_v4_header);
+    place(p, XDP_LABEL_V4);
+    emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0, none);
+    emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, v4_icmp + sizeof(struct icmp_v4_header) + sizeof(uint16_t), none);
+    emit(p, BPF_JMP | BPF_JGT | BPF_X, 4, 3, 0, 0, XDP_LABEL_PASS);
+    emit(p, BPF_LDX | BPF_MEM | BPF_B, 5, 2, ETHER_HDR_LEN + offsetof(struct ip_v4_header, version_ihl), 0, none);
+    emit(p, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0, (IP_V4 << 4) | IP_V4_MIN_IHL, XDP_LABEL_PASS);
+    emit(p, BPF_LDX | BPF_MEM | BPF_B, 5, 2, ETHER_HDR_LEN + offsetof(struct ip_v4_header, protocol), 0, none);
+    emit(p, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0, IP_PROTO_ICMP_V4, XDP_LABEL_PASS);
+    emit(p, BPF_LDX | BPF_MEM | BPF_H, 5, 2, ETHER_HDR_LEN + offsetof(struct ip_v4_header, flags_frag_offset), 0, none);
+    emit(p, BPF_JMP | BPF_JSET | BPF_K, 5, 0, 0, htons(IP_V4_FLAG_MF | IP_V4_FRAG_OFFSET_MASK), XDP_LABEL_REDIRECT);
+    emit(p, BPF_LDX | BPF_MEM | BPF_B, 5, 2, v4_icmp, 0, none);
+    emit(p, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0, ICMP_V4_ECHO_REPLY, XDP_LABEL_PASS);
+    emit(p, BPF_LDX | BPF_MEM | BPF_H, 5, 2, v4_icmp + sizeof(struct icmp_v4_header), 0, none);
+    emit(p, BPF_JMP | BPF_JA, 0, 0, 0, 0, XDP_LABEL_IDENTIFIER);
+
+    // IPv6: next header (a fragment header's own next header for fragments), ICMPv6 type; r5 = identifier
+    const int v6_icmp = ETHER_HDR_LEN + sizeof(struct ip_v6_header);
+    place(p, XDP_LABEL_V6);
+    emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0, none);
+    emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, v6_icmp + sizeof(struct icmp_v6_header) + sizeof(uint16_t), none);
+    emit(p, BPF_JMP | BPF_JGT | BPF_X, 4, 3, 0, 0, XDP_LABEL_PASS);
+    emit(p, BPF_LDX | BPF_MEM | BPF_B, 5, 2, ETHER_HDR_LEN + offsetof(struct ip_v6_header, next_header), 0, none);
+    emit(p, BPF_JMP | BPF_JEQ | BPF_K, 5, 0, 0, IP_V6_ICMP_V6, XDP_LABEL_V6_ICMP);
+    emit(p, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0, IP_V6_FRAGMENT, XDP_LABEL_PASS);
+    emit(p, BPF_LDX | BPF_MEM | BPF_B, 5, 2, v6_icmp + offsetof(struct ip_v6_fragment_header, next_header), 0, none);
+    emit(p, BPF_JMP | BPF_JEQ | BPF_K, 5, 0, 0, IP_V6_ICMP_V6, XDP_LABEL_REDIRECT);
+    emit(p, BPF_JMP | BPF_JA, 0, 0, 0, 0, XDP_LABEL_PASS);
+    place(p, XDP_LABEL_V6_ICMP);
+    emit(p, BPF_LDX | BPF_MEM | BPF_B, 5, 2, v6_icmp, 0, none);
+    emit(p, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0, ICMP_V6_ECHO_REPLY, XDP_LABEL_PASS);
+    emit(p, BPF_LDX | BPF_MEM | BPF_H, 5, 2, v6_icmp + sizeof(struct icmp_v6_header), 0, none);
+
+    // Identifier as stored on the wire; then redirect to this queue's socket, falling back to XDP_PASS
+    place(p, XDP_LABEL_IDENTIFIER);
+    emit(p, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0, htons(identifier), XDP_LABEL_PASS);
+    place(p, XDP_LABEL_REDIRECT);
+    emit(p, BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, map_fd, none);
+    emit(p, 0, 0, 0, 0, 0, none); /**< Upper half of the 64-bit immediate */
+    emit(p, BPF_LDX | BPF_MEM | BPF_W, 2, 6, offsetof(struct xdp_md, rx_queue_index), 0, none);
+    emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS, none);
+    emit(p, BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map, none);
+    emit(p, BPF_JMP | BPF_EXIT, 0, 0, 0, 0, none);
+
+    place(p, XDP_LABEL_PASS);
+    emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS, none);
+    emit(p, BPF_JMP | BPF_EXIT, 0, 0, 0, 0, none);
+
+    // Resolve jump offsets (relative to the instruction after the jump)
+    for (int i = 0; i < p->count; i++)
+    {
+        if (p->jump_label[i] >= 0)
+        {
+            p->insns[i].off = (int16_t)(p->label_at[p->jump_label[i]] - i - 1);
+        }
+    }
+}
+
+/**
+ * @brief Creates the XSKMAP, loads the steering program and attaches it (driver mode, else generic).
+ */
+static int attach_program(struct xdp_socket *xsk, int ifindex, uint32_t queue, uint16_t identifier)
+{
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(int);
+    attr.max_entries = XDP_SOCKET_MAP_ENTRIES;
+    xsk->map_fd = sys_bpf(BPF_MAP_CREATE, &attr);
+    if (xsk->map_fd < 0)
+    {
+        perror("Error: Failed to create the XSKMAP");
+        return -1;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = (uint32_t)xsk->map_fd;
+    attr.key = (uint64_t)(uintptr_t)&queue;
+    attr.value = (uint64_t)(uintptr_t)&xsk->fd;
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0)
+    {
+        perror("Error: Failed to register the AF_XDP socket");
+        return -1;
+    }
+
+    struct xdp_program program;
+    assemble_steering_program(&program, xsk->map_fd, identifier);
+
+    static char verifier_log[4096];
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.expected_attach_type = BPF_XDP;
+    attr.insns = (uint64_t)(uintptr_t)program.insns;
+    attr.insn_cnt = (uint32_t)program.count;
+    attr.license = (uint64_t)(uintptr_t)"GPL";
+    attr.log_buf = (uint64_t)(uintptr_t)verifier_log;
+    attr.log_size = sizeof(verifier_log);
+    attr.log_level = 1;
+    xsk->prog_fd = sys_bpf(BPF_PROG_LOAD, &attr);
+    if (xsk->prog_fd < 0)
+    {
+        perror("Error: Failed to load the XDP steering program");
+        fprintf(stderr, "%s", verifier_log);
+        return -1;
+    }
+
+    const uint32_t modes[] = {XDP_FLAGS_DRV_MODE, XDP_FLAGS_SKB_MODE};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.link_create.prog_fd = (uint32_t)xsk->prog_fd;
+        attr.link_create.target_ifindex = (uint32_t)ifindex;
+        attr.link_create.attach_type = BPF_XDP;
+        attr.link_create.flags = modes[i];
+        xsk->link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+        if (xsk->link_fd >= 0)
+        {
+            return 0;
+        }
+    }
+
+    perror("Error: Failed to attach the XDP steering program");
+    return -1;
+}
+
+/**
+ * @brief Maps one ring at @p pgoff and resolves its producer/consumer/descriptor pointers.
+ */
+static int map_ring(struct xdp_ring *ring, int fd, const struct xdp_ring_offset *off, uint32_t size, size_t entry_size, off_t pgoff)
+{
+    ring->size = size;
+    ring->map_len = off->desc + (size * entry_size);
+    ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+    if (ring->map == MAP_FAILED)
+    {
+        ring->map = NULL;
+        return -1;
+    }
+
+    ring->producer = (uint32_t *)((uint8_t *)ring->map + off->producer);
+    ring->consumer = (uint32_t *)((uint8_t *)ring->map + off->consumer);
+    ring->descs = (uint8_t *)ring->map + off->desc;
+    return 0;
+}
+
+static uint32_t next_power_of_two(uint32_t value)
+{
+    uint32_t power = 1;
+    while (power < value)
+    {
+        power <<= 1;
+    }
+    return power;
+}
+
+int xdp_socket_open(struct xdp_socket *xsk, const char *ifname, uint32_t queue, const uint8_t dst_mac[ETHER_ADDR_LEN], uint16_t ethertype, uint16_t identifier, uint32_t tx_frames, size_t max_packet_len)
+{
+    memset(xsk, 0, sizeof(struct xdp_socket));
+    xsk->fd = -1;
+    xsk->map_fd = -1;
+    xsk->prog_fd = -1;
+    xsk->link_fd = -1;
+    memcpy(xsk->dst_mac, dst_mac, ETHER_ADDR_LEN);
+
+    if (ETHER_HDR_LEN + max_packet_len > XDP_SOCKET_FRAME_SIZE)
+    {
+        fprintf(stderr, "Error: %zu byte datagrams do not fit a %i byte UMEM frame\n", max_packet_len, XDP_SOCKET_FRAME_SIZE);
+        return -1;
+    }
+
+    int ifindex = (int)if_nametoindex(ifname);
+    if (ifindex == 0)
+    {
+        fprintf(stderr, "Error: Unknown interface '%s'\n", ifname);
+        return -1;
+    }
+
+    xsk->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (xsk->fd < 0)
+    {
+        perror("Error: Failed to open AF_XDP socket");
+        return -1;
+    }
+
+    // 1. Interface hardware address, for the prewritten Ethernet header
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    int probe = socket(AF_INET, SOCK_DGRAM, 0);
+    if (probe < 0 || ioctl(probe, SIOCGIFHWADDR, &ifr) < 0)
+    {
+        perror("Error: Failed to read the interface hardware address");
+        if (probe >= 0)
+        {
+            close(probe);
+        }
+        xdp_socket_close(xsk);
+        return -1;
+    }
+    close(probe);
+    memcpy(xsk->src_mac, ifr.ifr_hwaddr.sa_data, ETHER_ADDR_LEN);
+
+    // 2. One UMEM: transmit frames first, receive frames after them
+    xsk->tx_frames = next_power_of_two(tx_frames);
+    uint32_t total_frames = xsk->tx_frames + XDP_SOCKET_RX_FRAMES;
+    xsk->umem_len = (size_t)total_frames * XDP_SOCKET_FRAME_SIZE;
+    void *umem = mmap(NULL, xsk->umem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    xsk->tx_free = calloc(xsk->tx_frames, sizeof(uint32_t));
+    if (umem == MAP_FAILED || !xsk->tx_free)
+    {
+        fprintf(stderr, "Error: Failed to allocate %u UMEM frames\n", total_frames);
+        if (umem != MAP_FAILED)
+        {
+            munmap(umem, xsk->umem_len);
+        }
+        xsk->umem_len = 0;
+        xdp_socket_close(xsk);
+        return -1;
+    }
+    xsk->umem = umem;
+
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (uint64_t)(uintptr_t)xsk->umem;
+    reg.len = xsk->umem_len;
+    reg.chunk_size = XDP_SOCKET_FRAME_SIZE;
+
+    uint32_t rx_size = XDP_SOCKET_RX_FRAMES;
+    uint32_t tx_size = xsk->tx_frames;
+    if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0 ||
+        setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &rx_size, sizeof(rx_size)) < 0 ||
+        setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &tx_size, sizeof(tx_size)) < 0 ||
+        setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &rx_size, sizeof(rx_size)) < 0 ||
+        setsockopt(xsk->fd, SOL_XDP, XDP_TX_RING, &tx_size, sizeof(tx_size)) < 0)
+    {
+        perror("Error: Failed to configure the AF_XDP rings");
+        xdp_socket_close(xsk);
+        return -1;
+    }
+
+    // 3. Map all four rings
+    struct xdp_mmap_offsets off;
+    socklen_t off_len = sizeof(off);
+    if (getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &off_len) < 0 ||
+        map_ring(&xsk->rx, xsk->fd, &off.rx, rx_size, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) != 0 ||
+        map_ring(&xsk->tx, xsk->fd, &off.tx, tx_size, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) != 0 ||
+        map_ring(&xsk->fill, xsk->fd, &off.fr, rx_size, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) != 0 ||
+        map_ring(&xsk->completion, xsk->fd, &off.cr, tx_size, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) != 0)
+    {
+        perror("Error: Failed to map the AF_XDP rings");
+        xdp_socket_close(xsk);
+        return -1;
+    }
+
+    // 4. Bind the queue: zero-copy where the driver supports it, copy mode otherwise
+    struct sockaddr_xdp addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sxdp_family = AF_XDP;
+    addr.sxdp_ifindex = (uint32_t)ifindex;
+    addr.sxdp_queue_id = queue;
+    addr.sxdp_flags = XDP_ZEROCOPY;
+    xsk->zero_copy = 1;
+    if (bind(xsk->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        addr.sxdp_flags = XDP_COPY;
+        xsk->zero_copy = 0;
+        if (bind(xsk->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            perror("Error: Failed to bind the AF_XDP socket");
+            xdp_socket_close(xsk);
+            return -1;
+        }
+    }
+
+    // 5. Every receive frame starts out owned by the kernel; every transmit frame by us
+    uint64_t *fill = (uint64_t *)xsk->fill.descs;
+    for (uint32_t i = 0; i < XDP_SOCKET_RX_FRAMES; i++)
+    {
+        fill[i] = (uint64_t)(xsk->tx_frames + i) * XDP_SOCKET_FRAME_SIZE;
+    }
+    xsk->fill.cached = XDP_SOCKET_RX_FRAMES;
+    __atomic_store_n(xsk->fill.producer, xsk->fill.cached, __ATOMIC_RELEASE);
+
+    struct ether_header eth;
+    memcpy(eth.ether_dhost, xsk->dst_mac, ETHER_ADDR_LEN);
+    memcpy(eth.ether_shost, xsk->src_mac, ETHER_ADDR_LEN);
+    eth.ether_type = htons(ethertype);
+    for (uint32_t i = 0; i < xsk->tx_frames; i++)
+    {
+        memcpy(xsk->umem + ((size_t)i * XDP_SOCKET_FRAME_SIZE), &eth, sizeof(eth));
+        xsk->tx_free[xsk->tx_free_count++] = xsk->tx_frames - 1 - i;
+    }
+
+    // 6. Start steering our replies into the RX ring
+    if (attach_program(xsk, ifindex, queue, identifier) != 0)
+    {
+        xdp_socket_close(xsk);
+        return -1;
+    }
+
+    return 0;
+}
+
+uint8_t *xdp_socket_frame_data(const struct xdp_socket *xsk, uint32_t index)
+{
+    return xsk->umem + ((size_t)index * XDP_SOCKET_FRAME_SIZE) + ETHER_HDR_LEN;
+}
+
+/**
+ * @brief Moves every finished transmission from the completion ring back onto the free stack.
+ */
+static void reap_completions(struct xdp_socket *xsk)
+{
+    uint32_t producer = __atomic_load_n(xsk->completion.producer, __ATOMIC_ACQUIRE);
+    const uint64_t *addrs = (const uint64_t *)xsk->completion.descs;
+    uint32_t mask = xsk->completion.size - 1;
+
+    while (xsk->completion.cached != producer)
+    {
+        uint64_t addr = addrs[xsk->completion.cached & mask];
+        xsk->tx_free[xsk->tx_free_count++] = (uint32_t)(addr / XDP_SOCKET_FRAME_SIZE);
+        xsk->completion.cached++;
+    }
+
+    __atomic_store_n(xsk->completion.consumer, xsk->completion.cached, __ATOMIC_RELEASE);
+}
+
+int xdp_socket_acquire_tx(struct xdp_socket *xsk, uint32_t *index)
+{
+    int waited_ms = 0;
+
+    while (xsk->tx_free_count == 0)
+    {
+        if (waited_ms >= XDP_SOCKET_ACQUIRE_TIMEOUT_MS)
+        {
+            fprintf(stderr, "Error: No AF_XDP transmit frame was completed in time\n");
+            return -1;
+        }
+
+        // Every frame is queued or in flight: make sure they were kicked, then wait for completions
+        if (xdp_socket_flush(xsk) != 0)
+        {
+            return -1;
+        }
+        if (xsk->tx_free_count == 0)
+        {
+            struct pollfd pfd = {.fd = xsk->fd, .events = POLLOUT};
+            poll(&pfd, 1, XDP_SOCKET_POLL_MS);
+            waited_ms += XDP_SOCKET_POLL_MS;
+            reap_completions(xsk);
+        }
+    }
+
+    *index = xsk->tx_free[--xsk->tx_free_count];
+    return 0;
+}
+
+void xdp_socket_commit_tx(struct xdp_socket *xsk, uint32_t index, size_t packet_len)
+{
+    // The TX ring holds as many entries as there are transmit frames, so it can never overflow
+    struct xdp_desc *desc = &((struct xdp_desc *)xsk->tx.descs)[xsk->tx.cached & (xsk->tx.size - 1)];
+    desc->addr = (uint64_t)index * XDP_SOCKET_FRAME_SIZE;
+    desc->len = (uint32_t)(ETHER_HDR_LEN + packet_len);
+    desc->options = 0;
+    xsk->tx.cached++;
+}
+
+int xdp_socket_flush(struct xdp_socket *xsk)
+{
+    __atomic_store_n(xsk->tx.producer, xsk->tx.cached, __ATOMIC_RELEASE);
+
+    if (sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 && errno != EAGAIN && errno != EBUSY && errno != ENOBUFS)
+    {
+        perror("Error: Failed to kick the AF_XDP TX ring");
+        return -1;
+    }
+
+    reap_completions(xsk);
+    return 0;
+}
+
+int xdp_socket_receive(struct xdp_socket *xsk, const uint8_t **frame, size_t *length, uint64_t *addr)
+{
+    uint32_t producer = __atomic_load_n(xsk->rx.producer, __ATOMIC_ACQUIRE);
+    if (xsk->rx.cached == producer)
+    {
+        return 0;
+    }
+
+    const struct xdp_desc *desc = &((const struct xdp_desc *)xsk->rx.descs)[xsk->rx.cached & (xsk->rx.size - 1)];
+    *addr = desc->addr;
+    *frame = xsk->umem + desc->addr;
+    *length = desc->len;
+
+    xsk->rx.cached++;
+    __atomic_store_n(xsk->rx.consumer, xsk->rx.cached, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void xdp_socket_release_rx(struct xdp_socket *xsk, uint64_t addr)
+{
+    // At most XDP_SOCKET_RX_FRAMES frames exist for reception, so the fill ring always has room
+    uint64_t *fill = (uint64_t *)xsk->fill.descs;
+    fill[xsk->fill.cached & (xsk->fill.size - 1)] = addr - (addr % XDP_SOCKET_FRAME_SIZE);
+    xsk->fill.cached++;
+    __atomic_store_n(xsk->fill.producer, xsk->fill.cached, __ATOMIC_RELEASE);
+}
+
+void xdp_socket_close(struct xdp_socket *xsk)
+{
+    int *fds[] = {&xsk->link_fd, &xsk->prog_fd, &xsk->map_fd, &xsk->fd};
+    struct xdp_ring *rings[] = {&xsk->rx, &xsk->tx, &xsk->fill, &xsk->completion};
+
+    for (size_t i = 0; i < sizeof(rings) / sizeof(rings[0]); i++)
+    {
+        if (rings[i]->map)
+        {
+            munmap(rings[i]->map, rings[i]->map_len);
+            rings[i]->map = NULL;
+        }
+    }
+
+    // The link goes first, so the program stops redirecting before the socket disappears
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+    {
+        if (*fds[i] >= 0)
+        {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+
+    if (xsk->umem)
+    {
+        munmap(xsk->umem, xsk->umem_len);
+        xsk->umem = NULL;
+        xsk->umem_len = 0;
+    }
+
+    free(xsk->tx_free);
+    xsk->tx_free = NULL;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file xdp_socket.h
+ * @brief AF_XDP kernel-bypass port: one UMEM shared by TX and RX, with fill and completion rings.
+ *
+ * @note A small XDP program redirects Echo Replies carrying our identifier, and every ICMP fragment,
+ *       to the socket; everything else (and anything that arrives on another queue) stays on the
+ *       regular kernel path. Fragments are reassembled by the receiver (see reassembly_cache.h).
+ *
+ * @author Jim Diroff II
+ */
+#ifndef XDP_SOCKET_H
+#define XDP_SOCKET_H
+
+#include <net/ethernet.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Size of one UMEM frame; a datagram plus its Ethernet header must fit in it.
+ */
+#define XDP_SOCKET_FRAME_SIZE 4096
+
+/**
+ * @brief UMEM frames handed to the kernel for reception (also the RX and fill ring sizes).
+ */
+#define XDP_SOCKET_RX_FRAMES 2048
+
+/**
+ * @brief Entries in the XSKMAP; the program indexes it by receive queue, so this bounds the queue number.
+ */
+#define XDP_SOCKET_MAP_ENTRIES 64
+
+/**
+ * @struct xdp_ring
+ * @brief User-space view of one of the four single-producer/single-consumer rings.
+ */
+struct xdp_ring
+{
+    uint32_t *producer; /**< Shared producer index */
+    uint32_t *consumer; /**< Shared consumer index */
+    void *descs;        /**< Ring entries: `struct xdp_desc` (RX/TX) or `uint64_t` UMEM addresses (fill/completion) */
+    uint32_t size;      /**< Number of entries (a power of two) */
+    uint32_t cached;    /**< Our private copy of the index we own (producer or consumer) */
+    void *map;          /**< Start of the ring mapping */
+    size_t map_len;     /**< Bytes mapped at @ref map */
+};
+
+/**
+ * @struct xdp_socket
+ * @brief One AF_XDP socket bound to a single interface queue, plus the XDP program steering replies to it.
+ *
+ * UMEM frames `[0, tx_frames)` hold prebuilt transmit datagrams and are patched in place; the rest
+ * are recycled through the fill ring for reception.
+ */
+struct xdp_socket
+{
+    int fd;                          /**< AF_XDP socket, or -1 when closed */
+    int map_fd;                      /**< XSKMAP the program redirects into */
+    int prog_fd;                     /**< The XDP program */
+    int link_fd;                     /**< Attachment of the program to the interface (detaches on close) */
+    uint8_t *umem;                   /**< Shared packet memory */
+    size_t umem_len;                 /**< Bytes at @ref umem */
+    uint32_t tx_frames;              /**< Frames reserved for transmission */
+    uint32_t *tx_free;               /**< Stack of transmit frames owned by user space */
+    uint32_t tx_free_count;          /**< Entries in @ref tx_free */
+    struct xdp_ring rx;              /**< Received frames, kernel to user */
+    struct xdp_ring tx;              /**< Frames to send, user to kernel */
+    struct xdp_ring fill;            /**< Free frames for reception, user to kernel */
+    struct xdp_ring completion;      /**< Sent frames, kernel to user */
+    uint8_t zero_copy;               /**< 1 if the driver maps UMEM directly, 0 in copy mode */
+    uint8_t src_mac[ETHER_ADDR_LEN]; /**< Interface hardware address */
+    uint8_t dst_mac[ETHER_ADDR_LEN]; /**< Next-hop hardware address */
+};
+
+/**
+ * @brief Creates the UMEM, the socket and its rings, binds @p queue of @p ifname and attaches the steering program.
+ * @param xsk            Pointer to the caller-allocated port.
+ * @param ifname         Interface to bind (e.g., "eth0").
+ * @param queue          Interface queue to bind; replies hashed to other queues reach the kernel stack instead.
+ * @param dst_mac        Next-hop hardware address.
+ * @param ethertype      Ethernet type of every transmitted frame (ETHERTYPE_IP or ETHERTYPE_IPV6).
+ * @param identifier     Echo identifier to steer (host byte order).
+ * @param tx_frames      Lower bound on the number of transmit frames.
+ * @param max_packet_len Largest L3 datagram that will be placed in a frame.
+ * @return 0 on success, -1 on failure (the port is left closed and the reason printed).
+ */
+int xdp_socket_open(struct xdp_socket *xsk, const char *ifname, uint32_t queue, const uint8_t dst_mac[ETHER_ADDR_LEN], uint16_t ethertype, uint16_t identifier, uint32_t tx_frames, size_t max_packet_len);
+
+/**
+ * @brief Points at the L3 area (just past the Ethernet header) of transmit frame @p index.
+ * @param xsk   Pointer to an open port.
+ * @param index Transmit frame index, below `tx_frames`.
+ * @return The frame's datagram memory, valid for as long as the port is open.
+ */
+uint8_t *xdp_socket_frame_data(const struct xdp_socket *xsk, uint32_t index);
+
+/**
+ * @brief Takes a transmit frame back from the kernel, waiting for completions if all are in flight.
+ * @param xsk   Pointer to an open port.
+ * @param index Output for the frame's index.
+ * @return 0 on success, -1 if no frame was released in time or the kick failed.
+ */
+int xdp_socket_acquire_tx(struct xdp_socket *xsk, uint32_t *index);
+
+/**
+ * @brief Queues transmit frame @p index (L3 length @p packet_len) on the TX ring.
+ * @param xsk        Pointer to an open port.
+ * @param index      Frame obtained from @ref xdp_socket_acquire_tx.
+ * @param packet_len Length of the datagram in the frame, the Ethernet header excluded.
+ */
+void xdp_socket_commit_tx(struct xdp_socket *xsk, uint32_t index, size_t packet_len);
+
+/**
+ * @brief Publishes every queued frame, kicks the kernel once and reaps finished transmissions.
+ * @param xsk Pointer to an open port.
+ * @return 0 on success, -1 on failure.
+ */
+int xdp_socket_flush(struct xdp_socket *xsk);
+
+/**
+ * @brief Takes the next received Ethernet frame off the RX ring without blocking.
+ * @param xsk    Pointer to an open port.
+ * @param frame  Output for the frame (Ethernet header first), valid until released.
+ * @param length Output for the frame length.
+ * @param addr   Output for the UMEM address, to pass to @ref xdp_socket_release_rx.
+ * @return 1 if a frame was taken, 0 if the ring is empty.
+ */
+int xdp_socket_receive(struct xdp_socket *xsk, const uint8_t **frame, size_t *length, uint64_t *addr);
+
+/**
+ * @brief Returns a received frame to the fill ring.
+ * @param xsk  Pointer to an open port.
+ * @param addr UMEM address from @ref xdp_socket_receive.
+ */
+void xdp_socket_release_rx(struct xdp_socket *xsk, uint64_t addr);
+
+/**
+ * @brief Detaches the program and releases the socket, rings and UMEM. Safe to call on a closed port.
+ * @param xsk Pointer to the port.
+ */
+void xdp_socket_close(struct xdp_socket *xsk);
+
+#endif /* XDP_SOCKET_H */